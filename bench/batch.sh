@@ -0,0 +1,52 @@
+#!/bin/sh
+#
+# Compares running a program once per argument set as separate processes against
+# running all of them with --batch, on one job and on several. Run it from the
+# repository's root: ./bench/batch.sh [jobs] [runs]
+
+JOBS=${1:-4}
+RUNS=${2:-2000}
+TMP=$(mktemp -d)
+trap 'rm -rf "$TMP"' EXIT
+
+make > /dev/null || exit 1
+
+# Sums the squares of the numbers up to N, a short run like most in a batch
+cat > "$TMP/squares.ipl" << 'IPL'
+argument 1 N
+i = 1
+while i <= N
+	sq = i * i
+	s = s + sq
+	i = i + 1
+writeln s
+IPL
+
+for i in $(seq "$RUNS"); do
+	echo $(( i % 500 ))
+done > "$TMP/args.txt"
+
+# Prints the wall-clock time (in ms) of a command
+time_of() {
+	start=$(date +%s%N)
+	"$@" > /dev/null
+	end=$(date +%s%N)
+	echo $(( (end - start) / 1000000 ))
+}
+
+separate() {
+	while read -r n; do
+		./ipli "$TMP/squares.ipl" "$n"
+	done < "$TMP/args.txt"
+}
+
+procs=$(time_of separate)
+one=$(time_of ./ipli --batch "$TMP/args.txt" "$TMP/squares.ipl")
+many=$(time_of ./ipli --batch "$TMP/args.txt" --jobs "$JOBS" "$TMP/squares.ipl")
+
+printf "%-24s %10s %9s\n" "$RUNS runs" "time" "speedup"
+printf "%-24s %10s %9s\n" "separate processes" "${procs}ms" "1.00x"
+for row in "--batch:$one" "--batch --jobs $JOBS:$many"; do
+	ms=${row##*:}
+	printf "%-24s %10s %9s\n" "${row%:*}" "${ms}ms" "$(awk "BEGIN { printf \"%.2fx\", $procs / $ms }")"
+done
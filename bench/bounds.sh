@@ -0,0 +1,59 @@
+#!/bin/sh
+#
+# Compares loading programs with many distinct names at -O0 and at -O1, where the
+# bounds analysis runs along with the other passes. Each program assigns its names
+# once and then runs 20 small loops, so loading it is nearly all of the work. Run it
+# from the repository's root: ./bench/bounds.sh [runs]
+
+RUNS=${1:-3}
+TMP=$(mktemp -d)
+trap 'rm -rf "$TMP"' EXIT
+
+make > /dev/null || exit 1
+
+# Writes a program with $1 names besides the loops' own to $2
+generate() {
+	i=0
+	while [ $i -lt "$1" ]; do
+		echo "v$i = $i"
+		i=$((i + 1))
+	done
+
+	echo "n = 10"
+	echo "new a[n]"
+
+	i=0
+	while [ $i -lt 20 ]; do
+		echo "c$i = 0"
+		echo "while c$i < n"
+		echo "	a[c$i] = a[c$i] + v$i"
+		echo "	c$i = c$i + 1"
+		i=$((i + 1))
+	done
+
+	echo "writeln a[3]"
+} > "$2"
+
+# Prints the best wall-clock time (in ms) out of $RUNS runs of a command
+best_of() {
+	best=""
+	for i in $(seq "$RUNS"); do
+		start=$(date +%s%N)
+		"$@" > /dev/null
+		end=$(date +%s%N)
+		ms=$(( (end - start) / 1000000 ))
+		if [ -z "$best" ] || [ "$ms" -lt "$best" ]; then
+			best=$ms
+		fi
+	done
+	echo "$best"
+}
+
+printf "%-8s %10s %10s %10s\n" "names" "-O0" "-O1" "removed"
+for n in 1000 3000 6000 20000; do
+	generate "$n" "$TMP/names.ipl"
+	removed=$(./ipli --stats "$TMP/names.ipl" 2>&1 > /dev/null \
+		| awk '/bounds checks removed/ { print $NF }')
+	printf "%-8s %10s %10s %10s\n" "$n" "$(best_of ./ipli -O0 "$TMP/names.ipl")ms" \
+		"$(best_of ./ipli -O1 "$TMP/names.ipl")ms" "$removed"
+done
@@ -0,0 +1,39 @@
+#!/bin/sh
+#
+# Compares loading a large program from its text against running its bytecode
+# out of the --cache directory. Run it from the repository's root: ./bench/cache.sh [runs]
+
+RUNS=${1:-100}
+TMP=$(mktemp -d)
+trap 'rm -rf "$TMP"' EXIT
+
+make > /dev/null || exit 1
+
+# Lots of straight-line code, so that loading the program is most of the work
+i=0
+while [ $i -lt 3000 ]; do
+	echo "t = x$(((i + 7) % 50)) * 3"
+	echo "x$((i % 50)) = t + $i"
+	echo "if x$((i % 50)) > 1000"
+	echo "	x$((i % 50)) = x$((i % 50)) % 997"
+	i=$((i + 1))
+done > "$TMP/big.ipl"
+echo "writeln x0" >> "$TMP/big.ipl"
+
+# Prints the wall-clock time (in ms) of $RUNS runs of a command
+time_of() {
+	start=$(date +%s%N)
+	for i in $(seq "$RUNS"); do
+		"$@" "$TMP/big.ipl" > /dev/null
+	done
+	end=$(date +%s%N)
+	echo $(( (end - start) / 1000000 ))
+}
+
+cold=$(time_of ./ipli)
+./ipli --cache "$TMP/cache" "$TMP/big.ipl" > /dev/null
+warm=$(time_of ./ipli --cache "$TMP/cache")
+
+printf "%-24s %10s %12s\n" "$RUNS runs" "time" "per run"
+printf "%-24s %10s %12s\n" "./ipli" "${cold}ms" "$(awk "BEGIN { printf \"%.0fus\", $cold * 1000 / $RUNS }")"
+printf "%-24s %10s %12s\n" "./ipli --cache" "${warm}ms" "$(awk "BEGIN { printf \"%.0fus\", $warm * 1000 / $RUNS }")"
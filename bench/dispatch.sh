@@ -0,0 +1,48 @@
+#!/bin/sh
+#
+# Compares the VM's threaded dispatch against the portable switch dispatch on
+# CPU-bound programs (with the JIT off), and both against the JIT. Run it from the
+# repository's root: ./bench/dispatch.sh [runs]
+
+RUNS=${1:-3}
+TMP=$(mktemp -d)
+trap 'rm -rf "$TMP"' EXIT
+
+make clean > /dev/null && make DISPATCH=switch > /dev/null || exit 1
+mv ipli "$TMP/ipli-switch"
+make clean > /dev/null && make > /dev/null || exit 1
+cp ipli "$TMP/ipli-threaded"
+
+# primes.ipl has its limit hard-coded, so scale it up
+sed 's/number <= 100$/number <= 1000000/' programs/primes.ipl > "$TMP/primes.ipl"
+
+# Prints the best wall-clock time (in ms) out of $RUNS runs of a command
+best_of() {
+	best=""
+	for i in $(seq "$RUNS"); do
+		start=$(date +%s%N)
+		"$@" > /dev/null
+		end=$(date +%s%N)
+		ms=$(( (end - start) / 1000000 ))
+		if [ -z "$best" ] || [ "$ms" -lt "$best" ]; then
+			best=$ms
+		fi
+	done
+	echo "$best"
+}
+
+bench() {
+	name=$1
+	shift
+	switch=$(best_of "$TMP/ipli-switch" --no-jit "$@")
+	threaded=$(best_of "$TMP/ipli-threaded" --no-jit "$@")
+	jit=$(best_of "$TMP/ipli-threaded" "$@")
+	printf "%-24s %10s %10s %9s %10s %9s\n" "$name" "${switch}ms" "${threaded}ms" \
+		"$(awk "BEGIN { printf \"%.2fx\", $switch / $threaded }")" "${jit}ms" \
+		"$(awk "BEGIN { printf \"%.2fx\", $switch / $jit }")"
+}
+
+printf "%-24s %10s %10s %9s %10s %9s\n" "program" "switch" "threaded" "speedup" "jit" "speedup"
+bench "primes (1000000)" "$TMP/primes.ipl"
+bench "nqueens (24)" programs/nqueens.ipl 24
+bench "matrmult (300x300x300)" programs/matrmult.ipl 300 300 300
@@ -0,0 +1,114 @@
+// Fills a map with n keys and looks all of them up (and as many that aren't there),
+// printing the best time per operation over a number of runs, along with a digest of
+// what the lookups found (which every map should agree on). The keys are ints hashed
+// to themselves, like the compiler's constants, and generated names hashed by
+// default_hash. Built and run by bench/map.sh, once per map implementation
+
+#include <time.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "map.h"
+
+typedef struct workload {
+	const char* name;
+	void** keys; // The first n are put in the map, the other n are looked up as misses
+	int (*cmp_keys)(void*, void*);
+	unsigned long (*hash_function)(void*);
+} Workload;
+
+static int cmp_ints(void* a, void* b) {
+	return *((int*) a) - *((int*) b);
+}
+
+static unsigned long hash_int(void* key) {
+	return (unsigned int) *((int*) key);
+}
+
+static double elapsed(struct timespec* start) {
+	struct timespec end;
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	return (end.tv_sec - start->tv_sec) + (end.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+static void run_workload(const char* label, Workload* workload, int n, int runs) {
+	double best[3] = { 0 };
+	unsigned long digest = 0;
+
+	for (int run = 0; run < runs; run++) {
+		struct timespec start;
+		double seconds[3];
+		unsigned long run_digest = 0;
+
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		Map map = map_create(workload->cmp_keys, NULL, NULL, workload->hash_function);
+		for (int i = 0; i < n; i++) {
+			map_put(map, workload->keys[i], (void*) (long) (i + 1));
+		}
+		seconds[0] = elapsed(&start);
+
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		for (int i = 0; i < n; i++) {
+			run_digest = (run_digest ^ (long) map_get(map, workload->keys[i])) * 1099511628211UL;
+		}
+		seconds[1] = elapsed(&start);
+
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		for (int i = n; i < 2 * n; i++) {
+			run_digest = (run_digest ^ (long) map_get(map, workload->keys[i])) * 1099511628211UL;
+		}
+		seconds[2] = elapsed(&start);
+
+		map_destroy(map);
+
+		for (int phase = 0; phase < 3; phase++) {
+			if (run == 0 || seconds[phase] < best[phase]) {
+				best[phase] = seconds[phase];
+			}
+		}
+		digest = run_digest;
+	}
+
+	printf("%-8s %-8s %9d %10.1f %10.1f %10.1f %18lx\n", label, workload->name, n,
+		best[0] / n * 1e9, best[1] / n * 1e9, best[2] / n * 1e9, digest);
+}
+
+int main(int argc, char* argv[]) {
+	if (argc != 4) {
+		fprintf(stderr, "Usage: ./map <label> <n> <runs>\n");
+		return 1;
+	}
+
+	int n = atoi(argv[2]);
+	int runs = atoi(argv[3]);
+
+	int* ints = malloc(2 * n * sizeof(int));
+	char (*names)[24] = malloc(2 * n * sizeof(*names));
+	void** int_keys = malloc(2 * n * sizeof(void*));
+	void** name_keys = malloc(2 * n * sizeof(void*));
+
+	// Distinct keys with irregular gaps, the same ones on every run and for every map
+	srand(42);
+	for (int i = 0; i < 2 * n; i++) {
+		ints[i] = i * 1009 + rand() % 1009;
+		int_keys[i] = &ints[i];
+
+		snprintf(names[i], sizeof(names[i]), "name_%d", ints[i]);
+		name_keys[i] = names[i];
+	}
+
+	Workload workloads[] = {
+		{ "ints", int_keys, cmp_ints, hash_int },
+		{ "names", name_keys, NULL, NULL }
+	};
+
+	for (int w = 0; w < 2; w++) {
+		run_workload(argv[1], &workloads[w], n, runs);
+	}
+
+	free(ints);
+	free(names);
+	free(int_keys);
+	free(name_keys);
+	return 0;
+}
@@ -0,0 +1,66 @@
+// Puts n distinct names in an empty map, timing every map_put on its own, and prints
+// the mean and the worst time per put. The worst one is where a map that moves all
+// of its entries at once when it grows stalls. Built and run by bench/rehash.sh, once
+// per map implementation
+
+#include <time.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "map.h"
+
+static long nanoseconds(void) {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec * 1000000000L + now.tv_nsec;
+}
+
+int main(int argc, char* argv[]) {
+	if (argc != 4) {
+		fprintf(stderr, "Usage: ./rehash <label> <n> <runs>\n");
+		return 1;
+	}
+
+	int n = atoi(argv[2]);
+	int runs = atoi(argv[3]);
+
+	char (*names)[24] = malloc(n * sizeof(*names));
+	for (int i = 0; i < n; i++) {
+		snprintf(names[i], sizeof(names[i]), "name_%d", i);
+	}
+
+	// The least noisy run is the one reported, for the mean and the worst put alike
+	double best_mean = 0;
+	long best_worst = 0;
+
+	for (int run = 0; run < runs; run++) {
+		Map map = map_create(NULL, NULL, NULL, NULL);
+		long total = 0;
+		long worst = 0;
+
+		for (int i = 0; i < n; i++) {
+			long start = nanoseconds();
+			map_put(map, names[i], names[i]);
+			long elapsed = nanoseconds() - start;
+
+			total += elapsed;
+			if (elapsed > worst) {
+				worst = elapsed;
+			}
+		}
+
+		map_destroy(map);
+
+		if (run == 0 || (double) total / n < best_mean) {
+			best_mean = (double) total / n;
+		}
+		if (run == 0 || worst < best_worst) {
+			best_worst = worst;
+		}
+	}
+
+	printf("%-12s %9d %10.1f %12.1f\n", argv[1], n, best_mean, best_worst / 1e3);
+
+	free(names);
+	return 0;
+}
@@ -0,0 +1,23 @@
+#!/bin/sh
+#
+# Compares the mean and the worst map_put time of the map that moves its entries
+# incrementally when it grows, the same map built to move them all at once
+# (make REHASH=full) and the separate chaining one it replaced (bench/chained_map.c).
+# Run it from the repository's root: ./bench/rehash.sh [runs]
+
+RUNS=${1:-5}
+TMP=$(mktemp -d)
+trap 'rm -rf "$TMP"' EXIT
+
+CFLAGS="-O2 -Imodules/map"
+
+gcc $CFLAGS bench/rehash.c bench/chained_map.c -o "$TMP/rehash-chained" || exit 1
+gcc $CFLAGS -DFULL_REHASH bench/rehash.c modules/map/map.c -o "$TMP/rehash-full" || exit 1
+gcc $CFLAGS bench/rehash.c modules/map/map.c -o "$TMP/rehash" || exit 1
+
+printf "%-12s %9s %10s %12s\n" "map" "n" "mean ns" "worst us"
+for n in 1000 100000 1000000; do
+	"$TMP/rehash-chained" chained $n "$RUNS"
+	"$TMP/rehash-full" full $n "$RUNS"
+	"$TMP/rehash" incremental $n "$RUNS"
+done
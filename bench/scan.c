@@ -0,0 +1,68 @@
+// Scans a program over and over and prints the scanner's best throughput, along
+// with a digest of the tokens (which every build of the scanner should agree on).
+// Built and run by bench/scan.sh
+
+#include <time.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "charclass.h"
+#include "scanner.h"
+#include "source.h"
+
+int main(int argc, char* argv[]) {
+	if (argc != 3) {
+		fprintf(stderr, "Usage: ./scan <file> <runs>\n");
+		return 1;
+	}
+
+	SourceFile file;
+	if (!open_source(argv[1], &file)) {
+		fprintf(stderr, "Error: unable to open input file\n");
+		return 1;
+	}
+
+	double best = 0;
+	unsigned long digest = 0;
+	int n_tokens = 0;
+
+	for (int run = 0; run < atoi(argv[2]); run++) {
+		struct timespec start, end;
+		clock_gettime(CLOCK_MONOTONIC, &start);
+
+		// The tokens are pulled the way the parser does, so the digest is part of the run
+		TokenStream* tokens = scan_tokens(file.text, file.size);
+		unsigned long run_digest = 0;
+		int i = 0;
+
+		for (;; i++) {
+			Token token = get_token(tokens, i);
+			unsigned long fields[] = { token.type, token.start, token.length, token.line };
+			for (int f = 0; f < 4; f++) {
+				run_digest = (run_digest ^ fields[f]) * 1099511628211UL;
+			}
+
+			if (token.type == ENDOFFILE) {
+				break;
+			}
+			release_tokens(tokens, i);
+		}
+
+		destroy_tokens(tokens);
+		clock_gettime(CLOCK_MONOTONIC, &end);
+
+		double seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+		if (run == 0 || seconds < best) {
+			best = seconds;
+		}
+
+		digest = run_digest;
+		n_tokens = i + 1;
+	}
+
+	printf("%-8s %10.0f %10d %18lx\n", char_skippers()->isa, file.size / best / 1e6, n_tokens,
+		digest);
+
+	close_source(&file);
+	return 0;
+}
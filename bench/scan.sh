@@ -0,0 +1,37 @@
+#!/bin/sh
+#
+# Measures the scanner alone (in MB/s) on a large generated program, with the
+# character skippers that the CPU supports and with the scalar ones. Both should
+# produce the same tokens. Run it from the repository's root: ./bench/scan.sh [runs]
+
+RUNS=${1:-10}
+TMP=$(mktemp -d)
+trap 'rm -rf "$TMP"' EXIT
+
+CFLAGS="-O2 -Iinclude -Imodules/vector -Imodules/map -pthread"
+
+make clean > /dev/null && make SCANNER=scalar > /dev/null || exit 1
+gcc $CFLAGS bench/scan.c libipl.a -o "$TMP/scan-scalar" || exit 1
+make clean > /dev/null && make > /dev/null || exit 1
+gcc $CFLAGS bench/scan.c libipl.a -o "$TMP/scan" || exit 1
+
+# Long names, indented blocks and comments, which is where the skippers help
+i=0
+while [ $i -lt 2000 ]; do
+	echo "# Block $i, which computes nothing in particular but keeps the scanner busy"
+	echo "while iteration_counter_$((i % 40)) < upper_bound_of_the_loop"
+	echo "	accumulated_value_$((i % 40)) = accumulated_value_$((i % 40)) + 1234567"
+	echo "	if accumulated_value_$((i % 40)) >= 987654321   # keep it in range"
+	echo "		accumulated_value_$((i % 40)) = accumulated_value_$((i % 40)) % 1000003"
+	echo "	iteration_counter_$((i % 40)) = iteration_counter_$((i % 40)) + 1"
+	i=$((i + 1))
+done > "$TMP/block.ipl"
+
+# Copies of the blocks make up a few megabytes
+for i in $(seq 20); do
+	cat "$TMP/block.ipl"
+done > "$TMP/big.ipl"
+
+printf "%-8s %10s %10s %18s\n" "isa" "MB/s" "tokens" "digest"
+"$TMP/scan-scalar" "$TMP/big.ipl" "$RUNS"
+"$TMP/scan" "$TMP/big.ipl" "$RUNS"
@@ -0,0 +1,60 @@
+#!/bin/sh
+#
+# Compares starting ipli for every run of a program against sending the runs to an
+# ipli --serve server through iplc (whose cache keeps the program loaded). Run it
+# from the repository's root: ./bench/serve.sh [runs]
+
+RUNS=${1:-500}
+TMP=$(mktemp -d)
+SOCKET="$TMP/ipli.sock"
+
+make > /dev/null || exit 1
+
+./ipli --serve "$SOCKET" &
+SERVER=$!
+trap 'kill $SERVER; rm -rf "$TMP"' EXIT
+
+# Sorts a small array, so that loading the program is most of the work
+cat > "$TMP/sort.ipl" << 'IPL'
+argument 1 n
+new a[n]
+i = 0
+while i < n
+	t = n - i
+	t = t * 7
+	a[i] = t % 31
+	i = i + 1
+i = 0
+while i < n
+	j = i + 1
+	while j < n
+		if a[j] < a[i]
+			t = a[i]
+			a[i] = a[j]
+			a[j] = t
+		j = j + 1
+	i = i + 1
+writeln a[0]
+IPL
+
+while [ ! -S "$SOCKET" ]; do
+	sleep 0.1
+done
+
+# Prints the wall-clock time (in ms) of $RUNS runs of a command
+time_of() {
+	start=$(date +%s%N)
+	for i in $(seq "$RUNS"); do
+		"$@" "$TMP/sort.ipl" 20 > /dev/null
+	done
+	end=$(date +%s%N)
+	echo $(( (end - start) / 1000000 ))
+}
+
+cold=$(time_of ./ipli)
+export IPLI_SOCKET="$SOCKET"
+warm=$(time_of ./iplc)
+
+printf "%-24s %10s %12s\n" "$RUNS runs" "time" "per run"
+printf "%-24s %10s %12s\n" "./ipli" "${cold}ms" "$(awk "BEGIN { printf \"%.0fus\", $cold * 1000 / $RUNS }")"
+printf "%-24s %10s %12s\n" "./iplc (cached)" "${warm}ms" "$(awk "BEGIN { printf \"%.0fus\", $warm * 1000 / $RUNS }")"
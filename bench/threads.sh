@@ -0,0 +1,59 @@
+#!/bin/sh
+#
+# Compares running independent loops on one thread against splitting them across
+# several (on both engines). Run it from the repository's root:
+# ./bench/threads.sh [threads] [runs]
+
+THREADS=${1:-4}
+RUNS=${2:-3}
+TMP=$(mktemp -d)
+trap 'rm -rf "$TMP"' EXIT
+
+make > /dev/null || exit 1
+
+# Counts the divisors of every number up to N, one number per iteration
+cat > "$TMP/divisors.ipl" << 'IPL'
+argument 1 N
+new counts[N]
+i = 1
+while i < N
+	count = 0
+	d = 1
+	while d <= i
+		r = i % d
+		if r == 0
+			count = count + 1
+		d = d + 1
+	counts[i] = count
+	total = total + count
+	i = i + 1
+writeln total
+IPL
+
+# Prints the best wall-clock time (in ms) out of $RUNS runs of a command
+best_of() {
+	best=""
+	for i in $(seq "$RUNS"); do
+		start=$(date +%s%N)
+		"$@" > /dev/null
+		end=$(date +%s%N)
+		ms=$(( (end - start) / 1000000 ))
+		if [ -z "$best" ] || [ "$ms" -lt "$best" ]; then
+			best=$ms
+		fi
+	done
+	echo "$best"
+}
+
+bench() {
+	name=$1
+	shift
+	one=$(best_of ./ipli "$@")
+	many=$(best_of ./ipli --threads "$THREADS" "$@")
+	printf "%-24s %10s %10s %9s\n" "$name" "${one}ms" "${many}ms" \
+		"$(awk "BEGIN { printf \"%.2fx\", $one / $many }")"
+}
+
+printf "%-24s %10s %10s %9s\n" "program" "1 thread" "$THREADS threads" "speedup"
+bench "divisors (vm)" "$TMP/divisors.ipl" 20000
+bench "divisors (tree)" --engine=tree "$TMP/divisors.ipl" 20000
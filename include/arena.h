@@ -0,0 +1,20 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+// A bump allocator for things that all go away together (e.g. a program's names).
+// It hands out memory from chunks that get larger as it fills up, and nothing
+// is freed on its own, only the whole arena at once
+typedef struct arena Arena;
+
+// Constructs and returns a new empty arena
+Arena* arena_create(void);
+
+// Returns size bytes out of arena, aligned for any of the types that are put in it
+void* arena_alloc(Arena* arena, size_t size);
+
+// Frees all memory allocated for arena
+void arena_destroy(Arena* arena);
+
+#endif // ARENA_H
@@ -0,0 +1,13 @@
+#ifndef BOUNDS_H
+#define BOUNDS_H
+
+#include "stmt.h"
+#include "vector.h"
+
+// Tracks the value ranges of variables, the sizes of arrays and which variables
+// are known to be less than others, and marks every array access whose array is
+// proven to exist and whose index is proven to be in range. Returns the number of
+// accesses that were marked. The symbols are the ones returned by the resolver
+int eliminate_bounds_checks(Tree* tree, Block stmts, Vector symbols);
+
+#endif // BOUNDS_H
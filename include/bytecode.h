@@ -0,0 +1,100 @@
+#ifndef BYTECODE_H
+#define BYTECODE_H
+
+#include "idiom.h"
+#include "dependence.h"
+
+// Register-based three-address code. Registers [0, n_slots) hold the program's
+// variables and the registers after them are used for temporaries. Constants live
+// at negative register indices, i.e. constant k is register -(k+1), so that any
+// operand can refer to a constant without a separate addressing mode.
+typedef enum op_code {
+	// a = b, a = b <op> c
+	OP_MOVE, OP_ADD, OP_SUB, OP_MUL, OP_DIV, OP_MOD,
+
+	// Jump to a unconditionally, if b is (not) zero or if b <cmp> c holds
+	OP_JUMP, OP_JUMP_ZERO, OP_JUMP_NOT_ZERO,
+	OP_JUMP_EQ, OP_JUMP_NE, OP_JUMP_LT, OP_JUMP_LE, OP_JUMP_GT, OP_JUMP_GE,
+
+	// a = array b at index c, array a at index b = c
+	OP_GET_ELEM, OP_SET_ELEM,
+
+	// Name checks for slot a, only needed for names used both as arrays & variables
+	OP_CHECK_VAR, OP_CHECK_ARRAY, OP_CHECK_NEW,
+
+	// new a[b], free a, a = size of array b
+	OP_NEW, OP_FREE, OP_SIZE,
+
+	// Built-in commands that store into register a (b is the argument index)
+	OP_READ, OP_RANDOM, OP_ARG, OP_ARG_SIZE,
+
+	// Write register a (or nothing) followed by a space or a newline
+	OP_WRITE, OP_WRITELN, OP_WRITE_SPACE, OP_WRITE_NEWLINE,
+
+	// Raise the runtime error with status a, stop execution
+	OP_ERROR, OP_HALT,
+
+	// Start of the body of loop a, whose code ends right before b. Counts the
+	// loop's iterations, so that it can be compiled to native code once it's hot
+	OP_LOOP_HEAD,
+
+	// Run the loop described by idiom b with a kernel and jump to a, or fall
+	// through to the loop itself if the kernel can't run it
+	OP_KERNEL,
+
+	// Run the iterations of parallel loop b on all threads and jump to a, or fall
+	// through to the loop itself if it isn't worth it
+	OP_PARALLEL,
+
+	// Superinstructions produced by the peephole pass (b and c are immediates):
+	// a += b, jump to a if b <cmp> c and array a at index b += (-=) c
+	OP_INCREMENT,
+	OP_JUMP_EQ_IMM, OP_JUMP_NE_IMM, OP_JUMP_LT_IMM,
+	OP_JUMP_LE_IMM, OP_JUMP_GT_IMM, OP_JUMP_GE_IMM,
+	OP_ADD_ELEM, OP_SUB_ELEM,
+
+	N_OPS
+} OpCode;
+
+// The peephole pattern that produced an instruction
+typedef enum fusion {
+	NO_FUSION, FUSED_INCREMENT, FUSED_COMPARE_BRANCH, FUSED_ELEM_UPDATE, FUSED_OP_INTO_VAR,
+	N_FUSIONS
+} Fusion;
+
+typedef struct instr {
+	OpCode op;
+	int a;
+	int b;
+	int c;
+} Instr;
+
+// A parallel loop along with a program of its own that every worker of the loop
+// runs on its own registers. The program runs the iterations from the counter's
+// value up to (but not including) the value of register end and then halts
+typedef struct parallel_code {
+	ParallelLoop* loop; // Owned by the loop's statement
+	struct program* body;
+	int end;
+} ParallelCode;
+
+typedef struct program {
+	Instr* code;
+	int* lines; // Source line of each instruction (for runtime errors)
+	Fusion* fusions; // Peephole pattern of each instruction (for --stats)
+	int n_code;
+	int* consts; // The k-th constant is loaded in register -(k+1)
+	int n_consts;
+	int n_slots;
+	int n_temps;
+	int n_loops;
+	Idiom* idioms; // The loops that OP_KERNEL runs
+	int n_idioms;
+	ParallelCode* parallel; // The loops that OP_PARALLEL runs
+	int n_parallel;
+} Program;
+
+// Frees all memory allocated for program
+void destroy_program(Program* program);
+
+#endif // BYTECODE_H
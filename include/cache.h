@@ -0,0 +1,46 @@
+#ifndef CACHE_H
+#define CACHE_H
+
+#include <stddef.h>
+#include <stdbool.h>
+
+#include "optimizer.h"
+#include "bytecode.h"
+
+// What the passes did to a program, which a cache file keeps for --stats
+typedef struct pass_stats {
+	OptStats opt;
+	int n_hoisted;
+	int n_parallel;
+	int n_reduced;
+	int n_removed;
+	int n_vectorized;
+} PassStats;
+
+// What a compiled program depends on besides its text
+typedef struct cache_key {
+	int opt_level;
+	bool parallel; // Parallel loops were split out (i.e. there's more than one thread)
+} CacheKey;
+
+// A program whose bytecode is used right from a cache file's mapping
+typedef struct mapped_program MappedProgram;
+
+// Hashes a program's text (FNV-1a)
+unsigned long hash_text(const char* text, size_t size);
+
+// Maps the cache file in dir that holds the compiled form of source under key and
+// returns it, or NULL if there's none or it's out of date (e.g. written for another
+// text or by a build of other sources) or it can't be trusted. Sets *program and *stats
+MappedProgram* cache_load(const char* dir, const char* source, size_t size, CacheKey key,
+	Program** program, PassStats* stats);
+
+// Writes the compiled form of source under key to a cache file in dir, replacing
+// the one that's there (if any) atomically. Failing to write it isn't an error
+void cache_store(const char* dir, const char* source, size_t size, CacheKey key,
+	Program* program, PassStats* stats);
+
+// Frees all memory allocated for mapped, including its program, and unmaps it
+void cache_unmap(MappedProgram* mapped);
+
+#endif // CACHE_H
@@ -0,0 +1,17 @@
+#ifndef CHARCLASS_H
+#define CHARCLASS_H
+
+// The character classes that the scanner skips over in runs. Each skipper returns
+// the first character in [p, end) that's not in its class, or end if there's none
+typedef struct char_skippers {
+	const char* isa;
+	const char* (*name)(const char* p, const char* end); // Letters, digits and underscores
+	const char* (*digits)(const char* p, const char* end);
+	const char* (*blanks)(const char* p, const char* end); // Spaces and tabs
+	const char* (*tabs)(const char* p, const char* end);
+} CharSkippers;
+
+// Returns the widest skippers that the CPU supports
+const CharSkippers* char_skippers(void);
+
+#endif // CHARCLASS_H
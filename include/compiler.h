@@ -0,0 +1,13 @@
+#ifndef COMPILER_H
+#define COMPILER_H
+
+#include "vector.h"
+
+#include "stmt.h"
+#include "bytecode.h"
+
+// Lowers a block of resolved statements (in tree) into a bytecode program. The
+// symbols are the ones returned by the resolver for the same statements
+Program* compile(Tree* tree, Block stmts, Vector symbols);
+
+#endif // COMPILER_H
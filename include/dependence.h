@@ -0,0 +1,41 @@
+#ifndef DEPENDENCE_H
+#define DEPENDENCE_H
+
+#include <stdbool.h>
+
+#include "vector.h"
+
+#include "stmt.h"
+#include "idiom.h"
+
+// A loop of the form while i < n (or i <= n) { <body>; i = i + 1; } whose
+// iterations don't depend on each other: every array that the body writes is
+// only ever accessed at index i, and every variable that it writes is either
+// assigned before it's used in each iteration or only added to (a reduction).
+// The body itself is the loop's, which later passes may still rebuild
+//
+// A variable that only the loops nested in the body assign isn't assigned by the
+// iterations in which they don't run, so it's tracked: right after the assignment
+// that comes first, the body sets a stamp of its own to the counter, which tells
+// the iteration that assigned the variable last
+typedef struct parallel_loop {
+	int counter;
+	Operand limit;
+	bool inclusive; // The condition is i <= n rather than i < n
+	int* reductions; // Variables that the body only updates by s = s + e or s = s - e
+	int n_reductions;
+	int* written; // Every variable that the body writes, including the above
+	int n_written;
+	int* tracked; // Variables that only the loops nested in the body assign
+	int* stamps; // The stamp of every tracked variable, indexed like tracked
+	int n_tracked;
+} ParallelLoop;
+
+// Attaches a ParallelLoop to every outermost loop that can run its iterations in
+// any order, as long as it doesn't read or write anything, allocate or free arrays,
+// draw random numbers or break out of itself and its names are never used both as
+// variables and as arrays. Returns the number of loops that were found (which are
+// allocated along with the rest of the tree)
+int parallelize_loops(Tree* tree, Block stmts, Vector symbols);
+
+#endif // DEPENDENCE_H
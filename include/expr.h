@@ -1,49 +1,59 @@
 #ifndef EXPR_H
 #define EXPR_H
 
+#include <stdint.h>
+#include <stdbool.h>
+
 #include "token.h"
 
+typedef struct tree Tree;
+
 typedef enum expr_type {
 	LITERAL, VAR, ARRAY, BINARY
 } ExprType;
 
-typedef struct expr {
-	ExprType type;
-	void* expr;
-} Expr;
+#define N_EXPR_TYPES 4
+
+// Every kind of expression is stored in an array of its own, so an expression is
+// referred to by its kind (in the low two bits) and its index among those nodes
+typedef uint32_t Expr;
+
+#define NO_EXPR ((Expr) UINT32_MAX) // e.g. the value of a write statement without one
+#define EXPR_TYPE(expr) ((ExprType) ((expr) & 3))
+#define EXPR_INDEX(expr) ((int) ((expr) >> 2))
+#define MAKE_EXPR(type, index) (((Expr) (index) << 2) | (Expr) (type))
 
 typedef struct literal {
 	int value;
 } Literal;
 
 typedef struct var {
-	char* id;
-	int value; // This will be useful for the runtime
+	int slot; // The name's index among the program's symbols
 } Var;
 
 typedef struct array {
-	char* id;
-	Expr* index;
+	int slot; // The name's index among the program's symbols
+	Expr index;
+	bool in_bounds; // Set by the bounds analysis if the access can't fail
 } Array;
 
 typedef struct binary {
 	TokenType type;
-	Expr* left;
-	Expr* right;
+	Expr left;
+	Expr right;
 } Binary;
 
-// Constructors for the above types
-Expr* create_expr(ExprType type, void* expr);
-Literal* create_literal(int value);
-Var* create_var(char* id);
-Array* create_array(char* id, Expr* index);
-Binary* create_binary(TokenType type, Expr* left, Expr* right);
-
-// Destructors for the above types
-void destroy_expr(void* expr);
-void destroy_literal(void* expr);
-void destroy_var(void* expr);
-void destroy_array(void* expr);
-void destroy_binary(void* expr);
+// Constructors for the above types, which add the node to tree
+Expr create_literal(Tree* tree, int value);
+Expr create_var(Tree* tree, int slot);
+Expr create_array(Tree* tree, int slot, Expr index);
+Expr create_binary(Tree* tree, TokenType type, Expr left, Expr right);
+
+// Return the node that expr refers to in tree. Creating more nodes of the same kind
+// may move them, so the pointers are only good until then
+Literal* get_literal(Tree* tree, Expr expr);
+Var* get_var(Tree* tree, Expr expr);
+Array* get_array(Tree* tree, Expr expr);
+Binary* get_binary(Tree* tree, Expr expr);
 
 #endif // EXPR_H
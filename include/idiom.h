@@ -0,0 +1,40 @@
+#ifndef IDIOM_H
+#define IDIOM_H
+
+#include <stdbool.h>
+
+#include "stmt.h"
+#include "vector.h"
+
+typedef enum idiom_type {
+	IDIOM_FILL,  // a[i] = v
+	IDIOM_COPY,  // a[i] = b[i]
+	IDIOM_SCALE, // a[i] = b[i] * v
+	IDIOM_ADD,   // a[i] = b[i] + c[i]
+	IDIOM_SUM,   // s = s + b[i]
+	IDIOM_MAX    // if b[i] > m then m = b[i]
+} IdiomType;
+
+typedef struct operand {
+	bool is_var;
+	int value; // The literal's value, or the variable's slot
+} Operand;
+
+// A loop of the form while i < n { <idiom>; i = i + 1; }, where n and v are
+// literals or variables that the loop never writes
+typedef struct idiom {
+	IdiomType type;
+	int counter;
+	Operand limit;
+	int target; // The array that's written, or the variable that accumulates
+	int src1;
+	int src2;
+	Operand value;
+} Idiom;
+
+// Attaches an Idiom to every loop that has one of the above shapes and whose
+// names are never used both as variables and as arrays, so that the engines can
+// run it with a kernel instead. Returns the number of loops that were recognized
+int recognize_idioms(Tree* tree, Block stmts, Vector symbols);
+
+#endif // IDIOM_H
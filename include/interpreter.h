@@ -1,9 +1,12 @@
 #ifndef INTERPRETER_H
 #define INTERPRETER_H
 
-#include "vector.h"
+#include "stmt.h"
+#include "tree.h"
+#include "runtime.h"
 
-// Executes a program that's represented as a vector of statements
-void execute(Vector stmts, int argc, char **argv);
+// Executes a program that's represented as a block of resolved statements in tree,
+// whose names have been assigned slots in [0, n_slots), doing its I/O through io
+void execute(Tree* tree, Block stmts, int n_slots, int argc, char **argv, RunIO io);
 
 #endif // INTERPRETER_H
@@ -0,0 +1,77 @@
+#ifndef IPL_H
+#define IPL_H
+
+#include <stdio.h>
+#include <stdbool.h>
+
+#include "runtime.h"
+
+// The interpreter as a library: a program is loaded (scanned, parsed, optimized and
+// compiled) once and can then be run any number of times, one run at a time. Errors
+// are returned instead of terminating the process. Each load keeps its state to
+// itself, so different threads can load programs at the same time
+
+typedef enum ipl_engine {
+	IPL_ENGINE_VM, IPL_ENGINE_TREE
+} IplEngine;
+
+typedef struct ipl_options {
+	IplEngine engine;
+	int opt_level; // 0 runs the program exactly as it was written
+	bool jit; // Compile hot loops to native code (VM only)
+	bool stats; // Report what the passes and the VM did on stderr
+	const char* cache_dir; // Where the VM's bytecode is cached across processes (or NULL)
+} IplOptions;
+
+typedef struct ipl_error {
+	int status; // The exit code that ipli reports the error with
+	char msg[MAX_ERROR]; // The message exactly as ipli prints it
+} IplError;
+
+typedef struct ipl_program IplProgram;
+
+// Returns the options that ipli runs programs with by default
+IplOptions ipl_default_options(void);
+
+// Sets the number of threads that parallel loops are split across, for every
+// program in the process. Must be called before any program is loaded
+void ipl_set_threads(int n_threads);
+
+// Loads the program stored at path. Returns NULL and fills in error if the file
+// can't be opened or the program has a lexical or syntax error
+IplProgram* ipl_program_load(const char* path, IplOptions options, IplError* error);
+
+// Same as ipl_program_load, but the program's text is given (path is only used as
+// its name)
+IplProgram* ipl_program_load_source(const char* path, const char* source, size_t size,
+	IplOptions options, IplError* error);
+
+// Runs a program with the given arguments (the ones that come after the file on
+// ipli's command line). Returns 0, or the status of the runtime error that ended
+// it, in which case error is filled in
+int ipl_run(IplProgram* program, int argc, char** argv, IplError* error);
+
+// Same as ipl_run, but the program does its I/O through io instead of the standard
+// streams and rand()
+int ipl_run_io(IplProgram* program, int argc, char** argv, RunIO io, IplError* error);
+
+// Runs a program once for every line of args (its arguments, separated by spaces),
+// with up to n_jobs runs at a time. Every run has its own variables and random
+// numbers and no input. The runs' output is written to out in the order of their
+// lines, each followed by its error message on stderr if it failed. Returns 0 if
+// every run succeeded, or else the status of the first one that didn't
+int ipl_run_batch(IplProgram* program, FILE* args, int n_jobs, FILE* out);
+
+// Listens for requests (see wire.h) on a Unix socket at socket_path and runs them
+// with the given options, caching the programs by their text so that each one is
+// only loaded once. Only returns if the socket can't be opened, with its status
+int ipl_serve(const char* socket_path, IplOptions options, IplError* error);
+
+// Writes a standalone C translation of the program to out (not available for
+// programs whose bytecode came from the cache)
+void ipl_emit_c(IplProgram* program, FILE* out);
+
+// Frees all memory allocated for program
+void ipl_program_free(IplProgram* program);
+
+#endif // IPL_H
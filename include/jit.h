@@ -0,0 +1,27 @@
+#ifndef JIT_H
+#define JIT_H
+
+#include "runtime.h"
+#include "bytecode.h"
+
+// Native code for a loop is entered at the start of its body and returns the pc
+// where the virtual machine has to resume. That's either where control left the
+// loop, or an instruction that the native code doesn't handle itself (I/O, name
+// checks, or any instruction that's about to raise a runtime error), which the
+// virtual machine then executes as usual
+typedef int (*NativeLoop)(int* regs, ArrayDesc* arrays);
+
+typedef struct native_code {
+	NativeLoop entry;
+	void* mem;
+	unsigned long size;
+} NativeCode;
+
+// Compiles the loop whose OP_LOOP_HEAD is at pc head to native code. Returns NULL
+// on platforms other than x86-64 or if executable memory can't be allocated
+NativeCode* jit_compile(Program* program, int head);
+
+// Frees all memory allocated for code
+void jit_destroy(NativeCode* code);
+
+#endif // JIT_H
@@ -0,0 +1,19 @@
+#ifndef KERNELS_H
+#define KERNELS_H
+
+#include <stdbool.h>
+
+#include "idiom.h"
+#include "runtime.h"
+
+// Runs a recognized loop with the widest kernels that the CPU supports, leaving
+// the variables and arrays exactly as the loop itself would (the counter ends up
+// at the limit). vars and arrays are indexed by slot. Returns false without
+// changing anything if an element that the loop accesses doesn't exist, so that
+// the loop can run normally and fail where it would have failed anyway
+bool run_idiom(Idiom* idiom, int* vars, ArrayDesc* arrays);
+
+// The instruction set of the kernels that run_idiom uses
+const char* kernel_isa(void);
+
+#endif // KERNELS_H
@@ -0,0 +1,21 @@
+#ifndef LICM_H
+#define LICM_H
+
+#include "stmt.h"
+#include "vector.h"
+
+// Moves the expressions of every loop whose operands the loop never writes into
+// temporaries that are assigned right before the loop, so that they're computed
+// once instead of on every iteration. Only expressions that can't fail are moved,
+// since the loop may not run at all. The temporaries are added to the symbols.
+// Returns the number of expressions that were moved out of a loop
+int hoist_invariants(Tree* tree, Block* stmts, Vector symbols);
+
+// Replaces every multiplication of an induction variable (one that a loop only
+// advances by a constant, like k = k + 1) by a loop invariant with a temporary,
+// which starts out as the product before the loop and is advanced by a running
+// addition right after the induction variable is. Returns the number of
+// multiplications that were replaced
+int reduce_strength(Tree* tree, Block* stmts, Vector symbols);
+
+#endif // LICM_H
@@ -0,0 +1,20 @@
+#ifndef OPTIMIZER_H
+#define OPTIMIZER_H
+
+#include "stmt.h"
+#include "vector.h"
+
+// What the optimizer did, reported by --stats
+typedef struct opt_stats {
+	int n_propagated; // Variable reads replaced by their constant value
+	int n_folded; // Binary expressions replaced by their value
+	int n_removed; // Branches and loops that could never be taken
+} OptStats;
+
+// Propagates constants through assignments, folds binary expressions whose
+// operands are literals and removes if/else arms and loops that can never be
+// taken, rewriting the resolved statements (in tree) in place. Divisions by 0 are left
+// alone, so that they still fail at runtime
+OptStats optimize(Tree* tree, Block* stmts, Vector symbols);
+
+#endif // OPTIMIZER_H
@@ -0,0 +1,32 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <stdbool.h>
+
+#include "dependence.h"
+
+// How an engine runs a parallel loop's body on the pool's workers: vars returns the
+// variables (indexed by slot) that the given worker's iterations run on, and run
+// runs the iterations in [start, end) on them, in order. Both only use state that
+// belongs to that worker, and a runtime error leaves the counter at the iteration
+// that raised it
+typedef struct loop_body {
+	int* (*vars)(void* state, int worker);
+	void (*run)(void* state, int worker, int start, int end);
+	void* state;
+} LoopBody;
+
+// Sets the number of threads that parallel loops are split across (1 by default,
+// which runs every loop sequentially)
+void set_threads(int n_threads);
+
+// Returns the number of threads, i.e. the number of workers that a body may run on
+int get_threads(void);
+
+// Runs the iterations of a parallel loop on a work-stealing thread pool, leaving
+// vars exactly as running the loop would. If an iteration fails, the error of the
+// earliest failing one is raised. Returns false without changing anything if the
+// loop isn't worth splitting, in which case it should run as usual
+bool run_parallel(ParallelLoop* loop, int* vars, int n_slots, LoopBody* body);
+
+#endif // PARALLEL_H
@@ -1,10 +1,11 @@
 #ifndef PARSER_H
 #define PARSER_H
 
-#include "vector.h"
+#include "stmt.h"
+#include "token.h"
 
-// Parses a stream of tokens and returns a vector of statements ready to be executed
-// by the interpreter
-Vector parse(Vector tokens);
+// Parses a stream of tokens into tree and returns the program's top-level block,
+// ready to be executed by the interpreter
+Block parse(Tree* tree, TokenStream* tokens);
 
 #endif // PARSER_H
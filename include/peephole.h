@@ -0,0 +1,10 @@
+#ifndef PEEPHOLE_H
+#define PEEPHOLE_H
+
+#include "bytecode.h"
+
+// Fuses the instruction sequences that IPL's statement shapes compile to into
+// superinstructions, recording which pattern produced each instruction
+void fuse_instructions(Program* program);
+
+#endif // PEEPHOLE_H
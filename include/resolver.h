@@ -0,0 +1,28 @@
+#ifndef RESOLVER_H
+#define RESOLVER_H
+
+#include <stdbool.h>
+
+#include "stmt.h"
+#include "vector.h"
+
+typedef struct symbol {
+	char* name;
+	bool is_var;   // The name appears somewhere as a variable
+	bool is_array; // The name appears somewhere as an array
+} Symbol;
+
+// The parser already stores the index of every name among the scanner's names in
+// the corresponding Var/Array nodes and named statements, so that index is also
+// the name's slot. Returns a vector with the symbols of all slots (the i-th symbol
+// corresponds to slot i), each recording how its name is used in stmts (in tree)
+Vector resolve(Tree* tree, Block stmts, Vector names);
+
+// Names that are used both as a variable and as an array need runtime checks
+bool is_mixed_symbol(Symbol* symbol);
+
+// Adds a variable that doesn't appear in the program (e.g. a temporary that's
+// introduced by an optimization) to the symbols and returns its slot
+int add_var_symbol(Vector symbols, char* name);
+
+#endif // RESOLVER_H
@@ -0,0 +1,56 @@
+#ifndef RUNTIME_H
+#define RUNTIME_H
+
+#include <stdio.h>
+#include <setjmp.h>
+
+#define MAX_ERROR 256
+
+// What a slot currently holds; a freed array's slot goes back to UNBOUND
+typedef enum slot_kind {
+	UNBOUND, BOUND_VAR, BOUND_ARRAY
+} SlotKind;
+
+typedef struct array_desc {
+	int size;
+	int* elems;
+} ArrayDesc;
+
+// Where a run reads its input from (NULL if it has none), where it writes its output
+// to and the state of its random numbers (NULL draws them from rand(), which srand
+// seeds)
+typedef struct run_io {
+	FILE* in;
+	FILE* out;
+	unsigned* seed;
+} RunIO;
+
+// While a trap is set, the errors of the thread that set it jump back to env with
+// the error filled in, instead of terminating the program
+typedef struct error_trap {
+	jmp_buf env;
+	int status;
+	char msg[MAX_ERROR]; // The message exactly as it would be printed
+} ErrorTrap;
+
+// Reports an error (formatted like printf) and terminates the program with the
+// given status
+void report_error(int status, const char* format, ...);
+
+// Reports a runtime error and terminates the program with the given status
+void runtime_error(char* msg, int line, int status);
+
+// Sets the calling thread's trap (NULL to terminate on errors again) and returns
+// the one it replaces
+ErrorTrap* set_error_trap(ErrorTrap* trap);
+
+// Reports an error that a trap caught once more, e.g. after cleaning up
+void rethrow_error(ErrorTrap* trap);
+
+// Reads an integer from io's input (0 if there's none left)
+int read_input(RunIO* io);
+
+// Draws a random number in [0, RAND_MAX] from io's generator
+int draw_random(RunIO* io);
+
+#endif // RUNTIME_H
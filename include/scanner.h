@@ -1,11 +1,33 @@
 #ifndef SCANNER_H
 #define SCANNER_H
 
-#include <stdio.h>
+#include <stddef.h>
 
 #include "vector.h"
 
-// Tokenize input coming from stream and return a vector of tokens
-Vector scan_tokens(FILE* stream);
+#include "token.h"
+
+// Start tokenizing the size bytes of source. The tokens are scanned as they're
+// asked for, or by a thread of their own that runs ahead of the parser for larger
+// programs, and only the ones that haven't been released yet are kept around
+TokenStream* scan_tokens(const char* source, size_t size);
+
+// Returns the i-th token, reporting a lexical error if the scanner ran into one
+// before it. The last token is always an ENDOFFILE
+Token get_token(TokenStream* tokens, int i);
+
+// Lets the scanner reuse the room taken by the tokens before the i-th one, which
+// may not be asked for anymore
+void release_tokens(TokenStream* tokens, int i);
+
+// Scans whatever is left of the text (throwing the tokens away), so that a lexical
+// error anywhere in it gets reported, and the names are all in
+void finish_tokens(TokenStream* tokens);
+
+// The distinct names in the order they were first seen (complete after finish_tokens)
+Vector token_names(TokenStream* tokens);
+
+// Frees all memory allocated for the tokens (but not the text they point into)
+void destroy_tokens(TokenStream* tokens);
 
 #endif // SCANNER_H
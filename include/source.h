@@ -0,0 +1,26 @@
+#ifndef SOURCE_H
+#define SOURCE_H
+
+#include <stddef.h>
+#include <stdbool.h>
+
+// A program's text, mapped from its file when that's a regular one or read into
+// memory otherwise (e.g. when it's a pipe)
+typedef struct source_file {
+	char* text;
+	size_t size;
+	bool mapped;
+} SourceFile;
+
+// Opens the program at path, or returns false if it can't be opened and read (or
+// it's neither a file nor a pipe)
+bool open_source(const char* path, SourceFile* file);
+
+// Releases the text of a program opened with open_source
+void close_source(SourceFile* file);
+
+// Reads the whole text of the program at path, or returns NULL if open_source
+// would return false. The caller frees it
+char* read_source(const char* path, size_t* size);
+
+#endif // SOURCE_H
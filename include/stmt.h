@@ -4,7 +4,6 @@
 #include <stdbool.h>
 
 #include "expr.h"
-#include "vector.h"
 
 typedef enum stmt_type {
 	READ_STMT, ASSIGNMENT_STMT,
@@ -15,56 +14,78 @@ typedef enum stmt_type {
 	NEW_STMT, FREE_STMT, SIZE_STMT
 } StmtType;
 
+#define N_STMT_TYPES 14
+
+// Like expressions, every kind of statement keeps its fields in an array of its
+// own, and the statement itself only refers to them by their index there
 typedef struct stmt {
 	int line; // This comes in handy for error handling
 	StmtType type;
-	void* stmt;
+	int index;
 } Stmt;
 
+// The statements of a block are stored next to each other, so a block is just the
+// range of them that it takes up among the tree's statements
+typedef struct block {
+	int first;
+	int n_stmts;
+} Block;
+
+// Statements that are collected before they're stored as a block, e.g. while a
+// pass rebuilds one
+typedef struct stmt_list {
+	Stmt* stmts;
+	int n_stmts;
+	int cap;
+} StmtList;
+
 typedef struct read_stmt {
 	bool is_array;
-	void* lvalue;
+	Expr lvalue; // A VAR or an ARRAY expression
 } ReadStmt;
 
 typedef struct assignment_stmt {
 	bool is_array;
-	void* lvalue;
-	Expr* expr;
+	Expr lvalue;
+	Expr expr;
 } AssignmentStmt;
 
 typedef struct write_stmt {
-	Expr* expr;
+	Expr expr;
 } WriteStmt;
 
 typedef struct writeln_stmt {
-	Expr* expr;
+	Expr expr;
 } WritelnStmt;
 
 typedef struct while_stmt {
-	Expr* cond;
-	Vector stmts;
+	Expr cond;
+	Block stmts;
+	struct idiom* idiom; // Set by the idiom recognizer if a kernel can run the loop
+	struct parallel_loop* parallel; // Set by the dependence analysis if its iterations are independent
 } WhileStmt;
 
 typedef struct if_else_stmt {
-	Expr* cond;
-	Vector then_stmts;
-	Vector else_stmts;
+	Expr cond;
+	Block then_stmts;
+	Block else_stmts;
+	bool has_else;
 } IfElseStmt;
 
 typedef struct random_stmt {
 	bool is_array;
-	void* lvalue;
+	Expr lvalue;
 } RandomStmt;
 
 typedef struct arg_size_stmt {
 	bool is_array;
-	void* lvalue;
+	Expr lvalue;
 } ArgSizeStmt;
 
 typedef struct arg_stmt {
-	Expr* expr;
+	Expr expr;
 	bool is_array;
-	void* lvalue;
+	Expr lvalue;
 } ArgStmt;
 
 typedef struct break_stmt {
@@ -76,52 +97,54 @@ typedef struct continue_stmt {
 } ContinueStmt;
 
 typedef struct new_stmt {
-	char* id;
-	Expr* size;
+	int slot; // The name's index among the program's symbols
+	Expr size;
 } NewStmt;
 
 typedef struct free_stmt {
-	char* id;
+	int slot; // The name's index among the program's symbols
 } FreeStmt;
 
 typedef struct size_stmt {
-	char* id;
+	int slot; // The name's index among the program's symbols
 	bool is_array;
-	void* lvalue;
+	Expr lvalue;
 } SizeStmt;
 
-// Constructors for the above types
-Stmt* create_stmt(int line, StmtType type, void* stmt);
-ReadStmt* create_read_stmt(bool is_array, void* lvalue);
-AssignmentStmt* create_assignment_stmt(bool is_array, void* lvalue, Expr* expr);
-WriteStmt* create_write_stmt(Expr* expr);
-WritelnStmt* create_writeln_stmt(Expr* expr);
-WhileStmt* create_while_stmt(Expr* cond, Vector stmts);
-IfElseStmt* create_if_else_stmt(Expr* cond, Vector then_stmts, Vector else_stmts);
-RandomStmt* create_random_stmt(bool is_array, void* lvalue);
-ArgSizeStmt* create_arg_size_stmt(bool is_array, void* lvalue);
-ArgStmt* create_arg_stmt(Expr* expr, bool is_array, void* lvalue);
-BreakStmt* create_break_stmt(int n_loops);
-ContinueStmt* create_continue_stmt(int n_loops);
-NewStmt* create_new_stmt(char* id, Expr* size);
-FreeStmt* create_free_stmt(char* id);
-SizeStmt* create_size_stmt(char* id, bool is_array, void* lvalue);
-
-// Destructors for the above types
-void destroy_stmt(void* stmt);
-void destroy_read_stmt(void* stmt);
-void destroy_assignment_stmt(void* stmt);
-void destroy_write_stmt(void* stmt);
-void destroy_writeln_stmt(void* stmt);
-void destroy_while_stmt(void* stmt);
-void destroy_if_else_stmt(void* stmt);
-void destroy_random_stmt(void* stmt);
-void destroy_arg_size_stmt(void* stmt);
-void destroy_arg_stmt(void* stmt);
-void destroy_break_stmt(void* stmt);
-void destroy_continue_stmt(void* stmt);
-void destroy_new_stmt(void* stmt);
-void destroy_free_stmt(void* stmt);
-void destroy_size_stmt(void* stmt);
+// Constructors for the above types. The fields are added to tree and their index is
+// returned, which create_stmt turns into a statement
+Stmt create_stmt(int line, StmtType type, int index);
+int create_read_stmt(Tree* tree, bool is_array, Expr lvalue);
+int create_assignment_stmt(Tree* tree, bool is_array, Expr lvalue, Expr expr);
+int create_write_stmt(Tree* tree, Expr expr);
+int create_writeln_stmt(Tree* tree, Expr expr);
+int create_while_stmt(Tree* tree, Expr cond, Block stmts);
+int create_if_else_stmt(Tree* tree, Expr cond, Block then_stmts, Block else_stmts, bool has_else);
+int create_random_stmt(Tree* tree, bool is_array, Expr lvalue);
+int create_arg_size_stmt(Tree* tree, bool is_array, Expr lvalue);
+int create_arg_stmt(Tree* tree, Expr expr, bool is_array, Expr lvalue);
+int create_break_stmt(Tree* tree, int n_loops);
+int create_continue_stmt(Tree* tree, int n_loops);
+int create_new_stmt(Tree* tree, int slot, Expr size);
+int create_free_stmt(Tree* tree, int slot);
+int create_size_stmt(Tree* tree, int slot, bool is_array, Expr lvalue);
+
+// Returns the fields of the statement (e.g. a WhileStmt*), which move when more
+// statements of the same kind are created
+void* get_payload(Tree* tree, Stmt* stmt);
+
+// Returns a copy of the i-th statement of the block
+Stmt get_stmt(Tree* tree, Block block, int i);
+
+// Copies the statements into tree as a new block and returns it
+Block store_block(Tree* tree, Stmt* stmts, int n_stmts);
+
+// Makes the statements the contents of block, reusing its place if they fit there
+void replace_block(Tree* tree, Block* block, Stmt* stmts, int n_stmts);
+
+// Operations on lists of statements that are yet to be stored
+void init_stmt_list(StmtList* list);
+void add_stmt(StmtList* list, Stmt stmt);
+void free_stmt_list(StmtList* list);
 
 #endif // STMT_H
@@ -24,9 +24,16 @@ typedef enum token_type {
 
 typedef struct token {
 	TokenType type;
-	char* lexeme;
-	int literal; // Useful for numbers (slow to call atoi all the time)
+	int start; // The lexeme is the slice [start, start + length) of the program's text
+	int length;
+	int literal; // A number's value, or a name's index among the program's names
 	int line; // This comes in handy for error handling
 } Token;
 
+// The tokens of a program as the scanner hands them out (see scanner.h). They point
+// into its text rather than own copies of their lexemes (so the text must outlive
+// them). Every distinct name is kept once, so later stages can tell names apart by
+// their index alone
+typedef struct token_stream TokenStream;
+
 #endif // TOKEN_H
@@ -0,0 +1,14 @@
+#ifndef TRANSLATOR_H
+#define TRANSLATOR_H
+
+#include <stdio.h>
+
+#include "stmt.h"
+#include "vector.h"
+
+// Translates a block of resolved statements (in tree) into a standalone C program
+// that's written to out. The symbols are the ones returned by the resolver for the
+// same statements and source is the name of the IPL file (only used in a comment)
+void translate_to_c(Tree* tree, Block stmts, Vector symbols, char* source, FILE* out);
+
+#endif // TRANSLATOR_H
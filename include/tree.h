@@ -0,0 +1,67 @@
+#ifndef TREE_H
+#define TREE_H
+
+#include <stddef.h>
+
+#include "arena.h"
+#include "expr.h"
+#include "stmt.h"
+
+// Nodes of a single kind, stored contiguously and referred to by their index
+typedef struct node_array {
+	char* items;
+	int n_items;
+	int cap;
+	int item_size;
+} NodeArray;
+
+// A program's nodes, grouped by their kind. Nothing refers to a node by its
+// address, so the arrays can grow by reallocating and the whole tree goes away at
+// once, without visiting any of its nodes
+typedef struct tree {
+	NodeArray exprs[N_EXPR_TYPES]; // Indexed by ExprType
+	NodeArray payloads[N_STMT_TYPES]; // The statements' fields, indexed by StmtType
+	NodeArray stmts; // The blocks' statements
+	Arena* arena; // For what hangs off a node (e.g. an idiom)
+} Tree;
+
+// Constructs and returns a new empty tree
+Tree* tree_create(void);
+
+// Frees all memory allocated for tree
+void tree_destroy(Tree* tree);
+
+// Appends n nodes to the array and returns the index of the first one
+int add_nodes(NodeArray* nodes, const void* items, int n);
+
+// Allocates size bytes for something that hangs off a node from the tree's arena
+void* alloc_node(Tree* tree, size_t size);
+
+// Accessors without the checks of get_literal and the like, for the engines that run
+// a program after it's loaded
+static inline Literal* tree_literal(Tree* tree, Expr expr) {
+	return (Literal*) tree->exprs[LITERAL].items + EXPR_INDEX(expr);
+}
+
+static inline Var* tree_var(Tree* tree, Expr expr) {
+	return (Var*) tree->exprs[VAR].items + EXPR_INDEX(expr);
+}
+
+static inline Array* tree_array(Tree* tree, Expr expr) {
+	return (Array*) tree->exprs[ARRAY].items + EXPR_INDEX(expr);
+}
+
+static inline Binary* tree_binary(Tree* tree, Expr expr) {
+	return (Binary*) tree->exprs[BINARY].items + EXPR_INDEX(expr);
+}
+
+static inline void* tree_payload(Tree* tree, Stmt* stmt) {
+	NodeArray* payloads = &tree->payloads[stmt->type];
+	return payloads->items + (size_t) stmt->index * payloads->item_size;
+}
+
+static inline Stmt* tree_stmt(Tree* tree, Block block, int i) {
+	return (Stmt*) tree->stmts.items + block.first + i;
+}
+
+#endif // TREE_H
@@ -0,0 +1,17 @@
+#ifndef VM_H
+#define VM_H
+
+#include <stdbool.h>
+
+#include "runtime.h"
+#include "bytecode.h"
+
+typedef struct vm_options {
+	bool stats; // Report execution counts per peephole pattern on stderr
+	bool jit; // Compile hot loops to native code
+} VMOptions;
+
+// Runs a bytecode program on the register machine, doing its I/O through io
+void run_program(Program* program, int argc, char **argv, VMOptions options, RunIO io);
+
+#endif // VM_H
@@ -0,0 +1,31 @@
+#ifndef WIRE_H
+#define WIRE_H
+
+#include <stdbool.h>
+
+// The protocol between ipli --serve and its clients. A client connects to the
+// server's Unix socket and sends a request: its stdin, stdout and stderr (passed as
+// file descriptors) along with the program's path and arguments. The server runs
+// the program on those streams and replies with the status that ipli would exit with
+
+#define N_STREAMS 3
+
+// Sends the streams and the strings (the path, followed by the arguments) over sock.
+// Returns false if the connection failed
+bool send_request(int sock, int streams[N_STREAMS], int n_strings, char** strings);
+
+// Receives a request sent by send_request. The strings are allocated for the caller,
+// who frees them with free_strings. Returns false if the connection failed or the
+// request is malformed
+bool receive_request(int sock, int streams[N_STREAMS], int* n_strings, char*** strings);
+
+// Frees strings received by receive_request
+void free_strings(int n_strings, char** strings);
+
+// Sends the status that a request finished with
+bool send_status(int sock, int status);
+
+// Receives the status that a request finished with
+bool receive_status(int sock, int* status);
+
+#endif // WIRE_H
@@ -1,33 +1,58 @@
-// Hash table (separate chaining) implementation of a map
+// Hash table (open addressing) implementation of a map
+//
+// Every slot has a control byte, which is either EMPTY, DELETED or the low 7 bits
+// of the slot's hash. A lookup compares a whole group of control bytes against the
+// hash at once and only calls cmp_keys for the slots that match, moving on to the
+// next group (triangular probing) until it meets one with an EMPTY slot
+//
+// When the table fills up, its entries are moved to a new one a few slots at a time,
+// on every map_put and map_remove that follows, so that no single operation has to
+// move all of them. Until they've all moved, lookups look at both tables
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
 #include <assert.h>
 #include <string.h>
 
 #include "map.h"
 
-#define MIN_CAP 64
+#if defined(__SSE2__)
+#define SSE2_GROUPS
+#include <emmintrin.h>
+#endif
+
+#define MIN_CAP 64 // Always a power of two, and at least GROUP_SIZE
+#define GROUP_SIZE 16
+
+// How many of the old table's slots every operation moves. Building with FULL_REHASH
+// defined (make REHASH=full) moves all of them at once instead
+#define MIGRATE_SLOTS 32
+
+#define EMPTY ((int8_t) -128)
+#define DELETED ((int8_t) -2)
+
+#define H1(hash) ((hash) >> 7) // Where the probing starts
+#define H2(hash) ((int8_t) ((hash) & 0x7F)) // What's kept in the control byte
 
 typedef struct {
+	uint64_t hash; // Kept so that moving the entries doesn't hash the keys again
 	void* key;
 	void* value;
-} KVPair;
+} Slot;
 
-typedef struct node {
-	KVPair* pair;
-	struct node *next;
-} Node;
-
-typedef struct list {
-	Node* head;
-	int size;
-} List;
+typedef struct {
+	int cap;
+	int growth_left; // How many EMPTY slots can still be filled before growing
+	int8_t* ctrl; // cap bytes, followed by a copy of the first GROUP_SIZE ones
+	Slot* slots;
+} Table;
 
 struct map {
 	int size;
-	int cap;
-	List** buckets;
+	Table table; // Where new entries are put
+	Table old; // The table that's being moved into table (ctrl is NULL if there's none)
+	int migrated; // How many of the old table's slots have been moved
 
 	int (*cmp_keys)(void*, void*);
 	void (*destroy_key)(void*);
@@ -35,97 +60,173 @@ struct map {
 	unsigned long (*hash_function)(void*);
 };
 
-static KVPair* create_kvpair(void* key, void* value) {
-	KVPair* new_kvpair = malloc(sizeof(KVPair));
-	assert(new_kvpair != NULL);
-
-	new_kvpair->key = key;
-	new_kvpair->value = value;
+// Helper functions used by the map (no reason to expose them)
+static void init_table(Table* table, int cap);
+static void free_table(Table* table);
+static uint64_t hash_key(Map map, void* key);
+static Slot* find_slot(Map map, void* key, uint64_t hash, Table** table);
+static int find_in_table(Map map, Table* table, void* key, uint64_t hash);
+static int find_free_slot(Table* table, uint64_t hash);
+static void set_ctrl(Table* table, int i, int8_t ctrl);
+static void start_migration(Map map, int cap);
+static void migrate(Map map, int n_slots);
+
+// Bit i of a mask is set if the group's i-th control byte matched
+static inline unsigned match_byte(const int8_t* group, int8_t ctrl) {
+#ifdef SSE2_GROUPS
+	__m128i bytes = _mm_loadu_si128((const __m128i*) group);
+	return (unsigned) _mm_movemask_epi8(_mm_cmpeq_epi8(bytes, _mm_set1_epi8(ctrl)));
+#else
+	unsigned mask = 0;
+	for (int i = 0; i < GROUP_SIZE; i++) {
+		mask |= (unsigned) (group[i] == ctrl) << i;
+	}
+	return mask;
+#endif
+}
 
-	return new_kvpair;
+// EMPTY and DELETED are the only negative control bytes
+static inline unsigned match_free(const int8_t* group) {
+#ifdef SSE2_GROUPS
+	return (unsigned) _mm_movemask_epi8(_mm_loadu_si128((const __m128i*) group));
+#else
+	unsigned mask = 0;
+	for (int i = 0; i < GROUP_SIZE; i++) {
+		mask |= (unsigned) (group[i] < 0) << i;
+	}
+	return mask;
+#endif
 }
 
-static Node* create_node(KVPair* kvpair, Node* next) {
-	Node* new_node = malloc(sizeof(Node));
-	assert(new_node != NULL);
+static void init_table(Table* table, int cap) {
+	table->cap = cap;
+	table->growth_left = cap - cap / 8; // Grow if load factor reaches 87.5%
 
-	new_node->pair = kvpair;
-	new_node->next = next;
+	table->ctrl = malloc(cap + GROUP_SIZE);
+	table->slots = malloc(cap * sizeof(Slot));
+	assert(table->ctrl != NULL && table->slots != NULL);
 
-	return new_node;
+	memset(table->ctrl, EMPTY, cap + GROUP_SIZE);
 }
 
-static List* create_list(void) {
-	List* new_list = malloc(sizeof(List));
-	assert(new_list != NULL);
+static void free_table(Table* table) {
+	free(table->ctrl);
+	free(table->slots);
+	table->ctrl = NULL;
+}
+
+// The user's hash is mixed, since both H1 and H2 need bits that vary from key to
+// key (e.g. hashing ints to themselves would otherwise leave H2 always 0)
+static uint64_t hash_key(Map map, void* key) {
+	uint64_t hash = map->hash_function(key);
 
-	new_list->head = NULL;
-	new_list->size = 0;
+	hash ^= hash >> 33;
+	hash *= 0xff51afd7ed558ccdULL;
+	hash ^= hash >> 33;
+	hash *= 0xc4ceb9fe1a85ec53ULL;
+	hash ^= hash >> 33;
 
-	return new_list;
+	return hash;
 }
 
-static void destroy_list(List* list) {
-	assert(list != NULL);
-	Node* temp;
-	Node* curr = list->head;
+// Returns the slot that holds key and sets table to the table it's in, or returns
+// NULL if key is not in map
+static Slot* find_slot(Map map, void* key, uint64_t hash, Table** table) {
+	*table = &map->table;
+	int i = find_in_table(map, *table, key, hash);
 
-	// Don't destroy the keys/values, only the strutures that contain them
-	while (curr != NULL) {
-		temp = curr;
-		curr = curr->next;
-		free(temp->pair);
-		free(temp);
+	if (i < 0 && map->old.ctrl != NULL) {
+		*table = &map->old;
+		i = find_in_table(map, *table, key, hash);
 	}
 
-	free(list);
+	return i < 0 ? NULL : &(*table)->slots[i];
 }
 
-static void add_to_list(List* list, void* kvpair) {
-	assert(list != NULL);
-	Node* new_node = create_node(kvpair, list->head);
-	list->head = new_node;
-	list->size++;
-}
+// Returns the slot of table that holds key, or -1 if it's not there
+static int find_in_table(Map map, Table* table, void* key, uint64_t hash) {
+	int mask = table->cap - 1;
+	int pos = H1(hash) & mask;
 
-static Node* find_node_in_list(Map map, List* list, KVPair* pair) {
-	if (list == NULL) return NULL;
+	for (int stride = GROUP_SIZE;; stride += GROUP_SIZE) {
+		const int8_t* group = table->ctrl + pos;
 
-	Node* curr = list->head;
+		for (unsigned match = match_byte(group, H2(hash)); match != 0; match &= match - 1) {
+			int i = (pos + __builtin_ctz(match)) & mask;
+			if (table->slots[i].hash == hash && map->cmp_keys(table->slots[i].key, key) == 0) {
+				return i;
+			}
+		}
 
-	while (curr != NULL) {
-		if (map->cmp_keys(curr->pair->key, pair->key) == 0) {
-			return curr;
+		if (match_byte(group, EMPTY) != 0) {
+			return -1;
 		}
 
-		curr = curr->next;
+		pos = (pos + stride) & mask;
 	}
+}
 
-	return NULL;
+// Returns the first EMPTY or DELETED slot along hash's probe sequence
+static int find_free_slot(Table* table, uint64_t hash) {
+	int mask = table->cap - 1;
+	int pos = H1(hash) & mask;
+
+	for (int stride = GROUP_SIZE;; stride += GROUP_SIZE) {
+		unsigned match = match_free(table->ctrl + pos);
+		if (match != 0) {
+			return (pos + __builtin_ctz(match)) & mask;
+		}
+
+		pos = (pos + stride) & mask;
+	}
 }
 
-static void rehash(Map map) {
-	List** old_buckets = map->buckets;
-	int old_cap = map->cap;
+// The copy past the end lets a group that wraps around be loaded at once
+static void set_ctrl(Table* table, int i, int8_t ctrl) {
+	table->ctrl[i] = ctrl;
+	if (i < GROUP_SIZE) {
+		table->ctrl[table->cap + i] = ctrl;
+	}
+}
 
-	map->cap *= 2;
-	map->buckets = calloc(map->cap, sizeof(List)); // NULL-initialization here
+// Starts moving the entries to a table with cap slots, which also drops the DELETED
+// ones. The new table has room for all of them (and then some) by the time they've
+// moved, since it's at least half empty and MIGRATE_SLOTS slots move per insertion
+static void start_migration(Map map, int cap) {
+	if (map->old.ctrl != NULL) {
+		migrate(map, map->old.cap); // Only if DELETED slots filled the new table up
+	}
 
-	void (*destroy_value)(void*) = map->destroy_value;
-	map->destroy_value = NULL;
+	map->old = map->table;
+	map->migrated = 0;
+	init_table(&map->table, cap);
 
-	for (int i = 0; i < old_cap; i++) {
-		Node* curr = old_buckets[i]->head;
+#ifdef FULL_REHASH
+	migrate(map, map->old.cap);
+#endif
+}
 
-		while (curr != NULL) {
-			map_put(map, curr->pair->key, curr->pair->value);
-			curr = curr->next;
+// Moves the entries of the old table's next n_slots slots to the new one. The slots
+// that are left behind are DELETED, so that the lookups that probe past them in the
+// old table still reach the entries that haven't moved yet
+static void migrate(Map map, int n_slots) {
+	Table* old = &map->old;
+	int end = map->migrated + n_slots < old->cap ? map->migrated + n_slots : old->cap;
+
+	for (int i = map->migrated; i < end; i++) {
+		if (old->ctrl[i] >= 0) {
+			int j = find_free_slot(&map->table, old->slots[i].hash);
+			map->table.growth_left -= map->table.ctrl[j] == EMPTY;
+			set_ctrl(&map->table, j, old->ctrl[i]);
+			map->table.slots[j] = old->slots[i];
+			set_ctrl(old, i, DELETED);
 		}
-
-		destroy_list(old_buckets[i]);
 	}
+	map->migrated = end;
 
-	map->destroy_value = destroy_value; // Reset old value destructor
+	if (map->migrated == old->cap) {
+		free_table(old);
+	}
 }
 
 // Constructs and returns a new empty map
@@ -141,10 +242,8 @@ Map map_create(int (*cmp_keys)(void*, void*),
 	assert(map != NULL);
 
 	map->size = 0;
-	map->cap = MIN_CAP;
-
-	map->buckets = calloc(map->cap, sizeof(List)); // NULL-initialization here
-	assert(map->buckets != NULL);
+	init_table(&map->table, MIN_CAP);
+	map->old.ctrl = NULL;
 
 	map->cmp_keys = cmp_keys == NULL ? default_cmp : cmp_keys;
 	map->destroy_key = destroy_key;
@@ -165,75 +264,124 @@ int map_size(Map map) {
 // the old value will be replaced with the new one
 void map_put(Map map, void* key, void* value) {
 	assert(map != NULL);
-	int idx = map->hash_function(key) % map->cap;
+	uint64_t hash = hash_key(map, key);
 
-	if (map->buckets[idx] == NULL) {
-		map->buckets[idx] = create_list();
-	} else {
-		KVPair target_pair = { .key = key };
-		Node* target_node = find_node_in_list(map, map->buckets[idx], &target_pair);
+	if (map->old.ctrl != NULL) {
+		migrate(map, MIGRATE_SLOTS);
+	}
 
-		if (target_node != NULL) {
-			void* old_value = target_node->pair->value;
-			target_node->pair->value = value;
+	Table* table;
+	Slot* slot = find_slot(map, key, hash, &table);
 
-			if (map->destroy_value != NULL) {
-				map->destroy_value(old_value);
-			}
+	if (slot != NULL) {
+		void* old_value = slot->value;
+		slot->value = value;
 
-			return;
+		if (map->destroy_value != NULL) {
+			map->destroy_value(old_value);
 		}
+
+		return;
 	}
 
-	add_to_list(map->buckets[idx], create_kvpair(key, value));
-	map->size++;
+	table = &map->table;
+	int i = find_free_slot(table, hash);
 
-	if (((double) map->size) / map->cap >= 0.8) {
-		rehash(map); // Rehash if load factor reaches 80%
+	// Reusing a DELETED slot doesn't make the probe sequences any longer
+	if (table->ctrl[i] == EMPTY && table->growth_left == 0) {
+		// If it's mostly DELETED slots that filled the table up, they're dropped
+		start_migration(map, map->size >= table->cap / 2 ? table->cap * 2 : table->cap);
+		i = find_free_slot(table, hash);
 	}
+
+	table->growth_left -= table->ctrl[i] == EMPTY;
+	set_ctrl(table, i, H2(hash));
+	table->slots[i] = (Slot) { .hash = hash, .key = key, .value = value };
+	map->size++;
 }
 
 // Retrieves the value that corresponds to key in map
 void* map_get(Map map, void* key) {
 	assert(map != NULL);
-	int idx = map->hash_function(key) % map->cap;
-	KVPair target_pair = { .key = key };
-	Node* target_node = find_node_in_list(map, map->buckets[idx], &target_pair);
-	return target_node == NULL ? NULL : target_node->pair->value;
+	Table* table;
+	Slot* slot = find_slot(map, key, hash_key(map, key), &table);
+	return slot == NULL ? NULL : slot->value;
+}
+
+// Removes key and its value from map (destroying both), if it's there.
+// Returns whether it was
+bool map_remove(Map map, void* key) {
+	assert(map != NULL);
+	uint64_t hash = hash_key(map, key);
+
+	if (map->old.ctrl != NULL) {
+		migrate(map, MIGRATE_SLOTS);
+	}
+
+	Table* table;
+	Slot* found = find_slot(map, key, hash, &table);
+	if (found == NULL) {
+		return false;
+	}
+
+	Slot slot = *found;
+	int i = found - table->slots;
+
+	// A lookup only stops at a group with an EMPTY slot. If every group that holds
+	// slot i has one near enough, no probe sequence has gone past it while it was
+	// full, and it can be EMPTY again
+	int mask = table->cap - 1;
+	unsigned before = match_byte(table->ctrl + ((i - GROUP_SIZE) & mask), EMPTY);
+	unsigned after = match_byte(table->ctrl + i, EMPTY);
+
+	if (before != 0 && after != 0 &&
+		__builtin_ctz(after) + __builtin_clz(before << (32 - GROUP_SIZE)) < GROUP_SIZE) {
+		set_ctrl(table, i, EMPTY);
+		table->growth_left++;
+	} else {
+		set_ctrl(table, i, DELETED);
+	}
+	map->size--;
+
+	if (map->destroy_key != NULL) {
+		map->destroy_key(slot.key);
+	}
+
+	if (map->destroy_value != NULL) {
+		map->destroy_value(slot.value);
+	}
+
+	return true;
 }
 
 // Frees all memory allocated for map
 void map_destroy(Map map) {
 	assert(map != NULL);
-	for (int i = 0; i < map->cap; i++) {
-		Node* temp;
 
-		if (map->buckets[i] == NULL) {
+	Table* tables[] = { &map->table, &map->old };
+	for (int t = 0; t < 2; t++) {
+		Table* table = tables[t];
+		if (table->ctrl == NULL) {
 			continue;
 		}
 
-		Node* curr = map->buckets[i]->head;
-
-		while (curr != NULL) {
-			temp = curr;
-			curr = curr->next;
+		for (int i = 0; i < table->cap; i++) {
+			if (table->ctrl[i] < 0) {
+				continue;
+			}
 
 			if (map->destroy_key != NULL) {
-				map->destroy_key(temp->pair->key);
+				map->destroy_key(table->slots[i].key);
 			}
 
 			if (map->destroy_value != NULL) {
-				map->destroy_value(temp->pair->value);
+				map->destroy_value(table->slots[i].value);
 			}
-
-			free(temp->pair);
-			free(temp);
 		}
 
-		free(map->buckets[i]);
+		free_table(table);
 	}
 
-	free(map->buckets);
 	free(map);
 }
 
@@ -241,7 +389,7 @@ unsigned long default_hash(void* key) {
 	unsigned long hash = 5381;
 
 	for (char *str = (char*) key; *str != '\0'; str++) {
-		hash = ((hash << 5) + hash) + *str; 
+		hash = ((hash << 5) + hash) + *str;
 	}
 
 	return hash; // djb2 hash value is returned
@@ -1,6 +1,8 @@
 #ifndef MAP_H
 #define MAP_H
 
+#include <stdbool.h>
+
 typedef struct map* Map;
 
 // Constructs and returns a new empty map
@@ -23,6 +25,10 @@ void map_put(Map map, void* key, void* value);
 // Retrieves the value that corresponds to key in map
 void* map_get(Map map, void* key);
 
+// Removes key and its value from map (destroying both), if it's there.
+// Returns whether it was
+bool map_remove(Map map, void* key);
+
 // Frees all memory allocated for map
 void map_destroy(Map map);
 
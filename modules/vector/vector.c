@@ -56,6 +56,12 @@ void* vector_get(Vector vector, int pos) {
 	return vector->arr[pos];
 }
 
+// Removes the last item of vector and returns it, without destroying it
+void* vector_remove_last(Vector vector) {
+	assert(vector != NULL && vector->size > 0);
+	return vector->arr[--vector->size];
+}
+
 // Frees all memory allocated for vector
 void vector_destroy(Vector vector) {
 	assert(vector != NULL);
@@ -15,6 +15,9 @@ void vector_add(Vector vector, void* item);
 // Returns pos-th item in vector (starting at 0)
 void* vector_get(Vector vector, int pos);
 
+// Removes the last item of vector and returns it, without destroying it
+void* vector_remove_last(Vector vector);
+
 // Frees all memory allocated for vector
 void vector_destroy(Vector vector);
 
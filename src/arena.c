@@ -0,0 +1,82 @@
+#include <assert.h>
+#include <stdlib.h>
+
+#include "arena.h"
+
+#define MIN_CHUNK 4096
+#define MAX_CHUNK (1 << 20) // Chunks stop doubling here
+#define ALIGNMENT 8
+
+typedef struct chunk {
+	struct chunk* next; // The chunk that was filled before this one
+	size_t size;
+	size_t used;
+	char* data;
+} Chunk;
+
+// Helper functions used by the arena (no reason to expose them)
+static void add_chunk(Arena* arena, size_t size);
+
+struct arena {
+	Chunk* chunk; // The one that's being filled
+	size_t next_size;
+};
+
+Arena* arena_create(void) {
+	Arena* arena = malloc(sizeof(Arena));
+	assert(arena != NULL);
+
+	arena->chunk = NULL;
+	arena->next_size = MIN_CHUNK;
+
+	return arena;
+}
+
+void* arena_alloc(Arena* arena, size_t size) {
+	size = (size + ALIGNMENT - 1) & ~(size_t) (ALIGNMENT - 1);
+
+	Chunk* chunk = arena->chunk;
+	if (chunk == NULL || chunk->size - chunk->used < size) {
+		add_chunk(arena, size);
+		chunk = arena->chunk;
+	}
+
+	void* ptr = chunk->data + chunk->used;
+	chunk->used += size;
+	return ptr;
+}
+
+void arena_destroy(Arena* arena) {
+	assert(arena != NULL);
+
+	while (arena->chunk != NULL) {
+		Chunk* next = arena->chunk->next;
+		free(arena->chunk);
+		arena->chunk = next;
+	}
+
+	free(arena);
+}
+
+// Whatever's left of the current chunk goes unused, which is less than the allocation
+// that didn't fit in it (the data is laid out right after the header)
+static void add_chunk(Arena* arena, size_t size) {
+	size_t chunk_size = arena->next_size;
+	while (chunk_size < size) {
+		chunk_size *= 2;
+	}
+
+	if (arena->next_size < MAX_CHUNK) {
+		arena->next_size *= 2;
+	}
+
+	size_t header = (sizeof(Chunk) + ALIGNMENT - 1) & ~(size_t) (ALIGNMENT - 1);
+	Chunk* chunk = malloc(header + chunk_size);
+	assert(chunk != NULL);
+
+	chunk->next = arena->chunk;
+	chunk->size = chunk_size;
+	chunk->used = 0;
+	chunk->data = (char*) chunk + header;
+	arena->chunk = chunk;
+}
@@ -0,0 +1,175 @@
+#include <time.h>
+#include <stdio.h>
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+
+#include "runtime.h"
+#include "ipl.h"
+
+#define MIN_CAP 64
+
+typedef struct batch_run {
+	char* line; // The run's line of the arguments file, which argv points into
+	int argc;
+	char** argv;
+	char* output; // Everything that the run wrote, once it's done
+	size_t output_size;
+	int status;
+	IplError error;
+	bool done;
+} BatchRun;
+
+// This is used as a wrapper for a batch's state, which its threads share
+typedef struct batch {
+	IplProgram* program;
+	BatchRun* runs;
+	int n_runs;
+	unsigned seed; // The runs' generators are seeded by this and their index
+	atomic_int next; // The next run that a thread may take
+	pthread_mutex_t lock; // Guards the following three
+	int n_written; // The runs before this one have been written out
+	int status;
+	FILE* out;
+} Batch;
+
+// Helper functions used by the batch runner (no reason to expose them)
+static void read_runs(Batch* batch, FILE* args);
+static void split_args(BatchRun* run);
+static void* run_batch(void* arg);
+static void run_one(Batch* batch, int i);
+static void write_runs(Batch* batch);
+
+int ipl_run_batch(IplProgram* program, FILE* args, int n_jobs, FILE* out) {
+	Batch batch = { .program = program, .seed = (unsigned) time(NULL), .out = out };
+	read_runs(&batch, args);
+
+	atomic_init(&batch.next, 0);
+	pthread_mutex_init(&batch.lock, NULL);
+
+	if (n_jobs > batch.n_runs) {
+		n_jobs = batch.n_runs > 0 ? batch.n_runs : 1;
+	}
+
+	// The calling thread takes runs as well
+	pthread_t* threads = malloc(n_jobs * sizeof(pthread_t));
+	assert(threads != NULL);
+
+	for (int t = 1; t < n_jobs; t++) {
+		int status = pthread_create(&threads[t], NULL, run_batch, &batch);
+		assert(status == 0);
+	}
+
+	run_batch(&batch);
+
+	for (int t = 1; t < n_jobs; t++) {
+		pthread_join(threads[t], NULL);
+	}
+
+	free(threads);
+	free(batch.runs);
+	pthread_mutex_destroy(&batch.lock);
+
+	return batch.status;
+}
+
+// Every line is a run, even an empty one (which gets no arguments)
+static void read_runs(Batch* batch, FILE* args) {
+	int runs_cap = MIN_CAP;
+	batch->runs = malloc(runs_cap * sizeof(BatchRun));
+	assert(batch->runs != NULL);
+	batch->n_runs = 0;
+
+	char* line = NULL;
+	size_t line_cap = 0;
+	while (getline(&line, &line_cap, args) != -1) {
+		if (batch->n_runs == runs_cap) {
+			runs_cap *= 2;
+			batch->runs = realloc(batch->runs, runs_cap * sizeof(BatchRun));
+			assert(batch->runs != NULL);
+		}
+
+		BatchRun* run = &batch->runs[batch->n_runs++];
+		run->line = strdup(line);
+		run->output = NULL;
+		run->output_size = 0;
+		run->status = 0;
+		run->done = false;
+		split_args(run);
+	}
+
+	free(line);
+}
+
+static void split_args(BatchRun* run) {
+	int argv_cap = 4;
+	run->argv = malloc(argv_cap * sizeof(char*));
+	assert(run->argv != NULL);
+	run->argc = 0;
+
+	char* save;
+	for (char* arg = strtok_r(run->line, " \t\r\n", &save); arg != NULL;
+		arg = strtok_r(NULL, " \t\r\n", &save)) {
+		if (run->argc == argv_cap) {
+			argv_cap *= 2;
+			run->argv = realloc(run->argv, argv_cap * sizeof(char*));
+			assert(run->argv != NULL);
+		}
+
+		run->argv[run->argc++] = arg;
+	}
+}
+
+static void* run_batch(void* arg) {
+	Batch* batch = arg;
+
+	for (int i; (i = atomic_fetch_add(&batch->next, 1)) < batch->n_runs;) {
+		run_one(batch, i);
+
+		pthread_mutex_lock(&batch->lock);
+		batch->runs[i].done = true;
+		write_runs(batch);
+		pthread_mutex_unlock(&batch->lock);
+	}
+
+	return NULL;
+}
+
+static void run_one(Batch* batch, int i) {
+	BatchRun* run = &batch->runs[i];
+
+	FILE* out = open_memstream(&run->output, &run->output_size);
+	assert(out != NULL);
+
+	// Knuth's multiplicative hash spreads consecutive indices over the seeds
+	unsigned seed = batch->seed ^ ((unsigned) i * 2654435761u);
+	RunIO io = { .in = NULL, .out = out, .seed = &seed };
+
+	run->status = ipl_run_io(batch->program, run->argc, run->argv, io, &run->error);
+	fclose(out);
+}
+
+// Writes out the runs that are done and only come after ones that have been
+// written, so that the output follows the order of the arguments file
+static void write_runs(Batch* batch) {
+	while (batch->n_written < batch->n_runs && batch->runs[batch->n_written].done) {
+		BatchRun* run = &batch->runs[batch->n_written++];
+
+		fwrite(run->output, 1, run->output_size, batch->out);
+		fflush(batch->out);
+
+		if (run->status != 0) {
+			fprintf(stderr, "%s", run->error.msg);
+			if (batch->status == 0) {
+				batch->status = run->status;
+			}
+		}
+
+		free(run->output);
+		free(run->argv);
+		free(run->line);
+	}
+}
@@ -0,0 +1,1100 @@
+#include <stdio.h>
+#include <assert.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+
+#include "vector.h"
+
+#include "stmt.h"
+#include "expr.h"
+#include "token.h"
+#include "resolver.h"
+#include "bounds.h"
+
+#define MIN_CAP 64
+#define NO_SLOT (-1)
+#define MAX_TRACKED 256
+#define MAX_RELATED 64
+
+// Ranges are kept in 64 bits, so that overflowing a 32-bit int can be detected
+typedef struct range {
+	long long lo;
+	long long hi;
+} Range;
+
+// What is known at some point of the program about the tracked names (see
+// find_tracked), by their index among them. Only names that are never used both as
+// variables and as arrays get any facts about their arrays
+typedef struct state {
+	bool reachable;
+	Range* vars; // Value of every variable
+	Range* sizes; // Size of every array, whose lower bound is 0 if it may not exist
+	int* size_vars; // A related variable that holds an array's size, or NO_SLOT
+	bool* less; // LESS(state, v, w) is set if v < w is known to hold
+	bool* less_eq; // LESS_EQ(state, v, w) is set if v <= w is known to hold
+} State;
+
+// Relations are only kept between related variables, by their index among them
+#define LESS(state, v, w) ((state)->less[(v) * bounds->n_related + (w)])
+#define LESS_EQ(state, v, w) ((state)->less_eq[(v) * bounds->n_related + (w)])
+
+// Where control goes after a break or continue statement
+typedef struct loop {
+	State* breaks;
+	State* continues;
+} Loop;
+
+static const Range ANY = { INT_MIN, INT_MAX };
+
+typedef struct bounds Bounds;
+
+// Helper functions used by the bounds analysis (no reason to expose them)
+static void init_bounds(Bounds* bounds, Tree* tree, Vector symbols);
+static void find_tracked(Bounds* bounds, Block stmts);
+static void track_cond(Bounds* bounds, Expr cond);
+static void track_accesses(Bounds* bounds, Expr expr);
+static void track_vars(Bounds* bounds, Expr expr);
+static bool has_tracked_var(Bounds* bounds, Expr expr);
+static void track(Bounds* bounds, int slot);
+static void relate(Bounds* bounds, int slot);
+static int related_index(Bounds* bounds, int slot);
+static State* create_state(Bounds* bounds, bool reachable);
+static State* copy_state(Bounds* bounds, State* state);
+static void destroy_state(State* state);
+static void set_state(Bounds* bounds, State* dst, State* src);
+static void join_states(Bounds* bounds, State* dst, State* src);
+static void widen_state(Bounds* bounds, State* state, State* prev);
+static bool equal_states(Bounds* bounds, State* a, State* b);
+static Range var_range(Bounds* bounds, State* state, int slot);
+static void set_var_range(Bounds* bounds, State* state, int slot, Range value);
+static Range size_range(Bounds* bounds, State* state, int slot);
+static bool holds_less(Bounds* bounds, State* state, int v, int w);
+static bool holds_less_eq(Bounds* bounds, State* state, int v, int w);
+static void analyze_stmts(Bounds* bounds, Block stmts, State* state);
+static void analyze_stmt(Bounds* bounds, Stmt* stmt, State* state);
+static void analyze_while_stmt(Bounds* bounds, WhileStmt* stmt, State* state);
+static void analyze_body(Bounds* bounds, WhileStmt* stmt, int loop, State* head, State* body);
+static void analyze_if_else_stmt(Bounds* bounds, IfElseStmt* stmt, State* state);
+static void analyze_jump(Bounds* bounds, int n_loops, bool is_break, State* state);
+static void analyze_new_stmt(Bounds* bounds, NewStmt* stmt, State* state);
+static void analyze_size_stmt(Bounds* bounds, SizeStmt* stmt, State* state);
+static void analyze_store(Bounds* bounds, Expr lvalue, Range value, Expr expr, State* state);
+static void analyze_expr(Bounds* bounds, Expr expr, State* state);
+static void analyze_access(Bounds* bounds, Array* array, State* state);
+static void assign(Bounds* bounds, State* state, int slot, Range value, Expr expr);
+static void assume(Bounds* bounds, State* state, Expr cond, bool outcome);
+static void refine(Bounds* bounds, State* state, Expr left, TokenType op, Expr right);
+static Range range_of(Bounds* bounds, Expr expr, State* state);
+static Range make_range(long long lo, long long hi);
+static long long min4(long long a, long long b, long long c, long long d);
+static long long max4(long long a, long long b, long long c, long long d);
+static Range intersect(Range a, Range b);
+static int var_slot(Bounds* bounds, Expr expr);
+static bool is_mixed_slot(Bounds* bounds, int slot);
+
+// This is used as a wrapper for the bounds analysis' state
+struct bounds {
+	Tree* tree;
+	Vector symbols;
+	int n_slots;
+	int* tracked; // The index of every slot among the tracked names, or NO_SLOT
+	int n_tracked;
+	int* related; // The index of every slot among the related variables, or NO_SLOT
+	int* related_slots; // The slot of every related variable
+	int n_related;
+	int n_unstable; // Enclosing loops that haven't reached their fixpoint yet
+	int n_removed;
+	Loop* loops;
+	int loop_nesting;
+	int loops_cap;
+};
+
+static void init_bounds(Bounds* bounds, Tree* tree, Vector symbols) {
+	bounds->tree = tree;
+	bounds->symbols = symbols;
+	bounds->n_slots = vector_size(symbols);
+	bounds->n_unstable = 0;
+	bounds->n_removed = 0;
+
+	bounds->tracked = malloc((bounds->n_slots + 1) * sizeof(int));
+	bounds->related = malloc((bounds->n_slots + 1) * sizeof(int));
+	bounds->related_slots = malloc(MAX_RELATED * sizeof(int));
+	assert(bounds->tracked != NULL && bounds->related != NULL && bounds->related_slots != NULL);
+	bounds->n_tracked = 0;
+	bounds->n_related = 0;
+
+	for (int i = 0; i < bounds->n_slots; i++) {
+		bounds->tracked[i] = NO_SLOT;
+		bounds->related[i] = NO_SLOT;
+	}
+
+	bounds->loops = malloc(MIN_CAP * sizeof(Loop));
+	assert(bounds->loops != NULL);
+	bounds->loop_nesting = 0;
+	bounds->loops_cap = MIN_CAP;
+}
+
+int eliminate_bounds_checks(Tree* tree, Block stmts, Vector symbols) {
+	Bounds bounds;
+	init_bounds(&bounds, tree, symbols);
+
+	// Every pass may track names that an earlier statement depends on
+	for (int n_found = -1; n_found != bounds.n_tracked + bounds.n_related; ) {
+		n_found = bounds.n_tracked + bounds.n_related;
+		find_tracked(&bounds, stmts);
+	}
+
+	// Every name starts out as a variable that holds 0 and not as an array
+	State* state = create_state(&bounds, true);
+	analyze_stmts(&bounds, stmts, state);
+	destroy_state(state);
+
+	free(bounds.tracked);
+	free(bounds.related);
+	free(bounds.related_slots);
+	free(bounds.loops);
+	return bounds.n_removed;
+}
+
+// Only the names that an access can depend on are tracked, so that what's copied at
+// every branch and loop doesn't grow with the program: the arrays that are accessed,
+// the variables in their indexes and sizes, and whatever those variables are assigned
+// from (including the sizes of other arrays) or compared against. Relations are only kept
+// between the variables that are used as indexes or sizes, compared with those, or copied
+// or stepped into them
+static void find_tracked(Bounds* bounds, Block stmts) {
+	for (int i = 0; i < stmts.n_stmts; i++) {
+		Stmt stmt = get_stmt(bounds->tree, stmts, i);
+		void* payload = get_payload(bounds->tree, &stmt);
+
+		switch (stmt.type) {
+			case ASSIGNMENT_STMT: {
+				AssignmentStmt* assignment_stmt = payload;
+				Expr expr = assignment_stmt->expr;
+				int slot = var_slot(bounds, assignment_stmt->lvalue);
+
+				track_accesses(bounds, assignment_stmt->lvalue);
+				track_accesses(bounds, expr);
+
+				if (slot != NO_SLOT && bounds->tracked[slot] != NO_SLOT) {
+					track_vars(bounds, expr);
+				}
+
+				if (related_index(bounds, slot) == NO_SLOT) {
+					break;
+				}
+
+				// Increments, decrements and copies keep some of the relations
+				if (EXPR_TYPE(expr) == BINARY) {
+					Binary* binary = get_binary(bounds->tree, expr);
+					if (binary->type == PLUS || binary->type == MINUS) {
+						relate(bounds, var_slot(bounds, binary->left));
+						relate(bounds, var_slot(bounds, binary->right));
+					}
+				} else {
+					relate(bounds, var_slot(bounds, expr));
+				}
+				break;
+			}
+
+			case WHILE_STMT: {
+				WhileStmt* while_stmt = payload;
+				track_cond(bounds, while_stmt->cond);
+				find_tracked(bounds, while_stmt->stmts);
+				break;
+			}
+
+			case IF_ELSE_STMT: {
+				IfElseStmt* if_else_stmt = payload;
+				track_cond(bounds, if_else_stmt->cond);
+				find_tracked(bounds, if_else_stmt->then_stmts);
+				find_tracked(bounds, if_else_stmt->else_stmts);
+				break;
+			}
+
+			case NEW_STMT: {
+				NewStmt* new_stmt = payload;
+				track_accesses(bounds, new_stmt->size);
+
+				if (bounds->tracked[new_stmt->slot] != NO_SLOT) {
+					track_vars(bounds, new_stmt->size);
+					relate(bounds, var_slot(bounds, new_stmt->size));
+				}
+				break;
+			}
+
+			case SIZE_STMT: {
+				SizeStmt* size_stmt = payload;
+				int slot = var_slot(bounds, size_stmt->lvalue);
+				track_accesses(bounds, size_stmt->lvalue);
+
+				if (slot != NO_SLOT && bounds->tracked[slot] != NO_SLOT) {
+					track(bounds, size_stmt->slot);
+				}
+
+				if (bounds->tracked[size_stmt->slot] != NO_SLOT) {
+					relate(bounds, slot);
+				}
+				break;
+			}
+
+			case READ_STMT: track_accesses(bounds, ((ReadStmt*) payload)->lvalue); break;
+			case WRITE_STMT: track_accesses(bounds, ((WriteStmt*) payload)->expr); break;
+			case WRITELN_STMT: track_accesses(bounds, ((WritelnStmt*) payload)->expr); break;
+			case RANDOM_STMT: track_accesses(bounds, ((RandomStmt*) payload)->lvalue); break;
+
+			case ARG_STMT:
+				track_accesses(bounds, ((ArgStmt*) payload)->expr);
+				track_accesses(bounds, ((ArgStmt*) payload)->lvalue);
+				break;
+
+			case ARG_SIZE_STMT: track_accesses(bounds, ((ArgSizeStmt*) payload)->lvalue); break;
+			case BREAK_STMT: break;
+			case CONTINUE_STMT: break;
+			case FREE_STMT: break;
+
+			default:
+				fprintf(stderr, "Invalid statement type (this shouldn't be printed)\n");
+				exit(EXIT_FAILURE);
+		}
+	}
+}
+
+// A condition only narrows down what's known about the variables it compares
+static void track_cond(Bounds* bounds, Expr cond) {
+	track_accesses(bounds, cond);
+	if (!has_tracked_var(bounds, cond)) {
+		return;
+	}
+
+	track_vars(bounds, cond);
+	if (EXPR_TYPE(cond) != BINARY) {
+		return;
+	}
+
+	Binary* binary = get_binary(bounds->tree, cond);
+	int left = var_slot(bounds, binary->left);
+	int right = var_slot(bounds, binary->right);
+
+	switch (binary->type) {
+		case EQUAL_EQUAL: case BANG_EQUAL:
+		case LESS: case LESS_EQUAL: case GREATER: case GREATER_EQUAL:
+			if (related_index(bounds, left) != NO_SLOT || related_index(bounds, right) != NO_SLOT) {
+				relate(bounds, left);
+				relate(bounds, right);
+			}
+			break;
+
+		default:
+			break;
+	}
+}
+
+// Tracks every array that's accessed in expr, along with the variables in its index
+static void track_accesses(Bounds* bounds, Expr expr) {
+	if (expr == NO_EXPR) {
+		return;
+	}
+
+	switch (EXPR_TYPE(expr)) {
+		case LITERAL: break;
+		case VAR: break;
+
+		case ARRAY: {
+			Array* array = get_array(bounds->tree, expr);
+			track(bounds, array->slot);
+			track_vars(bounds, array->index);
+			relate(bounds, var_slot(bounds, array->index));
+			track_accesses(bounds, array->index);
+			break;
+		}
+
+		case BINARY: {
+			Binary* binary = get_binary(bounds->tree, expr);
+			track_accesses(bounds, binary->left);
+			track_accesses(bounds, binary->right);
+			break;
+		}
+
+		default:
+			fprintf(stderr, "Invalid expression type (this shouldn't be printed)\n");
+			exit(EXIT_FAILURE);
+	}
+}
+
+// Tracks every variable whose value expr depends on (an element could be anything)
+static void track_vars(Bounds* bounds, Expr expr) {
+	if (EXPR_TYPE(expr) == VAR) {
+		track(bounds, var_slot(bounds, expr));
+	} else if (EXPR_TYPE(expr) == BINARY) {
+		track_vars(bounds, get_binary(bounds->tree, expr)->left);
+		track_vars(bounds, get_binary(bounds->tree, expr)->right);
+	}
+}
+
+static bool has_tracked_var(Bounds* bounds, Expr expr) {
+	if (EXPR_TYPE(expr) == VAR) {
+		int slot = var_slot(bounds, expr);
+		return slot != NO_SLOT && bounds->tracked[slot] != NO_SLOT;
+	} else if (EXPR_TYPE(expr) == BINARY) {
+		Binary* binary = get_binary(bounds->tree, expr);
+		return has_tracked_var(bounds, binary->left) || has_tracked_var(bounds, binary->right);
+	}
+
+	return false;
+}
+
+// Past MAX_TRACKED names the rest are taken to hold anything (and past MAX_RELATED
+// variables the rest only get ranges), so the checks that depend on them stay
+static void track(Bounds* bounds, int slot) {
+	if (slot == NO_SLOT || is_mixed_slot(bounds, slot) || bounds->tracked[slot] != NO_SLOT ||
+	    bounds->n_tracked == MAX_TRACKED) {
+		return;
+	}
+
+	bounds->tracked[slot] = bounds->n_tracked++;
+}
+
+static void relate(Bounds* bounds, int slot) {
+	track(bounds, slot);
+	if (slot == NO_SLOT || bounds->tracked[slot] == NO_SLOT || bounds->related[slot] != NO_SLOT ||
+	    bounds->n_related == MAX_RELATED) {
+		return;
+	}
+
+	bounds->related[slot] = bounds->n_related;
+	bounds->related_slots[bounds->n_related++] = slot;
+}
+
+// Returns the index of slot among the related variables, or NO_SLOT
+static int related_index(Bounds* bounds, int slot) {
+	return slot == NO_SLOT ? NO_SLOT : bounds->related[slot];
+}
+
+static State* create_state(Bounds* bounds, bool reachable) {
+	int n = bounds->n_tracked + 1;
+	int n_less = bounds->n_related * bounds->n_related + 1;
+
+	State* state = malloc(sizeof(State));
+	assert(state != NULL);
+
+	state->reachable = reachable;
+	state->vars = calloc(n, sizeof(Range));
+	state->sizes = calloc(n, sizeof(Range));
+	state->size_vars = malloc(n * sizeof(int));
+	state->less = calloc(n_less, sizeof(bool));
+	state->less_eq = calloc(n_less, sizeof(bool));
+	assert(state->vars != NULL && state->sizes != NULL && state->size_vars != NULL);
+	assert(state->less != NULL && state->less_eq != NULL);
+
+	for (int i = 0; i < n; i++) {
+		state->size_vars[i] = NO_SLOT;
+	}
+
+	return state;
+}
+
+static State* copy_state(Bounds* bounds, State* state) {
+	State* copy = create_state(bounds, state->reachable);
+	set_state(bounds, copy, state);
+	return copy;
+}
+
+static void destroy_state(State* state) {
+	free(state->vars);
+	free(state->sizes);
+	free(state->size_vars);
+	free(state->less);
+	free(state->less_eq);
+	free(state);
+}
+
+static void set_state(Bounds* bounds, State* dst, State* src) {
+	int n = bounds->n_tracked + 1;
+	int n_less = bounds->n_related * bounds->n_related + 1;
+
+	dst->reachable = src->reachable;
+	memcpy(dst->vars, src->vars, n * sizeof(Range));
+	memcpy(dst->sizes, src->sizes, n * sizeof(Range));
+	memcpy(dst->size_vars, src->size_vars, n * sizeof(int));
+	memcpy(dst->less, src->less, n_less * sizeof(bool));
+	memcpy(dst->less_eq, src->less_eq, n_less * sizeof(bool));
+}
+
+// Keeps only what holds in both states
+static void join_states(Bounds* bounds, State* dst, State* src) {
+	if (!src->reachable) {
+		return;
+	} else if (!dst->reachable) {
+		set_state(bounds, dst, src);
+		return;
+	}
+
+	// Relations that follow from the ranges are made explicit before the ranges are
+	// joined, e.g. i = 0 before a loop and i <= n after an iteration give i <= n. This
+	// is holds_less and holds_less_eq, for variables that are never mixed
+	for (int i = 0; i < bounds->n_related; i++) {
+		Range dst_v = var_range(bounds, dst, bounds->related_slots[i]);
+		Range src_v = var_range(bounds, src, bounds->related_slots[i]);
+
+		for (int j = 0; j < bounds->n_related; j++) {
+			Range dst_w = var_range(bounds, dst, bounds->related_slots[j]);
+			Range src_w = var_range(bounds, src, bounds->related_slots[j]);
+
+			bool dst_less = LESS(dst, i, j) || dst_v.hi < dst_w.lo;
+			bool src_less = LESS(src, i, j) || src_v.hi < src_w.lo;
+			bool dst_less_eq = LESS_EQ(dst, i, j) || dst_less || dst_v.hi <= dst_w.lo;
+			bool src_less_eq = LESS_EQ(src, i, j) || src_less || src_v.hi <= src_w.lo;
+
+			LESS(dst, i, j) = dst_less && src_less;
+			LESS_EQ(dst, i, j) = dst_less_eq && src_less_eq;
+		}
+	}
+
+	for (int i = 0; i < bounds->n_tracked; i++) {
+		dst->vars[i].lo = src->vars[i].lo < dst->vars[i].lo ? src->vars[i].lo : dst->vars[i].lo;
+		dst->vars[i].hi = src->vars[i].hi > dst->vars[i].hi ? src->vars[i].hi : dst->vars[i].hi;
+		dst->sizes[i].lo = src->sizes[i].lo < dst->sizes[i].lo ? src->sizes[i].lo : dst->sizes[i].lo;
+		dst->sizes[i].hi = src->sizes[i].hi > dst->sizes[i].hi ? src->sizes[i].hi : dst->sizes[i].hi;
+
+		if (dst->size_vars[i] != src->size_vars[i]) {
+			dst->size_vars[i] = NO_SLOT;
+		}
+	}
+}
+
+// Bounds that are still moving at a loop's head are given up right away, so that
+// the analysis of every loop terminates after a few passes
+static void widen_state(Bounds* bounds, State* state, State* prev) {
+	if (!prev->reachable) {
+		return;
+	}
+
+	for (int i = 0; i < bounds->n_tracked; i++) {
+		if (state->vars[i].lo < prev->vars[i].lo) state->vars[i].lo = INT_MIN;
+		if (state->vars[i].hi > prev->vars[i].hi) state->vars[i].hi = INT_MAX;
+		if (state->sizes[i].lo < prev->sizes[i].lo) state->sizes[i].lo = 0;
+		if (state->sizes[i].hi > prev->sizes[i].hi) state->sizes[i].hi = INT_MAX;
+	}
+}
+
+static bool equal_states(Bounds* bounds, State* a, State* b) {
+	int n = bounds->n_tracked + 1;
+	int n_less = bounds->n_related * bounds->n_related + 1;
+
+	if (a->reachable != b->reachable) {
+		return false;
+	}
+
+	return memcmp(a->vars, b->vars, n * sizeof(Range)) == 0 &&
+	       memcmp(a->sizes, b->sizes, n * sizeof(Range)) == 0 &&
+	       memcmp(a->size_vars, b->size_vars, n * sizeof(int)) == 0 &&
+	       memcmp(a->less, b->less, n_less * sizeof(bool)) == 0 &&
+	       memcmp(a->less_eq, b->less_eq, n_less * sizeof(bool)) == 0;
+}
+
+// Untracked variables could hold anything
+static Range var_range(Bounds* bounds, State* state, int slot) {
+	int i = slot == NO_SLOT ? NO_SLOT : bounds->tracked[slot];
+	return i == NO_SLOT ? ANY : state->vars[i];
+}
+
+static void set_var_range(Bounds* bounds, State* state, int slot, Range value) {
+	if (bounds->tracked[slot] != NO_SLOT) {
+		state->vars[bounds->tracked[slot]] = value;
+	}
+}
+
+// Untracked arrays could have any size, if they exist at all
+static Range size_range(Bounds* bounds, State* state, int slot) {
+	int i = bounds->tracked[slot];
+	return i == NO_SLOT ? make_range(0, INT_MAX) : state->sizes[i];
+}
+
+static bool holds_less(Bounds* bounds, State* state, int v, int w) {
+	if (is_mixed_slot(bounds, v) || is_mixed_slot(bounds, w)) {
+		return false;
+	}
+
+	int i = bounds->related[v];
+	int j = bounds->related[w];
+	return (i != NO_SLOT && j != NO_SLOT && LESS(state, i, j)) ||
+	       var_range(bounds, state, v).hi < var_range(bounds, state, w).lo;
+}
+
+static bool holds_less_eq(Bounds* bounds, State* state, int v, int w) {
+	if (is_mixed_slot(bounds, v) || is_mixed_slot(bounds, w)) {
+		return false;
+	}
+
+	int i = bounds->related[v];
+	int j = bounds->related[w];
+	return (i != NO_SLOT && j != NO_SLOT && LESS_EQ(state, i, j)) ||
+	       holds_less(bounds, state, v, w) ||
+	       var_range(bounds, state, v).hi <= var_range(bounds, state, w).lo;
+}
+
+static void analyze_stmts(Bounds* bounds, Block stmts, State* state) {
+	for (int i = 0; i < stmts.n_stmts && state->reachable; i++) {
+		Stmt stmt = get_stmt(bounds->tree, stmts, i);
+		analyze_stmt(bounds, &stmt, state);
+	}
+}
+
+static void analyze_stmt(Bounds* bounds, Stmt* stmt, State* state) {
+	switch (stmt->type) {
+		case READ_STMT: {
+			ReadStmt* read_stmt = get_payload(bounds->tree, stmt);
+			analyze_store(bounds, read_stmt->lvalue, ANY, NO_EXPR, state);
+			break;
+		}
+
+		case ASSIGNMENT_STMT: {
+			AssignmentStmt* assignment_stmt = get_payload(bounds->tree, stmt);
+			analyze_expr(bounds, assignment_stmt->expr, state);
+
+			Range value = range_of(bounds, assignment_stmt->expr, state);
+			analyze_store(bounds, assignment_stmt->lvalue, value, assignment_stmt->expr, state);
+			break;
+		}
+
+		case WRITE_STMT: {
+			WriteStmt* write_stmt = get_payload(bounds->tree, stmt);
+			if (write_stmt->expr != NO_EXPR) {
+				analyze_expr(bounds, write_stmt->expr, state);
+			}
+			break;
+		}
+
+		case WRITELN_STMT: {
+			WritelnStmt* writeln_stmt = get_payload(bounds->tree, stmt);
+			if (writeln_stmt->expr != NO_EXPR) {
+				analyze_expr(bounds, writeln_stmt->expr, state);
+			}
+			break;
+		}
+
+		case WHILE_STMT: analyze_while_stmt(bounds, get_payload(bounds->tree, stmt), state); break;
+		case IF_ELSE_STMT:
+			analyze_if_else_stmt(bounds, get_payload(bounds->tree, stmt), state);
+			break;
+
+		case RANDOM_STMT: {
+			RandomStmt* random_stmt = get_payload(bounds->tree, stmt);
+			analyze_store(bounds, random_stmt->lvalue, make_range(0, RAND_MAX),
+				NO_EXPR, state);
+			break;
+		}
+
+		case ARG_STMT: {
+			ArgStmt* arg_stmt = get_payload(bounds->tree, stmt);
+			analyze_expr(bounds, arg_stmt->expr, state);
+			analyze_store(bounds, arg_stmt->lvalue, ANY, NO_EXPR, state);
+			break;
+		}
+
+		case ARG_SIZE_STMT: {
+			ArgSizeStmt* arg_size_stmt = get_payload(bounds->tree, stmt);
+			analyze_store(bounds, arg_size_stmt->lvalue, make_range(0, INT_MAX),
+				NO_EXPR, state);
+			break;
+		}
+
+		case BREAK_STMT:
+			analyze_jump(bounds, ((BreakStmt*) get_payload(bounds->tree, stmt))->n_loops, true,
+				state);
+			break;
+
+		case CONTINUE_STMT:
+			analyze_jump(bounds, ((ContinueStmt*) get_payload(bounds->tree, stmt))->n_loops, false,
+				state);
+			break;
+		case NEW_STMT: analyze_new_stmt(bounds, get_payload(bounds->tree, stmt), state); break;
+
+		case FREE_STMT: {
+			FreeStmt* free_stmt = get_payload(bounds->tree, stmt);
+			int i = bounds->tracked[free_stmt->slot];
+			if (i != NO_SLOT) {
+				state->sizes[i] = make_range(0, 0);
+				state->size_vars[i] = NO_SLOT;
+			}
+			break;
+		}
+
+		case SIZE_STMT: analyze_size_stmt(bounds, get_payload(bounds->tree, stmt), state); break;
+
+		default:
+			fprintf(stderr, "Invalid statement type (this shouldn't be printed)\n");
+			exit(EXIT_FAILURE);
+	}
+}
+
+// The loop's head is analyzed until what's known there stops changing. Accesses
+// are only marked in a final pass over the body, once that's the case for the
+// loop itself and for every loop that encloses it
+static void analyze_while_stmt(Bounds* bounds, WhileStmt* stmt, State* state) {
+	if (bounds->loop_nesting == bounds->loops_cap) {
+		bounds->loops_cap *= 2;
+		bounds->loops = realloc(bounds->loops, bounds->loops_cap * sizeof(Loop));
+		assert(bounds->loops != NULL);
+	}
+
+	// Nested loops may reallocate the stack, so the loop is referred to by its index
+	int loop = bounds->loop_nesting++;
+	bounds->loops[loop].breaks = create_state(bounds, false);
+	bounds->loops[loop].continues = create_state(bounds, false);
+
+	State* head = copy_state(bounds, state);
+	State* body = create_state(bounds, false);
+	State* next = create_state(bounds, false);
+
+	bounds->n_unstable++;
+	for (bool stable = false; !stable; ) {
+		analyze_body(bounds, stmt, loop, head, body);
+
+		set_state(bounds, next, head);
+		join_states(bounds, next, body);
+		widen_state(bounds, next, head);
+
+		stable = equal_states(bounds, next, head);
+		set_state(bounds, head, next);
+	}
+	bounds->n_unstable--;
+
+	analyze_body(bounds, stmt, loop, head, body);
+
+	set_state(bounds, state, head);
+	assume(bounds, state, stmt->cond, false);
+	join_states(bounds, state, bounds->loops[loop].breaks);
+
+	bounds->loop_nesting--;
+	destroy_state(bounds->loops[loop].breaks);
+	destroy_state(bounds->loops[loop].continues);
+	destroy_state(head);
+	destroy_state(body);
+	destroy_state(next);
+}
+
+// Leaves the state at the end of an iteration that starts with head in body
+static void analyze_body(Bounds* bounds, WhileStmt* stmt, int loop, State* head, State* body) {
+	bounds->loops[loop].breaks->reachable = false;
+	bounds->loops[loop].continues->reachable = false;
+
+	set_state(bounds, body, head);
+	analyze_expr(bounds, stmt->cond, body);
+	assume(bounds, body, stmt->cond, true);
+	analyze_stmts(bounds, stmt->stmts, body);
+	join_states(bounds, body, bounds->loops[loop].continues);
+}
+
+static void analyze_if_else_stmt(Bounds* bounds, IfElseStmt* stmt, State* state) {
+	analyze_expr(bounds, stmt->cond, state);
+
+	State* then_state = copy_state(bounds, state);
+	assume(bounds, then_state, stmt->cond, true);
+	analyze_stmts(bounds, stmt->then_stmts, then_state);
+
+	assume(bounds, state, stmt->cond, false);
+	if (stmt->has_else) {
+		analyze_stmts(bounds, stmt->else_stmts, state);
+	}
+
+	join_states(bounds, state, then_state);
+	destroy_state(then_state);
+}
+
+// An invalid break or continue raises an error, so nothing follows it either way
+static void analyze_jump(Bounds* bounds, int n_loops, bool is_break, State* state) {
+	if (n_loops <= bounds->loop_nesting) {
+		Loop* loop = &bounds->loops[bounds->loop_nesting - n_loops];
+		join_states(bounds, is_break ? loop->breaks : loop->continues, state);
+	}
+
+	state->reachable = false;
+}
+
+static void analyze_new_stmt(Bounds* bounds, NewStmt* stmt, State* state) {
+	analyze_expr(bounds, stmt->size, state);
+
+	// Past a successful new the size is positive
+	Range size = intersect(range_of(bounds, stmt->size, state), make_range(1, INT_MAX));
+	if (size.lo > size.hi) {
+		state->reachable = false;
+		return;
+	}
+
+	int size_var = var_slot(bounds, stmt->size);
+
+	if (is_mixed_slot(bounds, stmt->slot)) {
+		size = make_range(0, INT_MAX);
+		size_var = NO_SLOT;
+	}
+
+	if (size_var != NO_SLOT) {
+		set_var_range(bounds, state, size_var, size);
+	}
+
+	// Sizes are only compared against indexes through relations
+	int i = bounds->tracked[stmt->slot];
+	if (i != NO_SLOT) {
+		state->sizes[i] = size;
+		state->size_vars[i] = related_index(bounds, size_var) != NO_SLOT ? size_var : NO_SLOT;
+	}
+}
+
+static void analyze_size_stmt(Bounds* bounds, SizeStmt* stmt, State* state) {
+	// Past a successful size statement the array exists
+	Range size = intersect(size_range(bounds, state, stmt->slot), make_range(1, INT_MAX));
+	analyze_store(bounds, stmt->lvalue, size, NO_EXPR, state);
+
+	if (!stmt->is_array && !is_mixed_slot(bounds, stmt->slot)) {
+		int i = bounds->tracked[stmt->slot];
+		int slot = var_slot(bounds, stmt->lvalue);
+		if (i != NO_SLOT && slot != NO_SLOT) {
+			state->sizes[i] = size;
+			state->size_vars[i] = related_index(bounds, slot) != NO_SLOT ? slot : NO_SLOT;
+		}
+	}
+}
+
+// The value's range is computed before the store, expr is only needed to keep
+// facts that survive the assignment (NO_EXPR if there's no expression)
+static void analyze_store(Bounds* bounds, Expr lvalue, Range value, Expr expr, State* state) {
+	if (EXPR_TYPE(lvalue) == ARRAY) {
+		analyze_access(bounds, get_array(bounds->tree, lvalue), state);
+	} else {
+		assign(bounds, state, get_var(bounds->tree, lvalue)->slot, value, expr);
+	}
+}
+
+// Visits every array access in expr
+static void analyze_expr(Bounds* bounds, Expr expr, State* state) {
+	switch (EXPR_TYPE(expr)) {
+		case LITERAL: break;
+		case VAR: break;
+		case ARRAY: analyze_access(bounds, get_array(bounds->tree, expr), state); break;
+
+		case BINARY: {
+			Binary* binary = get_binary(bounds->tree, expr);
+			analyze_expr(bounds, binary->left, state);
+			analyze_expr(bounds, binary->right, state);
+			break;
+		}
+
+		default:
+			fprintf(stderr, "Invalid expression type (this shouldn't be printed)\n");
+			exit(EXIT_FAILURE);
+	}
+}
+
+static void analyze_access(Bounds* bounds, Array* array, State* state) {
+	analyze_expr(bounds, array->index, state);
+
+	// Mixed names are never tracked, and neither are the arrays past MAX_TRACKED
+	int i = bounds->tracked[array->slot];
+	if (bounds->n_unstable > 0 || !state->reachable || i == NO_SLOT) {
+		return;
+	}
+
+	Range size = state->sizes[i];
+	Range idx = range_of(bounds, array->index, state);
+	int idx_var = var_slot(bounds, array->index);
+	int size_var = state->size_vars[i];
+
+	bool in_bounds = size.lo >= 1 && idx.lo >= 0 &&
+		(idx.hi < size.lo || (idx_var != NO_SLOT && size_var != NO_SLOT &&
+		                      holds_less(bounds, state, idx_var, size_var)));
+
+	if (in_bounds) {
+		array->in_bounds = true;
+		bounds->n_removed++;
+	}
+}
+
+// Everything that was known about the variable is forgotten, except for what an
+// increment, a decrement or a copy keeps
+static void assign(Bounds* bounds, State* state, int slot, Range value, Expr expr) {
+	int r = bounds->related[slot];
+	if (r == NO_SLOT) {
+		set_var_range(bounds, state, slot, value);
+		return;
+	}
+
+	bool keep_less = false; // slot < w still holds
+	bool keep_greater = false; // w < slot still holds
+	int copied = NO_SLOT;
+	int above = NO_SLOT; // The new value is less than this variable
+	int successor = NO_SLOT; // The new value is this variable plus 1
+
+	if (expr != NO_EXPR && EXPR_TYPE(expr) == BINARY) {
+		Binary* binary = get_binary(bounds->tree, expr);
+		int left = var_slot(bounds, binary->left);
+		int right = var_slot(bounds, binary->right);
+		Range l = range_of(bounds, binary->left, state);
+		Range r = range_of(bounds, binary->right, state);
+		Range old = var_range(bounds, state, slot);
+
+		// Adding a constant moves the variable in one direction, unless it wraps
+		long long step = 0;
+		bool is_step = true;
+		if (binary->type == PLUS && left == slot && r.lo == r.hi) {
+			step = r.lo;
+		} else if (binary->type == PLUS && right == slot && l.lo == l.hi) {
+			step = l.lo;
+		} else if (binary->type == MINUS && left == slot && r.lo == r.hi) {
+			step = -r.lo;
+		} else {
+			is_step = false;
+		}
+
+		if (binary->type == PLUS && left != NO_SLOT && r.lo == 1 && r.hi == 1) {
+			successor = left;
+		} else if (binary->type == PLUS && right != NO_SLOT && l.lo == 1 && l.hi == 1) {
+			successor = right;
+		}
+
+		if (is_step) {
+			keep_greater = step >= 0 && old.hi + step <= INT_MAX;
+			keep_less = step <= 0 && old.lo + step >= INT_MIN;
+		} else if (binary->type == MINUS && left != NO_SLOT && left != slot &&
+		           r.lo >= 1 && l.lo - r.hi >= INT_MIN) {
+			above = left;
+		}
+	} else if (expr != NO_EXPR && var_slot(bounds, expr) != NO_SLOT &&
+	           var_slot(bounds, expr) != slot) {
+		copied = var_slot(bounds, expr);
+	}
+
+	// Copying a variable that isn't related only keeps its range
+	int c = related_index(bounds, copied);
+	int a = related_index(bounds, above);
+
+	for (int j = 0; j < bounds->n_related; j++) {
+		int w = bounds->related_slots[j];
+
+		// If successor < w held, then slot <= w holds now (no wrap, since w <= INT_MAX)
+		bool below = successor != NO_SLOT && w != slot && holds_less(bounds, state, successor, w);
+
+		if (!keep_less) LESS(state, r, j) = LESS_EQ(state, r, j) = false;
+		if (!keep_greater) LESS(state, j, r) = LESS_EQ(state, j, r) = false;
+
+		if (c != NO_SLOT) {
+			LESS(state, r, j) = LESS(state, c, j);
+			LESS(state, j, r) = LESS(state, j, c);
+			LESS_EQ(state, r, j) = LESS_EQ(state, c, j);
+			LESS_EQ(state, j, r) = LESS_EQ(state, j, c);
+		}
+
+		if (below) {
+			LESS_EQ(state, r, j) = true;
+		}
+	}
+
+	// Only related variables are kept as sizes
+	for (int i = 0; i < bounds->n_tracked; i++) {
+		if (state->size_vars[i] == slot) {
+			state->size_vars[i] = NO_SLOT;
+		}
+	}
+
+	LESS(state, r, r) = LESS_EQ(state, r, r) = false;
+	if (a != NO_SLOT) {
+		LESS(state, r, a) = true;
+	}
+
+	if (c != NO_SLOT) {
+		LESS_EQ(state, r, c) = LESS_EQ(state, c, r) = true;
+	}
+
+	set_var_range(bounds, state, slot, value);
+}
+
+// Narrows the state down to the executions where cond evaluates to outcome
+static void assume(Bounds* bounds, State* state, Expr cond, bool outcome) {
+	if (!state->reachable || EXPR_TYPE(cond) != BINARY) {
+		return;
+	}
+
+	Binary* binary = get_binary(bounds->tree, cond);
+	TokenType op = binary->type;
+
+	if (!outcome) {
+		switch (op) {
+			case EQUAL_EQUAL: op = BANG_EQUAL; break;
+			case BANG_EQUAL: op = EQUAL_EQUAL; break;
+			case LESS: op = GREATER_EQUAL; break;
+			case LESS_EQUAL: op = GREATER; break;
+			case GREATER: op = LESS_EQUAL; break;
+			case GREATER_EQUAL: op = LESS; break;
+			default: return;
+		}
+	}
+
+	// a > b is b < a and a >= b is b <= a
+	if (op == GREATER) {
+		refine(bounds, state, binary->right, LESS, binary->left);
+	} else if (op == GREATER_EQUAL) {
+		refine(bounds, state, binary->right, LESS_EQUAL, binary->left);
+	} else {
+		refine(bounds, state, binary->left, op, binary->right);
+	}
+}
+
+static void refine(Bounds* bounds, State* state, Expr left, TokenType op, Expr right) {
+	Range l = range_of(bounds, left, state);
+	Range r = range_of(bounds, right, state);
+	int left_var = var_slot(bounds, left);
+	int right_var = var_slot(bounds, right);
+	int left_rel = related_index(bounds, left_var);
+	int right_rel = related_index(bounds, right_var);
+
+	Range new_l = l;
+	Range new_r = r;
+
+	// Two values that differ, where one is known to be at most the other, are ordered
+	if (op == BANG_EQUAL && left_var != NO_SLOT && right_var != NO_SLOT) {
+		if (holds_less_eq(bounds, state, left_var, right_var)) {
+			op = LESS;
+		} else if (holds_less_eq(bounds, state, right_var, left_var)) {
+			refine(bounds, state, right, LESS, left);
+			return;
+		}
+	}
+
+	switch (op) {
+		case LESS:
+			new_l = intersect(l, make_range(INT_MIN, r.hi - 1));
+			new_r = intersect(r, make_range(l.lo + 1, INT_MAX));
+			if (left_rel != NO_SLOT && right_rel != NO_SLOT) {
+				LESS(state, left_rel, right_rel) = true;
+			}
+			break;
+
+		case LESS_EQUAL:
+			new_l = intersect(l, make_range(INT_MIN, r.hi));
+			new_r = intersect(r, make_range(l.lo, INT_MAX));
+			if (left_rel != NO_SLOT && right_rel != NO_SLOT) {
+				LESS_EQ(state, left_rel, right_rel) = true;
+			}
+			break;
+
+		case EQUAL_EQUAL:
+			new_l = intersect(l, r);
+			new_r = new_l;
+			break;
+
+		case BANG_EQUAL:
+			if (r.lo == r.hi && l.lo == r.lo) new_l.lo++;
+			if (r.lo == r.hi && l.hi == r.lo) new_l.hi--;
+			if (l.lo == l.hi && r.lo == l.lo) new_r.lo++;
+			if (l.lo == l.hi && r.hi == l.lo) new_r.hi--;
+			break;
+
+		default:
+			return;
+	}
+
+	if (new_l.lo > new_l.hi || new_r.lo > new_r.hi) {
+		state->reachable = false;
+		return;
+	}
+
+	if (left_var != NO_SLOT) set_var_range(bounds, state, left_var, new_l);
+	if (right_var != NO_SLOT) set_var_range(bounds, state, right_var, new_r);
+}
+
+// Arithmetic wraps around, so any result that doesn't fit in an int could be anything
+static Range range_of(Bounds* bounds, Expr expr, State* state) {
+	switch (EXPR_TYPE(expr)) {
+		case LITERAL: {
+			int value = get_literal(bounds->tree, expr)->value;
+			return make_range(value, value);
+		}
+
+		case VAR: {
+			int slot = var_slot(bounds, expr);
+			return var_range(bounds, state, slot);
+		}
+
+		case ARRAY: return ANY;
+
+		case BINARY: {
+			Binary* binary = get_binary(bounds->tree, expr);
+			Range l = range_of(bounds, binary->left, state);
+			Range r = range_of(bounds, binary->right, state);
+			Range result = ANY;
+
+			switch (binary->type) {
+				case PLUS: result = make_range(l.lo + r.lo, l.hi + r.hi); break;
+				case MINUS: result = make_range(l.lo - r.hi, l.hi - r.lo); break;
+
+				case STAR: {
+					long long a = l.lo * r.lo, b = l.lo * r.hi, c = l.hi * r.lo, d = l.hi * r.hi;
+					result = make_range(min4(a, b, c, d), max4(a, b, c, d));
+					break;
+				}
+
+				// Division truncates towards zero, which is monotonic for a positive divisor
+				case SLASH:
+					if (r.lo >= 1) {
+						long long a = l.lo / r.lo, b = l.lo / r.hi, c = l.hi / r.lo, d = l.hi / r.hi;
+						result = make_range(a < b ? a : b, c > d ? c : d);
+					}
+					break;
+
+				// The remainder has the sign of the dividend and is smaller than the divisor
+				case MODULO:
+					if (r.lo >= 1) {
+						result = make_range(l.lo >= 0 ? 0 : -(r.hi - 1), l.hi <= 0 ? 0 : r.hi - 1);
+					}
+					break;
+
+				default:
+					break;
+			}
+
+			return result;
+		}
+
+		default:
+			fprintf(stderr, "Invalid expression type (this shouldn't be printed)\n");
+			exit(EXIT_FAILURE);
+	}
+}
+
+static Range make_range(long long lo, long long hi) {
+	if (lo < INT_MIN || hi > INT_MAX) {
+		return ANY;
+	}
+
+	return (Range) { .lo = lo, .hi = hi };
+}
+
+static long long min4(long long a, long long b, long long c, long long d) {
+	long long ab = a < b ? a : b, cd = c < d ? c : d;
+	return ab < cd ? ab : cd;
+}
+
+static long long max4(long long a, long long b, long long c, long long d) {
+	long long ab = a > b ? a : b, cd = c > d ? c : d;
+	return ab > cd ? ab : cd;
+}
+
+static Range intersect(Range a, Range b) {
+	return (Range) { .lo = a.lo > b.lo ? a.lo : b.lo, .hi = a.hi < b.hi ? a.hi : b.hi };
+}
+
+// Returns the slot of a variable expression whose facts can be trusted, or NO_SLOT
+static int var_slot(Bounds* bounds, Expr expr) {
+	if (EXPR_TYPE(expr) != VAR || is_mixed_slot(bounds, get_var(bounds->tree, expr)->slot)) {
+		return NO_SLOT;
+	}
+
+	return get_var(bounds->tree, expr)->slot;
+}
+
+static bool is_mixed_slot(Bounds* bounds, int slot) {
+	return is_mixed_symbol(vector_get(bounds->symbols, slot));
+}
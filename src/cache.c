@@ -0,0 +1,562 @@
+#include <stdio.h>
+#include <fcntl.h>
+#include <assert.h>
+#include <limits.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <stdbool.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "dependence.h"
+#include "bytecode.h"
+#include "cache.h"
+
+// A cache file starts with a header, followed by the program's text and its
+// bytecode. Everything refers to everything else by its offset in the file, so
+// the file can be mapped anywhere and its arrays used in place
+
+#define CACHE_MAGIC "IPLC"
+#define CACHE_FORMAT 2 // Bump whenever the layout changes
+
+#define ALIGNMENT 8
+#define MAX_PATH 4096
+#define MAX_REGS (1 << 24) // Far more slots or temporaries than any program has
+
+// The Makefile derives the key from the interpreter's sources, which cache.o is
+// rebuilt along with whenever any of them changes
+#ifndef BUILD_KEY
+#error "BUILD_KEY must be defined (see the Makefile)"
+#endif
+
+typedef struct header {
+	char magic[4];
+	uint32_t format;
+	char build[32]; // The key of the interpreter that wrote the file
+	uint32_t n_ops;
+	uint32_t instr_size;
+	int32_t opt_level;
+	int32_t parallel;
+	PassStats stats;
+	uint64_t file_size;
+	uint64_t source;
+	uint64_t source_size;
+	uint64_t program; // The main program's record
+} Header;
+
+typedef struct program_record {
+	int32_t n_code;
+	int32_t n_consts;
+	int32_t n_slots;
+	int32_t n_temps;
+	int32_t n_loops;
+	int32_t n_idioms;
+	int32_t n_parallel;
+	uint64_t code; // The following are arrays of the above sizes
+	uint64_t lines;
+	uint64_t fusions;
+	uint64_t consts;
+	uint64_t idioms;
+	uint64_t parallel; // Of parallel records
+} ProgramRecord;
+
+typedef struct parallel_record {
+	int32_t counter;
+	int32_t limit_is_var;
+	int32_t limit;
+	int32_t inclusive;
+	int32_t n_reductions;
+	int32_t end;
+	int32_t n_tracked;
+	int32_t unused; // Keeps the offsets aligned
+	uint64_t reductions;
+	uint64_t tracked;
+	uint64_t stamps;
+	uint64_t body; // The body's program record
+} ParallelRecord;
+
+struct mapped_program {
+	char* base;
+	size_t size;
+	Program* program;
+};
+
+// The files that a build writes are only ever read by builds of the same sources,
+// since the bytecode and structs of any other may differ
+static const char build[] = BUILD_KEY;
+
+// What every operand of an instruction is, so that a mapped program can be held to
+// what the compiler guarantees before the VM (or the JIT) runs any of it
+typedef enum operand_kind {
+	OPND_ANY,      // Unused, an immediate or an error status
+	OPND_READ,     // A register that's read, which may be a constant
+	OPND_WRITE,    // A register that's written
+	OPND_NAME,     // A name's slot, as an index into the arrays and their kinds
+	OPND_TARGET,   // An instruction to jump to
+	OPND_LOOP,     // One of the program's loops
+	OPND_LOOP_END, // The end of the loop that starts at the instruction
+	OPND_IDIOM,    // One of the program's idioms
+	OPND_PARALLEL  // One of the program's parallel loops
+} OperandKind;
+
+static const OperandKind operand_kinds[N_OPS][3] = {
+	[OP_MOVE] = { OPND_WRITE, OPND_READ, OPND_ANY },
+	[OP_ADD] = { OPND_WRITE, OPND_READ, OPND_READ },
+	[OP_SUB] = { OPND_WRITE, OPND_READ, OPND_READ },
+	[OP_MUL] = { OPND_WRITE, OPND_READ, OPND_READ },
+	[OP_DIV] = { OPND_WRITE, OPND_READ, OPND_READ },
+	[OP_MOD] = { OPND_WRITE, OPND_READ, OPND_READ },
+	[OP_JUMP] = { OPND_TARGET, OPND_ANY, OPND_ANY },
+	[OP_JUMP_ZERO] = { OPND_TARGET, OPND_READ, OPND_ANY },
+	[OP_JUMP_NOT_ZERO] = { OPND_TARGET, OPND_READ, OPND_ANY },
+	[OP_JUMP_EQ] = { OPND_TARGET, OPND_READ, OPND_READ },
+	[OP_JUMP_NE] = { OPND_TARGET, OPND_READ, OPND_READ },
+	[OP_JUMP_LT] = { OPND_TARGET, OPND_READ, OPND_READ },
+	[OP_JUMP_LE] = { OPND_TARGET, OPND_READ, OPND_READ },
+	[OP_JUMP_GT] = { OPND_TARGET, OPND_READ, OPND_READ },
+	[OP_JUMP_GE] = { OPND_TARGET, OPND_READ, OPND_READ },
+	[OP_GET_ELEM] = { OPND_WRITE, OPND_NAME, OPND_READ },
+	[OP_SET_ELEM] = { OPND_NAME, OPND_READ, OPND_READ },
+	[OP_CHECK_VAR] = { OPND_NAME, OPND_ANY, OPND_ANY },
+	[OP_CHECK_ARRAY] = { OPND_NAME, OPND_ANY, OPND_ANY },
+	[OP_CHECK_NEW] = { OPND_NAME, OPND_ANY, OPND_ANY },
+	[OP_NEW] = { OPND_NAME, OPND_READ, OPND_ANY },
+	[OP_FREE] = { OPND_NAME, OPND_ANY, OPND_ANY },
+	[OP_SIZE] = { OPND_WRITE, OPND_NAME, OPND_ANY },
+	[OP_READ] = { OPND_WRITE, OPND_ANY, OPND_ANY },
+	[OP_RANDOM] = { OPND_WRITE, OPND_ANY, OPND_ANY },
+	[OP_ARG] = { OPND_WRITE, OPND_READ, OPND_ANY },
+	[OP_ARG_SIZE] = { OPND_WRITE, OPND_ANY, OPND_ANY },
+	[OP_WRITE] = { OPND_READ, OPND_ANY, OPND_ANY },
+	[OP_WRITELN] = { OPND_READ, OPND_ANY, OPND_ANY },
+	[OP_WRITE_SPACE] = { OPND_ANY, OPND_ANY, OPND_ANY },
+	[OP_WRITE_NEWLINE] = { OPND_ANY, OPND_ANY, OPND_ANY },
+	[OP_ERROR] = { OPND_ANY, OPND_ANY, OPND_ANY }, [OP_HALT] = { OPND_ANY, OPND_ANY, OPND_ANY },
+	[OP_LOOP_HEAD] = { OPND_LOOP, OPND_LOOP_END, OPND_ANY },
+	[OP_KERNEL] = { OPND_TARGET, OPND_IDIOM, OPND_ANY },
+	[OP_PARALLEL] = { OPND_TARGET, OPND_PARALLEL, OPND_ANY },
+	[OP_INCREMENT] = { OPND_WRITE, OPND_ANY, OPND_ANY },
+	[OP_JUMP_EQ_IMM] = { OPND_TARGET, OPND_READ, OPND_ANY },
+	[OP_JUMP_NE_IMM] = { OPND_TARGET, OPND_READ, OPND_ANY },
+	[OP_JUMP_LT_IMM] = { OPND_TARGET, OPND_READ, OPND_ANY },
+	[OP_JUMP_LE_IMM] = { OPND_TARGET, OPND_READ, OPND_ANY },
+	[OP_JUMP_GT_IMM] = { OPND_TARGET, OPND_READ, OPND_ANY },
+	[OP_JUMP_GE_IMM] = { OPND_TARGET, OPND_READ, OPND_ANY },
+	[OP_ADD_ELEM] = { OPND_NAME, OPND_READ, OPND_READ },
+	[OP_SUB_ELEM] = { OPND_NAME, OPND_READ, OPND_READ }
+};
+
+typedef struct buffer {
+	char* data;
+	size_t size;
+	size_t cap;
+} Buffer;
+
+// Helper functions used by the cache (no reason to expose them)
+static void cache_path(char* path, const char* dir, const char* source, size_t size,
+	CacheKey key);
+static uint64_t append(Buffer* buf, const void* data, size_t size);
+static uint64_t write_program(Buffer* buf, Program* program);
+static bool in_bounds(MappedProgram* mapped, uint64_t offset, int64_t count, size_t elem_size);
+static Program* map_program(MappedProgram* mapped, uint64_t offset, Program* main);
+static bool check_parallel(ParallelCode* parallel, int n_slots);
+static bool check_code(Program* program, int n_names);
+static bool check_operand(Program* program, int pc, OperandKind kind, int value, int n_names);
+static bool check_idiom(Idiom* idiom, int n_slots, int n_names);
+static bool check_mapped_operand(Operand* operand, int n_slots);
+static bool in_range(int value, int lo, int hi);
+static void unmap_program(Program* program);
+
+unsigned long hash_text(const char* text, size_t size) {
+	uint64_t hash = 14695981039346656037ULL;
+	for (size_t i = 0; i < size; i++) {
+		hash = (hash ^ (unsigned char) text[i]) * 1099511628211ULL;
+	}
+
+	return hash;
+}
+
+// Every text gets a file per key, named after the text's hash
+static void cache_path(char* path, const char* dir, const char* source, size_t size,
+	CacheKey key) {
+	snprintf(path, MAX_PATH, "%s/%016lx-O%d%s.iplc", dir, hash_text(source, size),
+		key.opt_level, key.parallel ? "p" : "");
+}
+
+MappedProgram* cache_load(const char* dir, const char* source, size_t size, CacheKey key,
+	Program** program, PassStats* stats) {
+	char path[MAX_PATH];
+	cache_path(path, dir, source, size, key);
+
+	int fd = open(path, O_RDONLY);
+	if (fd < 0) {
+		return NULL;
+	}
+
+	// Only files that nobody else could have written are trusted
+	struct stat st;
+	if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_uid != geteuid() ||
+		(st.st_mode & (S_IWGRP | S_IWOTH)) != 0 || st.st_size < (off_t) sizeof(Header)) {
+		close(fd);
+		return NULL;
+	}
+
+	char* base = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (base == MAP_FAILED) {
+		return NULL;
+	}
+
+	MappedProgram* mapped = malloc(sizeof(MappedProgram));
+	assert(mapped != NULL);
+
+	mapped->base = base;
+	mapped->size = st.st_size;
+	mapped->program = NULL;
+
+	// Anything that doesn't match means that the file is stale, so it's ignored
+	// (and replaced once the program is compiled again)
+	Header* header = (Header*) base;
+	bool valid = memcmp(header->magic, CACHE_MAGIC, 4) == 0 &&
+		header->format == CACHE_FORMAT &&
+		strncmp(header->build, build, sizeof(header->build)) == 0 &&
+		header->n_ops == N_OPS && header->instr_size == sizeof(Instr) &&
+		header->opt_level == key.opt_level && header->parallel == key.parallel &&
+		header->file_size == mapped->size && header->source_size == size &&
+		in_bounds(mapped, header->source, size, 1) &&
+		memcmp(base + header->source, source, size) == 0;
+
+	if (valid) {
+		mapped->program = map_program(mapped, header->program, NULL);
+	}
+
+	if (mapped->program == NULL) {
+		cache_unmap(mapped);
+		return NULL;
+	}
+
+	*program = mapped->program;
+	*stats = header->stats;
+	return mapped;
+}
+
+void cache_store(const char* dir, const char* source, size_t size, CacheKey key,
+	Program* program, PassStats* stats) {
+	Buffer buf = { .data = NULL, .size = 0, .cap = 0 };
+
+	Header header;
+	memset(&header, 0, sizeof(Header));
+	append(&buf, &header, sizeof(Header)); // Filled in once the offsets are known
+
+	memcpy(header.magic, CACHE_MAGIC, 4);
+	header.format = CACHE_FORMAT;
+	strncpy(header.build, build, sizeof(header.build));
+	header.n_ops = N_OPS;
+	header.instr_size = sizeof(Instr);
+	header.opt_level = key.opt_level;
+	header.parallel = key.parallel;
+	header.stats = *stats;
+	header.source = append(&buf, source, size);
+	header.source_size = size;
+	header.program = write_program(&buf, program);
+	header.file_size = buf.size;
+	memcpy(buf.data, &header, sizeof(Header));
+
+	char path[MAX_PATH];
+	char tmp_path[MAX_PATH + 8];
+	cache_path(path, dir, source, size, key);
+	snprintf(tmp_path, sizeof(tmp_path), "%s.XXXXXX", path);
+
+	// Readers either see the old file or the whole new one, never a partial one
+	mkdir(dir, 0755);
+	int fd = mkstemp(tmp_path);
+	if (fd >= 0) {
+		bool written = write(fd, buf.data, buf.size) == (ssize_t) buf.size;
+		close(fd);
+
+		if (!written || rename(tmp_path, path) != 0) {
+			unlink(tmp_path);
+		}
+	}
+
+	free(buf.data);
+}
+
+void cache_unmap(MappedProgram* mapped) {
+	if (mapped->program != NULL) {
+		unmap_program(mapped->program);
+	}
+
+	munmap(mapped->base, mapped->size);
+	free(mapped);
+}
+
+// Appends data to buf at the next aligned offset and returns that offset
+static uint64_t append(Buffer* buf, const void* data, size_t size) {
+	size_t offset = (buf->size + ALIGNMENT - 1) & ~(size_t) (ALIGNMENT - 1);
+
+	if (offset + size > buf->cap) {
+		buf->cap = 2 * (offset + size) > 4096 ? 2 * (offset + size) : 4096;
+		buf->data = realloc(buf->data, buf->cap);
+		assert(buf->data != NULL);
+	}
+
+	memset(buf->data + buf->size, 0, offset - buf->size);
+	if (size > 0) {
+		memcpy(buf->data + offset, data, size);
+	}
+
+	buf->size = offset + size;
+	return offset;
+}
+
+// Writes a program's arrays (and its parallel loops' programs) to buf, followed by
+// its record, and returns the record's offset
+static uint64_t write_program(Buffer* buf, Program* program) {
+	ProgramRecord record = {
+		.n_code = program->n_code, .n_consts = program->n_consts,
+		.n_slots = program->n_slots, .n_temps = program->n_temps,
+		.n_loops = program->n_loops, .n_idioms = program->n_idioms,
+		.n_parallel = program->n_parallel
+	};
+
+	record.code = append(buf, program->code, program->n_code * sizeof(Instr));
+	record.lines = append(buf, program->lines, program->n_code * sizeof(int));
+	record.fusions = append(buf, program->fusions, program->n_code * sizeof(Fusion));
+	record.consts = append(buf, program->consts, program->n_consts * sizeof(int));
+	record.idioms = append(buf, program->idioms, program->n_idioms * sizeof(Idiom));
+
+	ParallelRecord* parallel = calloc(program->n_parallel + 1, sizeof(ParallelRecord));
+	assert(parallel != NULL);
+
+	for (int i = 0; i < program->n_parallel; i++) {
+		ParallelCode* code = &program->parallel[i];
+		ParallelLoop* loop = code->loop;
+
+		parallel[i] = (ParallelRecord) {
+			.counter = loop->counter, .limit_is_var = loop->limit.is_var,
+			.limit = loop->limit.value, .inclusive = loop->inclusive,
+			.n_reductions = loop->n_reductions, .end = code->end,
+			.n_tracked = loop->n_tracked
+		};
+
+		parallel[i].reductions = append(buf, loop->reductions, loop->n_reductions * sizeof(int));
+		parallel[i].tracked = append(buf, loop->tracked, loop->n_tracked * sizeof(int));
+		parallel[i].stamps = append(buf, loop->stamps, loop->n_tracked * sizeof(int));
+		parallel[i].body = write_program(buf, code->body);
+	}
+
+	record.parallel = append(buf, parallel, program->n_parallel * sizeof(ParallelRecord));
+	free(parallel);
+
+	return append(buf, &record, sizeof(ProgramRecord));
+}
+
+// Every array was appended at an aligned offset, so one that isn't can't be read in place
+static bool in_bounds(MappedProgram* mapped, uint64_t offset, int64_t count, size_t elem_size) {
+	return count >= 0 && offset % ALIGNMENT == 0 && offset <= mapped->size &&
+		(uint64_t) count <= (mapped->size - offset) / elem_size;
+}
+
+// Builds a program whose arrays point into the mapping out of the record at offset,
+// or returns NULL if any of it lies outside the file or isn't something that the
+// compiler could have produced. The body of a parallel loop gets the main program,
+// whose arrays its workers share. Only the main program has parallel loops, which
+// also keeps a damaged file from sending this in circles
+static Program* map_program(MappedProgram* mapped, uint64_t offset, Program* main) {
+	bool is_body = main != NULL;
+	if (!in_bounds(mapped, offset, 1, sizeof(ProgramRecord))) {
+		return NULL;
+	}
+
+	ProgramRecord* record = (ProgramRecord*) (mapped->base + offset);
+	if (!in_range(record->n_code, 1, INT_MAX) || !in_range(record->n_slots, 0, MAX_REGS) ||
+		!in_range(record->n_temps, 0, MAX_REGS) || !in_range(record->n_loops, 0, record->n_code) ||
+		!in_bounds(mapped, record->code, record->n_code, sizeof(Instr)) ||
+		!in_bounds(mapped, record->lines, record->n_code, sizeof(int)) ||
+		!in_bounds(mapped, record->fusions, record->n_code, sizeof(Fusion)) ||
+		!in_bounds(mapped, record->consts, record->n_consts, sizeof(int)) ||
+		!in_bounds(mapped, record->idioms, record->n_idioms, sizeof(Idiom)) ||
+		!in_bounds(mapped, record->parallel, record->n_parallel, sizeof(ParallelRecord)) ||
+		(is_body && record->n_parallel > 0)) {
+		return NULL;
+	}
+
+	Program* program = malloc(sizeof(Program));
+	assert(program != NULL);
+
+	program->code = (Instr*) (mapped->base + record->code);
+	program->lines = (int*) (mapped->base + record->lines);
+	program->fusions = (Fusion*) (mapped->base + record->fusions);
+	program->n_code = record->n_code;
+	program->consts = (int*) (mapped->base + record->consts);
+	program->n_consts = record->n_consts;
+	program->n_slots = record->n_slots;
+	program->n_temps = record->n_temps;
+	program->n_loops = record->n_loops;
+	program->idioms = (Idiom*) (mapped->base + record->idioms);
+	program->n_idioms = record->n_idioms;
+
+	program->parallel = calloc(record->n_parallel + 1, sizeof(ParallelCode));
+	assert(program->parallel != NULL);
+	program->n_parallel = 0;
+
+	ParallelRecord* parallel = (ParallelRecord*) (mapped->base + record->parallel);
+	for (int i = 0; i < record->n_parallel; i++) {
+		if (!in_bounds(mapped, parallel[i].reductions, parallel[i].n_reductions, sizeof(int)) ||
+			!in_bounds(mapped, parallel[i].tracked, parallel[i].n_tracked, sizeof(int)) ||
+			!in_bounds(mapped, parallel[i].stamps, parallel[i].n_tracked, sizeof(int))) {
+			unmap_program(program);
+			return NULL;
+		}
+
+		Program* body = map_program(mapped, parallel[i].body, program);
+		if (body == NULL) {
+			unmap_program(program);
+			return NULL;
+		}
+
+		// Only the fields that the VM uses are kept
+		ParallelLoop* loop = calloc(1, sizeof(ParallelLoop));
+		assert(loop != NULL);
+
+		loop->counter = parallel[i].counter;
+		loop->limit = (Operand) { .is_var = parallel[i].limit_is_var, .value = parallel[i].limit };
+		loop->inclusive = parallel[i].inclusive;
+		loop->reductions = (int*) (mapped->base + parallel[i].reductions);
+		loop->n_reductions = parallel[i].n_reductions;
+		loop->tracked = (int*) (mapped->base + parallel[i].tracked);
+		loop->stamps = (int*) (mapped->base + parallel[i].stamps);
+		loop->n_tracked = parallel[i].n_tracked;
+
+		program->parallel[program->n_parallel++] = (ParallelCode) {
+			.loop = loop, .body = body, .end = parallel[i].end
+		};
+
+		if (!check_parallel(&program->parallel[program->n_parallel - 1], program->n_slots)) {
+			unmap_program(program);
+			return NULL;
+		}
+	}
+
+	if (!check_code(program, is_body ? main->n_slots : program->n_slots)) {
+		unmap_program(program);
+		return NULL;
+	}
+
+	return program;
+}
+
+// The workers start out with the program's variables in their body's registers
+static bool check_parallel(ParallelCode* parallel, int n_slots) {
+	ParallelLoop* loop = parallel->loop;
+	Program* body = parallel->body;
+
+	if (!in_range(loop->counter, 0, n_slots) ||
+		(loop->limit.is_var && !in_range(loop->limit.value, 0, n_slots)) ||
+		body->n_slots < n_slots || !in_range(parallel->end, 0, body->n_slots + body->n_temps)) {
+		return false;
+	}
+
+	for (int i = 0; i < loop->n_reductions; i++) {
+		if (!in_range(loop->reductions[i], 0, n_slots)) {
+			return false;
+		}
+	}
+
+	for (int i = 0; i < loop->n_tracked; i++) {
+		if (!in_range(loop->tracked[i], 0, n_slots) || !in_range(loop->stamps[i], 0, n_slots)) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+// Every operand must be within what it refers to, and the code must end with the
+// halt that the compiler puts there, so that running it never leaves it. n_names
+// is the number of slots that the arrays and their kinds have room for
+static bool check_code(Program* program, int n_names) {
+	if (program->code[program->n_code - 1].op != OP_HALT) {
+		return false;
+	}
+
+	for (int pc = 0; pc < program->n_code; pc++) {
+		Instr* instr = &program->code[pc];
+		if ((unsigned) instr->op >= N_OPS || (unsigned) program->fusions[pc] >= N_FUSIONS) {
+			return false;
+		}
+
+		const OperandKind* kinds = operand_kinds[instr->op];
+		if (!check_operand(program, pc, kinds[0], instr->a, n_names) ||
+			!check_operand(program, pc, kinds[1], instr->b, n_names) ||
+			!check_operand(program, pc, kinds[2], instr->c, n_names)) {
+			return false;
+		}
+	}
+
+	for (int i = 0; i < program->n_idioms; i++) {
+		if (!check_idiom(&program->idioms[i], program->n_slots, n_names)) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+static bool check_operand(Program* program, int pc, OperandKind kind, int value, int n_names) {
+	int n_regs = program->n_slots + program->n_temps;
+
+	switch (kind) {
+		case OPND_ANY: return true;
+		case OPND_READ: return in_range(value, -program->n_consts, n_regs);
+		case OPND_WRITE: return in_range(value, 0, n_regs);
+		case OPND_NAME: return in_range(value, 0, n_names);
+		case OPND_TARGET: return in_range(value, 0, program->n_code);
+		case OPND_LOOP: return in_range(value, 0, program->n_loops);
+		case OPND_LOOP_END: return in_range(value, pc + 1, program->n_code); // Before the halt
+		case OPND_IDIOM: return in_range(value, 0, program->n_idioms);
+		case OPND_PARALLEL: return in_range(value, 0, program->n_parallel);
+	}
+
+	return false;
+}
+
+// Kernels read the loop's variables from the registers and its arrays by name
+static bool check_idiom(Idiom* idiom, int n_slots, int n_names) {
+	if ((unsigned) idiom->type > IDIOM_MAX || !in_range(idiom->counter, 0, n_slots) ||
+		!check_mapped_operand(&idiom->limit, n_slots) ||
+		!check_mapped_operand(&idiom->value, n_slots)) {
+		return false;
+	}
+
+	bool writes_array = idiom->type != IDIOM_SUM && idiom->type != IDIOM_MAX;
+
+	return in_range(idiom->target, 0, writes_array ? n_names : n_slots) &&
+		(idiom->type == IDIOM_FILL || in_range(idiom->src1, 0, n_names)) &&
+		(idiom->type != IDIOM_ADD || in_range(idiom->src2, 0, n_names));
+}
+
+// The flag comes straight from the file, so its byte is looked at before it's used as a bool
+static bool check_mapped_operand(Operand* operand, int n_slots) {
+	unsigned char is_var = *(unsigned char*) &operand->is_var;
+	return is_var == 0 || (is_var == 1 && in_range(operand->value, 0, n_slots));
+}
+
+// Whether lo <= value < hi
+static bool in_range(int value, int lo, int hi) {
+	return value >= lo && value < hi;
+}
+
+// Frees what map_program allocated, leaving the mapping alone
+static void unmap_program(Program* program) {
+	for (int i = 0; i < program->n_parallel; i++) {
+		free(program->parallel[i].loop);
+		unmap_program(program->parallel[i].body);
+	}
+
+	free(program->parallel);
+	free(program);
+}
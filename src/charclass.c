@@ -0,0 +1,200 @@
+#include <pthread.h>
+#include <stdbool.h>
+
+#include "charclass.h"
+
+// Same as the array kernels: SSE2 is always there on x86-64 and AVX2 is picked at
+// runtime. Building with SCALAR_SCANNER defined (make SCANNER=scalar) skips both
+#if defined(__x86_64__) && defined(__GNUC__) && !defined(SCALAR_SCANNER)
+#define X86_SKIPPERS
+#include <immintrin.h>
+#endif
+
+typedef enum char_class {
+	CLASS_NAME, CLASS_DIGIT, CLASS_BLANK, CLASS_TAB
+} CharClass;
+
+// Helper functions used by the skippers (no reason to expose them)
+static void select_skippers(void);
+static bool in_class(unsigned char symbol, CharClass class);
+
+static bool in_class(unsigned char symbol, CharClass class) {
+	switch (class) {
+		case CLASS_NAME:
+			return (symbol >= 'a' && symbol <= 'z') || (symbol >= 'A' && symbol <= 'Z') ||
+			       (symbol >= '0' && symbol <= '9') || symbol == '_';
+
+		case CLASS_DIGIT: return symbol >= '0' && symbol <= '9';
+		case CLASS_BLANK: return symbol == ' ' || symbol == '\t';
+		case CLASS_TAB: return symbol == '\t';
+	}
+
+	return false;
+}
+
+static inline const char* skip_scalar(const char* p, const char* end, CharClass class) {
+	while (p < end && in_class(*p, class)) {
+		p++;
+	}
+	return p;
+}
+
+static const char* name_scalar(const char* p, const char* end) {
+	return skip_scalar(p, end, CLASS_NAME);
+}
+
+static const char* digits_scalar(const char* p, const char* end) {
+	return skip_scalar(p, end, CLASS_DIGIT);
+}
+
+static const char* blanks_scalar(const char* p, const char* end) {
+	return skip_scalar(p, end, CLASS_BLANK);
+}
+
+static const char* tabs_scalar(const char* p, const char* end) {
+	return skip_scalar(p, end, CLASS_TAB);
+}
+
+#ifdef X86_SKIPPERS
+
+// The vector loops only load whole vectors that lie inside the text (which may be
+// mapped right up to the end of a page) and leave the rest to the narrower ones.
+// A byte is in [lo, hi] when c - lo doesn't exceed hi - lo as an unsigned byte,
+// and ORing in 0x20 maps the upper case letters onto the lower case ones and
+// nothing else onto them
+
+static inline __m128i in_range_sse2(__m128i c, char lo, char hi) {
+	__m128i offset = _mm_sub_epi8(c, _mm_set1_epi8(lo));
+	return _mm_cmpeq_epi8(_mm_min_epu8(offset, _mm_set1_epi8(hi - lo)), offset);
+}
+
+static inline __m128i class_sse2(__m128i c, CharClass class) {
+	switch (class) {
+		case CLASS_NAME: {
+			__m128i alpha = in_range_sse2(_mm_or_si128(c, _mm_set1_epi8(0x20)), 'a', 'z');
+			__m128i digit = in_range_sse2(c, '0', '9');
+			__m128i underscore = _mm_cmpeq_epi8(c, _mm_set1_epi8('_'));
+			return _mm_or_si128(_mm_or_si128(alpha, digit), underscore);
+		}
+
+		case CLASS_DIGIT: return in_range_sse2(c, '0', '9');
+		case CLASS_BLANK:
+			return _mm_or_si128(_mm_cmpeq_epi8(c, _mm_set1_epi8(' ')),
+			                    _mm_cmpeq_epi8(c, _mm_set1_epi8('\t')));
+		case CLASS_TAB: return _mm_cmpeq_epi8(c, _mm_set1_epi8('\t'));
+	}
+
+	return _mm_setzero_si128();
+}
+
+static inline const char* skip_sse2(const char* p, const char* end, CharClass class) {
+	for (; end - p >= 16; p += 16) {
+		__m128i c = _mm_loadu_si128((const __m128i*) p);
+		unsigned outside = ~_mm_movemask_epi8(class_sse2(c, class)) & 0xFFFF;
+		if (outside != 0) {
+			return p + __builtin_ctz(outside);
+		}
+	}
+
+	return skip_scalar(p, end, class);
+}
+
+static const char* name_sse2(const char* p, const char* end) {
+	return skip_sse2(p, end, CLASS_NAME);
+}
+
+static const char* digits_sse2(const char* p, const char* end) {
+	return skip_sse2(p, end, CLASS_DIGIT);
+}
+
+static const char* blanks_sse2(const char* p, const char* end) {
+	return skip_sse2(p, end, CLASS_BLANK);
+}
+
+static const char* tabs_sse2(const char* p, const char* end) {
+	return skip_sse2(p, end, CLASS_TAB);
+}
+
+__attribute__((target("avx2")))
+static inline __m256i in_range_avx2(__m256i c, char lo, char hi) {
+	__m256i offset = _mm256_sub_epi8(c, _mm256_set1_epi8(lo));
+	return _mm256_cmpeq_epi8(_mm256_min_epu8(offset, _mm256_set1_epi8(hi - lo)), offset);
+}
+
+__attribute__((target("avx2")))
+static inline __m256i class_avx2(__m256i c, CharClass class) {
+	switch (class) {
+		case CLASS_NAME: {
+			__m256i alpha = in_range_avx2(_mm256_or_si256(c, _mm256_set1_epi8(0x20)), 'a', 'z');
+			__m256i digit = in_range_avx2(c, '0', '9');
+			__m256i underscore = _mm256_cmpeq_epi8(c, _mm256_set1_epi8('_'));
+			return _mm256_or_si256(_mm256_or_si256(alpha, digit), underscore);
+		}
+
+		case CLASS_DIGIT: return in_range_avx2(c, '0', '9');
+		case CLASS_BLANK:
+			return _mm256_or_si256(_mm256_cmpeq_epi8(c, _mm256_set1_epi8(' ')),
+			                       _mm256_cmpeq_epi8(c, _mm256_set1_epi8('\t')));
+		case CLASS_TAB: return _mm256_cmpeq_epi8(c, _mm256_set1_epi8('\t'));
+	}
+
+	return _mm256_setzero_si256();
+}
+
+__attribute__((target("avx2")))
+static inline const char* skip_avx2(const char* p, const char* end, CharClass class) {
+	for (; end - p >= 32; p += 32) {
+		__m256i c = _mm256_loadu_si256((const __m256i*) p);
+		unsigned outside = ~(unsigned) _mm256_movemask_epi8(class_avx2(c, class));
+		if (outside != 0) {
+			return p + __builtin_ctz(outside);
+		}
+	}
+
+	return skip_sse2(p, end, class);
+}
+
+__attribute__((target("avx2")))
+static const char* name_avx2(const char* p, const char* end) {
+	return skip_avx2(p, end, CLASS_NAME);
+}
+
+__attribute__((target("avx2")))
+static const char* digits_avx2(const char* p, const char* end) {
+	return skip_avx2(p, end, CLASS_DIGIT);
+}
+
+__attribute__((target("avx2")))
+static const char* blanks_avx2(const char* p, const char* end) {
+	return skip_avx2(p, end, CLASS_BLANK);
+}
+
+__attribute__((target("avx2")))
+static const char* tabs_avx2(const char* p, const char* end) {
+	return skip_avx2(p, end, CLASS_TAB);
+}
+
+#endif // X86_SKIPPERS
+
+// This is used as a wrapper for the skippers that were picked for this CPU, which
+// programs that are loaded side by side (e.g. by the server) may ask for at once
+static CharSkippers skippers;
+static pthread_once_t skippers_once = PTHREAD_ONCE_INIT;
+
+static void select_skippers(void) {
+	skippers = (CharSkippers) { "scalar", name_scalar, digits_scalar, blanks_scalar, tabs_scalar };
+
+#ifdef X86_SKIPPERS
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2")) {
+		skippers = (CharSkippers) { "avx2", name_avx2, digits_avx2, blanks_avx2, tabs_avx2 };
+	} else {
+		skippers = (CharSkippers) { "sse2", name_sse2, digits_sse2, blanks_sse2, tabs_sse2 };
+	}
+#endif
+}
+
+const CharSkippers* char_skippers(void) {
+	pthread_once(&skippers_once, select_skippers);
+	return &skippers;
+}
@@ -0,0 +1,622 @@
+#include <stdio.h>
+#include <assert.h>
+#include <stdlib.h>
+#include <stdbool.h>
+
+#include "map.h"
+#include "vector.h"
+
+#include "stmt.h"
+#include "expr.h"
+#include "error.h"
+#include "token.h"
+#include "bytecode.h"
+#include "compiler.h"
+#include "resolver.h"
+#include "peephole.h"
+
+#define MIN_CAP 64
+#define NO_JUMP (-1)
+
+// Jumps to a location that isn't known yet are chained through their (unused)
+// target operand, so every pending label is just the pc of its latest jump
+typedef struct loop {
+	int break_jumps;
+	int continue_jumps;
+} Loop;
+
+typedef struct compiler Compiler;
+
+// Helper functions used by the compiler (no reason to expose them)
+static void init_compiler(Compiler* compiler, Tree* tree, Vector symbols);
+static Program* finish_program(Compiler* compiler);
+static Program* compile_parallel_body(Tree* tree, ParallelCode* parallel, Block stmts,
+	Vector symbols);
+static void compile_stmts(Compiler* compiler, Block stmts);
+static void compile_stmt(Compiler* compiler, Stmt* stmt);
+static void compile_read_stmt(Compiler* compiler, int line, ReadStmt* stmt);
+static void compile_assignment_stmt(Compiler* compiler, int line, AssignmentStmt* stmt);
+static void compile_write_stmt(Compiler* compiler, int line, WriteStmt* stmt);
+static void compile_writeln_stmt(Compiler* compiler, int line, WritelnStmt* stmt);
+static void compile_while_stmt(Compiler* compiler, int line, WhileStmt* stmt);
+static void compile_if_else_stmt(Compiler* compiler, int line, IfElseStmt* stmt);
+static void compile_random_stmt(Compiler* compiler, int line, RandomStmt* stmt);
+static void compile_arg_stmt(Compiler* compiler, int line, ArgStmt* stmt);
+static void compile_arg_size_stmt(Compiler* compiler, int line, ArgSizeStmt* stmt);
+static void compile_break_stmt(Compiler* compiler, int line, BreakStmt* stmt);
+static void compile_continue_stmt(Compiler* compiler, int line, ContinueStmt* stmt);
+static void compile_new_stmt(Compiler* compiler, int line, NewStmt* stmt);
+static void compile_free_stmt(Compiler* compiler, int line, FreeStmt* stmt);
+static void compile_size_stmt(Compiler* compiler, int line, SizeStmt* stmt);
+static int compile_cond(Compiler* compiler, int line, Expr cond, bool jump_if);
+static int compile_expr(Compiler* compiler, int line, Expr expr);
+static int compile_index(Compiler* compiler, int line, Array* array);
+static void compile_store(Compiler* compiler, int line, Expr lvalue, int value);
+static bool can_fail(Compiler* compiler, Expr expr);
+static bool is_mixed_slot(Compiler* compiler, int slot);
+static int constant_register(Compiler* compiler, int value);
+static int add_idiom(Compiler* compiler, Idiom* idiom);
+static int add_parallel_loop(Compiler* compiler, ParallelLoop* loop, Block stmts);
+static int new_temp(Compiler* compiler);
+static int emit(Compiler* compiler, int line, OpCode op, int a, int b, int c);
+static int chain_jump(Compiler* compiler, int line, OpCode op, int list, int b, int c);
+static void patch_jumps(Compiler* compiler, int list, int target);
+static OpCode jump_op(TokenType type, bool jump_if);
+
+// This is used as a wrapper for the compiler's state
+struct compiler {
+	Tree* tree;
+	Program* program;
+	int code_cap;
+	int consts_cap;
+	int idioms_cap;
+	int parallel_cap;
+	Block* bodies; // The statements of the parallel loops, which are compiled last
+	Map consts; // Maps constant values to their index in the constant table
+	Vector symbols;
+	int n_temps; // Temporaries in use by the current statement
+	Loop* loops;
+	int loop_nesting;
+	int loops_cap;
+};
+
+static int* create_int(int value) {
+	int* new_int = malloc(sizeof(int));
+	assert(new_int != NULL);
+	*new_int = value;
+	return new_int;
+}
+
+static int cmp_ints(void* a, void* b) {
+	return *((int*) a) - *((int*) b);
+}
+
+static unsigned long hash_int(void* key) {
+	return (unsigned int) *((int*) key);
+}
+
+static void init_compiler(Compiler* compiler, Tree* tree, Vector symbols) {
+	Program* program = malloc(sizeof(Program));
+	assert(program != NULL);
+
+	program->code = malloc(MIN_CAP * sizeof(Instr));
+	program->lines = malloc(MIN_CAP * sizeof(int));
+	program->fusions = NULL;
+	program->consts = malloc(MIN_CAP * sizeof(int));
+	assert(program->code != NULL && program->lines != NULL && program->consts != NULL);
+
+	program->n_code = 0;
+	program->n_consts = 0;
+	program->n_slots = vector_size(symbols);
+	program->n_temps = 0;
+	program->n_loops = 0;
+
+	program->idioms = malloc(MIN_CAP * sizeof(Idiom));
+	assert(program->idioms != NULL);
+	program->n_idioms = 0;
+
+	program->parallel = malloc(MIN_CAP * sizeof(ParallelCode));
+	compiler->bodies = malloc(MIN_CAP * sizeof(Block));
+	assert(program->parallel != NULL && compiler->bodies != NULL);
+	program->n_parallel = 0;
+
+	compiler->tree = tree;
+	compiler->program = program;
+	compiler->code_cap = MIN_CAP;
+	compiler->consts_cap = MIN_CAP;
+	compiler->idioms_cap = MIN_CAP;
+	compiler->parallel_cap = MIN_CAP;
+	compiler->consts = map_create(cmp_ints, free, free, hash_int);
+	compiler->symbols = symbols;
+	compiler->n_temps = 0;
+
+	compiler->loops = malloc(MIN_CAP * sizeof(Loop));
+	assert(compiler->loops != NULL);
+	compiler->loop_nesting = 0;
+	compiler->loops_cap = MIN_CAP;
+}
+
+Program* compile(Tree* tree, Block stmts, Vector symbols) {
+	Compiler compiler;
+	init_compiler(&compiler, tree, symbols);
+
+	compile_stmts(&compiler, stmts);
+	emit(&compiler, 0, OP_HALT, 0, 0, 0);
+
+	Block* bodies = compiler.bodies;
+	compiler.bodies = NULL;
+
+	Program* program = finish_program(&compiler);
+
+	// The workers of parallel loops run their bodies as programs of their own, which
+	// can only be compiled once the compiler is done with this one
+	for (int i = 0; i < program->n_parallel; i++) {
+		program->parallel[i].body = compile_parallel_body(tree, &program->parallel[i], bodies[i],
+			symbols);
+	}
+
+	free(bodies);
+	return program;
+}
+
+static Program* finish_program(Compiler* compiler) {
+	fuse_instructions(compiler->program);
+
+	map_destroy(compiler->consts);
+	free(compiler->loops);
+	free(compiler->bodies);
+
+	return compiler->program;
+}
+
+// Every name keeps its register, and end gets the one right after the variables,
+// so that temporaries don't overlap it. Running a whole range in one go lets the
+// worker's loop get compiled to native code, just like the loop itself would:
+//
+//         if counter >= end goto exit
+// body:   <stmts>
+//         if counter < end goto body
+// exit:   halt
+static Program* compile_parallel_body(Tree* tree, ParallelCode* parallel, Block stmts,
+	Vector symbols) {
+	Compiler compiler;
+	init_compiler(&compiler, tree, symbols);
+
+	Program* program = compiler.program;
+	int counter = parallel->loop->counter;
+	parallel->end = program->n_slots++;
+
+	int exit_jumps = chain_jump(&compiler, 0, OP_JUMP_GE, NO_JUMP, counter, parallel->end);
+	int body = emit(&compiler, 0, OP_LOOP_HEAD, program->n_loops++, 0, 0);
+
+	compile_stmts(&compiler, stmts);
+
+	patch_jumps(&compiler, chain_jump(&compiler, 0, OP_JUMP_LT, NO_JUMP, counter, parallel->end),
+		body);
+	patch_jumps(&compiler, exit_jumps, program->n_code);
+	program->code[body].b = program->n_code;
+
+	emit(&compiler, 0, OP_HALT, 0, 0, 0);
+	return finish_program(&compiler);
+}
+
+void destroy_program(Program* program) {
+	assert(program != NULL);
+
+	free(program->code);
+	free(program->lines);
+	free(program->fusions);
+	free(program->consts);
+	free(program->idioms);
+
+	for (int i = 0; i < program->n_parallel; i++) {
+		destroy_program(program->parallel[i].body);
+	}
+	free(program->parallel);
+	free(program);
+}
+
+static void compile_stmts(Compiler* compiler, Block stmts) {
+	for (int i = 0; i < stmts.n_stmts; i++) {
+		Stmt stmt = get_stmt(compiler->tree, stmts, i);
+		compile_stmt(compiler, &stmt);
+	}
+}
+
+static void compile_stmt(Compiler* compiler, Stmt* stmt) {
+	compiler->n_temps = 0; // Temporaries never outlive the statement that uses them
+	void* payload = get_payload(compiler->tree, stmt);
+
+	switch (stmt->type) {
+		case READ_STMT: compile_read_stmt(compiler, stmt->line, payload); break;
+		case ASSIGNMENT_STMT: compile_assignment_stmt(compiler, stmt->line, payload); break;
+		case WRITE_STMT: compile_write_stmt(compiler, stmt->line, payload); break;
+		case WRITELN_STMT: compile_writeln_stmt(compiler, stmt->line, payload); break;
+		case WHILE_STMT: compile_while_stmt(compiler, stmt->line, payload); break;
+		case IF_ELSE_STMT: compile_if_else_stmt(compiler, stmt->line, payload); break;
+		case RANDOM_STMT: compile_random_stmt(compiler, stmt->line, payload); break;
+		case ARG_STMT: compile_arg_stmt(compiler, stmt->line, payload); break;
+		case ARG_SIZE_STMT: compile_arg_size_stmt(compiler, stmt->line, payload); break;
+		case BREAK_STMT: compile_break_stmt(compiler, stmt->line, payload); break;
+		case CONTINUE_STMT: compile_continue_stmt(compiler, stmt->line, payload); break;
+		case NEW_STMT: compile_new_stmt(compiler, stmt->line, payload); break;
+		case FREE_STMT: compile_free_stmt(compiler, stmt->line, payload); break;
+		case SIZE_STMT: compile_size_stmt(compiler, stmt->line, payload); break;
+		default:
+			fprintf(stderr, "Invalid statement type (this shouldn't be printed)\n");
+			exit(EXIT_FAILURE);
+	}
+}
+
+// Values are always produced in a temporary and then stored into their lvalue. The
+// peephole pass retargets them to the variable itself wherever that's possible
+static void compile_read_stmt(Compiler* compiler, int line, ReadStmt* stmt) {
+	int value = new_temp(compiler);
+	emit(compiler, line, OP_READ, value, 0, 0);
+	compile_store(compiler, line, stmt->lvalue, value);
+}
+
+static void compile_assignment_stmt(Compiler* compiler, int line, AssignmentStmt* stmt) {
+	int value = compile_expr(compiler, line, stmt->expr);
+	compile_store(compiler, line, stmt->lvalue, value);
+}
+
+static void compile_write_stmt(Compiler* compiler, int line, WriteStmt* stmt) {
+	if (stmt->expr != NO_EXPR) {
+		emit(compiler, line, OP_WRITE, compile_expr(compiler, line, stmt->expr), 0, 0);
+	} else {
+		emit(compiler, line, OP_WRITE_SPACE, 0, 0, 0);
+	}
+}
+
+static void compile_writeln_stmt(Compiler* compiler, int line, WritelnStmt* stmt) {
+	if (stmt->expr != NO_EXPR) {
+		emit(compiler, line, OP_WRITELN, compile_expr(compiler, line, stmt->expr), 0, 0);
+	} else {
+		emit(compiler, line, OP_WRITE_NEWLINE, 0, 0, 0);
+	}
+}
+
+static void compile_while_stmt(Compiler* compiler, int line, WhileStmt* stmt) {
+	// Loops are rotated so that each iteration only needs a single jump:
+	//
+	//         if !cond goto exit
+	// body:   <stmts>
+	// cont:   if cond goto body
+	// exit:
+	//
+	// A loop that the idiom recognizer knows is preceded by OP_KERNEL, which jumps
+	// to exit whenever it can run the whole loop by itself, and a parallel loop by
+	// OP_PARALLEL, which does the same
+	int kernel = NO_JUMP;
+	if (stmt->idiom != NULL) {
+		kernel = emit(compiler, line, OP_KERNEL, 0, add_idiom(compiler, stmt->idiom), 0);
+	}
+
+	int parallel = NO_JUMP;
+	if (stmt->parallel != NULL) {
+		int index = add_parallel_loop(compiler, stmt->parallel, stmt->stmts);
+		parallel = emit(compiler, line, OP_PARALLEL, 0, index, 0);
+	}
+
+	int exit_jumps = compile_cond(compiler, line, stmt->cond, false);
+	int body = emit(compiler, line, OP_LOOP_HEAD, compiler->program->n_loops++, 0, 0);
+
+	if (compiler->loop_nesting == compiler->loops_cap) {
+		compiler->loops_cap *= 2;
+		compiler->loops = realloc(compiler->loops, compiler->loops_cap * sizeof(Loop));
+		assert(compiler->loops != NULL);
+	}
+
+	Loop* loop = &compiler->loops[compiler->loop_nesting++];
+	loop->break_jumps = exit_jumps;
+	loop->continue_jumps = NO_JUMP;
+
+	compile_stmts(compiler, stmt->stmts);
+
+	loop = &compiler->loops[--compiler->loop_nesting];
+	patch_jumps(compiler, loop->continue_jumps, compiler->program->n_code);
+
+	compiler->n_temps = 0;
+	patch_jumps(compiler, compile_cond(compiler, line, stmt->cond, true), body);
+	patch_jumps(compiler, loop->break_jumps, compiler->program->n_code);
+	compiler->program->code[body].b = compiler->program->n_code;
+
+	if (kernel != NO_JUMP) {
+		compiler->program->code[kernel].a = compiler->program->n_code;
+	}
+	if (parallel != NO_JUMP) {
+		compiler->program->code[parallel].a = compiler->program->n_code;
+	}
+}
+
+static void compile_if_else_stmt(Compiler* compiler, int line, IfElseStmt* stmt) {
+	int else_jumps = compile_cond(compiler, line, stmt->cond, false);
+	compile_stmts(compiler, stmt->then_stmts);
+
+	if (stmt->has_else) {
+		int end_jumps = chain_jump(compiler, line, OP_JUMP, NO_JUMP, 0, 0);
+		patch_jumps(compiler, else_jumps, compiler->program->n_code);
+		compile_stmts(compiler, stmt->else_stmts);
+		patch_jumps(compiler, end_jumps, compiler->program->n_code);
+	} else {
+		patch_jumps(compiler, else_jumps, compiler->program->n_code);
+	}
+}
+
+static void compile_random_stmt(Compiler* compiler, int line, RandomStmt* stmt) {
+	int value = new_temp(compiler);
+	emit(compiler, line, OP_RANDOM, value, 0, 0);
+	compile_store(compiler, line, stmt->lvalue, value);
+}
+
+static void compile_arg_stmt(Compiler* compiler, int line, ArgStmt* stmt) {
+	int pos = compile_expr(compiler, line, stmt->expr);
+	int value = new_temp(compiler);
+	emit(compiler, line, OP_ARG, value, pos, 0);
+	compile_store(compiler, line, stmt->lvalue, value);
+}
+
+static void compile_arg_size_stmt(Compiler* compiler, int line, ArgSizeStmt* stmt) {
+	int value = new_temp(compiler);
+	emit(compiler, line, OP_ARG_SIZE, value, 0, 0);
+	compile_store(compiler, line, stmt->lvalue, value);
+}
+
+static void compile_break_stmt(Compiler* compiler, int line, BreakStmt* stmt) {
+	if (stmt->n_loops > compiler->loop_nesting) {
+		// Only an error if it's ever reached, just like in the tree-walker
+		emit(compiler, line, OP_ERROR, EBAD_BREAK, 0, 0);
+		return;
+	}
+
+	Loop* loop = &compiler->loops[compiler->loop_nesting - stmt->n_loops];
+	loop->break_jumps = chain_jump(compiler, line, OP_JUMP, loop->break_jumps, 0, 0);
+}
+
+static void compile_continue_stmt(Compiler* compiler, int line, ContinueStmt* stmt) {
+	if (stmt->n_loops > compiler->loop_nesting) {
+		emit(compiler, line, OP_ERROR, EBAD_CONT, 0, 0);
+		return;
+	}
+
+	Loop* loop = &compiler->loops[compiler->loop_nesting - stmt->n_loops];
+	loop->continue_jumps = chain_jump(compiler, line, OP_JUMP, loop->continue_jumps, 0, 0);
+}
+
+static void compile_new_stmt(Compiler* compiler, int line, NewStmt* stmt) {
+	if (is_mixed_slot(compiler, stmt->slot)) {
+		emit(compiler, line, OP_CHECK_NEW, stmt->slot, 0, 0); // Must precede the size's evaluation
+	}
+
+	emit(compiler, line, OP_NEW, stmt->slot, compile_expr(compiler, line, stmt->size), 0);
+}
+
+static void compile_free_stmt(Compiler* compiler, int line, FreeStmt* stmt) {
+	emit(compiler, line, OP_FREE, stmt->slot, 0, 0);
+}
+
+static void compile_size_stmt(Compiler* compiler, int line, SizeStmt* stmt) {
+	int value = new_temp(compiler);
+	emit(compiler, line, OP_SIZE, value, stmt->slot, 0);
+	compile_store(compiler, line, stmt->lvalue, value);
+}
+
+// Emits a jump that's taken if cond evaluates to jump_if and returns it as a
+// pending jump list, so the caller can patch it once the target is known
+static int compile_cond(Compiler* compiler, int line, Expr cond, bool jump_if) {
+	if (EXPR_TYPE(cond) == BINARY) {
+		Binary* binary = get_binary(compiler->tree, cond);
+		OpCode op = jump_op(binary->type, jump_if);
+
+		if (op != OP_HALT) {
+			int left = compile_expr(compiler, line, binary->left);
+			int right = compile_expr(compiler, line, binary->right);
+			return chain_jump(compiler, line, op, NO_JUMP, left, right);
+		}
+	}
+
+	OpCode op = jump_if ? OP_JUMP_NOT_ZERO : OP_JUMP_ZERO;
+	return chain_jump(compiler, line, op, NO_JUMP, compile_expr(compiler, line, cond), 0);
+}
+
+// Returns a register holding the value of expr, which is only a new temporary if
+// the expression actually has to be computed
+static int compile_expr(Compiler* compiler, int line, Expr expr) {
+	switch (EXPR_TYPE(expr)) {
+		case LITERAL:
+			return constant_register(compiler, get_literal(compiler->tree, expr)->value);
+
+		case VAR: {
+			Var* var = get_var(compiler->tree, expr);
+			if (is_mixed_slot(compiler, var->slot)) {
+				emit(compiler, line, OP_CHECK_VAR, var->slot, 0, 0);
+			}
+			return var->slot;
+		}
+
+		case ARRAY: {
+			Array* array = get_array(compiler->tree, expr);
+			int idx = compile_index(compiler, line, array);
+			int dst = new_temp(compiler);
+			emit(compiler, line, OP_GET_ELEM, dst, array->slot, idx);
+			return dst;
+		}
+
+		case BINARY: {
+			Binary* binary = get_binary(compiler->tree, expr);
+			int left = compile_expr(compiler, line, binary->left);
+			int right = compile_expr(compiler, line, binary->right);
+			int dst = new_temp(compiler);
+
+			switch (binary->type) {
+				case PLUS: emit(compiler, line, OP_ADD, dst, left, right); break;
+				case MINUS: emit(compiler, line, OP_SUB, dst, left, right); break;
+				case STAR: emit(compiler, line, OP_MUL, dst, left, right); break;
+				case SLASH: emit(compiler, line, OP_DIV, dst, left, right); break;
+				case MODULO: emit(compiler, line, OP_MOD, dst, left, right); break;
+				default:
+					fprintf(stderr, "Invalid operator type (this shouldn't be printed)\n");
+					exit(EXIT_FAILURE);
+			}
+			return dst;
+		}
+
+		default:
+			fprintf(stderr, "Invalid expression type (this shouldn't be printed)\n");
+			exit(EXIT_FAILURE);
+	}
+}
+
+static int compile_index(Compiler* compiler, int line, Array* array) {
+	// The tree-walker checks the name before it evaluates the index, so if the
+	// index can fail on its own, the name check has to be done separately first
+	if (!array->in_bounds && can_fail(compiler, array->index)) {
+		emit(compiler, line, OP_CHECK_ARRAY, array->slot, 0, 0);
+	}
+
+	return compile_expr(compiler, line, array->index);
+}
+
+static void compile_store(Compiler* compiler, int line, Expr lvalue, int value) {
+	if (EXPR_TYPE(lvalue) == ARRAY) {
+		Array* array = get_array(compiler->tree, lvalue);
+		int idx = compile_index(compiler, line, array);
+		emit(compiler, line, OP_SET_ELEM, array->slot, idx, value);
+	} else {
+		// Checking a mixed name after the move is fine, as a failed check is fatal
+		Var* var = get_var(compiler->tree, lvalue);
+		if (value != var->slot) {
+			emit(compiler, line, OP_MOVE, var->slot, value, 0);
+		}
+
+		if (is_mixed_slot(compiler, var->slot)) {
+			emit(compiler, line, OP_CHECK_VAR, var->slot, 0, 0);
+		}
+	}
+}
+
+static bool can_fail(Compiler* compiler, Expr expr) {
+	switch (EXPR_TYPE(expr)) {
+		case LITERAL: return false;
+		case VAR: return is_mixed_slot(compiler, get_var(compiler->tree, expr)->slot);
+		case ARRAY: {
+			Array* array = get_array(compiler->tree, expr);
+			return !array->in_bounds || can_fail(compiler, array->index);
+		}
+
+		case BINARY: {
+			Binary* binary = get_binary(compiler->tree, expr);
+			return binary->type == SLASH || binary->type == MODULO ||
+			       can_fail(compiler, binary->left) || can_fail(compiler, binary->right);
+		}
+
+		default:
+			fprintf(stderr, "Invalid expression type (this shouldn't be printed)\n");
+			exit(EXIT_FAILURE);
+	}
+}
+
+static bool is_mixed_slot(Compiler* compiler, int slot) {
+	return is_mixed_symbol(vector_get(compiler->symbols, slot));
+}
+
+static int constant_register(Compiler* compiler, int value) {
+	int* idx = map_get(compiler->consts, &value);
+	if (idx != NULL) {
+		return -(*idx + 1);
+	}
+
+	Program* program = compiler->program;
+	if (program->n_consts == compiler->consts_cap) {
+		compiler->consts_cap *= 2;
+		program->consts = realloc(program->consts, compiler->consts_cap * sizeof(int));
+		assert(program->consts != NULL);
+	}
+
+	program->consts[program->n_consts] = value;
+	map_put(compiler->consts, create_int(value), create_int(program->n_consts));
+
+	return -(++program->n_consts);
+}
+
+// The idioms are copied, so that the program doesn't depend on the statements
+static int add_idiom(Compiler* compiler, Idiom* idiom) {
+	Program* program = compiler->program;
+	if (program->n_idioms == compiler->idioms_cap) {
+		compiler->idioms_cap *= 2;
+		program->idioms = realloc(program->idioms, compiler->idioms_cap * sizeof(Idiom));
+		assert(program->idioms != NULL);
+	}
+
+	program->idioms[program->n_idioms] = *idiom;
+	return program->n_idioms++;
+}
+
+static int add_parallel_loop(Compiler* compiler, ParallelLoop* loop, Block stmts) {
+	Program* program = compiler->program;
+	if (program->n_parallel == compiler->parallel_cap) {
+		compiler->parallel_cap *= 2;
+		program->parallel = realloc(program->parallel,
+			compiler->parallel_cap * sizeof(ParallelCode));
+		compiler->bodies = realloc(compiler->bodies, compiler->parallel_cap * sizeof(Block));
+		assert(program->parallel != NULL && compiler->bodies != NULL);
+	}
+
+	// The body is compiled once the whole program is
+	program->parallel[program->n_parallel] = (ParallelCode) { .loop = loop, .body = NULL, .end = 0 };
+	compiler->bodies[program->n_parallel] = stmts;
+	return program->n_parallel++;
+}
+
+static int new_temp(Compiler* compiler) {
+	int temp = compiler->program->n_slots + compiler->n_temps++;
+
+	if (compiler->n_temps > compiler->program->n_temps) {
+		compiler->program->n_temps = compiler->n_temps;
+	}
+
+	return temp;
+}
+
+static int emit(Compiler* compiler, int line, OpCode op, int a, int b, int c) {
+	Program* program = compiler->program;
+
+	if (program->n_code == compiler->code_cap) {
+		compiler->code_cap *= 2;
+		program->code = realloc(program->code, compiler->code_cap * sizeof(Instr));
+		program->lines = realloc(program->lines, compiler->code_cap * sizeof(int));
+		assert(program->code != NULL && program->lines != NULL);
+	}
+
+	program->code[program->n_code] = (Instr) { .op = op, .a = a, .b = b, .c = c };
+	program->lines[program->n_code] = line;
+
+	return program->n_code++;
+}
+
+// Emits a jump with an unknown target and links it to the pending jump list
+static int chain_jump(Compiler* compiler, int line, OpCode op, int list, int b, int c) {
+	return emit(compiler, line, op, list, b, c);
+}
+
+static void patch_jumps(Compiler* compiler, int list, int target) {
+	while (list != NO_JUMP) {
+		Instr* jump = &compiler->program->code[list];
+		list = jump->a;
+		jump->a = target;
+	}
+}
+
+// Returns the compare-and-jump for a comparison operator (or OP_HALT if there isn't one)
+static OpCode jump_op(TokenType type, bool jump_if) {
+	switch (type) {
+		case EQUAL_EQUAL: return jump_if ? OP_JUMP_EQ : OP_JUMP_NE;
+		case BANG_EQUAL: return jump_if ? OP_JUMP_NE : OP_JUMP_EQ;
+		case LESS: return jump_if ? OP_JUMP_LT : OP_JUMP_GE;
+		case LESS_EQUAL: return jump_if ? OP_JUMP_LE : OP_JUMP_GT;
+		case GREATER: return jump_if ? OP_JUMP_GT : OP_JUMP_LE;
+		case GREATER_EQUAL: return jump_if ? OP_JUMP_GE : OP_JUMP_LT;
+		default: return OP_HALT;
+	}
+}
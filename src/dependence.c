@@ -0,0 +1,571 @@
+#include <stdio.h>
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+
+#include "vector.h"
+
+#include "stmt.h"
+#include "expr.h"
+#include "token.h"
+#include "tree.h"
+#include "resolver.h"
+#include "dependence.h"
+
+#define NO_SLOT (-1)
+#define STAMP_NAME_LEN 32
+
+// What the body of the loop that's being analyzed does with every name
+#define USE_READ 1    // A variable is read outside of a reduction
+#define USE_WRITTEN 2 // A variable is assigned or an array element is written
+#define USE_REDUCED 4 // A variable is updated by s = s + e or s = s - e
+#define USE_FAR 8     // An array is accessed at an index other than the counter
+
+typedef struct dependence Dependence;
+
+// Helper functions used by the dependence analysis (no reason to expose them)
+static void parallelize_stmts(Dependence* dependence, Block stmts);
+static ParallelLoop* analyze_loop(Dependence* dependence, WhileStmt* stmt);
+static bool is_independent(Dependence* dependence, Block stmts, int n_slots, ParallelLoop* loop);
+static bool match_cond(Dependence* dependence, Expr cond, ParallelLoop* loop);
+static bool is_advance(Dependence* dependence, Stmt* stmt, int counter);
+static bool scan_stmts(Dependence* dependence, Block stmts, int depth);
+static bool scan_stmt(Dependence* dependence, Stmt* stmt, int depth);
+static bool scan_expr(Dependence* dependence, Expr expr);
+static bool scan_array(Dependence* dependence, Array* array, int use);
+static bool is_reduction(Dependence* dependence, AssignmentStmt* stmt, Expr* operand);
+static bool assigned_first(Dependence* dependence, Block stmts, int slot);
+static bool assigned_in_loop(Dependence* dependence, Block stmts, int slot);
+static void add_stamp(Dependence* dependence, Block* stmts, int slot, int stamp, int counter);
+static bool stmt_mentions(Dependence* dependence, Stmt* stmt, int slot);
+static bool expr_mentions(Dependence* dependence, Expr expr, int slot);
+static int plain_var(Dependence* dependence, Expr expr);
+static bool is_mixed_slot(Dependence* dependence, int slot);
+
+// This is used as a wrapper for the analysis' state
+struct dependence {
+	Tree* tree;
+	Vector symbols;
+	int n_slots; // The stamps' slots come after these, and no analyzed loop uses them
+	int counter; // The counter of the loop that's being analyzed
+	int* uses; // Indexed by slot
+	int* reductions; // Scratch space for the loop that's being analyzed
+	int* written;
+	int* tracked;
+	int n_parallel;
+	int n_stamps;
+};
+
+int parallelize_loops(Tree* tree, Block stmts, Vector symbols) {
+	int n_slots = vector_size(symbols);
+	Dependence dependence = { .tree = tree, .symbols = symbols, .n_slots = n_slots };
+
+	// Every tracked variable adds its stamp to the written ones
+	dependence.uses = malloc((n_slots + 1) * sizeof(int));
+	dependence.reductions = malloc((n_slots + 1) * sizeof(int));
+	dependence.written = malloc((2 * n_slots + 1) * sizeof(int));
+	dependence.tracked = malloc((n_slots + 1) * sizeof(int));
+	assert(dependence.uses != NULL && dependence.reductions != NULL && dependence.written != NULL);
+	assert(dependence.tracked != NULL);
+	dependence.n_parallel = 0;
+	dependence.n_stamps = 0;
+
+	parallelize_stmts(&dependence, stmts);
+
+	free(dependence.uses);
+	free(dependence.reductions);
+	free(dependence.written);
+	free(dependence.tracked);
+	return dependence.n_parallel;
+}
+
+// A loop that runs in parallel takes its nested loops along
+static void parallelize_stmts(Dependence* dependence, Block stmts) {
+	for (int i = 0; i < stmts.n_stmts; i++) {
+		Stmt stmt = get_stmt(dependence->tree, stmts, i);
+
+		if (stmt.type == WHILE_STMT) {
+			WhileStmt* while_stmt = get_payload(dependence->tree, &stmt);
+
+			while_stmt->parallel = analyze_loop(dependence, while_stmt);
+			if (while_stmt->parallel != NULL) {
+				dependence->n_parallel++;
+			} else {
+				parallelize_stmts(dependence, while_stmt->stmts);
+			}
+		} else if (stmt.type == IF_ELSE_STMT) {
+			IfElseStmt* if_else_stmt = get_payload(dependence->tree, &stmt);
+
+			parallelize_stmts(dependence, if_else_stmt->then_stmts);
+			if (if_else_stmt->has_else) {
+				parallelize_stmts(dependence, if_else_stmt->else_stmts);
+			}
+		}
+	}
+}
+
+static ParallelLoop* analyze_loop(Dependence* dependence, WhileStmt* stmt) {
+	int n_statements = stmt->stmts.n_stmts;
+	int n_slots = dependence->n_slots;
+
+	// The loop is analyzed in scratch space, and only the ones that are kept are
+	// copied over to the tree's arena
+	ParallelLoop loop = {
+		.reductions = dependence->reductions, .n_reductions = 0,
+		.written = dependence->written, .n_written = 0,
+		.tracked = dependence->tracked, .n_tracked = 0
+	};
+
+	if (n_statements == 0 || !match_cond(dependence, stmt->cond, &loop)) {
+		return NULL;
+	}
+
+	Stmt advance = get_stmt(dependence->tree, stmt->stmts, n_statements - 1);
+	if (!is_advance(dependence, &advance, loop.counter) ||
+	    !is_independent(dependence, stmt->stmts, n_slots, &loop)) {
+		return NULL;
+	}
+
+	ParallelLoop* kept = alloc_node(dependence->tree, sizeof(ParallelLoop));
+	*kept = loop;
+
+	kept->reductions = alloc_node(dependence->tree, loop.n_reductions * sizeof(int));
+	kept->tracked = alloc_node(dependence->tree, loop.n_tracked * sizeof(int));
+	kept->stamps = alloc_node(dependence->tree, loop.n_tracked * sizeof(int));
+	memcpy(kept->reductions, loop.reductions, loop.n_reductions * sizeof(int));
+	memcpy(kept->tracked, loop.tracked, loop.n_tracked * sizeof(int));
+
+	for (int i = 0; i < loop.n_tracked; i++) {
+		char name[STAMP_NAME_LEN];
+		snprintf(name, STAMP_NAME_LEN, "_stamp%d", dependence->n_stamps++);
+
+		kept->stamps[i] = add_var_symbol(dependence->symbols, name);
+		add_stamp(dependence, &stmt->stmts, loop.tracked[i], kept->stamps[i], loop.counter);
+		loop.written[loop.n_written++] = kept->stamps[i];
+	}
+
+	kept->n_written = loop.n_written;
+	kept->written = alloc_node(dependence->tree, loop.n_written * sizeof(int));
+	memcpy(kept->written, loop.written, loop.n_written * sizeof(int));
+
+	return kept;
+}
+
+static bool is_independent(Dependence* dependence, Block stmts, int n_slots, ParallelLoop* loop) {
+	for (int slot = 0; slot < n_slots; slot++) {
+		dependence->uses[slot] = 0;
+	}
+
+	// The counter's update is the only statement that isn't scanned, so any other
+	// write to the counter shows up as a use
+	dependence->counter = loop->counter;
+	for (int i = 0; i < stmts.n_stmts - 1; i++) {
+		Stmt stmt = get_stmt(dependence->tree, stmts, i);
+		if (!scan_stmt(dependence, &stmt, 0)) {
+			return false;
+		}
+	}
+
+	int changes = USE_WRITTEN | USE_REDUCED;
+	if ((dependence->uses[loop->counter] & changes) != 0 ||
+	    (loop->limit.is_var && (dependence->uses[loop->limit.value] & changes) != 0)) {
+		return false;
+	}
+
+	loop->written[loop->n_written++] = loop->counter;
+
+	for (int slot = 0; slot < n_slots; slot++) {
+		Symbol* symbol = vector_get(dependence->symbols, slot);
+		int uses = dependence->uses[slot];
+
+		// Two iterations can only touch the same element of an array that's written
+		// if some access to it doesn't go through the counter
+		if (symbol->is_array) {
+			if ((uses & USE_WRITTEN) && (uses & USE_FAR)) {
+				return false;
+			}
+			continue;
+		}
+
+		if (slot == loop->counter || (uses & changes) == 0) {
+			continue;
+		}
+
+		if (uses == USE_REDUCED) {
+			loop->reductions[loop->n_reductions++] = slot;
+		} else if (!assigned_first(dependence, stmts, slot)) {
+			return false;
+		} else if (assigned_in_loop(dependence, stmts, slot)) {
+			loop->tracked[loop->n_tracked++] = slot;
+		}
+
+		loop->written[loop->n_written++] = slot;
+	}
+
+	return true;
+}
+
+// i < n, i <= n, n > i or n >= i
+static bool match_cond(Dependence* dependence, Expr cond, ParallelLoop* loop) {
+	if (EXPR_TYPE(cond) != BINARY) {
+		return false;
+	}
+
+	Binary* binary = get_binary(dependence->tree, cond);
+	Expr counter;
+	Expr limit;
+
+	if (binary->type == LESS || binary->type == LESS_EQUAL) {
+		counter = binary->left;
+		limit = binary->right;
+	} else if (binary->type == GREATER || binary->type == GREATER_EQUAL) {
+		counter = binary->right;
+		limit = binary->left;
+	} else {
+		return false;
+	}
+
+	loop->counter = plain_var(dependence, counter);
+	loop->inclusive = binary->type == LESS_EQUAL || binary->type == GREATER_EQUAL;
+
+	if (loop->counter == NO_SLOT) {
+		return false;
+	}
+
+	if (EXPR_TYPE(limit) == LITERAL) {
+		int value = get_literal(dependence->tree, limit)->value;
+		loop->limit = (Operand) { .is_var = false, .value = value };
+		return true;
+	}
+
+	int slot = plain_var(dependence, limit);
+	loop->limit = (Operand) { .is_var = true, .value = slot };
+	return slot != NO_SLOT && slot != loop->counter;
+}
+
+// i = i + 1 or i = 1 + i
+static bool is_advance(Dependence* dependence, Stmt* stmt, int counter) {
+	if (stmt->type != ASSIGNMENT_STMT) {
+		return false;
+	}
+
+	AssignmentStmt* assignment = get_payload(dependence->tree, stmt);
+	if (assignment->is_array || get_var(dependence->tree, assignment->lvalue)->slot != counter ||
+	    EXPR_TYPE(assignment->expr) != BINARY) {
+		return false;
+	}
+
+	Binary* binary = get_binary(dependence->tree, assignment->expr);
+	if (binary->type != PLUS) {
+		return false;
+	}
+
+	Expr step;
+	if (plain_var(dependence, binary->left) == counter) {
+		step = binary->right;
+	} else if (plain_var(dependence, binary->right) == counter) {
+		step = binary->left;
+	} else {
+		return false;
+	}
+
+	return EXPR_TYPE(step) == LITERAL && get_literal(dependence->tree, step)->value == 1;
+}
+
+// Records what the statements do in dependence.uses. Returns false if they do
+// anything that has to happen in order (depth is the number of loops inside the
+// analyzed one that enclose them, which a break or continue may leave)
+static bool scan_stmts(Dependence* dependence, Block stmts, int depth) {
+	for (int i = 0; i < stmts.n_stmts; i++) {
+		Stmt stmt = get_stmt(dependence->tree, stmts, i);
+		if (!scan_stmt(dependence, &stmt, depth)) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+static bool scan_stmt(Dependence* dependence, Stmt* stmt, int depth) {
+	switch (stmt->type) {
+		case ASSIGNMENT_STMT: {
+			AssignmentStmt* assignment = get_payload(dependence->tree, stmt);
+			if (assignment->is_array) {
+				return scan_array(dependence, get_array(dependence->tree, assignment->lvalue),
+					USE_WRITTEN) && scan_expr(dependence, assignment->expr);
+			}
+
+			int slot = get_var(dependence->tree, assignment->lvalue)->slot;
+			if (is_mixed_slot(dependence, slot)) {
+				return false;
+			}
+
+			Expr operand;
+			if (is_reduction(dependence, assignment, &operand)) {
+				dependence->uses[slot] |= USE_REDUCED;
+				return scan_expr(dependence, operand);
+			}
+
+			dependence->uses[slot] |= USE_WRITTEN;
+			return scan_expr(dependence, assignment->expr);
+		}
+
+		case IF_ELSE_STMT: {
+			IfElseStmt* if_else_stmt = get_payload(dependence->tree, stmt);
+			return scan_expr(dependence, if_else_stmt->cond) &&
+			       scan_stmts(dependence, if_else_stmt->then_stmts, depth) &&
+			       (!if_else_stmt->has_else ||
+			        scan_stmts(dependence, if_else_stmt->else_stmts, depth));
+		}
+
+		case WHILE_STMT: {
+			WhileStmt* while_stmt = get_payload(dependence->tree, stmt);
+			return scan_expr(dependence, while_stmt->cond) &&
+			       scan_stmts(dependence, while_stmt->stmts, depth + 1);
+		}
+
+		case BREAK_STMT:
+			return ((BreakStmt*) get_payload(dependence->tree, stmt))->n_loops <= depth;
+		case CONTINUE_STMT:
+			return ((ContinueStmt*) get_payload(dependence->tree, stmt))->n_loops <= depth;
+
+		// Everything else either has a side effect that's visible outside of the
+		// program or changes which arrays exist
+		default:
+			return false;
+	}
+}
+
+static bool scan_expr(Dependence* dependence, Expr expr) {
+	switch (EXPR_TYPE(expr)) {
+		case LITERAL:
+			return true;
+
+		case VAR: {
+			int slot = get_var(dependence->tree, expr)->slot;
+			dependence->uses[slot] |= USE_READ;
+			return !is_mixed_slot(dependence, slot);
+		}
+
+		case ARRAY:
+			return scan_array(dependence, get_array(dependence->tree, expr), USE_READ);
+
+		case BINARY: {
+			Binary* binary = get_binary(dependence->tree, expr);
+			return scan_expr(dependence, binary->left) && scan_expr(dependence, binary->right);
+		}
+
+		default:
+			return false;
+	}
+}
+
+static bool scan_array(Dependence* dependence, Array* array, int use) {
+	if (is_mixed_slot(dependence, array->slot)) {
+		return false;
+	}
+
+	if (plain_var(dependence, array->index) != dependence->counter) {
+		use |= USE_FAR;
+	}
+
+	dependence->uses[array->slot] |= use;
+	return scan_expr(dependence, array->index);
+}
+
+// s = s + e, s = e + s or s = s - e, where e doesn't mention s
+static bool is_reduction(Dependence* dependence, AssignmentStmt* stmt, Expr* operand) {
+	int slot = get_var(dependence->tree, stmt->lvalue)->slot;
+	if (EXPR_TYPE(stmt->expr) != BINARY) {
+		return false;
+	}
+
+	Binary* binary = get_binary(dependence->tree, stmt->expr);
+	if ((binary->type == PLUS || binary->type == MINUS) &&
+	    plain_var(dependence, binary->left) == slot) {
+		*operand = binary->right;
+	} else if (binary->type == PLUS && plain_var(dependence, binary->right) == slot) {
+		*operand = binary->left;
+	} else {
+		return false;
+	}
+
+	return !expr_mentions(dependence, *operand, slot);
+}
+
+// A variable that every iteration assigns before doing anything else with it
+// doesn't carry a value from one iteration to the next. Neither does one that's
+// only used inside a nested loop that does the same in each of its iterations
+static bool assigned_first(Dependence* dependence, Block stmts, int slot) {
+	for (int i = 0; i < stmts.n_stmts; i++) {
+		Stmt stmt = get_stmt(dependence->tree, stmts, i);
+		if (!stmt_mentions(dependence, &stmt, slot)) {
+			continue;
+		}
+
+		if (stmt.type == WHILE_STMT) {
+			WhileStmt* while_stmt = get_payload(dependence->tree, &stmt);
+			if (expr_mentions(dependence, while_stmt->cond, slot) ||
+			    !assigned_first(dependence, while_stmt->stmts, slot)) {
+				return false;
+			}
+
+			for (int j = i + 1; j < stmts.n_stmts; j++) {
+				Stmt other = get_stmt(dependence->tree, stmts, j);
+				if (stmt_mentions(dependence, &other, slot)) {
+					return false;
+				}
+			}
+			return true;
+		}
+
+		if (stmt.type != ASSIGNMENT_STMT) {
+			return false;
+		}
+
+		AssignmentStmt* assignment = get_payload(dependence->tree, &stmt);
+		return !assignment->is_array &&
+		       get_var(dependence->tree, assignment->lvalue)->slot == slot &&
+		       !expr_mentions(dependence, assignment->expr, slot);
+	}
+
+	return false;
+}
+
+// Whether the first statement that mentions the variable is a loop, which is how
+// assigned_first accepts the variables that only nested loops assign
+static bool assigned_in_loop(Dependence* dependence, Block stmts, int slot) {
+	for (int i = 0; i < stmts.n_stmts; i++) {
+		Stmt stmt = get_stmt(dependence->tree, stmts, i);
+		if (stmt_mentions(dependence, &stmt, slot)) {
+			return stmt.type == WHILE_STMT;
+		}
+	}
+
+	return false;
+}
+
+// Puts stamp = counter right after the assignment that assigned_first found for the
+// variable. An iteration can't get to any other statement that mentions it without
+// running that one first
+static void add_stamp(Dependence* dependence, Block* stmts, int slot, int stamp, int counter) {
+	for (int i = 0; i < stmts->n_stmts; i++) {
+		Stmt stmt = get_stmt(dependence->tree, *stmts, i);
+		if (!stmt_mentions(dependence, &stmt, slot)) {
+			continue;
+		}
+
+		if (stmt.type == WHILE_STMT) {
+			WhileStmt* while_stmt = get_payload(dependence->tree, &stmt);
+			add_stamp(dependence, &while_stmt->stmts, slot, stamp, counter);
+			return;
+		}
+
+		StmtList out;
+		init_stmt_list(&out);
+
+		for (int j = 0; j < stmts->n_stmts; j++) {
+			add_stmt(&out, get_stmt(dependence->tree, *stmts, j));
+			if (j == i) {
+				int assignment = create_assignment_stmt(dependence->tree, false,
+					create_var(dependence->tree, stamp), create_var(dependence->tree, counter));
+				add_stmt(&out, create_stmt(stmt.line, ASSIGNMENT_STMT, assignment));
+			}
+		}
+
+		replace_block(dependence->tree, stmts, out.stmts, out.n_stmts);
+		free_stmt_list(&out);
+		return;
+	}
+}
+
+static bool stmt_mentions(Dependence* dependence, Stmt* stmt, int slot) {
+	switch (stmt->type) {
+		case ASSIGNMENT_STMT: {
+			AssignmentStmt* assignment = get_payload(dependence->tree, stmt);
+			if (expr_mentions(dependence, assignment->expr, slot)) {
+				return true;
+			}
+
+			if (!assignment->is_array) {
+				return get_var(dependence->tree, assignment->lvalue)->slot == slot;
+			}
+
+			Array* array = get_array(dependence->tree, assignment->lvalue);
+			return array->slot == slot || expr_mentions(dependence, array->index, slot);
+		}
+
+		case IF_ELSE_STMT: {
+			IfElseStmt* if_else_stmt = get_payload(dependence->tree, stmt);
+			if (expr_mentions(dependence, if_else_stmt->cond, slot)) {
+				return true;
+			}
+
+			// An if without an else has an empty else block
+			Block arms[] = { if_else_stmt->then_stmts, if_else_stmt->else_stmts };
+			for (int arm = 0; arm < 2; arm++) {
+				for (int i = 0; i < arms[arm].n_stmts; i++) {
+					Stmt arm_stmt = get_stmt(dependence->tree, arms[arm], i);
+					if (stmt_mentions(dependence, &arm_stmt, slot)) {
+						return true;
+					}
+				}
+			}
+			return false;
+		}
+
+		case WHILE_STMT: {
+			WhileStmt* while_stmt = get_payload(dependence->tree, stmt);
+			if (expr_mentions(dependence, while_stmt->cond, slot)) {
+				return true;
+			}
+
+			for (int i = 0; i < while_stmt->stmts.n_stmts; i++) {
+				Stmt body_stmt = get_stmt(dependence->tree, while_stmt->stmts, i);
+				if (stmt_mentions(dependence, &body_stmt, slot)) {
+					return true;
+				}
+			}
+			return false;
+		}
+
+		default:
+			return false;
+	}
+}
+
+static bool expr_mentions(Dependence* dependence, Expr expr, int slot) {
+	switch (EXPR_TYPE(expr)) {
+		case VAR:
+			return get_var(dependence->tree, expr)->slot == slot;
+
+		case ARRAY: {
+			Array* array = get_array(dependence->tree, expr);
+			return array->slot == slot || expr_mentions(dependence, array->index, slot);
+		}
+
+		case BINARY: {
+			Binary* binary = get_binary(dependence->tree, expr);
+			return expr_mentions(dependence, binary->left, slot) ||
+			       expr_mentions(dependence, binary->right, slot);
+		}
+
+		default:
+			return false;
+	}
+}
+
+// Returns the variable's slot if expr is a variable that's never used as an array
+static int plain_var(Dependence* dependence, Expr expr) {
+	if (EXPR_TYPE(expr) != VAR) {
+		return NO_SLOT;
+	}
+
+	int slot = get_var(dependence->tree, expr)->slot;
+	return is_mixed_slot(dependence, slot) ? NO_SLOT : slot;
+}
+
+static bool is_mixed_slot(Dependence* dependence, int slot) {
+	return is_mixed_symbol(vector_get(dependence->symbols, slot));
+}
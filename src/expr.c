@@ -1,106 +1,45 @@
-#include <stdio.h>
 #include <assert.h>
-#include <stdlib.h>
-#include <string.h>
 
 #include "expr.h"
+#include "tree.h"
 #include "token.h"
 
-Expr* create_expr(ExprType type, void* expr) {
-	Expr* new_expr = malloc(sizeof(Expr));
-	assert(new_expr != NULL);
-
-	new_expr->type = type;
-	new_expr->expr = expr;
-
-	return new_expr;
-}
-
-Literal* create_literal(int value) {
-	Literal* new_literal = malloc(sizeof(Literal));
-	assert(new_literal != NULL);
-
-	new_literal->value = value;
-
-	return new_literal;
-}
-
-Var* create_var(char* id) {
-	Var* new_var = malloc(sizeof(Var));
-	assert(new_var != NULL);
-
-	new_var->id = strdup(id);
-
-	return new_var;
+Expr create_literal(Tree* tree, int value) {
+	Literal literal = { .value = value };
+	return MAKE_EXPR(LITERAL, add_nodes(&tree->exprs[LITERAL], &literal, 1));
 }
 
-Array* create_array(char* id, Expr* index) {
-	Array* new_array = malloc(sizeof(Array));
-	assert(new_array != NULL);
-
-	new_array->id = strdup(id);
-	new_array->index = index;
-
-	return new_array;
+Expr create_var(Tree* tree, int slot) {
+	Var var = { .slot = slot };
+	return MAKE_EXPR(VAR, add_nodes(&tree->exprs[VAR], &var, 1));
 }
 
-Binary* create_binary(TokenType type, Expr* left, Expr* right) {
-	Binary* new_binary = malloc(sizeof(Binary));
-	assert(new_binary != NULL);
-
-	new_binary->type = type;
-	new_binary->left = left;
-	new_binary->right = right;
-
-	return new_binary;
+Expr create_array(Tree* tree, int slot, Expr index) {
+	Array array = { .slot = slot, .index = index, .in_bounds = false };
+	return MAKE_EXPR(ARRAY, add_nodes(&tree->exprs[ARRAY], &array, 1));
 }
 
-void destroy_expr(void* expr) {
-	assert(expr != NULL);
-
-	Expr* exprr = (Expr*) expr;
-	switch (exprr->type) {
-		case LITERAL: destroy_literal(exprr->expr); break;
-		case VAR: destroy_var(exprr->expr); break;
-		case ARRAY: destroy_array(exprr->expr); break;
-		case BINARY: destroy_binary(exprr->expr); break;
-		default:
-			fprintf(stderr, "Invalid expression type (shouldn't be printed)\n");
-			exit(EXIT_FAILURE);
-	}
-
-	free(exprr);
+Expr create_binary(Tree* tree, TokenType type, Expr left, Expr right) {
+	Binary binary = { .type = type, .left = left, .right = right };
+	return MAKE_EXPR(BINARY, add_nodes(&tree->exprs[BINARY], &binary, 1));
 }
 
-void destroy_literal(void* expr) {
-	assert(expr != NULL);
-
-	Literal* exprr = (Literal*) expr;
-	free(exprr);
+Literal* get_literal(Tree* tree, Expr expr) {
+	assert(EXPR_TYPE(expr) == LITERAL);
+	return tree_literal(tree, expr);
 }
 
-void destroy_var(void* expr) {
-	assert(expr != NULL);
-
-	Var* exprr = (Var*) expr;
-	free(exprr->id);
-	free(exprr);
+Var* get_var(Tree* tree, Expr expr) {
+	assert(EXPR_TYPE(expr) == VAR);
+	return tree_var(tree, expr);
 }
 
-void destroy_array(void* expr) {
-	assert(expr != NULL);
-
-	Array* exprr = (Array*) expr;
-	free(exprr->id);
-	destroy_expr(exprr->index);
-	free(exprr);
+Array* get_array(Tree* tree, Expr expr) {
+	assert(EXPR_TYPE(expr) == ARRAY);
+	return tree_array(tree, expr);
 }
 
-void destroy_binary(void* expr) {
-	assert(expr != NULL);
-
-	Binary* exprr = (Binary*) expr;
-	destroy_expr(exprr->left);
-	destroy_expr(exprr->right);
-	free(exprr);
+Binary* get_binary(Tree* tree, Expr expr) {
+	assert(EXPR_TYPE(expr) == BINARY);
+	return tree_binary(tree, expr);
 }
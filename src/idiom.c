@@ -0,0 +1,324 @@
+#include <assert.h>
+#include <stdlib.h>
+#include <stdbool.h>
+
+#include "vector.h"
+
+#include "stmt.h"
+#include "expr.h"
+#include "token.h"
+#include "tree.h"
+#include "resolver.h"
+#include "idiom.h"
+
+#define NO_SLOT (-1)
+
+typedef struct recognizer Recognizer;
+
+// Helper functions used by the idiom recognizer (no reason to expose them)
+static void recognize_stmts(Recognizer* recognizer, Block stmts);
+static Idiom* recognize_loop(Recognizer* recognizer, WhileStmt* stmt);
+static bool match_cond(Recognizer* recognizer, Expr cond, Idiom* idiom);
+static bool match_advance(Recognizer* recognizer, Stmt* stmt, int counter);
+static bool match_elem_assignment(Recognizer* recognizer, AssignmentStmt* stmt, Idiom* idiom);
+static bool match_sum(Recognizer* recognizer, AssignmentStmt* stmt, Idiom* idiom);
+static bool match_max(Recognizer* recognizer, IfElseStmt* stmt, Idiom* idiom);
+static bool match_operand(Recognizer* recognizer, Expr expr, int counter, Operand* operand);
+static int counter_elem(Recognizer* recognizer, Expr expr, int counter);
+static int plain_var(Recognizer* recognizer, Expr expr);
+static bool is_mixed_slot(Recognizer* recognizer, int slot);
+
+// This is used as a wrapper for the recognizer's state
+struct recognizer {
+	Tree* tree;
+	Vector symbols;
+	int n_recognized;
+};
+
+int recognize_idioms(Tree* tree, Block stmts, Vector symbols) {
+	Recognizer recognizer = { .tree = tree, .symbols = symbols, .n_recognized = 0 };
+
+	recognize_stmts(&recognizer, stmts);
+	return recognizer.n_recognized;
+}
+
+static void recognize_stmts(Recognizer* recognizer, Block stmts) {
+	for (int i = 0; i < stmts.n_stmts; i++) {
+		Stmt stmt = get_stmt(recognizer->tree, stmts, i);
+
+		if (stmt.type == WHILE_STMT) {
+			WhileStmt* while_stmt = get_payload(recognizer->tree, &stmt);
+
+			while_stmt->idiom = recognize_loop(recognizer, while_stmt);
+			if (while_stmt->idiom != NULL) {
+				recognizer->n_recognized++;
+			} else {
+				recognize_stmts(recognizer, while_stmt->stmts);
+			}
+		} else if (stmt.type == IF_ELSE_STMT) {
+			IfElseStmt* if_else_stmt = get_payload(recognizer->tree, &stmt);
+
+			recognize_stmts(recognizer, if_else_stmt->then_stmts);
+			if (if_else_stmt->has_else) {
+				recognize_stmts(recognizer, if_else_stmt->else_stmts);
+			}
+		}
+	}
+}
+
+static Idiom* recognize_loop(Recognizer* recognizer, WhileStmt* stmt) {
+	Idiom idiom = { .src1 = NO_SLOT, .src2 = NO_SLOT };
+
+	if (stmt->stmts.n_stmts != 2 || !match_cond(recognizer, stmt->cond, &idiom)) {
+		return NULL;
+	}
+
+	Stmt advance = get_stmt(recognizer->tree, stmt->stmts, 1);
+	if (!match_advance(recognizer, &advance, idiom.counter)) {
+		return NULL;
+	}
+
+	Stmt body = get_stmt(recognizer->tree, stmt->stmts, 0);
+	bool matched = false;
+
+	if (body.type == ASSIGNMENT_STMT) {
+		AssignmentStmt* assignment = get_payload(recognizer->tree, &body);
+		matched = assignment->is_array ? match_elem_assignment(recognizer, assignment, &idiom)
+		                               : match_sum(recognizer, assignment, &idiom);
+	} else if (body.type == IF_ELSE_STMT) {
+		matched = match_max(recognizer, get_payload(recognizer->tree, &body), &idiom);
+	}
+
+	// The accumulator is the only variable that the body writes besides the counter
+	bool accumulates = idiom.type == IDIOM_SUM || idiom.type == IDIOM_MAX;
+	if (!matched || (accumulates && idiom.limit.is_var && idiom.limit.value == idiom.target)) {
+		return NULL;
+	}
+
+	Idiom* new_idiom = alloc_node(recognizer->tree, sizeof(Idiom));
+
+	*new_idiom = idiom;
+	return new_idiom;
+}
+
+// i < n or n > i
+static bool match_cond(Recognizer* recognizer, Expr cond, Idiom* idiom) {
+	if (EXPR_TYPE(cond) != BINARY) {
+		return false;
+	}
+
+	Binary* binary = get_binary(recognizer->tree, cond);
+	Expr counter;
+	Expr limit;
+
+	if (binary->type == LESS) {
+		counter = binary->left;
+		limit = binary->right;
+	} else if (binary->type == GREATER) {
+		counter = binary->right;
+		limit = binary->left;
+	} else {
+		return false;
+	}
+
+	idiom->counter = plain_var(recognizer, counter);
+	return idiom->counter != NO_SLOT &&
+	       match_operand(recognizer, limit, idiom->counter, &idiom->limit);
+}
+
+// i = i + 1 or i = 1 + i
+static bool match_advance(Recognizer* recognizer, Stmt* stmt, int counter) {
+	if (stmt->type != ASSIGNMENT_STMT) {
+		return false;
+	}
+
+	AssignmentStmt* assignment = get_payload(recognizer->tree, stmt);
+	if (assignment->is_array || get_var(recognizer->tree, assignment->lvalue)->slot != counter ||
+	    EXPR_TYPE(assignment->expr) != BINARY) {
+		return false;
+	}
+
+	Binary* binary = get_binary(recognizer->tree, assignment->expr);
+	if (binary->type != PLUS) {
+		return false;
+	}
+
+	Expr step;
+	if (plain_var(recognizer, binary->left) == counter) {
+		step = binary->right;
+	} else if (plain_var(recognizer, binary->right) == counter) {
+		step = binary->left;
+	} else {
+		return false;
+	}
+
+	return EXPR_TYPE(step) == LITERAL && get_literal(recognizer->tree, step)->value == 1;
+}
+
+// a[i] = v, a[i] = b[i], a[i] = b[i] * v (or v * b[i]) and a[i] = b[i] + c[i]
+static bool match_elem_assignment(Recognizer* recognizer, AssignmentStmt* stmt, Idiom* idiom) {
+	Array* lvalue = get_array(recognizer->tree, stmt->lvalue);
+	if (is_mixed_slot(recognizer, lvalue->slot) ||
+	    plain_var(recognizer, lvalue->index) != idiom->counter) {
+		return false;
+	}
+
+	idiom->target = lvalue->slot;
+	Expr expr = stmt->expr;
+
+	if (match_operand(recognizer, expr, idiom->counter, &idiom->value)) {
+		idiom->type = IDIOM_FILL;
+		return true;
+	}
+
+	idiom->src1 = counter_elem(recognizer, expr, idiom->counter);
+	if (idiom->src1 != NO_SLOT) {
+		idiom->type = IDIOM_COPY;
+		return true;
+	}
+
+	if (EXPR_TYPE(expr) != BINARY) {
+		return false;
+	}
+
+	Binary* binary = get_binary(recognizer->tree, expr);
+	int left = counter_elem(recognizer, binary->left, idiom->counter);
+	int right = counter_elem(recognizer, binary->right, idiom->counter);
+
+	if (binary->type == PLUS && left != NO_SLOT && right != NO_SLOT) {
+		idiom->type = IDIOM_ADD;
+		idiom->src1 = left;
+		idiom->src2 = right;
+		return true;
+	}
+
+	if (binary->type == STAR && left != NO_SLOT &&
+	    match_operand(recognizer, binary->right, idiom->counter, &idiom->value)) {
+		idiom->src1 = left;
+	} else if (binary->type == STAR && right != NO_SLOT &&
+	           match_operand(recognizer, binary->left, idiom->counter, &idiom->value)) {
+		idiom->src1 = right;
+	} else {
+		return false;
+	}
+
+	idiom->type = IDIOM_SCALE;
+	return true;
+}
+
+// s = s + b[i] or s = b[i] + s
+static bool match_sum(Recognizer* recognizer, AssignmentStmt* stmt, Idiom* idiom) {
+	int target = get_var(recognizer->tree, stmt->lvalue)->slot;
+	if (is_mixed_slot(recognizer, target) || target == idiom->counter ||
+	    EXPR_TYPE(stmt->expr) != BINARY) {
+		return false;
+	}
+
+	Binary* binary = get_binary(recognizer->tree, stmt->expr);
+	if (binary->type != PLUS) {
+		return false;
+	}
+
+	if (plain_var(recognizer, binary->left) == target) {
+		idiom->src1 = counter_elem(recognizer, binary->right, idiom->counter);
+	} else if (plain_var(recognizer, binary->right) == target) {
+		idiom->src1 = counter_elem(recognizer, binary->left, idiom->counter);
+	}
+
+	idiom->type = IDIOM_SUM;
+	idiom->target = target;
+	return idiom->src1 != NO_SLOT;
+}
+
+// if b[i] > m then m = b[i], with either comparison that keeps the larger value
+static bool match_max(Recognizer* recognizer, IfElseStmt* stmt, Idiom* idiom) {
+	if (stmt->has_else || stmt->then_stmts.n_stmts != 1 || EXPR_TYPE(stmt->cond) != BINARY) {
+		return false;
+	}
+
+	Stmt then_stmt = get_stmt(recognizer->tree, stmt->then_stmts, 0);
+	if (then_stmt.type != ASSIGNMENT_STMT) {
+		return false;
+	}
+
+	AssignmentStmt* assignment = get_payload(recognizer->tree, &then_stmt);
+	if (assignment->is_array) {
+		return false;
+	}
+
+	int target = get_var(recognizer->tree, assignment->lvalue)->slot;
+	int src = counter_elem(recognizer, assignment->expr, idiom->counter);
+	if (src == NO_SLOT || is_mixed_slot(recognizer, target) || target == idiom->counter) {
+		return false;
+	}
+
+	Binary* cond = get_binary(recognizer->tree, stmt->cond);
+	Expr larger;
+	Expr smaller;
+
+	if (cond->type == GREATER || cond->type == GREATER_EQUAL) {
+		larger = cond->left;
+		smaller = cond->right;
+	} else if (cond->type == LESS || cond->type == LESS_EQUAL) {
+		larger = cond->right;
+		smaller = cond->left;
+	} else {
+		return false;
+	}
+
+	if (counter_elem(recognizer, larger, idiom->counter) != src ||
+	    plain_var(recognizer, smaller) != target) {
+		return false;
+	}
+
+	idiom->type = IDIOM_MAX;
+	idiom->target = target;
+	idiom->src1 = src;
+	return true;
+}
+
+// A literal, or a variable other than the counter (which is all the loop writes)
+static bool match_operand(Recognizer* recognizer, Expr expr, int counter, Operand* operand) {
+	if (EXPR_TYPE(expr) == LITERAL) {
+		operand->is_var = false;
+		operand->value = get_literal(recognizer->tree, expr)->value;
+		return true;
+	}
+
+	int slot = plain_var(recognizer, expr);
+	if (slot == NO_SLOT || slot == counter) {
+		return false;
+	}
+
+	operand->is_var = true;
+	operand->value = slot;
+	return true;
+}
+
+// Returns the array's slot if expr is an element of it at the counter's index
+static int counter_elem(Recognizer* recognizer, Expr expr, int counter) {
+	if (EXPR_TYPE(expr) != ARRAY) {
+		return NO_SLOT;
+	}
+
+	Array* array = get_array(recognizer->tree, expr);
+	if (is_mixed_slot(recognizer, array->slot) || plain_var(recognizer, array->index) != counter) {
+		return NO_SLOT;
+	}
+
+	return array->slot;
+}
+
+// Returns the variable's slot if expr is a variable that's never used as an array
+static int plain_var(Recognizer* recognizer, Expr expr) {
+	if (EXPR_TYPE(expr) != VAR) {
+		return NO_SLOT;
+	}
+
+	int slot = get_var(recognizer->tree, expr)->slot;
+	return is_mixed_slot(recognizer, slot) ? NO_SLOT : slot;
+}
+
+static bool is_mixed_slot(Recognizer* recognizer, int slot) {
+	return is_mixed_symbol(vector_get(recognizer->symbols, slot));
+}
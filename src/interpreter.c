@@ -1,313 +1,603 @@
 #include <stdio.h>
 #include <assert.h>
+#include <setjmp.h>
 #include <stdlib.h>
+#include <string.h>
 #include <stdbool.h>
 
-#include "map.h"
-#include "vector.h"
-
 #include "stmt.h"
 #include "expr.h"
+#include "tree.h"
 #include "error.h"
+#include "runtime.h"
+#include "kernels.h"
+#include "parallel.h"
 #include "interpreter.h"
 
-typedef struct table_entry {
-	ExprType type;
-	void* value;
-} TableEntry;
+#define MIN_CAP 64
+#define NO_JUMP (-1)
+
+// The statements are flattened into a sequence of steps before execution, so that
+// loops, if-else statements, break and continue are all just jumps to precomputed
+// targets and nested blocks don't need any recursion
+typedef enum step_type {
+	STEP_STMT, STEP_JUMP, STEP_JUMP_IF_FALSE, STEP_BAD_BREAK, STEP_BAD_CONTINUE,
+	STEP_KERNEL, // Runs a recognized loop (the step's stmt) and jumps past it
+	STEP_PARALLEL // Runs a parallel loop (the step's stmt is its ParallelStep) and jumps past it
+} StepType;
+
+typedef struct step {
+	StepType type;
+	int line;
+	void* stmt; // The statement to execute (the tree doesn't change while it runs)
+	Expr cond; // The condition of a conditional jump
+	int target;
+} Step;
+
+// Jumps to a step that isn't known yet are chained through their target, so every
+// pending label is just the index of its latest jump
+typedef struct loop {
+	int start; // The step that evaluates the loop's condition
+	int break_jumps;
+} Loop;
+
+typedef struct interpreter Interpreter;
+
+// The workers of a parallel loop run its body on interpreters of their own, which
+// share the arrays of the interpreter that runs the program
+typedef struct parallel_step {
+	ParallelLoop* loop;
+	Block stmts; // The loop's body
+	Interpreter** workers; // One per thread, created when the loop first runs in parallel
+} ParallelStep;
 
 // Helper functions used by the interpreter (no reason to expose them)
-static void init_interpreter(int argc, char** argv);
-static TableEntry* create_table_entry(ExprType type, void* value);
-static void execute_read_stmt(int line, ReadStmt* stmt);
-static void execute_assignment_stmt(int line, AssignmentStmt* stmt);
-static void execute_write_stmt(int line, WriteStmt* stmt);
-static void execute_writeln_stmt(int line, WritelnStmt* stmt);
-static void execute_while_stmt(int line, WhileStmt* stmt);
-static void execute_if_else_stmt(int line, IfElseStmt* stmt);
-static void execute_random_stmt(int line, RandomStmt* stmt);
-static void execute_arg_stmt(int line, ArgStmt* stmt);
-static void execute_arg_size_stmt(int line, ArgSizeStmt* stmt);
-static void execute_break_stmt(int line, BreakStmt* stmt);
-static void execute_continue_stmt(int line, ContinueStmt* stmt);
-static void execute_new_stmt(int line, NewStmt* stmt);
-static void execute_free_stmt(int line, FreeStmt* stmt);
-static void execute_size_stmt(int line, SizeStmt* stmt);
-static int evaluate_expr(int line, Expr* expr);
-static int evaluate_literal(int line, Literal* expr);
-static int evaluate_var(int line, Var* expr);
-static int evaluate_array(int line, Array* expr);
-static int evaluate_binary(int line, Binary* expr);
-static void assign_to_lvalue(int line, int value, bool is_array, void* lvalue);
-static void runtime_error(char* msg, int line, int status);
+static void init_interpreter(Interpreter* interpreter, Tree* tree, int n_slots, int argc,
+	char** argv, RunIO io, ArrayDesc* arrays);
+static void destroy_interpreter(Interpreter* interpreter);
+static void run(Interpreter* interpreter);
+static void flatten_stmts(Interpreter* interpreter, Block stmts);
+static void flatten_while_stmt(Interpreter* interpreter, int line, WhileStmt* stmt);
+static void flatten_if_else_stmt(Interpreter* interpreter, int line, IfElseStmt* stmt);
+static void flatten_break_stmt(Interpreter* interpreter, int line, BreakStmt* stmt);
+static void flatten_continue_stmt(Interpreter* interpreter, int line, ContinueStmt* stmt);
+static int add_step(Interpreter* interpreter, StepType type, int line, void* stmt, int target);
+static int add_jump_if_false(Interpreter* interpreter, int line, Expr cond);
+static void patch_jumps(Interpreter* interpreter, int list, int target);
+static bool execute_kernel(Interpreter* interpreter, Idiom* idiom);
+static bool execute_parallel(Interpreter* interpreter, ParallelStep* step);
+static int* worker_vars(void* state, int worker);
+static void run_worker(void* state, int worker, int start, int end);
+static void execute_stmt(Interpreter* interpreter, Stmt* stmt);
+static void execute_read_stmt(Interpreter* interpreter, int line, ReadStmt* stmt);
+static void execute_assignment_stmt(Interpreter* interpreter, int line, AssignmentStmt* stmt);
+static void execute_write_stmt(Interpreter* interpreter, int line, WriteStmt* stmt);
+static void execute_writeln_stmt(Interpreter* interpreter, int line, WritelnStmt* stmt);
+static void execute_random_stmt(Interpreter* interpreter, int line, RandomStmt* stmt);
+static void execute_arg_stmt(Interpreter* interpreter, int line, ArgStmt* stmt);
+static void execute_arg_size_stmt(Interpreter* interpreter, int line, ArgSizeStmt* stmt);
+static void execute_new_stmt(Interpreter* interpreter, int line, NewStmt* stmt);
+static void execute_free_stmt(Interpreter* interpreter, int line, FreeStmt* stmt);
+static void execute_size_stmt(Interpreter* interpreter, int line, SizeStmt* stmt);
+static int evaluate_expr(Interpreter* interpreter, int line, Expr expr);
+static int evaluate_literal(Interpreter* interpreter, int line, Literal* expr);
+static int evaluate_var(Interpreter* interpreter, int line, Var* expr);
+static int evaluate_array(Interpreter* interpreter, int line, Array* expr);
+static int* array_element(Interpreter* interpreter, int line, Array* array);
+static int evaluate_binary(Interpreter* interpreter, int line, Binary* expr);
+static void assign_to_lvalue(Interpreter* interpreter, int line, int value, Expr lvalue);
 
 // This is used as a wrapper for the interpreter's state
-static struct interpreter {
+struct interpreter {
+	Tree* tree;
 	int n_args;
 	char** args;
-	Map symbol_table;
-	int nesting;
+	RunIO io;
+	int n_slots;
+	SlotKind* kinds; // The following three arrays are indexed by slot
+	int* vars;
+	ArrayDesc* arrays;
+	Step* steps;
+	int n_steps;
+	int steps_cap;
+	Loop* loops; // The loops that enclose the statements being flattened
 	int loop_nesting;
-	int jump_n_loops; // Used for break <n> and continue <n>
-	enum { STOP, REPEAT, NORMAL } loop_state;
-} interpreter;
+	int loops_cap;
+	ParallelStep** parallel; // The parallel loops among the steps
+	int n_parallel;
+	int parallel_cap;
+	ParallelStep* running; // The parallel loop that the workers are running
+};
+
+// The arrays are allocated by the caller, as they may be shared
+static void init_interpreter(Interpreter* interpreter, Tree* tree, int n_slots, int argc,
+	char** argv, RunIO io, ArrayDesc* arrays) {
+	interpreter->tree = tree;
+	interpreter->n_args = argc;
+	interpreter->args = argv;
+	interpreter->io = io;
+
+	// Every name starts out unbound, so calloc gives us the right initial state
+	interpreter->n_slots = n_slots;
+	interpreter->kinds = calloc(n_slots+1, sizeof(SlotKind));
+	interpreter->vars = calloc(n_slots+1, sizeof(int));
+	assert(interpreter->kinds != NULL && interpreter->vars != NULL);
+	interpreter->arrays = arrays;
+
+	interpreter->steps = malloc(MIN_CAP * sizeof(Step));
+	interpreter->loops = malloc(MIN_CAP * sizeof(Loop));
+	assert(interpreter->steps != NULL && interpreter->loops != NULL);
+
+	interpreter->n_steps = 0;
+	interpreter->steps_cap = MIN_CAP;
+	interpreter->loop_nesting = 0;
+	interpreter->loops_cap = MIN_CAP;
+
+	interpreter->parallel = malloc(MIN_CAP * sizeof(ParallelStep*));
+	assert(interpreter->parallel != NULL);
+	interpreter->n_parallel = 0;
+	interpreter->parallel_cap = MIN_CAP;
+	interpreter->running = NULL;
+}
 
-static void init_interpreter(int argc, char** argv) {
-	interpreter.n_args = argc;
-	interpreter.args = argv;
+static void destroy_interpreter(Interpreter* interpreter) {
+	for (int i = 0; i < interpreter->n_parallel; i++) {
+		ParallelStep* step = interpreter->parallel[i];
+
+		for (int t = 0; t < get_threads(); t++) {
+			if (step->workers[t] != NULL) {
+				destroy_interpreter(step->workers[t]);
+				free(step->workers[t]);
+			}
+		}
+
+		free(step->workers);
+		free(step);
+	}
 
-	interpreter.symbol_table = map_create(NULL, NULL, free, NULL);
-	interpreter.nesting = 0;
-	interpreter.loop_nesting = 0;
-	interpreter.jump_n_loops = 1;
-	interpreter.loop_state = NORMAL;
+	free(interpreter->kinds);
+	free(interpreter->vars);
+	free(interpreter->steps);
+	free(interpreter->loops);
+	free(interpreter->parallel);
 }
 
-static TableEntry* create_table_entry(ExprType type, void* value) {
-	TableEntry* new_table_entry = malloc(sizeof(TableEntry));
-	assert(new_table_entry != NULL);
+void execute(Tree* tree, Block stmts, int n_slots, int argc, char **argv, RunIO io) {
+	ArrayDesc* arrays = calloc(n_slots+1, sizeof(ArrayDesc));
+	assert(arrays != NULL);
 
-	new_table_entry->type = type;
-	new_table_entry->value = value;
+	Interpreter interpreter;
+	init_interpreter(&interpreter, tree, n_slots, argc, argv, io, arrays);
+	flatten_stmts(&interpreter, stmts);
 
-	return new_table_entry;
-}
+	// The interpreter is torn down before a runtime error is reported any further
+	ErrorTrap trap = { .status = 0 };
+	ErrorTrap* previous = set_error_trap(&trap);
+
+	if (setjmp(trap.env) == 0) {
+		run(&interpreter);
+	}
 
-void execute(Vector stmts, int argc, char **argv) {
-	// This routine is used recursively and we only want init to be called once
-	static bool initialized = false;
+	set_error_trap(previous);
+	destroy_interpreter(&interpreter);
 
-	if (!initialized) {
-		init_interpreter(argc, argv);
-		initialized = true;
+	for (int i = 0; i < n_slots; i++) {
+		free(arrays[i].elems);
 	}
+	free(arrays);
 
-	int n_statements = vector_size(stmts);
-	for (int i = 0; i < n_statements; i++) {
-		Stmt* stmt = vector_get(stmts, i);
+	if (trap.status != 0) {
+		rethrow_error(&trap);
+	}
+}
+
+static void run(Interpreter* interpreter) {
+	int pc = 0;
+	while (pc < interpreter->n_steps) {
+		Step* step = &interpreter->steps[pc++];
+
+		switch (step->type) {
+			case STEP_STMT:
+				execute_stmt(interpreter, step->stmt);
+				break;
+
+			case STEP_JUMP:
+				pc = step->target;
+				break;
+
+			case STEP_JUMP_IF_FALSE:
+				if (evaluate_expr(interpreter, step->line, step->cond) == 0) {
+					pc = step->target;
+				}
+				break;
+
+			case STEP_KERNEL:
+				if (execute_kernel(interpreter, step->stmt)) {
+					pc = step->target;
+				}
+				break;
+
+			case STEP_PARALLEL:
+				if (execute_parallel(interpreter, step->stmt)) {
+					pc = step->target;
+				}
+				break;
+
+			case STEP_BAD_BREAK:
+				runtime_error("invalid break statement", step->line, EBAD_BREAK);
+				break;
+
+			case STEP_BAD_CONTINUE:
+				runtime_error("invalid continue statement", step->line, EBAD_CONT);
+				break;
 
-		switch (stmt->type) {
-			case READ_STMT: execute_read_stmt(stmt->line, stmt->stmt); break;
-			case ASSIGNMENT_STMT: execute_assignment_stmt(stmt->line, stmt->stmt); break;
-			case WRITE_STMT: execute_write_stmt(stmt->line, stmt->stmt); break;
-			case WRITELN_STMT: execute_writeln_stmt(stmt->line, stmt->stmt); break;
-			case WHILE_STMT: execute_while_stmt(stmt->line, stmt->stmt); break;
-			case IF_ELSE_STMT: execute_if_else_stmt(stmt->line, stmt->stmt); break;
-			case RANDOM_STMT: execute_random_stmt(stmt->line, stmt->stmt); break;
-			case ARG_STMT: execute_arg_stmt(stmt->line, stmt->stmt); break;
-			case ARG_SIZE_STMT: execute_arg_size_stmt(stmt->line, stmt->stmt); break;
-			case BREAK_STMT: execute_break_stmt(stmt->line, stmt->stmt); break;
-			case CONTINUE_STMT: execute_continue_stmt(stmt->line, stmt->stmt); break;
-			case NEW_STMT: execute_new_stmt(stmt->line, stmt->stmt); break;
-			case FREE_STMT: execute_free_stmt(stmt->line, stmt->stmt); break;
-			case SIZE_STMT: execute_size_stmt(stmt->line, stmt->stmt); break;
 			default:
-				fprintf(stderr, "Invalid statement type (this shouldn't be printed)\n");
+				fprintf(stderr, "Invalid step type (this shouldn't be printed)\n");
 				exit(EXIT_FAILURE);
 		}
+	}
+}
+
+static void flatten_stmts(Interpreter* interpreter, Block stmts) {
+	for (int i = 0; i < stmts.n_stmts; i++) {
+		Stmt* stmt = tree_stmt(interpreter->tree, stmts, i);
+		void* payload = tree_payload(interpreter->tree, stmt);
 
-		if (interpreter.loop_state != NORMAL) {
-			return; // A break or continue statement was encountered
+		switch (stmt->type) {
+			case WHILE_STMT: flatten_while_stmt(interpreter, stmt->line, payload); break;
+			case IF_ELSE_STMT: flatten_if_else_stmt(interpreter, stmt->line, payload); break;
+			case BREAK_STMT: flatten_break_stmt(interpreter, stmt->line, payload); break;
+			case CONTINUE_STMT: flatten_continue_stmt(interpreter, stmt->line, payload); break;
+			default: add_step(interpreter, STEP_STMT, stmt->line, stmt, 0); break;
 		}
 	}
+}
 
-	if (interpreter.nesting == 0) {
-		// Only destroy the symbol table if we're at the top level & finished
-		map_destroy(interpreter.symbol_table);
+// A loop evaluates its condition at its start and jumps back there after its body,
+// so continue <n> jumps to the start of the n-th enclosing loop and break <n> to
+// the step right after it
+static void flatten_while_stmt(Interpreter* interpreter, int line, WhileStmt* stmt) {
+	int kernel = NO_JUMP;
+	if (stmt->idiom != NULL) {
+		kernel = add_step(interpreter, STEP_KERNEL, line, stmt->idiom, NO_JUMP);
 	}
-}
 
-static void execute_read_stmt(int line, ReadStmt* stmt) {
-	int input;
-	scanf("%d", &input);
-	assign_to_lvalue(line, input, stmt->is_array, stmt->lvalue);
+	int parallel = NO_JUMP;
+	if (stmt->parallel != NULL) {
+		ParallelStep* step = malloc(sizeof(ParallelStep));
+		assert(step != NULL);
+		step->loop = stmt->parallel;
+		step->stmts = stmt->stmts;
+		step->workers = calloc(get_threads(), sizeof(Interpreter*));
+		assert(step->workers != NULL);
+
+		if (interpreter->n_parallel == interpreter->parallel_cap) {
+			interpreter->parallel_cap *= 2;
+			interpreter->parallel = realloc(interpreter->parallel,
+				interpreter->parallel_cap * sizeof(ParallelStep*));
+			assert(interpreter->parallel != NULL);
+		}
+
+		interpreter->parallel[interpreter->n_parallel++] = step;
+		parallel = add_step(interpreter, STEP_PARALLEL, line, step, NO_JUMP);
+	}
+
+	int start = add_jump_if_false(interpreter, line, stmt->cond);
+
+	if (interpreter->loop_nesting == interpreter->loops_cap) {
+		interpreter->loops_cap *= 2;
+		interpreter->loops = realloc(interpreter->loops, interpreter->loops_cap * sizeof(Loop));
+		assert(interpreter->loops != NULL);
+	}
+
+	Loop* loop = &interpreter->loops[interpreter->loop_nesting++];
+	loop->start = start;
+	loop->break_jumps = start;
+
+	flatten_stmts(interpreter, stmt->stmts);
+	add_step(interpreter, STEP_JUMP, line, NULL, start);
+
+	loop = &interpreter->loops[--interpreter->loop_nesting];
+	patch_jumps(interpreter, loop->break_jumps, interpreter->n_steps);
+
+	if (kernel != NO_JUMP) {
+		interpreter->steps[kernel].target = interpreter->n_steps;
+	}
+	if (parallel != NO_JUMP) {
+		interpreter->steps[parallel].target = interpreter->n_steps;
+	}
 }
 
-static void execute_assignment_stmt(int line, AssignmentStmt* stmt) {
-	assign_to_lvalue(line, evaluate_expr(line, stmt->expr), stmt->is_array, stmt->lvalue);
+static void flatten_if_else_stmt(Interpreter* interpreter, int line, IfElseStmt* stmt) {
+	int else_jump = add_jump_if_false(interpreter, line, stmt->cond);
+	flatten_stmts(interpreter, stmt->then_stmts);
+
+	if (stmt->has_else) {
+		int end_jump = add_step(interpreter, STEP_JUMP, line, NULL, NO_JUMP);
+		patch_jumps(interpreter, else_jump, interpreter->n_steps);
+		flatten_stmts(interpreter, stmt->else_stmts);
+		patch_jumps(interpreter, end_jump, interpreter->n_steps);
+	} else {
+		patch_jumps(interpreter, else_jump, interpreter->n_steps);
+	}
 }
 
-static void execute_write_stmt(int line, WriteStmt* stmt) {
-	if (stmt->expr != NULL) {
-		printf("%d", evaluate_expr(line, stmt->expr));
+// Jumping out of more loops than there are is only an error if it's ever reached
+static void flatten_break_stmt(Interpreter* interpreter, int line, BreakStmt* stmt) {
+	if (stmt->n_loops > interpreter->loop_nesting) {
+		add_step(interpreter, STEP_BAD_BREAK, line, NULL, 0);
+		return;
 	}
-	printf(" ");
+
+	Loop* loop = &interpreter->loops[interpreter->loop_nesting - stmt->n_loops];
+	loop->break_jumps = add_step(interpreter, STEP_JUMP, line, NULL, loop->break_jumps);
 }
 
-static void execute_writeln_stmt(int line, WritelnStmt* stmt) {
-	if (stmt->expr != NULL) {
-		printf("%d", evaluate_expr(line, stmt->expr));
+static void flatten_continue_stmt(Interpreter* interpreter, int line, ContinueStmt* stmt) {
+	if (stmt->n_loops > interpreter->loop_nesting) {
+		add_step(interpreter, STEP_BAD_CONTINUE, line, NULL, 0);
+		return;
 	}
-	printf("\n");
+
+	Loop* loop = &interpreter->loops[interpreter->loop_nesting - stmt->n_loops];
+	add_step(interpreter, STEP_JUMP, line, NULL, loop->start);
 }
 
-static void execute_while_stmt(int line, WhileStmt* stmt) {
-	interpreter.nesting++;
-	interpreter.loop_nesting++;
+static int add_step(Interpreter* interpreter, StepType type, int line, void* stmt, int target) {
+	if (interpreter->n_steps == interpreter->steps_cap) {
+		interpreter->steps_cap *= 2;
+		interpreter->steps = realloc(interpreter->steps, interpreter->steps_cap * sizeof(Step));
+		assert(interpreter->steps != NULL);
+	}
 
-	while (true) {
-		int cond = evaluate_expr(line, stmt->cond);
-		if (cond == 0) break;
+	interpreter->steps[interpreter->n_steps] = (Step) {
+		.type = type, .line = line, .stmt = stmt, .cond = NO_EXPR, .target = target
+	};
 
-		interpreter.jump_n_loops = 1;
-		interpreter.loop_state = NORMAL;
-		execute(stmt->stmts, interpreter.n_args, interpreter.args);
+	return interpreter->n_steps++;
+}
 
-		if (interpreter.loop_state != NORMAL) {
-			interpreter.jump_n_loops--;
-			if (interpreter.loop_state == STOP || interpreter.jump_n_loops != 0) {
-				break;
-			}
-		}
+static int add_jump_if_false(Interpreter* interpreter, int line, Expr cond) {
+	int jump = add_step(interpreter, STEP_JUMP_IF_FALSE, line, NULL, NO_JUMP);
+	interpreter->steps[jump].cond = cond;
+	return jump;
+}
+
+static void patch_jumps(Interpreter* interpreter, int list, int target) {
+	while (list != NO_JUMP) {
+		int next = interpreter->steps[list].target;
+		interpreter->steps[list].target = target;
+		list = next;
+	}
+}
+
+// The variables that the kernel writes are bound, just like assigning them would
+static bool execute_kernel(Interpreter* interpreter, Idiom* idiom) {
+	if (!run_idiom(idiom, interpreter->vars, interpreter->arrays)) {
+		return false;
 	}
 
-	if (interpreter.jump_n_loops == 0) {
-		interpreter.jump_n_loops = 1;
-		interpreter.loop_state = NORMAL;
+	interpreter->kinds[idiom->counter] = BOUND_VAR;
+	if (idiom->type == IDIOM_SUM || idiom->type == IDIOM_MAX) {
+		interpreter->kinds[idiom->target] = BOUND_VAR;
 	}
 
-	interpreter.nesting--;
-	interpreter.loop_nesting--;
+	return true;
 }
 
-static void execute_if_else_stmt(int line, IfElseStmt* stmt) {
-	int cond = evaluate_expr(line, stmt->cond);
+static bool execute_parallel(Interpreter* interpreter, ParallelStep* step) {
+	LoopBody body = { .vars = worker_vars, .run = run_worker, .state = interpreter };
+	interpreter->running = step;
 
-	interpreter.nesting++;
-	if (cond == 1) {
-		execute(stmt->then_stmts, interpreter.n_args, interpreter.args);
-	} else if (stmt->else_stmts != NULL) {
-		execute(stmt->else_stmts, interpreter.n_args, interpreter.args);
+	ParallelLoop* loop = step->loop;
+	if (!run_parallel(loop, interpreter->vars, interpreter->n_slots, &body)) {
+		return false;
 	}
 
-	interpreter.nesting--;
+	for (int i = 0; i < loop->n_written; i++) {
+		interpreter->kinds[loop->written[i]] = BOUND_VAR;
+	}
+
+	return true;
 }
 
-static void execute_random_stmt(int line, RandomStmt* stmt) {
-	assign_to_lvalue(line, rand(), stmt->is_array, stmt->lvalue);
+// Every worker starts out seeing the names the way the program does. The counter
+// is set by the pool, so it must not be installed with 0 when it's first read
+static int* worker_vars(void* state, int worker) {
+	Interpreter* interpreter = state;
+	ParallelStep* step = interpreter->running;
+
+	Interpreter* w = step->workers[worker];
+	if (w == NULL) {
+		w = malloc(sizeof(Interpreter));
+		assert(w != NULL);
+
+		init_interpreter(w, interpreter->tree, interpreter->n_slots, interpreter->n_args,
+			interpreter->args, interpreter->io, interpreter->arrays);
+		flatten_stmts(w, step->stmts);
+		step->workers[worker] = w;
+	}
+
+	memcpy(w->kinds, interpreter->kinds, interpreter->n_slots * sizeof(SlotKind));
+	w->kinds[step->loop->counter] = BOUND_VAR;
+
+	return w->vars;
 }
 
-static void execute_arg_stmt(int line, ArgStmt* stmt) {
-	int pos = evaluate_expr(line, stmt->expr);
-	if (pos < 1 || pos > interpreter.n_args-2) {
-		runtime_error("invalid argument index", line, EBAD_IDX);
+static void run_worker(void* state, int worker, int start, int end) {
+	Interpreter* interpreter = state;
+	ParallelStep* step = interpreter->running;
+
+	Interpreter* w = step->workers[worker];
+	for (int k = start; k < end; k++) {
+		w->vars[step->loop->counter] = k;
+		run(w);
+	}
+}
+
+static void execute_stmt(Interpreter* interpreter, Stmt* stmt) {
+	void* payload = tree_payload(interpreter->tree, stmt);
+
+	switch (stmt->type) {
+		case READ_STMT: execute_read_stmt(interpreter, stmt->line, payload); break;
+		case ASSIGNMENT_STMT: execute_assignment_stmt(interpreter, stmt->line, payload); break;
+		case WRITE_STMT: execute_write_stmt(interpreter, stmt->line, payload); break;
+		case WRITELN_STMT: execute_writeln_stmt(interpreter, stmt->line, payload); break;
+		case RANDOM_STMT: execute_random_stmt(interpreter, stmt->line, payload); break;
+		case ARG_STMT: execute_arg_stmt(interpreter, stmt->line, payload); break;
+		case ARG_SIZE_STMT: execute_arg_size_stmt(interpreter, stmt->line, payload); break;
+		case NEW_STMT: execute_new_stmt(interpreter, stmt->line, payload); break;
+		case FREE_STMT: execute_free_stmt(interpreter, stmt->line, payload); break;
+		case SIZE_STMT: execute_size_stmt(interpreter, stmt->line, payload); break;
+		default:
+			fprintf(stderr, "Invalid statement type (this shouldn't be printed)\n");
+			exit(EXIT_FAILURE);
 	}
+}
+
+static void execute_read_stmt(Interpreter* interpreter, int line, ReadStmt* stmt) {
+	int input = read_input(&interpreter->io);
+	assign_to_lvalue(interpreter, line, input, stmt->lvalue);
+}
 
-	assign_to_lvalue(line, atoi(interpreter.args[pos+1]), stmt->is_array, stmt->lvalue);
+static void execute_assignment_stmt(Interpreter* interpreter, int line, AssignmentStmt* stmt) {
+	int value = evaluate_expr(interpreter, line, stmt->expr);
+	assign_to_lvalue(interpreter, line, value, stmt->lvalue);
 }
 
-static void execute_arg_size_stmt(int line, ArgSizeStmt* stmt) {
-	assign_to_lvalue(line, interpreter.n_args, stmt->is_array, stmt->lvalue);
+static void execute_write_stmt(Interpreter* interpreter, int line, WriteStmt* stmt) {
+	if (stmt->expr != NO_EXPR) {
+		fprintf(interpreter->io.out, "%d", evaluate_expr(interpreter, line, stmt->expr));
+	}
+	fputc(' ', interpreter->io.out);
 }
 
-static void execute_break_stmt(int line, BreakStmt* stmt) {
-	if (stmt->n_loops > interpreter.loop_nesting) {
-		runtime_error("invalid break statement", line, EBAD_BREAK);
+static void execute_writeln_stmt(Interpreter* interpreter, int line, WritelnStmt* stmt) {
+	if (stmt->expr != NO_EXPR) {
+		fprintf(interpreter->io.out, "%d", evaluate_expr(interpreter, line, stmt->expr));
 	}
+	fputc('\n', interpreter->io.out);
+}
 
-	interpreter.loop_state = STOP;
-	interpreter.jump_n_loops = stmt->n_loops;
+static void execute_random_stmt(Interpreter* interpreter, int line, RandomStmt* stmt) {
+	int value = draw_random(&interpreter->io);
+	assign_to_lvalue(interpreter, line, value, stmt->lvalue);
 }
 
-static void execute_continue_stmt(int line, ContinueStmt* stmt) {
-	if (stmt->n_loops > interpreter.loop_nesting) {
-		runtime_error("invalid continue statement", line, EBAD_CONT);
+static void execute_arg_stmt(Interpreter* interpreter, int line, ArgStmt* stmt) {
+	int pos = evaluate_expr(interpreter, line, stmt->expr);
+	if (pos < 1 || pos > interpreter->n_args-2) {
+		runtime_error("invalid argument index", line, EBAD_IDX);
 	}
 
-	interpreter.loop_state = REPEAT;
-	interpreter.jump_n_loops = stmt->n_loops;
+	assign_to_lvalue(interpreter, line, atoi(interpreter->args[pos+1]), stmt->lvalue);
 }
 
-static void execute_new_stmt(int line, NewStmt* stmt) {
-	TableEntry* entry = map_get(interpreter.symbol_table, stmt->id);
-	if (entry != NULL) {
-		if (entry->type == VAR) {
-			runtime_error("array name overlaps with variable name", line, EBAD_ID);
-		}
+static void execute_arg_size_stmt(Interpreter* interpreter, int line, ArgSizeStmt* stmt) {
+	assign_to_lvalue(interpreter, line, interpreter->n_args, stmt->lvalue);
+}
 
-		free(entry->value); // Old array gets deallocated
+static void execute_new_stmt(Interpreter* interpreter, int line, NewStmt* stmt) {
+	if (interpreter->kinds[stmt->slot] == BOUND_VAR) {
+		runtime_error("array name overlaps with variable name", line, EBAD_ID);
 	}
 
-	int size = evaluate_expr(line, stmt->size);
+	int size = evaluate_expr(interpreter, line, stmt->size);
 	if (size <= 0) {
 		runtime_error("array size must be greater than 0", line, EBAD_SIZE);
 	}
 
-	int* arr = calloc(size+1, sizeof(int)); // Implicit 0-initialization
-	assert(arr != NULL);
+	int* elems = calloc(size, sizeof(int)); // Implicit 0-initialization
+	assert(elems != NULL);
+
+	ArrayDesc* array = &interpreter->arrays[stmt->slot];
+	free(array->elems); // Old array (if any) gets deallocated
 
-	arr[0] = size; // E.g. {1,2,3} is represented as {3, 1, 2, 3}
-	map_put(interpreter.symbol_table, stmt->id, create_table_entry(ARRAY, arr));
+	array->size = size;
+	array->elems = elems;
+	interpreter->kinds[stmt->slot] = BOUND_ARRAY;
 }
 
-static void execute_free_stmt(int line, FreeStmt* stmt) {
-	TableEntry* entry = map_get(interpreter.symbol_table, stmt->id);
-	if (entry == NULL || entry->type != ARRAY) {
+static void execute_free_stmt(Interpreter* interpreter, int line, FreeStmt* stmt) {
+	if (interpreter->kinds[stmt->slot] != BOUND_ARRAY) {
 		runtime_error("name does not correspond to an array", line, EBAD_ARRAY);
 	}
 
-	free(entry->value);
+	ArrayDesc* array = &interpreter->arrays[stmt->slot];
+	free(array->elems);
 
-	// Virtual removal of entry (free(NULL) is a no-op, so we're ok with destroy_value)
-	map_put(interpreter.symbol_table, stmt->id, NULL);
+	array->size = 0;
+	array->elems = NULL;
+	interpreter->kinds[stmt->slot] = UNBOUND;
 }
 
-static void execute_size_stmt(int line, SizeStmt* stmt) {
-	TableEntry* arr_entry = map_get(interpreter.symbol_table, stmt->id);
-	if (arr_entry == NULL || arr_entry->type != ARRAY) {
+static void execute_size_stmt(Interpreter* interpreter, int line, SizeStmt* stmt) {
+	if (interpreter->kinds[stmt->slot] != BOUND_ARRAY) {
 		runtime_error("name does not correspond to an array", line, EBAD_ARRAY);
 	}
 
-	assign_to_lvalue(line, ((int*) arr_entry->value)[0], stmt->is_array, stmt->lvalue);
+	int size = interpreter->arrays[stmt->slot].size;
+	assign_to_lvalue(interpreter, line, size, stmt->lvalue);
 }
 
-static int evaluate_expr(int line, Expr* expr) {
-	switch (expr->type) {
-		case LITERAL: return evaluate_literal(line, expr->expr);
-		case VAR: return evaluate_var(line, expr->expr);
-		case ARRAY: return evaluate_array(line, expr->expr);
-		case BINARY: return evaluate_binary(line, expr->expr);
+static int evaluate_expr(Interpreter* interpreter, int line, Expr expr) {
+	Tree* tree = interpreter->tree;
+
+	switch (EXPR_TYPE(expr)) {
+		case LITERAL: return evaluate_literal(interpreter, line, tree_literal(tree, expr));
+		case VAR: return evaluate_var(interpreter, line, tree_var(tree, expr));
+		case ARRAY: return evaluate_array(interpreter, line, tree_array(tree, expr));
+		case BINARY: return evaluate_binary(interpreter, line, tree_binary(tree, expr));
 		default:
 			fprintf(stderr, "Invalid expression type (this shouldn't be printed)\n");
 			exit(EXIT_FAILURE);
 	}
 }
 
-static int evaluate_literal(int line, Literal* expr) {
+static int evaluate_literal(Interpreter* interpreter, int line, Literal* expr) {
 	return expr->value;
 }
 
-static int evaluate_var(int line, Var* expr) {
-	TableEntry* entry = map_get(interpreter.symbol_table, expr->id);
-	if (entry == NULL) {
+static int evaluate_var(Interpreter* interpreter, int line, Var* expr) {
+	SlotKind kind = interpreter->kinds[expr->slot];
+	if (kind == UNBOUND) {
 		// If an unseen variable is used in an expression, it's installed with value = 0
-		expr->value = 0;
-		entry = create_table_entry(VAR, &expr->value);
-		map_put(interpreter.symbol_table, expr->id, entry);
-	} else if (entry->type == ARRAY) {
+		interpreter->kinds[expr->slot] = BOUND_VAR;
+		interpreter->vars[expr->slot] = 0;
+	} else if (kind == BOUND_ARRAY) {
 		runtime_error("expected a variable name", line, EBAD_VAR);
 	}
 
-	return *((int*) entry->value);
+	return interpreter->vars[expr->slot];
+}
+
+static int evaluate_array(Interpreter* interpreter, int line, Array* expr) {
+	return *array_element(interpreter, line, expr);
 }
 
-static int evaluate_array(int line, Array* expr) {
-	TableEntry* entry = map_get(interpreter.symbol_table, expr->id);
-	if (entry == NULL || entry->type != ARRAY) {
+static int* array_element(Interpreter* interpreter, int line, Array* array) {
+	if (array->in_bounds) {
+		// The bounds analysis proved that the array exists and the index is in range
+		return &interpreter->arrays[array->slot].elems[evaluate_expr(interpreter, line, array->index)];
+	}
+
+	if (interpreter->kinds[array->slot] != BOUND_ARRAY) {
 		runtime_error("name does not correspond to an array", line, EBAD_ARRAY);
 	}
 
-	int idx = evaluate_expr(line, expr->index);
-	if (idx < 0 || idx >= ((int*) entry->value)[0]) {
+	int idx = evaluate_expr(interpreter, line, array->index);
+
+	ArrayDesc* desc = &interpreter->arrays[array->slot];
+	if (idx < 0 || idx >= desc->size) {
 		runtime_error("array index out of bounds", line, EIDX_OOB);
 	}
 
-	return ((int*) entry->value)[idx+1];
+	return &desc->elems[idx];
 }
 
-static int evaluate_binary(int line, Binary* expr) {
-	int left = evaluate_expr(line, expr->left);
-	int right = evaluate_expr(line, expr->right);
+static int evaluate_binary(Interpreter* interpreter, int line, Binary* expr) {
+	int left = evaluate_expr(interpreter, line, expr->left);
+	int right = evaluate_expr(interpreter, line, expr->right);
 
 	switch (expr->type) {
 		case PLUS: return left + right;
@@ -338,37 +628,17 @@ static int evaluate_binary(int line, Binary* expr) {
 	}
 }
 
-static void assign_to_lvalue(int line, int value, bool is_array, void* lvalue) {
-	if (is_array) {
-		Array* array = (Array*) lvalue;
-
-		TableEntry* entry = map_get(interpreter.symbol_table, array->id);
-		if (entry == NULL || entry->type != ARRAY) {
-			runtime_error("name does not correspond to an array", line, EBAD_ARRAY);
-		}
-
-		int idx = evaluate_expr(line, array->index);
-		if (idx < 0 || idx >= ((int*) entry->value)[0]) {
-			runtime_error("array index out of bounds", line, EIDX_OOB);
-		}
-
-		((int*) entry->value)[idx+1] = value;
+static void assign_to_lvalue(Interpreter* interpreter, int line, int value, Expr lvalue) {
+	if (EXPR_TYPE(lvalue) == ARRAY) {
+		*array_element(interpreter, line, tree_array(interpreter->tree, lvalue)) = value;
 	} else {
-		Var* var = (Var*) lvalue;
+		Var* var = tree_var(interpreter->tree, lvalue);
 
-		TableEntry* entry = map_get(interpreter.symbol_table, var->id);
-		if (entry == NULL) {
-			var->value = value;
-			map_put(interpreter.symbol_table, var->id, create_table_entry(VAR, &var->value));
-		} else if (entry->type == ARRAY) {
+		if (interpreter->kinds[var->slot] == BOUND_ARRAY) {
 			runtime_error("expected a variable name", line, EBAD_VAR);
-		} else {
-			*((int*) entry->value) = value;
 		}
-	}
-}
 
-static void runtime_error(char* msg, int line, int status) {
-	fprintf(stderr, "Runtime Error: %s at line %d\n", msg, line);
-	exit(status);
+		interpreter->kinds[var->slot] = BOUND_VAR;
+		interpreter->vars[var->slot] = value;
+	}
 }
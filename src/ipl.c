@@ -0,0 +1,277 @@
+#include <stdio.h>
+#include <assert.h>
+#include <setjmp.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+
+#include "vector.h"
+
+#include "vm.h"
+#include "tree.h"
+#include "error.h"
+#include "runtime.h"
+#include "scanner.h"
+#include "parser.h"
+#include "resolver.h"
+#include "bounds.h"
+#include "idiom.h"
+#include "kernels.h"
+#include "dependence.h"
+#include "parallel.h"
+#include "optimizer.h"
+#include "licm.h"
+#include "compiler.h"
+#include "translator.h"
+#include "interpreter.h"
+#include "cache.h"
+#include "source.h"
+#include "ipl.h"
+
+struct ipl_program {
+	char* path;
+	IplOptions options;
+	Tree* tree; // Where the statements are stored
+	Block stmts;
+	Vector symbols;
+	Program* bytecode; // Only compiled for the VM
+	MappedProgram* mapped; // The cache file that the bytecode comes from (or NULL)
+	PassStats stats;
+};
+
+// Helper functions used by the library (no reason to expose them)
+static IplProgram* load_program(const char* path, const char* source, size_t size,
+	IplOptions options, IplError* error);
+static IplProgram* load_cached(const char* path, const char* source, size_t size,
+	IplOptions options, IplError* error);
+static void run_passes(IplProgram* program);
+static void print_pass_stats(PassStats* stats);
+static void catch_error(ErrorTrap* trap, IplError* error);
+
+IplOptions ipl_default_options(void) {
+	return (IplOptions) {
+		.engine = IPL_ENGINE_VM, .opt_level = 1, .jit = true, .stats = false, .cache_dir = NULL
+	};
+}
+
+void ipl_set_threads(int n_threads) {
+	set_threads(n_threads);
+}
+
+IplProgram* ipl_program_load(const char* path, IplOptions options, IplError* error) {
+	SourceFile file;
+	if (!open_source(path, &file)) {
+		error->status = EOPEN_FILE;
+		strcpy(error->msg, "Error: unable to open input file\n");
+		return NULL;
+	}
+
+	// The program keeps its own copies of everything it needs from the text
+	IplProgram* program = ipl_program_load_source(path, file.text, file.size, options, error);
+	close_source(&file);
+	return program;
+}
+
+IplProgram* ipl_program_load_source(const char* path, const char* source, size_t size,
+	IplOptions options, IplError* error) {
+	if (options.cache_dir != NULL && options.engine == IPL_ENGINE_VM) {
+		return load_cached(path, source, size, options, error);
+	}
+
+	return load_program(path, source, size, options, error);
+}
+
+// Runs the bytecode right out of the cache file if there's an up-to-date one, or
+// else loads the program as usual and writes its bytecode to one
+static IplProgram* load_cached(const char* path, const char* source, size_t size,
+	IplOptions options, IplError* error) {
+	CacheKey key = { .opt_level = options.opt_level };
+	key.parallel = options.opt_level >= 1 && get_threads() > 1;
+
+	Program* bytecode;
+	PassStats stats;
+	MappedProgram* mapped = cache_load(options.cache_dir, source, size, key, &bytecode, &stats);
+
+	if (mapped == NULL) {
+		IplOptions uncached = options;
+		uncached.cache_dir = NULL;
+
+		IplProgram* program = ipl_program_load_source(path, source, size, uncached, error);
+		if (program != NULL) {
+			cache_store(options.cache_dir, source, size, key, program->bytecode, &program->stats);
+		}
+		return program;
+	}
+
+	IplProgram* program = malloc(sizeof(IplProgram));
+	assert(program != NULL);
+
+	program->path = strdup(path);
+	program->options = options;
+	program->tree = NULL;
+	program->symbols = NULL;
+	program->bytecode = bytecode;
+	program->mapped = mapped;
+	program->stats = stats;
+
+	if (options.opt_level >= 1 && options.stats) {
+		print_pass_stats(&stats);
+	}
+
+	return program;
+}
+
+static IplProgram* load_program(const char* path, const char* source, size_t size,
+	IplOptions options, IplError* error) {
+	// Whatever the parser has built by the time it reports an error goes away at once
+	// with the tree
+	Tree* tree = tree_create();
+
+	TokenStream* volatile tokens = NULL; // Assigned after setjmp, so it must survive longjmp
+	ErrorTrap trap;
+	ErrorTrap* previous = set_error_trap(&trap);
+
+	if (setjmp(trap.env) != 0) {
+		set_error_trap(previous);
+		if (tokens != NULL) {
+			destroy_tokens(tokens);
+		}
+
+		tree_destroy(tree);
+
+		catch_error(&trap, error);
+		return NULL;
+	}
+
+	// The parser pulls the tokens out of the scanner as it goes
+	tokens = scan_tokens(source, size);
+	Block stmts = parse(tree, tokens);
+	set_error_trap(previous);
+
+	// The symbols keep their own copies of the names, so the tokens aren't needed
+	Vector symbols = resolve(tree, stmts, token_names(tokens));
+	destroy_tokens(tokens);
+
+	IplProgram* program = malloc(sizeof(IplProgram));
+	assert(program != NULL);
+
+	program->path = strdup(path);
+	program->options = options;
+	program->tree = tree;
+	program->stmts = stmts;
+	program->symbols = symbols;
+	program->bytecode = NULL;
+	program->mapped = NULL;
+	memset(&program->stats, 0, sizeof(PassStats));
+
+	// The passes add what they create to the same tree, which the compiler reads
+	if (options.opt_level >= 1) {
+		run_passes(program);
+		if (options.stats) {
+			print_pass_stats(&program->stats);
+		}
+	}
+
+	if (options.engine == IPL_ENGINE_VM) {
+		program->bytecode = compile(tree, program->stmts, program->symbols);
+	}
+
+	return program;
+}
+
+static void run_passes(IplProgram* program) {
+	Tree* tree = program->tree;
+	Block* stmts = &program->stmts;
+	Vector symbols = program->symbols;
+	PassStats* stats = &program->stats;
+
+	stats->opt = optimize(tree, stmts, symbols);
+	stats->n_hoisted = hoist_invariants(tree, stmts, symbols);
+
+	// Loops are only split when there's more than one thread to run them, since
+	// that also keeps strength reduction out of them
+	if (get_threads() > 1) {
+		stats->n_parallel = parallelize_loops(tree, *stmts, symbols);
+	}
+
+	stats->n_reduced = reduce_strength(tree, stmts, symbols);
+	stats->n_removed = eliminate_bounds_checks(tree, *stmts, symbols);
+	stats->n_vectorized = recognize_idioms(tree, *stmts, symbols);
+}
+
+// The tree passes run before any engine is picked, so their counts are printed by themselves
+static void print_pass_stats(PassStats* stats) {
+	fprintf(stderr, "%-24s %8d\n", "constants propagated", stats->opt.n_propagated);
+	fprintf(stderr, "%-24s %8d\n", "expressions folded", stats->opt.n_folded);
+	fprintf(stderr, "%-24s %8d\n", "dead branches removed", stats->opt.n_removed);
+	fprintf(stderr, "%-24s %8d\n", "invariants hoisted", stats->n_hoisted);
+	fprintf(stderr, "%-24s %8d\n", "multiplies reduced", stats->n_reduced);
+	fprintf(stderr, "%-24s %8d\n", "bounds checks removed", stats->n_removed);
+	fprintf(stderr, "%-24s %8d\n", "loops vectorized", stats->n_vectorized);
+	fprintf(stderr, "%-24s %8d\n", "loops parallelized", stats->n_parallel);
+	fprintf(stderr, "%-24s %8s\n", "kernel isa", kernel_isa());
+}
+
+int ipl_run(IplProgram* program, int argc, char** argv, IplError* error) {
+	RunIO io = { .in = stdin, .out = stdout, .seed = NULL };
+	return ipl_run_io(program, argc, argv, io, error);
+}
+
+int ipl_run_io(IplProgram* program, int argc, char** argv, RunIO io, IplError* error) {
+	// The engines see the arguments the way ipli's main gets them, after the file
+	char** args = malloc((argc + 3) * sizeof(char*));
+	assert(args != NULL);
+
+	args[0] = "ipli";
+	args[1] = program->path;
+	memcpy(args + 2, argv, argc * sizeof(char*));
+	args[argc + 2] = NULL;
+
+	ErrorTrap trap;
+	ErrorTrap* previous = set_error_trap(&trap);
+
+	if (setjmp(trap.env) != 0) {
+		set_error_trap(previous);
+		free(args);
+		catch_error(&trap, error);
+		return error->status;
+	}
+
+	if (program->options.engine == IPL_ENGINE_TREE) {
+		execute(program->tree, program->stmts, vector_size(program->symbols), argc + 2, args, io);
+	} else {
+		VMOptions options = { .stats = program->options.stats, .jit = program->options.jit };
+		run_program(program->bytecode, argc + 2, args, options, io);
+	}
+
+	set_error_trap(previous);
+	free(args);
+	return 0;
+}
+
+void ipl_emit_c(IplProgram* program, FILE* out) {
+	assert(program->tree != NULL);
+
+	translate_to_c(program->tree, program->stmts, program->symbols, program->path, out);
+}
+
+void ipl_program_free(IplProgram* program) {
+	if (program->mapped != NULL) {
+		cache_unmap(program->mapped);
+	} else if (program->bytecode != NULL) {
+		destroy_program(program->bytecode);
+	}
+
+	if (program->tree != NULL) {
+		tree_destroy(program->tree);
+		vector_destroy(program->symbols);
+	}
+
+	free(program->path);
+	free(program);
+}
+
+static void catch_error(ErrorTrap* trap, IplError* error) {
+	error->status = trap->status;
+	strcpy(error->msg, trap->msg);
+}
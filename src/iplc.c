@@ -0,0 +1,58 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/un.h>
+#include <sys/socket.h>
+
+#include "error.h"
+#include "wire.h"
+
+// Runs a program on an ipli --serve server, exactly like ./ipli <file> [<args>] would
+// run it: the server does the program's I/O on this process' streams and the client
+// exits with the status that ipli would exit with
+
+static void usage_error(void) {
+	fprintf(stderr, "Usage: IPLI_SOCKET=<socket> ./iplc <file> [<args>]\n");
+	exit(EBAD_ARGS);
+}
+
+static void connection_error(void) {
+	fprintf(stderr, "Error: unable to reach the server\n");
+	exit(EOPEN_FILE);
+}
+
+int main(int argc, char *argv[]) {
+	char* socket_path = getenv("IPLI_SOCKET");
+	if (socket_path == NULL || argc < 2) {
+		usage_error();
+	}
+
+	struct sockaddr_un addr = { .sun_family = AF_UNIX };
+	if (strlen(socket_path) >= sizeof(addr.sun_path)) {
+		connection_error();
+	}
+	strcpy(addr.sun_path, socket_path);
+
+	int sock = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (sock < 0 || connect(sock, (struct sockaddr*) &addr, sizeof(addr)) != 0) {
+		connection_error();
+	}
+
+	// The server resolves paths from its own directory, so it gets an absolute one
+	// (a path that doesn't resolve is sent as is, for the server to report)
+	char* path = realpath(argv[1], NULL);
+	if (path != NULL) {
+		argv[1] = path;
+	}
+
+	int streams[N_STREAMS] = { STDIN_FILENO, STDOUT_FILENO, STDERR_FILENO };
+	int status;
+	if (!send_request(sock, streams, argc - 1, argv + 1) || !receive_status(sock, &status)) {
+		connection_error();
+	}
+
+	free(path);
+	close(sock);
+	return status;
+}
@@ -2,36 +2,131 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-
-#include "vector.h"
+#include <stdbool.h>
 
 #include "error.h"
-#include "scanner.h"
-#include "parser.h"
-#include "interpreter.h"
+#include "ipl.h"
+
+static void usage_error(void) {
+	fprintf(stderr, "Usage: ./ipli [--engine=vm|tree] [-O0|-O1] [--stats] [--no-jit] [--emit-c] [--threads N] [--cache <dir>] [--batch <file> [--jobs N]] <file> [<args>]\n"
+		"       ./ipli [--engine=vm|tree] [-O0|-O1] [--no-jit] [--threads N] [--cache <dir>] --serve <socket>\n");
+	exit(EBAD_ARGS);
+}
 
 int main(int argc, char *argv[]) {
-	if (argc == 1) {
-		fprintf(stderr, "Usage: ./ipli <file> [<args>]\n");
-		return EBAD_ARGS;
+	IplOptions options = ipl_default_options();
+	bool emit_c = false;
+	int n_threads = 1;
+	char* batch = NULL;
+	char* socket_path = NULL;
+	int n_jobs = 1;
+
+	// Options come before the input file, everything after it belongs to the program
+	int n_opts = 0;
+	while (1 + n_opts < argc && argv[1 + n_opts][0] == '-') {
+		char* opt = argv[1 + n_opts++];
+
+		if (strcmp(opt, "--engine=vm") == 0) {
+			options.engine = IPL_ENGINE_VM;
+		} else if (strcmp(opt, "--engine=tree") == 0) {
+			options.engine = IPL_ENGINE_TREE;
+		} else if (strcmp(opt, "-O0") == 0 || strcmp(opt, "-O1") == 0) {
+			options.opt_level = opt[2] - '0';
+		} else if (strcmp(opt, "--stats") == 0) {
+			options.stats = true;
+		} else if (strcmp(opt, "--no-jit") == 0) {
+			options.jit = false;
+		} else if (strcmp(opt, "--emit-c") == 0) {
+			emit_c = true;
+		} else if (strcmp(opt, "--threads") == 0 && 1 + n_opts < argc) {
+			n_threads = atoi(argv[1 + n_opts++]);
+			if (n_threads < 1) {
+				usage_error();
+			}
+		} else if (strcmp(opt, "--cache") == 0 && 1 + n_opts < argc) {
+			options.cache_dir = argv[1 + n_opts++];
+		} else if (strcmp(opt, "--serve") == 0 && 1 + n_opts < argc) {
+			socket_path = argv[1 + n_opts++];
+		} else if (strcmp(opt, "--batch") == 0 && 1 + n_opts < argc) {
+			batch = argv[1 + n_opts++];
+		} else if (strcmp(opt, "--jobs") == 0 && 1 + n_opts < argc) {
+			n_jobs = atoi(argv[1 + n_opts++]);
+			if (n_jobs < 1) {
+				usage_error();
+			}
+		} else {
+			usage_error();
+		}
 	}
 
-	FILE* stream = fopen(argv[1], "r");
-	if (stream == NULL) {
-		fprintf(stderr, "Error: unable to open input file\n");
-		return EOPEN_FILE;
+	// Loops are only split by the passes, which -O0 skips
+	if (n_threads > 1 && options.opt_level == 0) {
+		usage_error();
+	}
+
+	// A server takes its programs from its clients
+	if (socket_path != NULL) {
+		if (1 + n_opts != argc || batch != NULL || emit_c) {
+			usage_error();
+		}
+
+		ipl_set_threads(n_threads);
+		srand(time(NULL));
+
+		IplError error;
+		ipl_serve(socket_path, options, &error);
+		fprintf(stderr, "%s", error.msg);
+		return error.status;
 	}
 
+	if (1 + n_opts == argc) {
+		usage_error();
+	}
+
+	// A batch takes the arguments of its runs from its own file
+	if (batch != NULL && (emit_c || 2 + n_opts < argc)) {
+		usage_error();
+	}
+
+	// The program only gets the arguments that come after the input file
+	char* path = argv[1 + n_opts];
+	argc -= 2 + n_opts;
+	argv += 2 + n_opts;
+
+	// The passes' counts would end up in the middle of the translation otherwise, and
+	// the translation needs the program's tree, which cached bytecode doesn't keep
+	if (emit_c) {
+		options.stats = false;
+		options.cache_dir = NULL;
+	}
+
+	ipl_set_threads(n_threads);
 	srand(time(NULL));
 
-	Vector tokens = scan_tokens(stream);
-	Vector stmts = parse(tokens);
+	IplError error;
+	IplProgram* program = ipl_program_load(path, options, &error);
+	if (program == NULL) {
+		fprintf(stderr, "%s", error.msg);
+		return error.status;
+	}
 
-	execute(stmts, argc, argv);
+	FILE* batch_args = NULL;
+	if (batch != NULL && (batch_args = fopen(batch, "r")) == NULL) {
+		fprintf(stderr, "Error: unable to open input file\n");
+		ipl_program_free(program);
+		return EOPEN_FILE;
+	}
 
-	vector_destroy(tokens);
-	vector_destroy(stmts);
+	int status = 0;
+	if (emit_c) {
+		ipl_emit_c(program, stdout);
+	} else if (batch != NULL) {
+		status = ipl_run_batch(program, batch_args, n_jobs, stdout);
+		fclose(batch_args);
+	} else if ((status = ipl_run(program, argc, argv, &error)) != 0) {
+		fprintf(stderr, "%s", error.msg);
+	}
 
-	fclose(stream);
-	return 0;
+	ipl_program_free(program);
+	return status;
 }
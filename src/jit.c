@@ -0,0 +1,357 @@
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#include "runtime.h"
+#include "bytecode.h"
+#include "jit.h"
+
+// Only x86-64 code is generated. The native code is a leaf function that gets the
+// registers in rdi and the array descriptors in rsi (System V calling convention),
+// keeps every IPL register in memory and only uses eax, ecx and edx as scratch
+#if defined(__x86_64__) && defined(__unix__)
+#define JIT_ENABLED
+#endif
+
+#ifdef JIT_ENABLED
+
+#include <pthread.h>
+#include <sys/mman.h>
+
+#define MIN_CAP 256
+
+#define EAX 0
+#define ECX 1
+#define EDX 2
+
+// Second opcode byte of the jcc rel32 instructions
+#define JE 0x84
+#define JNE 0x85
+#define JAE 0x83
+#define JL 0x8C
+#define JGE 0x8D
+#define JLE 0x8E
+#define JG 0x8F
+
+// A rel32 field that can only be filled in once the code has been laid out. The
+// jump either goes to the native code of instruction target, or it exits to the
+// virtual machine at target (e.g. to raise a runtime error there)
+typedef struct patch {
+	unsigned long at;
+	int target;
+	bool exits;
+} Patch;
+
+// Helper functions used by the JIT (no reason to expose them)
+static void init_jit(Program* program, int head);
+static void compile_instr(int pc);
+static void compile_elem_address(int pc, int slot, int idx);
+static void compile_jump(int opcode, int target, bool exits);
+static void compile_exit(int target);
+static void emit_byte(int byte);
+static void emit_int(int value);
+static void emit_reg_operand(int x86_reg, int reg);
+static void emit_array_operand(int x86_reg, int slot, int field);
+static void emit_load(int x86_reg, int reg);
+static void emit_store(int reg, int x86_reg);
+static int jcc_opcode(OpCode op);
+
+// This is used as a wrapper for the JIT's state
+static struct jit {
+	Program* program;
+	int head; // The loop's OP_LOOP_HEAD
+	int end; // First instruction after the loop
+	unsigned char* buf;
+	unsigned long size;
+	unsigned long cap;
+	unsigned long* offsets; // Native offset of every instruction in [head, end)
+	Patch* patches;
+	int n_patches;
+	int patches_cap;
+} jit;
+
+// Workers of parallel loops compile their own copies of the loops they run, but
+// there's only one JIT state to do it with
+static pthread_mutex_t jit_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static void init_jit(Program* program, int head) {
+	jit.program = program;
+	jit.head = head;
+	jit.end = program->code[head].b;
+
+	jit.buf = malloc(MIN_CAP);
+	jit.offsets = malloc((jit.end - head) * sizeof(unsigned long));
+	jit.patches = malloc(MIN_CAP * sizeof(Patch));
+	assert(jit.buf != NULL && jit.offsets != NULL && jit.patches != NULL);
+
+	jit.size = 0;
+	jit.cap = MIN_CAP;
+	jit.n_patches = 0;
+	jit.patches_cap = MIN_CAP;
+}
+
+NativeCode* jit_compile(Program* program, int head) {
+	pthread_mutex_lock(&jit_lock);
+	init_jit(program, head);
+
+	for (int pc = head; pc < jit.end; pc++) {
+		jit.offsets[pc - head] = jit.size;
+		compile_instr(pc);
+	}
+
+	// Falling through the loop's last jump leaves the loop
+	compile_exit(jit.end);
+
+	// Exits are laid out after the loop, so that the loop itself stays compact
+	for (int i = 0; i < jit.n_patches; i++) {
+		Patch* patch = &jit.patches[i];
+
+		unsigned long dest;
+		if (!patch->exits && patch->target >= head && patch->target < jit.end) {
+			dest = jit.offsets[patch->target - head];
+		} else {
+			dest = jit.size;
+			compile_exit(patch->target);
+		}
+
+		int rel = (int) (dest - (patch->at + 4));
+		memcpy(jit.buf + patch->at, &rel, sizeof(int));
+	}
+
+	NativeCode* code = NULL;
+
+	// The pages are never writable and executable at the same time
+	void* mem = mmap(NULL, jit.size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (mem != MAP_FAILED) {
+		memcpy(mem, jit.buf, jit.size);
+
+		if (mprotect(mem, jit.size, PROT_READ | PROT_EXEC) == 0) {
+			code = malloc(sizeof(NativeCode));
+			assert(code != NULL);
+
+			code->entry = (NativeLoop) mem;
+			code->mem = mem;
+			code->size = jit.size;
+		} else {
+			munmap(mem, jit.size);
+		}
+	}
+
+	free(jit.buf);
+	free(jit.offsets);
+	free(jit.patches);
+	pthread_mutex_unlock(&jit_lock);
+
+	return code;
+}
+
+void jit_destroy(NativeCode* code) {
+	assert(code != NULL);
+
+	munmap(code->mem, code->size);
+	free(code);
+}
+
+static void compile_instr(int pc) {
+	Instr* instr = &jit.program->code[pc];
+
+	switch (instr->op) {
+		case OP_LOOP_HEAD:
+			break; // Nested loops run as part of the enclosing loop's code
+
+		case OP_MOVE:
+			emit_load(EAX, instr->b);
+			emit_store(instr->a, EAX);
+			break;
+
+		// The 32-bit instructions wrap around on overflow, just like the VM does
+		case OP_ADD:
+		case OP_SUB:
+		case OP_MUL:
+			emit_load(EAX, instr->b);
+			if (instr->op == OP_ADD) {
+				emit_byte(0x03); // add eax, r/m32
+			} else if (instr->op == OP_SUB) {
+				emit_byte(0x2B); // sub eax, r/m32
+			} else {
+				emit_byte(0x0F); emit_byte(0xAF); // imul eax, r/m32
+			}
+			emit_reg_operand(EAX, instr->c);
+			emit_store(instr->a, EAX);
+			break;
+
+		case OP_DIV:
+		case OP_MOD:
+			emit_load(ECX, instr->c);
+			emit_byte(0x85); emit_byte(0xC9); // test ecx, ecx
+			compile_jump(JE, pc, true); // The VM raises the error
+			emit_load(EAX, instr->b);
+			emit_byte(0x99); // cdq
+			emit_byte(0xF7); emit_byte(0xF9); // idiv ecx
+			emit_store(instr->a, instr->op == OP_DIV ? EAX : EDX);
+			break;
+
+		case OP_INCREMENT:
+			emit_byte(0x81); // add r/m32, imm32
+			emit_reg_operand(0, instr->a);
+			emit_int(instr->b);
+			break;
+
+		case OP_JUMP:
+			compile_jump(0, instr->a, false);
+			break;
+
+		case OP_JUMP_ZERO:
+		case OP_JUMP_NOT_ZERO:
+			emit_byte(0x83); // cmp r/m32, imm8
+			emit_reg_operand(7, instr->b);
+			emit_byte(0);
+			compile_jump(instr->op == OP_JUMP_ZERO ? JE : JNE, instr->a, false);
+			break;
+
+		case OP_JUMP_EQ: case OP_JUMP_NE: case OP_JUMP_LT:
+		case OP_JUMP_LE: case OP_JUMP_GT: case OP_JUMP_GE:
+			emit_load(EAX, instr->b);
+			emit_byte(0x3B); // cmp eax, r/m32
+			emit_reg_operand(EAX, instr->c);
+			compile_jump(jcc_opcode(instr->op), instr->a, false);
+			break;
+
+		case OP_JUMP_EQ_IMM: case OP_JUMP_NE_IMM: case OP_JUMP_LT_IMM:
+		case OP_JUMP_LE_IMM: case OP_JUMP_GT_IMM: case OP_JUMP_GE_IMM:
+			emit_byte(0x81); // cmp r/m32, imm32
+			emit_reg_operand(7, instr->b);
+			emit_int(instr->c);
+			compile_jump(jcc_opcode(instr->op), instr->a, false);
+			break;
+
+		case OP_GET_ELEM:
+			compile_elem_address(pc, instr->b, instr->c);
+			emit_byte(0x8B); emit_byte(0x04); emit_byte(0x8A); // mov eax, [rdx+rcx*4]
+			emit_store(instr->a, EAX);
+			break;
+
+		case OP_SET_ELEM:
+		case OP_ADD_ELEM:
+		case OP_SUB_ELEM:
+			compile_elem_address(pc, instr->a, instr->b);
+			emit_load(EAX, instr->c);
+			if (instr->op == OP_SET_ELEM) {
+				emit_byte(0x89); // mov [rdx+rcx*4], eax
+			} else if (instr->op == OP_ADD_ELEM) {
+				emit_byte(0x01); // add [rdx+rcx*4], eax
+			} else {
+				emit_byte(0x29); // sub [rdx+rcx*4], eax
+			}
+			emit_byte(0x04); emit_byte(0x8A);
+			break;
+
+		// Everything else is left to the virtual machine, which re-enters the
+		// native code once it gets back to the loop's head
+		default:
+			compile_exit(pc);
+			break;
+	}
+}
+
+// Leaves the index in rcx and the array's elements in rdx. Names that aren't
+// arrays have size 0, so the bounds check also catches them
+static void compile_elem_address(int pc, int slot, int idx) {
+	emit_load(ECX, idx);
+	emit_byte(0x3B); // cmp ecx, r/m32
+	emit_array_operand(ECX, slot, offsetof(ArrayDesc, size));
+	compile_jump(JAE, pc, true);
+
+	emit_byte(0x48); emit_byte(0x8B); // mov rdx, r/m64
+	emit_array_operand(EDX, slot, offsetof(ArrayDesc, elems));
+}
+
+// Emits jcc rel32, or jmp rel32 if opcode is 0
+static void compile_jump(int opcode, int target, bool exits) {
+	if (opcode == 0) {
+		emit_byte(0xE9);
+	} else {
+		emit_byte(0x0F);
+		emit_byte(opcode);
+	}
+
+	if (jit.n_patches == jit.patches_cap) {
+		jit.patches_cap *= 2;
+		jit.patches = realloc(jit.patches, jit.patches_cap * sizeof(Patch));
+		assert(jit.patches != NULL);
+	}
+
+	jit.patches[jit.n_patches++] = (Patch) { .at = jit.size, .target = target, .exits = exits };
+	emit_int(0);
+}
+
+// Returns to the virtual machine, which continues at target
+static void compile_exit(int target) {
+	emit_byte(0xB8); // mov eax, imm32
+	emit_int(target);
+	emit_byte(0xC3); // ret
+}
+
+static void emit_byte(int byte) {
+	if (jit.size == jit.cap) {
+		jit.cap *= 2;
+		jit.buf = realloc(jit.buf, jit.cap);
+		assert(jit.buf != NULL);
+	}
+
+	jit.buf[jit.size++] = (unsigned char) byte;
+}
+
+static void emit_int(int value) {
+	unsigned bits = (unsigned) value;
+	for (int i = 0; i < 4; i++) {
+		emit_byte((bits >> (8 * i)) & 0xFF);
+	}
+}
+
+// ModRM + disp32 for [rdi + 4*reg], i.e. the IPL register reg
+static void emit_reg_operand(int x86_reg, int reg) {
+	emit_byte(0x80 | (x86_reg << 3) | 7);
+	emit_int(reg * (int) sizeof(int));
+}
+
+// ModRM + disp32 for a field of [rsi + slot*sizeof(ArrayDesc)]
+static void emit_array_operand(int x86_reg, int slot, int field) {
+	emit_byte(0x80 | (x86_reg << 3) | 6);
+	emit_int(slot * (int) sizeof(ArrayDesc) + field);
+}
+
+static void emit_load(int x86_reg, int reg) {
+	emit_byte(0x8B); // mov r32, r/m32
+	emit_reg_operand(x86_reg, reg);
+}
+
+static void emit_store(int reg, int x86_reg) {
+	emit_byte(0x89); // mov r/m32, r32
+	emit_reg_operand(x86_reg, reg);
+}
+
+static int jcc_opcode(OpCode op) {
+	switch (op) {
+		case OP_JUMP_EQ: case OP_JUMP_EQ_IMM: return JE;
+		case OP_JUMP_NE: case OP_JUMP_NE_IMM: return JNE;
+		case OP_JUMP_LT: case OP_JUMP_LT_IMM: return JL;
+		case OP_JUMP_LE: case OP_JUMP_LE_IMM: return JLE;
+		case OP_JUMP_GT: case OP_JUMP_GT_IMM: return JG;
+		case OP_JUMP_GE: case OP_JUMP_GE_IMM: return JGE;
+		default: return JE; // Not a conditional jump (this shouldn't happen)
+	}
+}
+
+#else
+
+NativeCode* jit_compile(Program* program, int head) {
+	return NULL;
+}
+
+void jit_destroy(NativeCode* code) {
+}
+
+#endif // JIT_ENABLED
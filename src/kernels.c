@@ -0,0 +1,282 @@
+#include <string.h>
+#include <pthread.h>
+#include <stdbool.h>
+
+#include "idiom.h"
+#include "runtime.h"
+#include "kernels.h"
+
+// SSE2 is part of x86-64, so it's always there. AVX2 is only used if the CPU
+// reports it at runtime, which lets the same binary run everywhere
+#if defined(__x86_64__) && defined(__GNUC__)
+#define X86_KERNELS
+#include <immintrin.h>
+#endif
+
+typedef struct kernels {
+	const char* isa;
+	void (*fill)(int* dst, int value, int n);
+	void (*scale)(int* dst, const int* src, int factor, int n);
+	void (*add)(int* dst, const int* a, const int* b, int n);
+	int (*sum)(const int* src, int n);
+	int (*max)(const int* src, int n, int init);
+} Kernels;
+
+// Helper functions used by the kernels (no reason to expose them)
+static void select_kernels(void);
+static int operand_value(Operand operand, int* vars);
+static bool fits(ArrayDesc* arrays, int slot, int limit);
+
+// Arithmetic wraps around on overflow, just like it does in the engines
+static void fill_scalar(int* dst, int value, int n) {
+	for (int i = 0; i < n; i++) {
+		dst[i] = value;
+	}
+}
+
+static void scale_scalar(int* dst, const int* src, int factor, int n) {
+	for (int i = 0; i < n; i++) {
+		dst[i] = (int) ((unsigned) src[i] * (unsigned) factor);
+	}
+}
+
+static void add_scalar(int* dst, const int* a, const int* b, int n) {
+	for (int i = 0; i < n; i++) {
+		dst[i] = (int) ((unsigned) a[i] + (unsigned) b[i]);
+	}
+}
+
+static int sum_scalar(const int* src, int n) {
+	unsigned sum = 0;
+	for (int i = 0; i < n; i++) {
+		sum += (unsigned) src[i];
+	}
+	return (int) sum;
+}
+
+static int max_scalar(const int* src, int n, int init) {
+	int max = init;
+	for (int i = 0; i < n; i++) {
+		if (src[i] > max) {
+			max = src[i];
+		}
+	}
+	return max;
+}
+
+#ifdef X86_KERNELS
+
+// The vector loops handle whole vectors and leave the rest to the scalar kernels.
+// Every kernel loads its inputs before storing, so a destination that's also a
+// source is fine (the loop only ever touches element i in iteration i)
+
+static void fill_sse2(int* dst, int value, int n) {
+	__m128i v = _mm_set1_epi32(value);
+	int i = 0;
+	for (; i + 4 <= n; i += 4) {
+		_mm_storeu_si128((__m128i*) (dst + i), v);
+	}
+	fill_scalar(dst + i, value, n - i);
+}
+
+// SSE2 only multiplies the even lanes into 64-bit products, so the odd lanes are
+// shifted down and both halves are shuffled back together
+static inline __m128i mullo_sse2(__m128i a, __m128i b) {
+	__m128i even = _mm_mul_epu32(a, b);
+	__m128i odd = _mm_mul_epu32(_mm_srli_epi64(a, 32), _mm_srli_epi64(b, 32));
+	return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)),
+	                          _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+}
+
+static void scale_sse2(int* dst, const int* src, int factor, int n) {
+	__m128i f = _mm_set1_epi32(factor);
+	int i = 0;
+	for (; i + 4 <= n; i += 4) {
+		__m128i x = _mm_loadu_si128((const __m128i*) (src + i));
+		_mm_storeu_si128((__m128i*) (dst + i), mullo_sse2(x, f));
+	}
+	scale_scalar(dst + i, src + i, factor, n - i);
+}
+
+static void add_sse2(int* dst, const int* a, const int* b, int n) {
+	int i = 0;
+	for (; i + 4 <= n; i += 4) {
+		__m128i x = _mm_loadu_si128((const __m128i*) (a + i));
+		__m128i y = _mm_loadu_si128((const __m128i*) (b + i));
+		_mm_storeu_si128((__m128i*) (dst + i), _mm_add_epi32(x, y));
+	}
+	add_scalar(dst + i, a + i, b + i, n - i);
+}
+
+// Addition modulo 2^32 doesn't depend on the order, so the lanes can be summed apart
+static int sum_sse2(const int* src, int n) {
+	__m128i acc = _mm_setzero_si128();
+	int i = 0;
+	for (; i + 4 <= n; i += 4) {
+		acc = _mm_add_epi32(acc, _mm_loadu_si128((const __m128i*) (src + i)));
+	}
+
+	int lanes[4];
+	_mm_storeu_si128((__m128i*) lanes, acc);
+	return (int) ((unsigned) sum_scalar(lanes, 4) + (unsigned) sum_scalar(src + i, n - i));
+}
+
+// SSE2 has no 32-bit max, so the larger lanes are picked with a comparison mask
+static int max_sse2(const int* src, int n, int init) {
+	__m128i acc = _mm_set1_epi32(init);
+	int i = 0;
+	for (; i + 4 <= n; i += 4) {
+		__m128i x = _mm_loadu_si128((const __m128i*) (src + i));
+		__m128i greater = _mm_cmpgt_epi32(x, acc);
+		acc = _mm_or_si128(_mm_and_si128(greater, x), _mm_andnot_si128(greater, acc));
+	}
+
+	int lanes[4];
+	_mm_storeu_si128((__m128i*) lanes, acc);
+	return max_scalar(src + i, n - i, max_scalar(lanes, 4, init));
+}
+
+__attribute__((target("avx2")))
+static void fill_avx2(int* dst, int value, int n) {
+	__m256i v = _mm256_set1_epi32(value);
+	int i = 0;
+	for (; i + 8 <= n; i += 8) {
+		_mm256_storeu_si256((__m256i*) (dst + i), v);
+	}
+	fill_scalar(dst + i, value, n - i);
+}
+
+__attribute__((target("avx2")))
+static void scale_avx2(int* dst, const int* src, int factor, int n) {
+	__m256i f = _mm256_set1_epi32(factor);
+	int i = 0;
+	for (; i + 8 <= n; i += 8) {
+		__m256i x = _mm256_loadu_si256((const __m256i*) (src + i));
+		_mm256_storeu_si256((__m256i*) (dst + i), _mm256_mullo_epi32(x, f));
+	}
+	scale_scalar(dst + i, src + i, factor, n - i);
+}
+
+__attribute__((target("avx2")))
+static void add_avx2(int* dst, const int* a, const int* b, int n) {
+	int i = 0;
+	for (; i + 8 <= n; i += 8) {
+		__m256i x = _mm256_loadu_si256((const __m256i*) (a + i));
+		__m256i y = _mm256_loadu_si256((const __m256i*) (b + i));
+		_mm256_storeu_si256((__m256i*) (dst + i), _mm256_add_epi32(x, y));
+	}
+	add_scalar(dst + i, a + i, b + i, n - i);
+}
+
+__attribute__((target("avx2")))
+static int sum_avx2(const int* src, int n) {
+	__m256i acc = _mm256_setzero_si256();
+	int i = 0;
+	for (; i + 8 <= n; i += 8) {
+		acc = _mm256_add_epi32(acc, _mm256_loadu_si256((const __m256i*) (src + i)));
+	}
+
+	int lanes[8];
+	_mm256_storeu_si256((__m256i*) lanes, acc);
+	return (int) ((unsigned) sum_scalar(lanes, 8) + (unsigned) sum_scalar(src + i, n - i));
+}
+
+__attribute__((target("avx2")))
+static int max_avx2(const int* src, int n, int init) {
+	__m256i acc = _mm256_set1_epi32(init);
+	int i = 0;
+	for (; i + 8 <= n; i += 8) {
+		acc = _mm256_max_epi32(acc, _mm256_loadu_si256((const __m256i*) (src + i)));
+	}
+
+	int lanes[8];
+	_mm256_storeu_si256((__m256i*) lanes, acc);
+	return max_scalar(src + i, n - i, max_scalar(lanes, 8, init));
+}
+
+#endif // X86_KERNELS
+
+// This is used as a wrapper for the kernels that were picked for this CPU. Workers
+// of parallel loops can get here at the same time, so they're only picked once
+static Kernels kernels;
+static pthread_once_t kernels_once = PTHREAD_ONCE_INIT;
+
+static void select_kernels(void) {
+	kernels = (Kernels) { "scalar", fill_scalar, scale_scalar, add_scalar, sum_scalar, max_scalar };
+
+#ifdef X86_KERNELS
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2")) {
+		kernels = (Kernels) { "avx2", fill_avx2, scale_avx2, add_avx2, sum_avx2, max_avx2 };
+	} else {
+		kernels = (Kernels) { "sse2", fill_sse2, scale_sse2, add_sse2, sum_sse2, max_sse2 };
+	}
+#endif
+}
+
+const char* kernel_isa(void) {
+	pthread_once(&kernels_once, select_kernels);
+	return kernels.isa;
+}
+
+bool run_idiom(Idiom* idiom, int* vars, ArrayDesc* arrays) {
+	pthread_once(&kernels_once, select_kernels);
+
+	int start = vars[idiom->counter];
+	int limit = operand_value(idiom->limit, vars);
+
+	// The loop wouldn't run at all
+	if (start >= limit) {
+		return true;
+	}
+
+	// Arrays that aren't bound have size 0, so this also rejects them
+	bool writes_array = idiom->type != IDIOM_SUM && idiom->type != IDIOM_MAX;
+	if (start < 0 || (writes_array && !fits(arrays, idiom->target, limit)) ||
+	    (idiom->type != IDIOM_FILL && !fits(arrays, idiom->src1, limit)) ||
+	    (idiom->type == IDIOM_ADD && !fits(arrays, idiom->src2, limit))) {
+		return false;
+	}
+
+	int n = limit - start;
+	int* dst = writes_array ? arrays[idiom->target].elems + start : NULL;
+	int* src1 = idiom->type != IDIOM_FILL ? arrays[idiom->src1].elems + start : NULL;
+
+	switch (idiom->type) {
+		case IDIOM_FILL:
+			kernels.fill(dst, operand_value(idiom->value, vars), n);
+			break;
+
+		// libc's memmove is already as wide as the CPU allows
+		case IDIOM_COPY:
+			memmove(dst, src1, n * sizeof(int));
+			break;
+
+		case IDIOM_SCALE:
+			kernels.scale(dst, src1, operand_value(idiom->value, vars), n);
+			break;
+
+		case IDIOM_ADD:
+			kernels.add(dst, src1, arrays[idiom->src2].elems + start, n);
+			break;
+
+		case IDIOM_SUM:
+			vars[idiom->target] = (int) ((unsigned) vars[idiom->target] + (unsigned) kernels.sum(src1, n));
+			break;
+
+		case IDIOM_MAX:
+			vars[idiom->target] = kernels.max(src1, n, vars[idiom->target]);
+			break;
+	}
+
+	vars[idiom->counter] = limit;
+	return true;
+}
+
+static int operand_value(Operand operand, int* vars) {
+	return operand.is_var ? vars[operand.value] : operand.value;
+}
+
+static bool fits(ArrayDesc* arrays, int slot, int limit) {
+	return limit <= arrays[slot].size;
+}
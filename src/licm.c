@@ -0,0 +1,722 @@
+#include <stdio.h>
+#include <assert.h>
+#include <stdlib.h>
+#include <stdbool.h>
+
+#include "vector.h"
+
+#include "stmt.h"
+#include "expr.h"
+#include "token.h"
+#include "resolver.h"
+#include "licm.h"
+
+#define TEMP_NAME_LEN 32
+#define NO_SLOT (-1)
+
+// A multiplication of an induction variable by a loop invariant, which is kept in
+// a temporary that's advanced whenever the induction variable is
+typedef struct reduction {
+	int iv;
+	int step; // What the induction variable is advanced by
+	Expr factor; // A literal or a variable that the loop never writes
+	Expr temp;
+} Reduction;
+
+typedef struct licm Licm;
+
+// Helper functions used by the hoisting pass (no reason to expose them)
+static void hoist_stmts(Licm* licm, Block* stmts);
+static void hoist_loop(Licm* licm, WhileStmt* stmt, StmtList* preheader);
+static void hoist_block(Licm* licm, Block* stmts, int* written, StmtList* preheader);
+static Expr hoist_expr(Licm* licm, int line, Expr expr, int* written, StmtList* preheader);
+static bool is_invariant(Licm* licm, Expr expr, int* written);
+static bool is_invariant_operand(Licm* licm, Expr expr, int* written);
+static bool equal_operands(Licm* licm, Expr a, Expr b);
+static void mark_written(Licm* licm, Block stmts, int* written);
+static void mark_lvalue(Licm* licm, Expr lvalue, int* written);
+static void reduce_stmts(Licm* licm, Block* stmts);
+static void reduce_loop(Licm* licm, WhileStmt* stmt, StmtList* preheader);
+static void reduce_block(Licm* licm, Block stmts, int* written, int* steps, StmtList* preheader,
+	Vector reductions);
+static Expr reduce_expr(Licm* licm, int line, Expr expr, int* written, int* steps,
+	StmtList* preheader, Vector reductions);
+static int induction_var(Licm* licm, Stmt* stmt, int* written, int* step);
+static Stmt create_advance(Licm* licm, int line, Reduction* reduction);
+static Expr create_temp(Licm* licm, char* prefix);
+static void fuse_copies(Licm* licm, Block* stmts);
+static bool reads_slot(Licm* licm, Expr expr, int slot);
+static void add_stmts(StmtList* dst, StmtList* src);
+static bool is_temp_assignment(Licm* licm, Stmt* stmt);
+static bool is_mixed_slot(Licm* licm, int slot);
+
+// This is used as a wrapper for the state of both loop passes
+struct licm {
+	Tree* tree;
+	Vector symbols;
+	int first_temp; // Slots from here on belong to the temporaries
+	int n_temps;
+	int n_hoisted;
+	int n_reduced;
+};
+
+int hoist_invariants(Tree* tree, Block* stmts, Vector symbols) {
+	Licm licm = {
+		.tree = tree, .symbols = symbols, .first_temp = vector_size(symbols), .n_temps = 0,
+		.n_hoisted = 0
+	};
+
+	hoist_stmts(&licm, stmts);
+	return licm.n_hoisted;
+}
+
+// Rebuilds the block, putting what's hoisted out of each loop right before it
+static void hoist_stmts(Licm* licm, Block* stmts) {
+	StmtList out;
+	init_stmt_list(&out);
+
+	for (int i = 0; i < stmts->n_stmts; i++) {
+		Stmt stmt = get_stmt(licm->tree, *stmts, i);
+
+		if (stmt.type == WHILE_STMT) {
+			StmtList preheader;
+			init_stmt_list(&preheader);
+
+			hoist_loop(licm, get_payload(licm->tree, &stmt), &preheader);
+			add_stmts(&out, &preheader);
+			free_stmt_list(&preheader);
+		} else if (stmt.type == IF_ELSE_STMT) {
+			IfElseStmt* if_else_stmt = get_payload(licm->tree, &stmt);
+			hoist_stmts(licm, &if_else_stmt->then_stmts);
+			if (if_else_stmt->has_else) {
+				hoist_stmts(licm, &if_else_stmt->else_stmts);
+			}
+		}
+
+		add_stmt(&out, stmt);
+	}
+
+	replace_block(licm->tree, stmts, out.stmts, out.n_stmts);
+	free_stmt_list(&out);
+}
+
+// Inner loops are handled first, so that what they hoisted can keep moving outwards.
+// Only assignments are created here, so stmt doesn't move
+static void hoist_loop(Licm* licm, WhileStmt* stmt, StmtList* preheader) {
+	hoist_stmts(licm, &stmt->stmts);
+
+	int n_slots = vector_size(licm->symbols);
+	int* written = calloc(n_slots + 1, sizeof(int));
+	assert(written != NULL);
+
+	mark_written(licm, stmt->stmts, written);
+	hoist_block(licm, &stmt->stmts, written, preheader);
+
+	free(written);
+}
+
+// Nested loops aren't visited, since whatever is still in them depends on a
+// variable that they (and so this loop as well) write
+static void hoist_block(Licm* licm, Block* stmts, int* written, StmtList* preheader) {
+	StmtList out;
+	init_stmt_list(&out);
+
+	for (int i = 0; i < stmts->n_stmts; i++) {
+		Stmt stmt = get_stmt(licm->tree, *stmts, i);
+
+		switch (stmt.type) {
+			// A temporary is only assigned right before the loop that reads it
+			case ASSIGNMENT_STMT: {
+				AssignmentStmt* assignment_stmt = get_payload(licm->tree, &stmt);
+				if (is_temp_assignment(licm, &stmt) &&
+				    is_invariant(licm, assignment_stmt->expr, written)) {
+					add_stmt(preheader, stmt);
+					continue;
+				}
+
+				// Hoisting adds an assignment, which may move this one
+				Expr expr = hoist_expr(licm, stmt.line, assignment_stmt->expr, written, preheader);
+				((AssignmentStmt*) get_payload(licm->tree, &stmt))->expr = expr;
+				break;
+			}
+
+			case WRITE_STMT: {
+				WriteStmt* write_stmt = get_payload(licm->tree, &stmt);
+				if (write_stmt->expr != NO_EXPR) {
+					write_stmt->expr = hoist_expr(licm, stmt.line, write_stmt->expr, written,
+						preheader);
+				}
+				break;
+			}
+
+			case WRITELN_STMT: {
+				WritelnStmt* writeln_stmt = get_payload(licm->tree, &stmt);
+				if (writeln_stmt->expr != NO_EXPR) {
+					writeln_stmt->expr = hoist_expr(licm, stmt.line, writeln_stmt->expr, written,
+						preheader);
+				}
+				break;
+			}
+
+			case IF_ELSE_STMT: {
+				IfElseStmt* if_else_stmt = get_payload(licm->tree, &stmt);
+				hoist_block(licm, &if_else_stmt->then_stmts, written, preheader);
+				if (if_else_stmt->has_else) {
+					hoist_block(licm, &if_else_stmt->else_stmts, written, preheader);
+				}
+				break;
+			}
+
+			case NEW_STMT: {
+				NewStmt* new_stmt = get_payload(licm->tree, &stmt);
+				new_stmt->size = hoist_expr(licm, stmt.line, new_stmt->size, written, preheader);
+				break;
+			}
+
+			default: break; // The rest of the statements don't have expressions worth moving
+		}
+
+		add_stmt(&out, stmt);
+	}
+
+	replace_block(licm->tree, stmts, out.stmts, out.n_stmts);
+	free_stmt_list(&out);
+}
+
+// Returns the expression that replaces expr in the loop. An expression that's
+// already been hoisted out of the same loop reuses its temporary
+static Expr hoist_expr(Licm* licm, int line, Expr expr, int* written, StmtList* preheader) {
+	if (!is_invariant(licm, expr, written)) {
+		return expr;
+	}
+
+	Binary* binary = get_binary(licm->tree, expr);
+	Expr temp = NO_EXPR;
+
+	for (int i = 0; i < preheader->n_stmts && temp == NO_EXPR; i++) {
+		AssignmentStmt* hoisted = get_payload(licm->tree, &preheader->stmts[i]);
+		Binary* other = get_binary(licm->tree, hoisted->expr);
+
+		if (other->type == binary->type && equal_operands(licm, other->left, binary->left) &&
+		    equal_operands(licm, other->right, binary->right)) {
+			temp = hoisted->lvalue;
+		}
+	}
+
+	if (temp == NO_EXPR) {
+		temp = create_temp(licm, "_licm");
+
+		int assignment_stmt = create_assignment_stmt(licm->tree, false, temp, expr);
+		add_stmt(preheader, create_stmt(line, ASSIGNMENT_STMT, assignment_stmt));
+	}
+
+	licm->n_hoisted++;
+
+	return create_var(licm->tree, get_var(licm->tree, temp)->slot);
+}
+
+// The loop may not run at all, so the expression must not be able to fail. It
+// must read at least one variable too, or there'd be nothing to gain
+static bool is_invariant(Licm* licm, Expr expr, int* written) {
+	if (EXPR_TYPE(expr) != BINARY) {
+		return false;
+	}
+
+	Binary* binary = get_binary(licm->tree, expr);
+	if (!is_invariant_operand(licm, binary->left, written) ||
+	    !is_invariant_operand(licm, binary->right, written)) {
+		return false;
+	} else if (EXPR_TYPE(binary->left) != VAR && EXPR_TYPE(binary->right) != VAR) {
+		return false;
+	}
+
+	if (binary->type == SLASH || binary->type == MODULO) {
+		if (EXPR_TYPE(binary->right) != LITERAL) {
+			return false;
+		}
+
+		// Dividing by 0 raises an error and INT_MIN / -1 traps
+		int divisor = get_literal(licm->tree, binary->right)->value;
+		return divisor != 0 && divisor != -1;
+	}
+
+	return true;
+}
+
+// Reading a name that's also used as an array may fail
+static bool is_invariant_operand(Licm* licm, Expr expr, int* written) {
+	if (EXPR_TYPE(expr) == LITERAL) {
+		return true;
+	} else if (EXPR_TYPE(expr) == VAR) {
+		int slot = get_var(licm->tree, expr)->slot;
+		return !is_mixed_slot(licm, slot) && !written[slot];
+	}
+
+	return false;
+}
+
+int reduce_strength(Tree* tree, Block* stmts, Vector symbols) {
+	Licm licm = {
+		.tree = tree, .symbols = symbols, .first_temp = vector_size(symbols), .n_temps = 0,
+		.n_reduced = 0
+	};
+
+	reduce_stmts(&licm, stmts);
+	fuse_copies(&licm, stmts);
+	return licm.n_reduced;
+}
+
+// Rebuilds the block, putting the initial values of each loop's temporaries right before it
+static void reduce_stmts(Licm* licm, Block* stmts) {
+	StmtList out;
+	init_stmt_list(&out);
+
+	for (int i = 0; i < stmts->n_stmts; i++) {
+		Stmt stmt = get_stmt(licm->tree, *stmts, i);
+
+		if (stmt.type == WHILE_STMT) {
+			StmtList preheader;
+			init_stmt_list(&preheader);
+
+			reduce_loop(licm, get_payload(licm->tree, &stmt), &preheader);
+			add_stmts(&out, &preheader);
+			free_stmt_list(&preheader);
+		} else if (stmt.type == IF_ELSE_STMT) {
+			IfElseStmt* if_else_stmt = get_payload(licm->tree, &stmt);
+			reduce_stmts(licm, &if_else_stmt->then_stmts);
+			if (if_else_stmt->has_else) {
+				reduce_stmts(licm, &if_else_stmt->else_stmts);
+			}
+		}
+
+		add_stmt(&out, stmt);
+	}
+
+	replace_block(licm->tree, stmts, out.stmts, out.n_stmts);
+	free_stmt_list(&out);
+}
+
+// The induction variables of a loop are the ones that are written exactly once in
+// it, by a statement like k = k + 1 directly in its body. Every temporary equals
+// k * M at the loop's head, so it's advanced right after k itself is
+static void reduce_loop(Licm* licm, WhileStmt* stmt, StmtList* preheader) {
+	reduce_stmts(licm, &stmt->stmts);
+
+	// A running sum would carry a value from each iteration to the next one
+	if (stmt->parallel != NULL) {
+		return;
+	}
+
+	int n_slots = vector_size(licm->symbols);
+	int* written = calloc(n_slots + 1, sizeof(int));
+	int* steps = calloc(n_slots + 1, sizeof(int)); // 0 for variables that aren't induction variables
+	assert(written != NULL && steps != NULL);
+
+	mark_written(licm, stmt->stmts, written);
+
+	for (int i = 0; i < stmt->stmts.n_stmts; i++) {
+		Stmt body_stmt = get_stmt(licm->tree, stmt->stmts, i);
+
+		int step;
+		int iv = induction_var(licm, &body_stmt, written, &step);
+		if (iv != NO_SLOT) {
+			steps[iv] = step;
+		}
+	}
+
+	Vector reductions = vector_create(free);
+	reduce_block(licm, stmt->stmts, written, steps, preheader, reductions);
+
+	if (vector_size(reductions) > 0) {
+		StmtList out;
+		init_stmt_list(&out);
+
+		for (int i = 0; i < stmt->stmts.n_stmts; i++) {
+			Stmt body_stmt = get_stmt(licm->tree, stmt->stmts, i);
+			add_stmt(&out, body_stmt);
+
+			int step;
+			int iv = induction_var(licm, &body_stmt, written, &step);
+
+			int n_reductions = vector_size(reductions);
+			for (int j = 0; j < n_reductions; j++) {
+				Reduction* reduction = vector_get(reductions, j);
+				if (iv != NO_SLOT && reduction->iv == iv) {
+					add_stmt(&out, create_advance(licm, body_stmt.line, reduction));
+				}
+			}
+		}
+
+		replace_block(licm->tree, &stmt->stmts, out.stmts, out.n_stmts);
+		free_stmt_list(&out);
+	}
+
+	vector_destroy(reductions);
+	free(written);
+	free(steps);
+}
+
+// Unlike hoisting, this also looks inside nested loops, as the temporaries keep
+// their value everywhere in the loop except right between k's update and their own
+static void reduce_block(Licm* licm, Block stmts, int* written, int* steps, StmtList* preheader,
+                         Vector reductions) {
+	for (int i = 0; i < stmts.n_stmts; i++) {
+		Stmt stmt = get_stmt(licm->tree, stmts, i);
+
+		switch (stmt.type) {
+			// Reducing adds an assignment, which may move this one
+			case ASSIGNMENT_STMT: {
+				AssignmentStmt* assignment_stmt = get_payload(licm->tree, &stmt);
+				Expr expr = reduce_expr(licm, stmt.line, assignment_stmt->expr, written, steps,
+					preheader, reductions);
+				((AssignmentStmt*) get_payload(licm->tree, &stmt))->expr = expr;
+				break;
+			}
+
+			case WRITE_STMT: {
+				WriteStmt* write_stmt = get_payload(licm->tree, &stmt);
+				if (write_stmt->expr != NO_EXPR) {
+					write_stmt->expr = reduce_expr(licm, stmt.line, write_stmt->expr, written,
+						steps, preheader, reductions);
+				}
+				break;
+			}
+
+			case WRITELN_STMT: {
+				WritelnStmt* writeln_stmt = get_payload(licm->tree, &stmt);
+				if (writeln_stmt->expr != NO_EXPR) {
+					writeln_stmt->expr = reduce_expr(licm, stmt.line, writeln_stmt->expr, written,
+						steps, preheader, reductions);
+				}
+				break;
+			}
+
+			case WHILE_STMT:
+				reduce_block(licm, ((WhileStmt*) get_payload(licm->tree, &stmt))->stmts, written,
+					steps, preheader, reductions);
+				break;
+
+			case IF_ELSE_STMT: {
+				IfElseStmt* if_else_stmt = get_payload(licm->tree, &stmt);
+				reduce_block(licm, if_else_stmt->then_stmts, written, steps, preheader, reductions);
+				if (if_else_stmt->has_else) {
+					reduce_block(licm, if_else_stmt->else_stmts, written, steps, preheader,
+						reductions);
+				}
+				break;
+			}
+
+			case NEW_STMT: {
+				NewStmt* new_stmt = get_payload(licm->tree, &stmt);
+				new_stmt->size = reduce_expr(licm, stmt.line, new_stmt->size, written, steps,
+					preheader, reductions);
+				break;
+			}
+
+			default: break; // The rest of the statements don't have expressions worth reducing
+		}
+	}
+}
+
+// Returns the expression that replaces expr in the loop
+static Expr reduce_expr(Licm* licm, int line, Expr expr, int* written, int* steps,
+	StmtList* preheader, Vector reductions) {
+	if (EXPR_TYPE(expr) != BINARY || get_binary(licm->tree, expr)->type != STAR) {
+		return expr;
+	}
+
+	Binary* binary = get_binary(licm->tree, expr);
+	Expr iv_expr = binary->left;
+	Expr factor = binary->right;
+	if (EXPR_TYPE(iv_expr) != VAR || steps[get_var(licm->tree, iv_expr)->slot] == 0) {
+		iv_expr = binary->right;
+		factor = binary->left;
+	}
+
+	if (EXPR_TYPE(iv_expr) != VAR || steps[get_var(licm->tree, iv_expr)->slot] == 0 ||
+	    !is_invariant_operand(licm, factor, written)) {
+		return expr;
+	}
+
+	// Advancing by a variable factor times anything but 1 would need another temporary
+	int iv = get_var(licm->tree, iv_expr)->slot;
+	if (EXPR_TYPE(factor) == VAR && steps[iv] != 1 && steps[iv] != -1) {
+		return expr;
+	}
+
+	Reduction* reduction = NULL;
+
+	int n_reductions = vector_size(reductions);
+	for (int i = 0; i < n_reductions && reduction == NULL; i++) {
+		Reduction* other = vector_get(reductions, i);
+		if (other->iv == iv && equal_operands(licm, other->factor, factor)) {
+			reduction = other;
+		}
+	}
+
+	if (reduction == NULL) {
+		reduction = malloc(sizeof(Reduction));
+		assert(reduction != NULL);
+
+		reduction->iv = iv;
+		reduction->step = steps[iv];
+		reduction->factor = factor;
+		reduction->temp = create_temp(licm, "_sr");
+		vector_add(reductions, reduction);
+
+		// The multiplication itself computes the temporary's initial value
+		int assignment_stmt = create_assignment_stmt(licm->tree, false, reduction->temp, expr);
+		add_stmt(preheader, create_stmt(line, ASSIGNMENT_STMT, assignment_stmt));
+	}
+
+	licm->n_reduced++;
+
+	return create_var(licm->tree, get_var(licm->tree, reduction->temp)->slot);
+}
+
+// Returns the variable that the statement advances by a constant step, if it's an
+// induction variable of the loop whose writes are counted in written, or NO_SLOT
+static int induction_var(Licm* licm, Stmt* stmt, int* written, int* step) {
+	if (stmt->type != ASSIGNMENT_STMT ||
+	    ((AssignmentStmt*) get_payload(licm->tree, stmt))->is_array) {
+		return NO_SLOT;
+	}
+
+	AssignmentStmt* assignment_stmt = get_payload(licm->tree, stmt);
+	int slot = get_var(licm->tree, assignment_stmt->lvalue)->slot;
+	if (is_mixed_slot(licm, slot) || written[slot] != 1 ||
+	    EXPR_TYPE(assignment_stmt->expr) != BINARY) {
+		return NO_SLOT;
+	}
+
+	Binary* binary = get_binary(licm->tree, assignment_stmt->expr);
+	Expr left = binary->left;
+	Expr right = binary->right;
+
+	bool left_is_iv = EXPR_TYPE(left) == VAR && get_var(licm->tree, left)->slot == slot;
+	bool right_is_iv = EXPR_TYPE(right) == VAR && get_var(licm->tree, right)->slot == slot;
+
+	if (binary->type == PLUS && left_is_iv && EXPR_TYPE(right) == LITERAL) {
+		*step = get_literal(licm->tree, right)->value;
+	} else if (binary->type == PLUS && right_is_iv && EXPR_TYPE(left) == LITERAL) {
+		*step = get_literal(licm->tree, left)->value;
+	} else if (binary->type == MINUS && left_is_iv && EXPR_TYPE(right) == LITERAL) {
+		*step = (int) (0u - (unsigned) get_literal(licm->tree, right)->value);
+	} else {
+		return NO_SLOT;
+	}
+
+	return *step != 0 ? slot : NO_SLOT;
+}
+
+// temp = temp + step * factor, which wraps around exactly like k * M does
+static Stmt create_advance(Licm* licm, int line, Reduction* reduction) {
+	Expr delta;
+	TokenType op = PLUS;
+
+	if (EXPR_TYPE(reduction->factor) == LITERAL) {
+		int factor = get_literal(licm->tree, reduction->factor)->value;
+		delta = create_literal(licm->tree, (int) ((unsigned) reduction->step * (unsigned) factor));
+	} else {
+		delta = create_var(licm->tree, get_var(licm->tree, reduction->factor)->slot);
+
+		if (reduction->step == -1) {
+			op = MINUS;
+		}
+	}
+
+	int slot = get_var(licm->tree, reduction->temp)->slot;
+	Expr use = create_var(licm->tree, slot);
+	Expr lvalue = create_var(licm->tree, slot);
+
+	Expr expr = create_binary(licm->tree, op, use, delta);
+	return create_stmt(line, ASSIGNMENT_STMT,
+		create_assignment_stmt(licm->tree, false, lvalue, expr));
+}
+
+// Both passes leave copies like y = _sr0 behind, which are often followed by
+// y = y + j. The pair becomes y = _sr0 + j, so that the derived index costs a
+// single statement again
+static void fuse_copies(Licm* licm, Block* stmts) {
+	StmtList out;
+	init_stmt_list(&out);
+
+	for (int i = 0; i < stmts->n_stmts; i++) {
+		Stmt stmt = get_stmt(licm->tree, *stmts, i);
+
+		if (stmt.type == WHILE_STMT) {
+			fuse_copies(licm, &((WhileStmt*) get_payload(licm->tree, &stmt))->stmts);
+		} else if (stmt.type == IF_ELSE_STMT) {
+			IfElseStmt* if_else_stmt = get_payload(licm->tree, &stmt);
+			fuse_copies(licm, &if_else_stmt->then_stmts);
+			if (if_else_stmt->has_else) {
+				fuse_copies(licm, &if_else_stmt->else_stmts);
+			}
+		}
+
+		if (i + 1 == stmts->n_stmts || stmt.type != ASSIGNMENT_STMT ||
+		    get_stmt(licm->tree, *stmts, i + 1).type != ASSIGNMENT_STMT) {
+			add_stmt(&out, stmt);
+			continue;
+		}
+
+		Stmt next_stmt = get_stmt(licm->tree, *stmts, i + 1);
+		AssignmentStmt* copy = get_payload(licm->tree, &stmt);
+		AssignmentStmt* next = get_payload(licm->tree, &next_stmt);
+		if (copy->is_array || next->is_array || EXPR_TYPE(next->expr) != BINARY) {
+			add_stmt(&out, stmt);
+			continue;
+		}
+
+		// The copy can't fail, so dropping it doesn't change where errors are raised
+		int slot = get_var(licm->tree, copy->lvalue)->slot;
+		Expr value = copy->expr;
+		bool is_copy = EXPR_TYPE(value) == LITERAL ||
+			(EXPR_TYPE(value) == VAR && !is_mixed_slot(licm, get_var(licm->tree, value)->slot) &&
+			 !reads_slot(licm, value, slot));
+
+		Binary* binary = get_binary(licm->tree, next->expr);
+		Expr* use = NULL;
+		if (EXPR_TYPE(binary->left) == VAR && get_var(licm->tree, binary->left)->slot == slot &&
+		    !reads_slot(licm, binary->right, slot)) {
+			use = &binary->left;
+		} else if (EXPR_TYPE(binary->right) == VAR &&
+		           get_var(licm->tree, binary->right)->slot == slot &&
+		           !reads_slot(licm, binary->left, slot)) {
+			use = &binary->right;
+		}
+
+		if (!is_copy || is_mixed_slot(licm, slot) ||
+		    get_var(licm->tree, next->lvalue)->slot != slot || use == NULL) {
+			add_stmt(&out, stmt);
+			continue;
+		}
+
+		// The copied value takes the place of the read, which goes away with the copy
+		copy->expr = *use;
+		*use = value;
+	}
+
+	replace_block(licm->tree, stmts, out.stmts, out.n_stmts);
+	free_stmt_list(&out);
+}
+
+static bool reads_slot(Licm* licm, Expr expr, int slot) {
+	switch (EXPR_TYPE(expr)) {
+		case LITERAL: return false;
+		case VAR: return get_var(licm->tree, expr)->slot == slot;
+		case ARRAY: return reads_slot(licm, get_array(licm->tree, expr)->index, slot);
+
+		case BINARY: {
+			Binary* binary = get_binary(licm->tree, expr);
+			return reads_slot(licm, binary->left, slot) || reads_slot(licm, binary->right, slot);
+		}
+
+		default:
+			fprintf(stderr, "Invalid expression type (this shouldn't be printed)\n");
+			exit(EXIT_FAILURE);
+	}
+}
+
+// Returns a new variable that can't clash with any name in the program, since
+// IPL names have to start with a letter
+static Expr create_temp(Licm* licm, char* prefix) {
+	char name[TEMP_NAME_LEN];
+	snprintf(name, TEMP_NAME_LEN, "%s%d", prefix, licm->n_temps++);
+
+	return create_var(licm->tree, add_var_symbol(licm->symbols, name));
+}
+
+static bool equal_operands(Licm* licm, Expr a, Expr b) {
+	if (EXPR_TYPE(a) != EXPR_TYPE(b)) {
+		return false;
+	} else if (EXPR_TYPE(a) == LITERAL) {
+		return get_literal(licm->tree, a)->value == get_literal(licm->tree, b)->value;
+	} else if (EXPR_TYPE(a) == VAR) {
+		return get_var(licm->tree, a)->slot == get_var(licm->tree, b)->slot;
+	}
+
+	return false;
+}
+
+static void mark_written(Licm* licm, Block stmts, int* written) {
+	for (int i = 0; i < stmts.n_stmts; i++) {
+		Stmt stmt = get_stmt(licm->tree, stmts, i);
+		void* payload = get_payload(licm->tree, &stmt);
+
+		switch (stmt.type) {
+			case READ_STMT: {
+				ReadStmt* read_stmt = payload;
+				mark_lvalue(licm, read_stmt->lvalue, written);
+				break;
+			}
+
+			case ASSIGNMENT_STMT: {
+				AssignmentStmt* assignment_stmt = payload;
+				mark_lvalue(licm, assignment_stmt->lvalue, written);
+				break;
+			}
+
+			case WHILE_STMT:
+				mark_written(licm, ((WhileStmt*) payload)->stmts, written);
+				break;
+
+			case IF_ELSE_STMT: {
+				IfElseStmt* if_else_stmt = payload;
+				mark_written(licm, if_else_stmt->then_stmts, written);
+				if (if_else_stmt->has_else) {
+					mark_written(licm, if_else_stmt->else_stmts, written);
+				}
+				break;
+			}
+
+			case RANDOM_STMT: {
+				RandomStmt* random_stmt = payload;
+				mark_lvalue(licm, random_stmt->lvalue, written);
+				break;
+			}
+
+			case ARG_STMT: {
+				ArgStmt* arg_stmt = payload;
+				mark_lvalue(licm, arg_stmt->lvalue, written);
+				break;
+			}
+
+			case ARG_SIZE_STMT: {
+				ArgSizeStmt* arg_size_stmt = payload;
+				mark_lvalue(licm, arg_size_stmt->lvalue, written);
+				break;
+			}
+
+			case SIZE_STMT: {
+				SizeStmt* size_stmt = payload;
+				mark_lvalue(licm, size_stmt->lvalue, written);
+				break;
+			}
+
+			default: break; // The rest of the statements don't assign to variables
+		}
+	}
+}
+
+static void mark_lvalue(Licm* licm, Expr lvalue, int* written) {
+	if (EXPR_TYPE(lvalue) == VAR) {
+		written[get_var(licm->tree, lvalue)->slot]++;
+	}
+}
+
+static void add_stmts(StmtList* dst, StmtList* src) {
+	for (int i = 0; i < src->n_stmts; i++) {
+		add_stmt(dst, src->stmts[i]);
+	}
+}
+
+static bool is_temp_assignment(Licm* licm, Stmt* stmt) {
+	AssignmentStmt* assignment_stmt = get_payload(licm->tree, stmt);
+	return !assignment_stmt->is_array &&
+	       get_var(licm->tree, assignment_stmt->lvalue)->slot >= licm->first_temp;
+}
+
+static bool is_mixed_slot(Licm* licm, int slot) {
+	return is_mixed_symbol(vector_get(licm->symbols, slot));
+}
@@ -0,0 +1,471 @@
+#include <stdio.h>
+#include <assert.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+
+#include "vector.h"
+
+#include "stmt.h"
+#include "expr.h"
+#include "token.h"
+#include "resolver.h"
+#include "optimizer.h"
+
+// The constant value of every variable at some point of the program, if it has one
+typedef struct state {
+	bool reachable;
+	bool* known;
+	int* values;
+} State;
+
+typedef struct optimizer Optimizer;
+
+// Helper functions used by the optimizer (no reason to expose them)
+static void init_optimizer(Optimizer* optimizer, Tree* tree, Vector symbols);
+static State* create_state(Optimizer* optimizer);
+static State* copy_state(Optimizer* optimizer, State* state);
+static void destroy_state(State* state);
+static void set_state(Optimizer* optimizer, State* dst, State* src);
+static void join_states(Optimizer* optimizer, State* dst, State* src);
+static void optimize_stmts(Optimizer* optimizer, Block* stmts, State* state);
+static void optimize_stmt(Optimizer* optimizer, Stmt* stmt, State* state, StmtList* out);
+static void optimize_while_stmt(Optimizer* optimizer, Stmt* stmt, State* state, StmtList* out);
+static void optimize_if_else_stmt(Optimizer* optimizer, Stmt* stmt, State* state, StmtList* out);
+static void optimize_store(Optimizer* optimizer, Expr lvalue, Expr value, State* state);
+static void kill_assigned(Optimizer* optimizer, Block stmts, State* state);
+static void kill_lvalue(Optimizer* optimizer, Expr lvalue, State* state);
+static void move_stmts(Optimizer* optimizer, StmtList* dst, Block src);
+static void fold_cond(Optimizer* optimizer, Expr cond, State* state);
+static bool is_constant_cond(Optimizer* optimizer, Expr cond, bool* outcome);
+static Expr fold_expr(Optimizer* optimizer, Expr expr, State* state);
+static bool compute(TokenType op, int left, int right, int* result);
+static bool is_mixed_slot(Optimizer* optimizer, int slot);
+
+// This is used as a wrapper for the optimizer's state
+struct optimizer {
+	Tree* tree;
+	Vector symbols;
+	int n_slots;
+	OptStats stats;
+};
+
+static void init_optimizer(Optimizer* optimizer, Tree* tree, Vector symbols) {
+	optimizer->tree = tree;
+	optimizer->symbols = symbols;
+	optimizer->n_slots = vector_size(symbols);
+	optimizer->stats = (OptStats) { .n_propagated = 0, .n_folded = 0, .n_removed = 0 };
+}
+
+OptStats optimize(Tree* tree, Block* stmts, Vector symbols) {
+	Optimizer optimizer;
+	init_optimizer(&optimizer, tree, symbols);
+
+	// Variables are implicitly initialized to 0. Names that are also used as arrays
+	// are left alone, since reading them may raise an error
+	State* state = create_state(&optimizer);
+	for (int i = 0; i < optimizer.n_slots; i++) {
+		state->known[i] = !is_mixed_slot(&optimizer, i);
+	}
+
+	optimize_stmts(&optimizer, stmts, state);
+	destroy_state(state);
+
+	return optimizer.stats;
+}
+
+static State* create_state(Optimizer* optimizer) {
+	int n = optimizer->n_slots + 1;
+
+	State* state = malloc(sizeof(State));
+	assert(state != NULL);
+
+	state->reachable = true;
+	state->known = calloc(n, sizeof(bool));
+	state->values = calloc(n, sizeof(int));
+	assert(state->known != NULL && state->values != NULL);
+
+	return state;
+}
+
+static State* copy_state(Optimizer* optimizer, State* state) {
+	State* copy = create_state(optimizer);
+	set_state(optimizer, copy, state);
+	return copy;
+}
+
+static void destroy_state(State* state) {
+	free(state->known);
+	free(state->values);
+	free(state);
+}
+
+static void set_state(Optimizer* optimizer, State* dst, State* src) {
+	int n = optimizer->n_slots + 1;
+
+	dst->reachable = src->reachable;
+	memcpy(dst->known, src->known, n * sizeof(bool));
+	memcpy(dst->values, src->values, n * sizeof(int));
+}
+
+// Keeps only the constants that both states agree on
+static void join_states(Optimizer* optimizer, State* dst, State* src) {
+	if (!src->reachable) {
+		return;
+	} else if (!dst->reachable) {
+		set_state(optimizer, dst, src);
+		return;
+	}
+
+	for (int i = 0; i < optimizer->n_slots; i++) {
+		dst->known[i] = dst->known[i] && src->known[i] && dst->values[i] == src->values[i];
+	}
+}
+
+// The block is rebuilt one statement at a time, so that the ones of a branch
+// that's always taken can be spliced in its place
+static void optimize_stmts(Optimizer* optimizer, Block* stmts, State* state) {
+	StmtList out;
+	init_stmt_list(&out);
+
+	for (int i = 0; i < stmts->n_stmts; i++) {
+		Stmt stmt = get_stmt(optimizer->tree, *stmts, i);
+		if (state->reachable) {
+			optimize_stmt(optimizer, &stmt, state, &out);
+		} else {
+			add_stmt(&out, stmt); // Code after a break or continue never runs
+		}
+	}
+
+	replace_block(optimizer->tree, stmts, out.stmts, out.n_stmts);
+	free_stmt_list(&out);
+}
+
+// Adds what's left of the statement to out
+static void optimize_stmt(Optimizer* optimizer, Stmt* stmt, State* state, StmtList* out) {
+	switch (stmt->type) {
+		case READ_STMT: {
+			ReadStmt* read_stmt = get_payload(optimizer->tree, stmt);
+			optimize_store(optimizer, read_stmt->lvalue, NO_EXPR, state);
+			break;
+		}
+
+		case ASSIGNMENT_STMT: {
+			AssignmentStmt* assignment_stmt = get_payload(optimizer->tree, stmt);
+			assignment_stmt->expr = fold_expr(optimizer, assignment_stmt->expr, state);
+			optimize_store(optimizer, assignment_stmt->lvalue, assignment_stmt->expr, state);
+			break;
+		}
+
+		case WRITE_STMT: {
+			WriteStmt* write_stmt = get_payload(optimizer->tree, stmt);
+			if (write_stmt->expr != NO_EXPR) {
+				write_stmt->expr = fold_expr(optimizer, write_stmt->expr, state);
+			}
+			break;
+		}
+
+		case WRITELN_STMT: {
+			WritelnStmt* writeln_stmt = get_payload(optimizer->tree, stmt);
+			if (writeln_stmt->expr != NO_EXPR) {
+				writeln_stmt->expr = fold_expr(optimizer, writeln_stmt->expr, state);
+			}
+			break;
+		}
+
+		case WHILE_STMT: optimize_while_stmt(optimizer, stmt, state, out); return;
+		case IF_ELSE_STMT: optimize_if_else_stmt(optimizer, stmt, state, out); return;
+
+		case RANDOM_STMT: {
+			RandomStmt* random_stmt = get_payload(optimizer->tree, stmt);
+			optimize_store(optimizer, random_stmt->lvalue, NO_EXPR, state);
+			break;
+		}
+
+		case ARG_STMT: {
+			ArgStmt* arg_stmt = get_payload(optimizer->tree, stmt);
+			arg_stmt->expr = fold_expr(optimizer, arg_stmt->expr, state);
+			optimize_store(optimizer, arg_stmt->lvalue, NO_EXPR, state);
+			break;
+		}
+
+		case ARG_SIZE_STMT: {
+			ArgSizeStmt* arg_size_stmt = get_payload(optimizer->tree, stmt);
+			optimize_store(optimizer, arg_size_stmt->lvalue, NO_EXPR, state);
+			break;
+		}
+
+		// An invalid break or continue raises an error, so nothing follows it either way
+		case BREAK_STMT:
+		case CONTINUE_STMT:
+			state->reachable = false;
+			break;
+
+		case NEW_STMT: {
+			NewStmt* new_stmt = get_payload(optimizer->tree, stmt);
+			new_stmt->size = fold_expr(optimizer, new_stmt->size, state);
+			break;
+		}
+
+		case FREE_STMT: break;
+
+		case SIZE_STMT: {
+			SizeStmt* size_stmt = get_payload(optimizer->tree, stmt);
+			optimize_store(optimizer, size_stmt->lvalue, NO_EXPR, state);
+			break;
+		}
+
+		default:
+			fprintf(stderr, "Invalid statement type (this shouldn't be printed)\n");
+			exit(EXIT_FAILURE);
+	}
+
+	add_stmt(out, *stmt);
+}
+
+// Whatever the loop assigns is unknown at its head, which is also where it's left
+// from (a break can only leave with values that the head allows as well)
+static void optimize_while_stmt(Optimizer* optimizer, Stmt* stmt, State* state, StmtList* out) {
+	WhileStmt* while_stmt = get_payload(optimizer->tree, stmt);
+
+	kill_assigned(optimizer, while_stmt->stmts, state);
+	fold_cond(optimizer, while_stmt->cond, state);
+
+	bool outcome;
+	if (is_constant_cond(optimizer, while_stmt->cond, &outcome) && !outcome) {
+		optimizer->stats.n_removed++;
+		return;
+	}
+
+	State* body = copy_state(optimizer, state);
+	optimize_stmts(optimizer, &while_stmt->stmts, body);
+	destroy_state(body);
+
+	add_stmt(out, *stmt);
+}
+
+static void optimize_if_else_stmt(Optimizer* optimizer, Stmt* stmt, State* state, StmtList* out) {
+	IfElseStmt* if_else_stmt = get_payload(optimizer->tree, stmt);
+	fold_cond(optimizer, if_else_stmt->cond, state);
+
+	// The arm that's always taken replaces the whole statement
+	bool outcome;
+	if (is_constant_cond(optimizer, if_else_stmt->cond, &outcome)) {
+		if (outcome || if_else_stmt->has_else) {
+			Block taken = outcome ? if_else_stmt->then_stmts : if_else_stmt->else_stmts;
+			optimize_stmts(optimizer, &taken, state);
+			move_stmts(optimizer, out, taken);
+		}
+
+		optimizer->stats.n_removed++;
+		return;
+	}
+
+	State* then_state = copy_state(optimizer, state);
+	optimize_stmts(optimizer, &if_else_stmt->then_stmts, then_state);
+
+	if (if_else_stmt->has_else) {
+		optimize_stmts(optimizer, &if_else_stmt->else_stmts, state);
+	}
+
+	join_states(optimizer, state, then_state);
+	destroy_state(then_state);
+
+	add_stmt(out, *stmt);
+}
+
+// value is the (already folded) expression that's stored, or NO_EXPR if it's not known
+static void optimize_store(Optimizer* optimizer, Expr lvalue, Expr value, State* state) {
+	if (EXPR_TYPE(lvalue) == ARRAY) {
+		Array* array = get_array(optimizer->tree, lvalue);
+		array->index = fold_expr(optimizer, array->index, state);
+		return;
+	}
+
+	int slot = get_var(optimizer->tree, lvalue)->slot;
+	if (value != NO_EXPR && EXPR_TYPE(value) == LITERAL && !is_mixed_slot(optimizer, slot)) {
+		state->known[slot] = true;
+		state->values[slot] = get_literal(optimizer->tree, value)->value;
+	} else {
+		state->known[slot] = false;
+	}
+}
+
+static void kill_assigned(Optimizer* optimizer, Block stmts, State* state) {
+	for (int i = 0; i < stmts.n_stmts; i++) {
+		Stmt stmt = get_stmt(optimizer->tree, stmts, i);
+		void* payload = get_payload(optimizer->tree, &stmt);
+
+		switch (stmt.type) {
+			case READ_STMT: {
+				ReadStmt* read_stmt = payload;
+				kill_lvalue(optimizer, read_stmt->lvalue, state);
+				break;
+			}
+
+			case ASSIGNMENT_STMT: {
+				AssignmentStmt* assignment_stmt = payload;
+				kill_lvalue(optimizer, assignment_stmt->lvalue, state);
+				break;
+			}
+
+			case WHILE_STMT:
+				kill_assigned(optimizer, ((WhileStmt*) payload)->stmts, state);
+				break;
+
+			case IF_ELSE_STMT: {
+				IfElseStmt* if_else_stmt = payload;
+				kill_assigned(optimizer, if_else_stmt->then_stmts, state);
+				if (if_else_stmt->has_else) {
+					kill_assigned(optimizer, if_else_stmt->else_stmts, state);
+				}
+				break;
+			}
+
+			case RANDOM_STMT: {
+				RandomStmt* random_stmt = payload;
+				kill_lvalue(optimizer, random_stmt->lvalue, state);
+				break;
+			}
+
+			case ARG_STMT: {
+				ArgStmt* arg_stmt = payload;
+				kill_lvalue(optimizer, arg_stmt->lvalue, state);
+				break;
+			}
+
+			case ARG_SIZE_STMT: {
+				ArgSizeStmt* arg_size_stmt = payload;
+				kill_lvalue(optimizer, arg_size_stmt->lvalue, state);
+				break;
+			}
+
+			case SIZE_STMT: {
+				SizeStmt* size_stmt = payload;
+				kill_lvalue(optimizer, size_stmt->lvalue, state);
+				break;
+			}
+
+			default: break; // The rest of the statements don't assign to variables
+		}
+	}
+}
+
+static void kill_lvalue(Optimizer* optimizer, Expr lvalue, State* state) {
+	if (EXPR_TYPE(lvalue) == VAR) {
+		state->known[get_var(optimizer->tree, lvalue)->slot] = false;
+	}
+}
+
+// Appends the statements of src to dst
+static void move_stmts(Optimizer* optimizer, StmtList* dst, Block src) {
+	for (int i = 0; i < src.n_stmts; i++) {
+		add_stmt(dst, get_stmt(optimizer->tree, src, i));
+	}
+}
+
+// Conditions stay comparisons (the engines expect that), only their operands are folded
+static void fold_cond(Optimizer* optimizer, Expr cond, State* state) {
+	Binary* binary = get_binary(optimizer->tree, cond);
+	binary->left = fold_expr(optimizer, binary->left, state);
+	binary->right = fold_expr(optimizer, binary->right, state);
+}
+
+static bool is_constant_cond(Optimizer* optimizer, Expr cond, bool* outcome) {
+	Binary* binary = get_binary(optimizer->tree, cond);
+	if (EXPR_TYPE(binary->left) != LITERAL || EXPR_TYPE(binary->right) != LITERAL) {
+		return false;
+	}
+
+	int left = get_literal(optimizer->tree, binary->left)->value;
+	int right = get_literal(optimizer->tree, binary->right)->value;
+
+	int result;
+	compute(binary->type, left, right, &result);
+	*outcome = result != 0;
+
+	return true;
+}
+
+// Returns the folded expression, which is a new literal if expr is replaced. Only
+// literals are created, so the pointers to the other kinds of nodes stay valid
+static Expr fold_expr(Optimizer* optimizer, Expr expr, State* state) {
+	switch (EXPR_TYPE(expr)) {
+		case LITERAL: return expr;
+
+		case VAR: {
+			int slot = get_var(optimizer->tree, expr)->slot;
+			if (!state->known[slot]) {
+				return expr;
+			}
+
+			optimizer->stats.n_propagated++;
+			return create_literal(optimizer->tree, state->values[slot]);
+		}
+
+		case ARRAY: {
+			Array* array = get_array(optimizer->tree, expr);
+			array->index = fold_expr(optimizer, array->index, state);
+			return expr;
+		}
+
+		case BINARY: {
+			Binary* binary = get_binary(optimizer->tree, expr);
+			binary->left = fold_expr(optimizer, binary->left, state);
+			binary->right = fold_expr(optimizer, binary->right, state);
+
+			if (EXPR_TYPE(binary->left) != LITERAL || EXPR_TYPE(binary->right) != LITERAL) {
+				return expr;
+			}
+
+			int left = get_literal(optimizer->tree, binary->left)->value;
+			int right = get_literal(optimizer->tree, binary->right)->value;
+
+			int result;
+			if (!compute(binary->type, left, right, &result)) {
+				return expr;
+			}
+
+			optimizer->stats.n_folded++;
+			return create_literal(optimizer->tree, result);
+		}
+
+		default:
+			fprintf(stderr, "Invalid expression type (this shouldn't be printed)\n");
+			exit(EXIT_FAILURE);
+	}
+}
+
+// Returns false if the operation has to be left for the runtime (dividing by 0 is
+// an error and INT_MIN / -1 traps), arithmetic wraps around like the engines' does
+static bool compute(TokenType op, int left, int right, int* result) {
+	switch (op) {
+		case PLUS: *result = (int) ((unsigned) left + (unsigned) right); return true;
+		case MINUS: *result = (int) ((unsigned) left - (unsigned) right); return true;
+		case STAR: *result = (int) ((unsigned) left * (unsigned) right); return true;
+
+		case SLASH:
+		case MODULO:
+			if (right == 0 || (left == INT_MIN && right == -1)) {
+				return false;
+			}
+			*result = op == SLASH ? left / right : left % right;
+			return true;
+
+		case EQUAL_EQUAL: *result = left == right; return true;
+		case BANG_EQUAL: *result = left != right; return true;
+		case LESS: *result = left < right; return true;
+		case LESS_EQUAL: *result = left <= right; return true;
+		case GREATER: *result = left > right; return true;
+		case GREATER_EQUAL: *result = left >= right; return true;
+
+		default:
+			fprintf(stderr, "Invalid operator type (this shouldn't be printed)\n");
+			exit(EXIT_FAILURE);
+	}
+}
+
+static bool is_mixed_slot(Optimizer* optimizer, int slot) {
+	return is_mixed_symbol(vector_get(optimizer->symbols, slot));
+}
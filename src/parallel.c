@@ -0,0 +1,360 @@
+#include <assert.h>
+#include <limits.h>
+#include <setjmp.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+
+#include "runtime.h"
+#include "dependence.h"
+#include "parallel.h"
+
+// Iterations that a worker takes from its own range at a time
+#define CHUNK_SIZE 16
+
+// Every worker runs the iterations of its own range in order and, once that's
+// empty, steals the upper half of the largest range that's left
+typedef struct worker {
+	pthread_mutex_t lock; // Guards the range
+	long long next;
+	long long end;
+	int* vars; // The worker's own copy of the variables
+	long long* assigned_at; // The last iteration that assigned each tracked variable
+	int* assigned; // What that iteration assigned it
+	ErrorTrap trap;
+} Worker;
+
+// Helper functions used by the thread pool (no reason to expose them)
+static void start_pool(void);
+static void* worker_main(void* arg);
+static void work(Worker* w);
+static bool take_chunk(Worker* w, long long* lo, long long* hi);
+static bool steal_range(Worker* thief);
+static void run_iterations(Worker* w, long long lo, long long hi);
+static void fail(Worker* w);
+
+// This is used as a wrapper for the thread pool's state and the loop it's running
+static struct pool {
+	int n_threads;
+	pthread_mutex_t busy; // Held by the thread whose loop is running
+	bool started;
+	Worker* workers; // The first one is the thread that calls run_parallel
+	pthread_mutex_t lock;
+	pthread_cond_t job_ready;
+	pthread_cond_t job_done;
+	int generation; // Bumped for every loop, so that the workers know to start
+	int n_busy;
+	ParallelLoop* loop;
+	LoopBody* body;
+	int n_slots;
+	long long last; // The last iteration, whose variables outlive the loop
+	int* last_vars;
+	atomic_llong failed; // The earliest iteration that failed (LLONG_MAX if none)
+	int error_status;
+	char error_msg[MAX_ERROR];
+} pool = { .n_threads = 1, .busy = PTHREAD_MUTEX_INITIALIZER };
+
+void set_threads(int n_threads) {
+	assert(!pool.started && n_threads >= 1);
+	pool.n_threads = n_threads;
+}
+
+int get_threads(void) {
+	return pool.n_threads;
+}
+
+static void start_pool(void) {
+	pool.workers = calloc(pool.n_threads, sizeof(Worker));
+	pool.last_vars = NULL;
+	assert(pool.workers != NULL);
+
+	pthread_mutex_init(&pool.lock, NULL);
+	pthread_cond_init(&pool.job_ready, NULL);
+	pthread_cond_init(&pool.job_done, NULL);
+
+	for (int t = 0; t < pool.n_threads; t++) {
+		pthread_mutex_init(&pool.workers[t].lock, NULL);
+	}
+
+	// The workers wait for loops until the program exits
+	for (int t = 1; t < pool.n_threads; t++) {
+		pthread_t thread;
+		int status = pthread_create(&thread, NULL, worker_main, &pool.workers[t]);
+		assert(status == 0);
+		pthread_detach(thread);
+	}
+
+	pool.started = true;
+}
+
+static void* worker_main(void* arg) {
+	Worker* w = arg;
+	int seen = 0;
+
+	for (;;) {
+		pthread_mutex_lock(&pool.lock);
+		while (pool.generation == seen) {
+			pthread_cond_wait(&pool.job_ready, &pool.lock);
+		}
+		seen = pool.generation;
+		pthread_mutex_unlock(&pool.lock);
+
+		work(w);
+
+		pthread_mutex_lock(&pool.lock);
+		if (--pool.n_busy == 0) {
+			pthread_cond_signal(&pool.job_done);
+		}
+		pthread_mutex_unlock(&pool.lock);
+	}
+
+	return NULL;
+}
+
+bool run_parallel(ParallelLoop* loop, int* vars, int n_slots, LoopBody* body) {
+	if (pool.n_threads == 1) {
+		return false;
+	}
+
+	int limit = loop->limit.is_var ? vars[loop->limit.value] : loop->limit.value;
+
+	// i <= n never ends for the largest n, since the counter wraps around
+	if (loop->inclusive && limit == INT_MAX) {
+		return false;
+	}
+
+	// Waking the workers up isn't worth it for a couple of iterations each
+	long long start = vars[loop->counter];
+	long long end = loop->inclusive ? (long long) limit + 1 : limit;
+	if (end - start < 2 * pool.n_threads) {
+		return false;
+	}
+
+	// Programs that run side by side (e.g. in a batch) take turns using the pool,
+	// the loops of the ones that don't get it run as usual
+	if (pthread_mutex_trylock(&pool.busy) != 0) {
+		return false;
+	}
+
+	if (!pool.started) {
+		start_pool();
+	}
+
+	pool.loop = loop;
+	pool.body = body;
+	pool.n_slots = n_slots;
+	pool.last = end - 1;
+	pool.last_vars = realloc(pool.last_vars, (n_slots + 1) * sizeof(int));
+	assert(pool.last_vars != NULL);
+	atomic_store(&pool.failed, LLONG_MAX);
+
+	// LLONG_MIN is before any iteration, i.e. no iteration of the worker's did
+	for (int t = 0; t < pool.n_threads; t++) {
+		Worker* w = &pool.workers[t];
+
+		w->assigned_at = realloc(w->assigned_at, (loop->n_tracked + 1) * sizeof(long long));
+		w->assigned = realloc(w->assigned, (loop->n_tracked + 1) * sizeof(int));
+		assert(w->assigned_at != NULL && w->assigned != NULL);
+
+		for (int i = 0; i < loop->n_tracked; i++) {
+			w->assigned_at[i] = LLONG_MIN;
+		}
+	}
+
+	long long n_iterations = end - start;
+	for (int t = 0; t < pool.n_threads; t++) {
+		Worker* w = &pool.workers[t];
+
+		w->next = start + n_iterations * t / pool.n_threads;
+		w->end = start + n_iterations * (t + 1) / pool.n_threads;
+		w->vars = body->vars(body->state, t);
+
+		// Every worker accumulates its own part of the reductions
+		memcpy(w->vars, vars, n_slots * sizeof(int));
+		for (int r = 0; r < loop->n_reductions; r++) {
+			w->vars[loop->reductions[r]] = 0;
+		}
+	}
+
+	pthread_mutex_lock(&pool.lock);
+	pool.generation++;
+	pool.n_busy = pool.n_threads - 1;
+	pthread_cond_broadcast(&pool.job_ready);
+	pthread_mutex_unlock(&pool.lock);
+
+	work(&pool.workers[0]);
+
+	pthread_mutex_lock(&pool.lock);
+	while (pool.n_busy > 0) {
+		pthread_cond_wait(&pool.job_done, &pool.lock);
+	}
+	pthread_mutex_unlock(&pool.lock);
+
+	// This goes to the caller's own trap, if it has one (the error is copied out
+	// first, since another program may take over the pool right after)
+	if (atomic_load(&pool.failed) != LLONG_MAX) {
+		char msg[MAX_ERROR];
+		int status = pool.error_status;
+		strcpy(msg, pool.error_msg);
+
+		pthread_mutex_unlock(&pool.busy);
+		report_error(status, "%s", msg);
+	}
+
+	// The iterations don't depend on each other, so everything except for the
+	// reductions ends up the way the last iteration left it
+	for (int r = 0; r < loop->n_reductions; r++) {
+		int slot = loop->reductions[r];
+
+		unsigned sum = (unsigned) vars[slot];
+		for (int t = 0; t < pool.n_threads; t++) {
+			sum += (unsigned) pool.workers[t].vars[slot];
+		}
+		pool.last_vars[slot] = (int) sum;
+	}
+
+	// A tracked variable is left by the last iteration that assigned it, or not at
+	// all, along with its stamp
+	for (int i = 0; i < loop->n_tracked; i++) {
+		long long last = LLONG_MIN;
+		int value = vars[loop->tracked[i]];
+
+		for (int t = 0; t < pool.n_threads; t++) {
+			Worker* w = &pool.workers[t];
+			if (w->assigned_at[i] > last) {
+				last = w->assigned_at[i];
+				value = w->assigned[i];
+			}
+		}
+
+		pool.last_vars[loop->tracked[i]] = value;
+		pool.last_vars[loop->stamps[i]] = last == LLONG_MIN ? vars[loop->stamps[i]] : (int) last;
+	}
+
+	memcpy(vars, pool.last_vars, n_slots * sizeof(int));
+	pthread_mutex_unlock(&pool.busy);
+	return true;
+}
+
+static void work(Worker* w) {
+	ErrorTrap* previous = set_error_trap(&w->trap);
+
+	for (;;) {
+		long long lo, hi;
+		if (!take_chunk(w, &lo, &hi) && !(steal_range(w) && take_chunk(w, &lo, &hi))) {
+			break;
+		}
+
+		if (setjmp(w->trap.env) == 0) {
+			run_iterations(w, lo, hi);
+		} else {
+			fail(w);
+		}
+	}
+
+	set_error_trap(previous);
+}
+
+static bool take_chunk(Worker* w, long long* lo, long long* hi) {
+	pthread_mutex_lock(&w->lock);
+
+	bool taken = w->next < w->end;
+	if (taken) {
+		*lo = w->next;
+		*hi = w->end - w->next > CHUNK_SIZE ? w->next + CHUNK_SIZE : w->end;
+		w->next = *hi;
+	}
+
+	pthread_mutex_unlock(&w->lock);
+	return taken;
+}
+
+static bool steal_range(Worker* thief) {
+	for (;;) {
+		Worker* victim = NULL;
+		long long most = 0;
+
+		for (int t = 0; t < pool.n_threads; t++) {
+			Worker* w = &pool.workers[t];
+
+			pthread_mutex_lock(&w->lock);
+			long long remaining = w->end - w->next;
+			pthread_mutex_unlock(&w->lock);
+
+			if (remaining > most) {
+				victim = w;
+				most = remaining;
+			}
+		}
+
+		if (victim == NULL) {
+			return false;
+		}
+
+		pthread_mutex_lock(&victim->lock);
+		long long remaining = victim->end - victim->next;
+		long long lo = victim->end - (remaining + 1) / 2;
+		long long hi = victim->end;
+		if (remaining > 0) {
+			victim->end = lo;
+		}
+		pthread_mutex_unlock(&victim->lock);
+
+		// Someone else got there first
+		if (remaining <= 0) {
+			continue;
+		}
+
+		pthread_mutex_lock(&thief->lock);
+		thief->next = lo;
+		thief->end = hi;
+		pthread_mutex_unlock(&thief->lock);
+
+		return true;
+	}
+}
+
+// The iterations after a failed one are skipped, since they'd never run
+static void run_iterations(Worker* w, long long lo, long long hi) {
+	LoopBody* body = pool.body;
+	ParallelLoop* loop = pool.loop;
+	if (lo >= atomic_load(&pool.failed)) {
+		return;
+	}
+
+	// The stamps start out past the chunk, so that the ones the chunk sets tell which
+	// tracked variables it assigned (a worker doesn't run its chunks in order)
+	for (int i = 0; i < loop->n_tracked; i++) {
+		w->vars[loop->stamps[i]] = (int) hi;
+	}
+
+	body->run(body->state, (int) (w - pool.workers), (int) lo, (int) hi);
+
+	for (int i = 0; i < loop->n_tracked; i++) {
+		int at = w->vars[loop->stamps[i]];
+		if (at >= lo && at < hi && at > w->assigned_at[i]) {
+			w->assigned_at[i] = at;
+			w->assigned[i] = w->vars[loop->tracked[i]];
+		}
+	}
+
+	if (hi == pool.last + 1) {
+		memcpy(pool.last_vars, w->vars, pool.n_slots * sizeof(int));
+	}
+}
+
+// Only the error of the earliest failing iteration is kept, as that's the one that
+// running the loop in order would raise
+static void fail(Worker* w) {
+	long long iteration = w->vars[pool.loop->counter];
+
+	pthread_mutex_lock(&pool.lock);
+	if (iteration < atomic_load(&pool.failed)) {
+		pool.error_status = w->trap.status;
+		strcpy(pool.error_msg, w->trap.msg);
+		atomic_store(&pool.failed, iteration);
+	}
+	pthread_mutex_unlock(&pool.lock);
+}
@@ -1,119 +1,151 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <assert.h>
+#include <setjmp.h>
 #include <stdbool.h>
 
-#include "vector.h"
-
 #include "stmt.h"
 #include "expr.h"
 #include "error.h"
 #include "token.h"
+#include "scanner.h"
+#include "runtime.h"
 #include "parser.h"
 
+typedef struct parser Parser;
+
 // Helper functions used by the parser (no reason to expose them)
-static void init_parser(Vector tokens);
-static void parse_stmt(void);
-static void parse_read_stmt(int line);
-static void parse_assignment_stmt(int line);
-static void parse_write_stmt(int line);
-static void parse_writeln_stmt(int line);
-static void parse_while_stmt(int line, int indent);
-static void parse_if_else_stmt(int line, int indent);
-static Vector parse_block_stmt(int line, int indent);
-static void parse_random_stmt(int line);
-static void parse_arg_size_stmt(int line);
-static void parse_arg_stmt(int line);
-static void parse_break_stmt(int line);
-static void parse_continue_stmt(int line);
-static void parse_new_stmt(int line);
-static void parse_free_stmt(int line);
-static void parse_size_stmt(int line);
-static Expr* parse_expr(void);
-static Expr* parse_rvalue(void);
-static Expr* parse_lvalue(void);
-static Token* advance_token(void);
-static Token* peek_token(void);
-static Token* previous_token(void);
-static Token* consume_token(TokenType type, bool endable);
-static bool match_token(TokenType type);
-static int compute_indentation(void);
+static void init_parser(Parser* parser, Tree* tree, TokenStream* tokens);
+static Block parse_stmts(Parser* parser);
+static void parse_stmt(Parser* parser);
+static void parse_read_stmt(Parser* parser, int line);
+static void parse_assignment_stmt(Parser* parser, int line);
+static void parse_write_stmt(Parser* parser, int line);
+static void parse_writeln_stmt(Parser* parser, int line);
+static void parse_while_stmt(Parser* parser, int line, int indent);
+static void parse_if_else_stmt(Parser* parser, int line, int indent);
+static Block parse_block_stmt(Parser* parser, int line, int indent);
+static void parse_random_stmt(Parser* parser, int line);
+static void parse_arg_size_stmt(Parser* parser, int line);
+static void parse_arg_stmt(Parser* parser, int line);
+static void parse_break_stmt(Parser* parser, int line);
+static void parse_continue_stmt(Parser* parser, int line);
+static void parse_new_stmt(Parser* parser, int line);
+static void parse_free_stmt(Parser* parser, int line);
+static void parse_size_stmt(Parser* parser, int line);
+static Expr parse_expr(Parser* parser);
+static Expr parse_rvalue(Parser* parser);
+static Expr parse_lvalue(Parser* parser);
+static Token advance_token(Parser* parser);
+static Token peek_token(Parser* parser);
+static Token previous_token(Parser* parser);
+static Token consume_token(Parser* parser, TokenType type, bool endable);
+static bool match_token(Parser* parser, TokenType type);
+static int compute_indentation(Parser* parser);
 static bool is_operator(TokenType type);
 static bool is_arithm_operator(TokenType type);
 static bool is_comp_operator(TokenType type);
-static bool reached_end(void);
+static bool reached_end(Parser* parser);
 static void syntax_error(char* msg, int line, int status);
 
 // This is used as a wrapper for the parser's state
-static struct parser {
+struct parser {
+	Tree* tree; // Where the nodes are added to
 	int curr_token;
-	Vector token_stream;
-	Vector stmts;
+	TokenStream* token_stream;
+	StmtList stmts; // The statements of every block that's being parsed, innermost last
 	int curr_indent;
 	bool return_from_block;
-} parser;
+};
 
-static void init_parser(Vector tokens) {
-	parser.token_stream = tokens;
+static void init_parser(Parser* parser, Tree* tree, TokenStream* tokens) {
+	parser->tree = tree;
+	parser->token_stream = tokens;
+	init_stmt_list(&parser->stmts);
 
-	parser.curr_token = 0;
-	parser.curr_indent = 0;
-	parser.return_from_block = false;
+	parser->curr_token = 0;
+	parser->curr_indent = 0;
+	parser->return_from_block = false;
 }
 
-Vector parse(Vector tokens) {
-	// This routine is used recursively and we only want init to be called once
-	static bool initialized = false;
+Block parse(Tree* tree, TokenStream* tokens) {
+	Parser parser;
+	init_parser(&parser, tree, tokens);
+
+	// A lexical error takes precedence over a syntax error, even if it comes later in
+	// the text (the nodes go away with the tree they were added to)
+	ErrorTrap trap;
+	ErrorTrap* previous = set_error_trap(&trap);
 
-	if (!initialized) {
-		init_parser(tokens);
-		initialized = true;
+	if (setjmp(trap.env) != 0) {
+		set_error_trap(previous);
+		free_stmt_list(&parser.stmts);
+		finish_tokens(tokens);
+		rethrow_error(&trap);
 	}
 
-	parser.stmts = vector_create(destroy_stmt);
-	while (!reached_end() && !parser.return_from_block) {
-		parse_stmt();
+	Block stmts = parse_stmts(&parser);
+	set_error_trap(previous);
+
+	free_stmt_list(&parser.stmts);
+	finish_tokens(tokens);
+
+	return stmts;
+}
+
+// Parses statements until the end of the current block, which is only stored once
+// all of them are known, so that they end up next to each other
+static Block parse_stmts(Parser* parser) {
+	int first = parser->stmts.n_stmts;
+	while (!reached_end(parser) && !parser->return_from_block) {
+		parse_stmt(parser);
 	}
 
-	return parser.stmts;
+	Block block = store_block(parser->tree, parser->stmts.stmts + first,
+		parser->stmts.n_stmts - first);
+	parser->stmts.n_stmts = first;
+	return block;
 }
 
-static void parse_stmt(void) {
-	int temp_token_pos = parser.curr_token; // Keep this in case we need to rewind
+static void parse_stmt(Parser* parser) {
+	int temp_token_pos = parser->curr_token; // Keep this in case we need to rewind
 
-	int indent = compute_indentation();
-	if (indent != parser.curr_indent) {
-		if (indent > parser.curr_indent) {
-			syntax_error("invalid indentation", previous_token()->line, EBAD_INDENT);
+	// Nothing before the statement is looked at again (a rewind never goes further)
+	release_tokens(parser->token_stream, temp_token_pos);
+
+	int indent = compute_indentation(parser);
+	if (indent != parser->curr_indent) {
+		if (indent > parser->curr_indent) {
+			syntax_error("invalid indentation", previous_token(parser).line, EBAD_INDENT);
 		}
 
 		// Rewind the stream index to parse the current statement in the proper context
-		parser.curr_token = temp_token_pos;
+		parser->curr_token = temp_token_pos;
 
-		parser.return_from_block = true;
+		parser->return_from_block = true;
 		return; // End of block
 	}
 
-	Token* token = advance_token();
-	switch (token->type) {
-		case READ: parse_read_stmt(token->line); break;
-		case IDENTIFIER: parse_assignment_stmt(token->line); break;
-		case WRITE: parse_write_stmt(token->line); break;
-		case WRITELN: parse_writeln_stmt(token->line); break;
-		case WHILE: parse_while_stmt(token->line, indent); break;
-		case IF: parse_if_else_stmt(token->line, indent); break;
-		case RANDOM: parse_random_stmt(token->line); break;
-		case BREAK: parse_break_stmt(token->line); break;
-		case CONTINUE: parse_continue_stmt(token->line); break;
-		case NEW: parse_new_stmt(token->line); break;
-		case FREE: parse_free_stmt(token->line); break;
-		case SIZE: parse_size_stmt(token->line); break;
+	Token token = advance_token(parser);
+	switch (token.type) {
+		case READ: parse_read_stmt(parser, token.line); break;
+		case IDENTIFIER: parse_assignment_stmt(parser, token.line); break;
+		case WRITE: parse_write_stmt(parser, token.line); break;
+		case WRITELN: parse_writeln_stmt(parser, token.line); break;
+		case WHILE: parse_while_stmt(parser, token.line, indent); break;
+		case IF: parse_if_else_stmt(parser, token.line, indent); break;
+		case RANDOM: parse_random_stmt(parser, token.line); break;
+		case BREAK: parse_break_stmt(parser, token.line); break;
+		case CONTINUE: parse_continue_stmt(parser, token.line); break;
+		case NEW: parse_new_stmt(parser, token.line); break;
+		case FREE: parse_free_stmt(parser, token.line); break;
+		case SIZE: parse_size_stmt(parser, token.line); break;
 
 		case ARGUMENT:
-			if (match_token(SIZE)) {
-				parse_arg_size_stmt(token->line);
+			if (match_token(parser, SIZE)) {
+				parse_arg_size_stmt(parser, token.line);
 			} else {
-				parse_arg_stmt(token->line);
+				parse_arg_stmt(parser, token.line);
 			}
 			break;
 
@@ -122,313 +154,314 @@ static void parse_stmt(void) {
 			break;
 
 		default:
-			syntax_error("unrecognized token", token->line, EBAD_TOK);
+			syntax_error("unrecognized token", token.line, EBAD_TOK);
 	}
 }
 
-static void parse_read_stmt(int line) {
-	Expr* lvalue = parse_lvalue();
-	consume_token(NEWLINE, true);
+static void parse_read_stmt(Parser* parser, int line) {
+	Expr lvalue = parse_lvalue(parser);
+	consume_token(parser, NEWLINE, true);
 
-	ReadStmt* read_stmt = create_read_stmt(lvalue->type == ARRAY, lvalue->expr);
-	vector_add(parser.stmts, create_stmt(line, READ_STMT, read_stmt));
+	int read_stmt = create_read_stmt(parser->tree, EXPR_TYPE(lvalue) == ARRAY, lvalue);
+	add_stmt(&parser->stmts, create_stmt(line, READ_STMT, read_stmt));
 }
 
-static void parse_assignment_stmt(int line) {
-	parser.curr_token--; // Unread one token so we can begin parsing an lvalue
+static void parse_assignment_stmt(Parser* parser, int line) {
+	parser->curr_token--; // Unread one token so we can begin parsing an lvalue
 
-	Expr* lvalue = parse_lvalue();
-	consume_token(EQUAL, false);
-	Expr* rhs_expr = parse_expr();
+	Expr lvalue = parse_lvalue(parser);
+	consume_token(parser, EQUAL, false);
+	Expr rhs_expr = parse_expr(parser);
 
-	if (rhs_expr->type == BINARY &&
-		  !is_arithm_operator(((Binary*) rhs_expr->expr)->type)) {
+	if (EXPR_TYPE(rhs_expr) == BINARY &&
+		  !is_arithm_operator(get_binary(parser->tree, rhs_expr)->type)) {
 		syntax_error("invalid operator in binary expression", line, EBAD_OP);
 	}
 
-	consume_token(NEWLINE, true);
-	AssignmentStmt* assignment_stmt = create_assignment_stmt(
-		lvalue->type == ARRAY, lvalue->expr, rhs_expr
+	consume_token(parser, NEWLINE, true);
+	int assignment_stmt = create_assignment_stmt(parser->tree, 
+		EXPR_TYPE(lvalue) == ARRAY, lvalue, rhs_expr
 	);
 
-	vector_add(parser.stmts, create_stmt(line, ASSIGNMENT_STMT, assignment_stmt));
+	add_stmt(&parser->stmts, create_stmt(line, ASSIGNMENT_STMT, assignment_stmt));
 }
 
-static void parse_write_stmt(int line) {
-	if (peek_token()->type == NEWLINE) {
-		consume_token(NEWLINE, true);
-		vector_add(parser.stmts, create_stmt(line, WRITE_STMT, create_write_stmt(NULL)));
+static void parse_write_stmt(Parser* parser, int line) {
+	if (peek_token(parser).type == NEWLINE) {
+		consume_token(parser, NEWLINE, true);
+		int write_stmt = create_write_stmt(parser->tree, NO_EXPR);
+		add_stmt(&parser->stmts, create_stmt(line, WRITE_STMT, write_stmt));
 	} else {
-		Expr* write_expr = parse_rvalue();
-		consume_token(NEWLINE, true);
+		Expr write_expr = parse_rvalue(parser);
+		consume_token(parser, NEWLINE, true);
 
-		WriteStmt* write_stmt = create_write_stmt(write_expr);
-		vector_add(parser.stmts, create_stmt(line, WRITE_STMT, write_stmt));
+		int write_stmt = create_write_stmt(parser->tree, write_expr);
+		add_stmt(&parser->stmts, create_stmt(line, WRITE_STMT, write_stmt));
 	}
 }
 
-static void parse_writeln_stmt(int line) {
-	if (peek_token()->type == NEWLINE) {
-		consume_token(NEWLINE, true);
-		vector_add(parser.stmts, create_stmt(line, WRITELN_STMT, create_writeln_stmt(NULL)));
+static void parse_writeln_stmt(Parser* parser, int line) {
+	if (peek_token(parser).type == NEWLINE) {
+		consume_token(parser, NEWLINE, true);
+		int writeln_stmt = create_writeln_stmt(parser->tree, NO_EXPR);
+		add_stmt(&parser->stmts, create_stmt(line, WRITELN_STMT, writeln_stmt));
 	} else {
-		Expr* writeln_expr = parse_rvalue();
-		consume_token(NEWLINE, true);
+		Expr writeln_expr = parse_rvalue(parser);
+		consume_token(parser, NEWLINE, true);
 
-		WritelnStmt* writeln_stmt = create_writeln_stmt(writeln_expr);
-		vector_add(parser.stmts, create_stmt(line, WRITELN_STMT, writeln_stmt));
+		int writeln_stmt = create_writeln_stmt(parser->tree, writeln_expr);
+		add_stmt(&parser->stmts, create_stmt(line, WRITELN_STMT, writeln_stmt));
 	}
 }
 
-static void parse_while_stmt(int line, int indent) {
-	Expr* cond = parse_expr();
-	if (cond->type != BINARY ||
-		  !is_comp_operator(((Binary*) cond->expr)->type) ) {
+static void parse_while_stmt(Parser* parser, int line, int indent) {
+	Expr cond = parse_expr(parser);
+	if (EXPR_TYPE(cond) != BINARY ||
+		  !is_comp_operator(get_binary(parser->tree, cond)->type) ) {
 		syntax_error("invalid conditional in while statement", line, EBAD_COND);
 	}
 
-	consume_token(NEWLINE, false);
+	consume_token(parser, NEWLINE, false);
 
-	WhileStmt* while_stmt = create_while_stmt(cond, parse_block_stmt(line, indent));
-	vector_add(parser.stmts, create_stmt(line, WHILE_STMT, while_stmt));
+	int while_stmt = create_while_stmt(parser->tree, cond, parse_block_stmt(parser, line, indent));
+	add_stmt(&parser->stmts, create_stmt(line, WHILE_STMT, while_stmt));
 }
 
-static void parse_if_else_stmt(int line, int indent) {
-	Expr* cond = parse_expr();
-	if (cond->type != BINARY ||
-		  !is_comp_operator(((Binary*) cond->expr)->type) ) {
+static void parse_if_else_stmt(Parser* parser, int line, int indent) {
+	Expr cond = parse_expr(parser);
+	if (EXPR_TYPE(cond) != BINARY ||
+		  !is_comp_operator(get_binary(parser->tree, cond)->type) ) {
 		syntax_error("invalid conditional in if-else statement", line, EBAD_COND);
 	}
 
-	consume_token(NEWLINE, false);
+	consume_token(parser, NEWLINE, false);
 
-	Vector then_stmts = parse_block_stmt(line, indent);
-	Vector else_stmts = NULL;
+	Block then_stmts = parse_block_stmt(parser, line, indent);
+	Block else_stmts = { .first = 0, .n_stmts = 0 };
 
-	int temp_curr_token = parser.curr_token;
-	int next_indent = compute_indentation();
+	int temp_curr_token = parser->curr_token;
+	int next_indent = compute_indentation(parser);
 
 	if (next_indent != indent) { // Next statement can only match with an outer block
 		// Fix the stream index to read the current statement in the proper context
-		parser.curr_token = temp_curr_token;
+		parser->curr_token = temp_curr_token;
 
-		IfElseStmt* if_else_stmt = create_if_else_stmt(cond, then_stmts, else_stmts);
-		vector_add(parser.stmts, create_stmt(line, IF_ELSE_STMT, if_else_stmt));
+		int if_else_stmt = create_if_else_stmt(parser->tree, cond, then_stmts, else_stmts, false);
+		add_stmt(&parser->stmts, create_stmt(line, IF_ELSE_STMT, if_else_stmt));
 		return; // End of if statement
 	}
 
-	if (match_token(ELSE)) {
-		int else_line = consume_token(NEWLINE, false)->line;
-		else_stmts = parse_block_stmt(else_line, indent);
+	bool has_else = match_token(parser, ELSE);
+	if (has_else) {
+		int else_line = consume_token(parser, NEWLINE, false).line;
+		else_stmts = parse_block_stmt(parser, else_line, indent);
 	} else {
 		// Fix the stream index to read the current statement in the proper context
-		parser.curr_token = temp_curr_token;
+		parser->curr_token = temp_curr_token;
 	}
 
-	IfElseStmt* if_else_stmt = create_if_else_stmt(cond, then_stmts, else_stmts);
-	vector_add(parser.stmts, create_stmt(line, IF_ELSE_STMT, if_else_stmt));
+	int if_else_stmt = create_if_else_stmt(parser->tree, cond, then_stmts, else_stmts, has_else);
+	add_stmt(&parser->stmts, create_stmt(line, IF_ELSE_STMT, if_else_stmt));
 }
 
-static Vector parse_block_stmt(int line, int indent) {
-	int temp_curr_indent = parser.curr_indent;
-	parser.curr_indent = indent + 1;
-
-	// We rely on the program's runtime stack to parse a block recursively and
-	// make a new vector containing the statements it contains
+static Block parse_block_stmt(Parser* parser, int line, int indent) {
+	int temp_curr_indent = parser->curr_indent;
+	parser->curr_indent = indent + 1;
 
-	Vector curr_stmts = parser.stmts;
-	Vector block_stmts = parse(parser.token_stream);
+	// We rely on the program's runtime stack to parse a block recursively, while
+	// its statements are collected after the ones of the blocks that enclose it
+	Block block_stmts = parse_stmts(parser);
 
-	// Get the state to where it was before parse()
-	parser.stmts = curr_stmts;
-	parser.curr_indent = temp_curr_indent;
+	// Get the state to where it was before parse_stmts()
+	parser->curr_indent = temp_curr_indent;
 
-	parser.return_from_block = false;
+	parser->return_from_block = false;
 
-	if (vector_size(block_stmts) == 0) {
+	if (block_stmts.n_stmts == 0) {
 		syntax_error("empty body statement", line, ENO_BODY);
 	}
 	return block_stmts;
 }
 
-static void parse_random_stmt(int line) {
-	Expr* lvalue = parse_lvalue();
-	consume_token(NEWLINE, true);
+static void parse_random_stmt(Parser* parser, int line) {
+	Expr lvalue = parse_lvalue(parser);
+	consume_token(parser, NEWLINE, true);
 
-	RandomStmt* random_stmt = create_random_stmt(lvalue->type == ARRAY, lvalue->expr);
-	vector_add(parser.stmts, create_stmt(line, RANDOM_STMT, random_stmt));
+	int random_stmt = create_random_stmt(parser->tree, EXPR_TYPE(lvalue) == ARRAY, lvalue);
+	add_stmt(&parser->stmts, create_stmt(line, RANDOM_STMT, random_stmt));
 }
 
-static void parse_arg_size_stmt(int line) {
-	Expr* lvalue = parse_lvalue();
-	consume_token(NEWLINE, true);
+static void parse_arg_size_stmt(Parser* parser, int line) {
+	Expr lvalue = parse_lvalue(parser);
+	consume_token(parser, NEWLINE, true);
 
-	ArgSizeStmt* arg_size_stmt = create_arg_size_stmt(lvalue->type == ARRAY, lvalue->expr);
-	vector_add(parser.stmts, create_stmt(line, ARG_SIZE_STMT, arg_size_stmt));
+	int arg_size_stmt = create_arg_size_stmt(parser->tree, EXPR_TYPE(lvalue) == ARRAY, lvalue);
+	add_stmt(&parser->stmts, create_stmt(line, ARG_SIZE_STMT, arg_size_stmt));
 }
 
-static void parse_arg_stmt(int line) {
-	Expr* index_expr = parse_rvalue();
-	Expr* lvalue = parse_lvalue();
-	consume_token(NEWLINE, true);
+static void parse_arg_stmt(Parser* parser, int line) {
+	Expr index_expr = parse_rvalue(parser);
+	Expr lvalue = parse_lvalue(parser);
+	consume_token(parser, NEWLINE, true);
 
-	ArgStmt* arg_stmt = create_arg_stmt(index_expr, lvalue->type == ARRAY, lvalue->expr);
-	vector_add(parser.stmts, create_stmt(line, ARG_STMT, arg_stmt));
+	int arg_stmt = create_arg_stmt(parser->tree, index_expr, EXPR_TYPE(lvalue) == ARRAY, lvalue);
+	add_stmt(&parser->stmts, create_stmt(line, ARG_STMT, arg_stmt));
 }
 
-static void parse_break_stmt(int line) {
+static void parse_break_stmt(Parser* parser, int line) {
 	int n_loops = 1;
 
-	if (peek_token()->type == NUMBER) {
-		n_loops = consume_token(NUMBER, false)->literal;
+	if (peek_token(parser).type == NUMBER) {
+		n_loops = consume_token(parser, NUMBER, false).literal;
 		if (n_loops == 0) {
 			syntax_error("invalid loop count in break statement", line, EBAD_LOOPS);
 		}
 	}
 
-	consume_token(NEWLINE, true);
-	vector_add(parser.stmts, create_stmt(line, BREAK_STMT, create_break_stmt(n_loops)));
+	consume_token(parser, NEWLINE, true);
+	add_stmt(&parser->stmts, create_stmt(line, BREAK_STMT,
+		create_break_stmt(parser->tree, n_loops)));
 }
 
-static void parse_continue_stmt(int line) {
+static void parse_continue_stmt(Parser* parser, int line) {
 	int n_loops = 1;
 
-	if (peek_token()->type == NUMBER) {
-		n_loops = consume_token(NUMBER, false)->literal;
+	if (peek_token(parser).type == NUMBER) {
+		n_loops = consume_token(parser, NUMBER, false).literal;
 		if (n_loops == 0) {
 			syntax_error("invalid loop count in continue statement", line, EBAD_LOOPS);
 		}
 	}
 
-	consume_token(NEWLINE, true);
-	vector_add(parser.stmts, create_stmt(line, CONTINUE_STMT,
-		create_continue_stmt(n_loops)));
+	consume_token(parser, NEWLINE, true);
+	add_stmt(&parser->stmts, create_stmt(line, CONTINUE_STMT,
+		create_continue_stmt(parser->tree, n_loops)));
 }
 
-static void parse_new_stmt(int line) {
-	Token* id_token = consume_token(IDENTIFIER, false);
-	consume_token(LSBRACE, false);
-	Expr* idx_expr = parse_rvalue();
-	consume_token(RSBRACE, false);
-	consume_token(NEWLINE, true);
+static void parse_new_stmt(Parser* parser, int line) {
+	Token id_token = consume_token(parser, IDENTIFIER, false);
+	consume_token(parser, LSBRACE, false);
+	Expr idx_expr = parse_rvalue(parser);
+	consume_token(parser, RSBRACE, false);
+	consume_token(parser, NEWLINE, true);
 
-	NewStmt* new_stmt = create_new_stmt(id_token->lexeme, idx_expr);
-	vector_add(parser.stmts, create_stmt(line, NEW_STMT, new_stmt));
+	int new_stmt = create_new_stmt(parser->tree, id_token.literal, idx_expr);
+	add_stmt(&parser->stmts, create_stmt(line, NEW_STMT, new_stmt));
 }
 
-static void parse_free_stmt(int line) {
-	Token* id_token = consume_token(IDENTIFIER, false);
-	consume_token(NEWLINE, true);
+static void parse_free_stmt(Parser* parser, int line) {
+	Token id_token = consume_token(parser, IDENTIFIER, false);
+	consume_token(parser, NEWLINE, true);
 
-	vector_add(parser.stmts, create_stmt(line, FREE_STMT,
-		create_free_stmt(id_token->lexeme)));
+	add_stmt(&parser->stmts, create_stmt(line, FREE_STMT,
+		create_free_stmt(parser->tree, id_token.literal)));
 }
 
-static void parse_size_stmt(int line) {
-	Token* id_token = consume_token(IDENTIFIER, false);
-	Expr* lvalue = parse_lvalue();
-	consume_token(NEWLINE, true);
+static void parse_size_stmt(Parser* parser, int line) {
+	Token id_token = consume_token(parser, IDENTIFIER, false);
+	Expr lvalue = parse_lvalue(parser);
+	consume_token(parser, NEWLINE, true);
 
-	SizeStmt* size_stmt = create_size_stmt(
-		id_token->lexeme, lvalue->type == ARRAY, lvalue->expr
+	int size_stmt = create_size_stmt(parser->tree, 
+		id_token.literal, EXPR_TYPE(lvalue) == ARRAY, lvalue
 	);
 
-	vector_add(parser.stmts, create_stmt(line, SIZE_STMT, size_stmt));
+	add_stmt(&parser->stmts, create_stmt(line, SIZE_STMT, size_stmt));
 }
 
-static Expr* parse_expr(void) {
-	Expr* left = parse_rvalue();
-	Token* tok = peek_token();
+static Expr parse_expr(Parser* parser) {
+	Expr left = parse_rvalue(parser);
+	Token tok = peek_token(parser);
 
-	if (is_operator(tok->type)) {
-		advance_token(); // Consume the operator
-		Expr* right = parse_rvalue();
-		return create_expr(BINARY, create_binary(tok->type, left, right));
+	if (is_operator(tok.type)) {
+		advance_token(parser); // Consume the operator
+		Expr right = parse_rvalue(parser);
+		return create_binary(parser->tree, tok.type, left, right);
 	} else {
 		return left;
 	}
 }
 
-static Expr* parse_rvalue(void) {
-	Token* curr = advance_token();
+static Expr parse_rvalue(Parser* parser) {
+	Token curr = advance_token(parser);
 
-	switch (curr->type) {
+	switch (curr.type) {
 		case IDENTIFIER:
-			if (match_token(LSBRACE)) {
-				Expr* idx_expr = parse_rvalue();
-				consume_token(RSBRACE, false);
-				return create_expr(ARRAY, create_array(curr->lexeme, idx_expr));
+			if (match_token(parser, LSBRACE)) {
+				Expr idx_expr = parse_rvalue(parser);
+				consume_token(parser, RSBRACE, false);
+				return create_array(parser->tree, curr.literal, idx_expr);
 			} else {
-				return create_expr(VAR, create_var(curr->lexeme));
+				return create_var(parser->tree, curr.literal);
 			}
 
 		case NUMBER:
-			return create_expr(LITERAL, create_literal(curr->literal));
+			return create_literal(parser->tree, curr.literal);
 
 		default:
-			syntax_error("expected name or literal", curr->line, EBAD_EXPR);
-			return NULL; // Unreachable -- silences non-void function warning
+			syntax_error("expected name or literal", curr.line, EBAD_EXPR);
+			return NO_EXPR; // Unreachable -- silences non-void function warning
 	}
 }
 
-static Expr* parse_lvalue(void) {
-	Expr* lvalue = parse_rvalue();
+static Expr parse_lvalue(Parser* parser) {
+	Expr lvalue = parse_rvalue(parser);
 
-	if (lvalue->type == LITERAL || lvalue->type == BINARY) {
-		syntax_error("expected lvalue", previous_token()->line, EBAD_EXPR);
+	if (EXPR_TYPE(lvalue) == LITERAL || EXPR_TYPE(lvalue) == BINARY) {
+		syntax_error("expected lvalue", previous_token(parser).line, EBAD_EXPR);
 	}
 
 	return lvalue;
 }
 
-static Token* advance_token(void) {
-	Token* token = vector_get(parser.token_stream, parser.curr_token);
-	if (!reached_end()) {
-		parser.curr_token++;
+static Token advance_token(Parser* parser) {
+	Token token = get_token(parser->token_stream, parser->curr_token);
+	if (token.type != ENDOFFILE) {
+		parser->curr_token++;
 	}
 	return token;
 }
 
-static Token* peek_token(void) {
-	return vector_get(parser.token_stream, parser.curr_token);
+static Token peek_token(Parser* parser) {
+	return get_token(parser->token_stream, parser->curr_token);
 }
 
-static Token* previous_token(void) {
-	assert(parser.curr_token > 0);
-	return vector_get(parser.token_stream, parser.curr_token-1);
+static Token previous_token(Parser* parser) {
+	assert(parser->curr_token > 0);
+	return get_token(parser->token_stream, parser->curr_token-1);
 }
 
-static Token* consume_token(TokenType type, bool endable) {
-	Token* curr = advance_token();
+static Token consume_token(Parser* parser, TokenType type, bool endable) {
+	Token curr = advance_token(parser);
 
-	if (curr->type == ENDOFFILE) {
+	if (curr.type == ENDOFFILE) {
 		if (endable) {
 			return curr;
 		} else {
-			syntax_error("unexpected program termination", curr->line, EBAD_TERM);
+			syntax_error("unexpected program termination", curr.line, EBAD_TERM);
 		}
-	} else if (curr->type != type) {
-		syntax_error("unexpected token", curr->line, EBAD_TOK);
+	} else if (curr.type != type) {
+		syntax_error("unexpected token", curr.line, EBAD_TOK);
 	}
 
 	return curr;
 }
 
-static bool match_token(TokenType type) {
-	if (peek_token()->type != type) {
+static bool match_token(Parser* parser, TokenType type) {
+	if (peek_token(parser).type != type) {
 		return false;
 	} else {
-		if (!reached_end()) {
-			parser.curr_token++;
+		if (!reached_end(parser)) {
+			parser->curr_token++;
 		}
 		return true;
 	}
 }
 
-static int compute_indentation(void) {
+static int compute_indentation(Parser* parser) {
 	int indent = 0;
 
-	while (match_token(TAB)) {
+	while (match_token(parser, TAB)) {
 		indent++;
 	}
 
@@ -449,12 +482,10 @@ static bool is_comp_operator(TokenType type) {
 	       type == LESS_EQUAL  || type == GREATER    || type == GREATER_EQUAL;
 }
 
-static bool reached_end(void) {
-	Token* curr_tok = vector_get(parser.token_stream, parser.curr_token);
-	return curr_tok->type == ENDOFFILE;
+static bool reached_end(Parser* parser) {
+	return peek_token(parser).type == ENDOFFILE;
 }
 
 static void syntax_error(char* msg, int line, int status) {
-	fprintf(stderr, "Syntax Error: %s at line %d\n", msg, line);
-	exit(status);
+	report_error(status, "Syntax Error: %s at line %d\n", msg, line);
 }
@@ -0,0 +1,251 @@
+#include <assert.h>
+#include <stdlib.h>
+#include <stdbool.h>
+
+#include "bytecode.h"
+#include "peephole.h"
+
+typedef struct peephole Peephole;
+
+// Helper functions used by the peephole pass (no reason to expose them)
+static void init_peephole(Peephole* peephole, Program* program);
+static int fuse_elem_update(Peephole* peephole, int pc);
+static int fuse_op_into_var(Peephole* peephole, int pc);
+static void fuse_increment(Peephole* peephole, Instr* instr);
+static void fuse_compare_branch(Peephole* peephole, Instr* instr);
+static void add_instr(Peephole* peephole, Instr instr, int line, Fusion fusion);
+static bool is_jump(OpCode op);
+static bool writes_register_a(OpCode op);
+static bool is_temp(Peephole* peephole, int reg);
+static bool is_const(int reg);
+static int const_value(Peephole* peephole, int reg);
+static OpCode mirrored_jump(OpCode op);
+
+// This is used as a wrapper for the peephole pass' state
+struct peephole {
+	Program* program;
+	Instr* code; // The unfused instructions
+	int* lines;
+	int n_code;
+	bool* is_target; // Fusing across a jump target would change the program
+	int* new_pc; // Where every unfused instruction ended up
+};
+
+static void init_peephole(Peephole* peephole, Program* program) {
+	peephole->program = program;
+	peephole->code = program->code;
+	peephole->lines = program->lines;
+	peephole->n_code = program->n_code;
+
+	peephole->is_target = calloc(program->n_code + 1, sizeof(bool));
+	peephole->new_pc = malloc((program->n_code + 1) * sizeof(int));
+	assert(peephole->is_target != NULL && peephole->new_pc != NULL);
+
+	for (int pc = 0; pc < program->n_code; pc++) {
+		if (is_jump(program->code[pc].op)) {
+			peephole->is_target[program->code[pc].a] = true;
+		}
+	}
+
+	// Fusing only ever shrinks the code, so it can be rewritten in new arrays of
+	// the same size
+	program->code = malloc(program->n_code * sizeof(Instr));
+	program->lines = malloc(program->n_code * sizeof(int));
+	program->fusions = malloc(program->n_code * sizeof(Fusion));
+	assert(program->code != NULL && program->lines != NULL && program->fusions != NULL);
+	program->n_code = 0;
+}
+
+// The code generator only relies on two facts: temporaries never outlive their
+// statement, and every temporary is written once and read once
+void fuse_instructions(Program* program) {
+	Peephole peephole;
+	init_peephole(&peephole, program);
+
+	int pc = 0;
+	while (pc < peephole.n_code) {
+		peephole.new_pc[pc] = program->n_code;
+
+		int fused = fuse_elem_update(&peephole, pc);
+		if (fused == 0) {
+			fused = fuse_op_into_var(&peephole, pc);
+		}
+
+		if (fused == 0) {
+			add_instr(&peephole, peephole.code[pc], peephole.lines[pc], NO_FUSION);
+			fused = 1;
+		}
+
+		Instr* instr = &program->code[program->n_code - 1];
+		fuse_increment(&peephole, instr);
+		fuse_compare_branch(&peephole, instr);
+
+		for (int i = 1; i < fused; i++) {
+			peephole.new_pc[pc + i] = program->n_code - 1;
+		}
+		pc += fused;
+	}
+
+	for (int i = 0; i < program->n_code; i++) {
+		if (is_jump(program->code[i].op)) {
+			program->code[i].a = peephole.new_pc[program->code[i].a];
+		} else if (program->code[i].op == OP_LOOP_HEAD) {
+			program->code[i].b = peephole.new_pc[program->code[i].b];
+		}
+	}
+
+	free(peephole.code);
+	free(peephole.lines);
+	free(peephole.is_target);
+	free(peephole.new_pc);
+}
+
+// a[i] = a[i] + v compiles to GET_ELEM t1, a, i; ADD t0, t1, v; SET_ELEM a, i, t0,
+// which becomes a single element update that only checks the bounds once
+static int fuse_elem_update(Peephole* peephole, int pc) {
+	if (pc + 2 >= peephole->n_code || peephole->is_target[pc+1] || peephole->is_target[pc+2]) {
+		return 0;
+	}
+
+	Instr get = peephole->code[pc];
+	Instr op = peephole->code[pc+1];
+	Instr set = peephole->code[pc+2];
+
+	if (get.op != OP_GET_ELEM || set.op != OP_SET_ELEM ||
+	    get.b != set.a || get.c != set.b || !is_temp(peephole, get.a) || op.a != set.c) {
+		return 0;
+	}
+
+	int value;
+	if (op.op == OP_ADD && op.b == get.a) {
+		value = op.c;
+	} else if (op.op == OP_ADD && op.c == get.a) {
+		value = op.b;
+	} else if (op.op == OP_SUB && op.b == get.a) {
+		value = op.c;
+	} else {
+		return 0;
+	}
+
+	if (!is_temp(peephole, op.a) || value == get.a || value == op.a) {
+		return 0;
+	}
+
+	OpCode fused_op = op.op == OP_ADD ? OP_ADD_ELEM : OP_SUB_ELEM;
+	Instr fused = { .op = fused_op, .a = set.a, .b = set.b, .c = value };
+	add_instr(peephole, fused, peephole->lines[pc], FUSED_ELEM_UPDATE);
+
+	return 3;
+}
+
+// x = y <op> z compiles to <op> t, y, z; MOVE x, t, so the result can be produced
+// in the variable right away
+static int fuse_op_into_var(Peephole* peephole, int pc) {
+	if (pc + 1 >= peephole->n_code || peephole->is_target[pc+1]) {
+		return 0;
+	}
+
+	Instr op = peephole->code[pc];
+	Instr move = peephole->code[pc+1];
+
+	if (!writes_register_a(op.op) || move.op != OP_MOVE ||
+	    move.b != op.a || !is_temp(peephole, op.a) || is_temp(peephole, move.a)) {
+		return 0;
+	}
+
+	op.a = move.a;
+	add_instr(peephole, op, peephole->lines[pc], FUSED_OP_INTO_VAR);
+
+	return 2;
+}
+
+// x = x + c (or x = c + x, x = x - c) becomes an increment by an immediate
+static void fuse_increment(Peephole* peephole, Instr* instr) {
+	int step;
+
+	if (instr->op == OP_ADD && instr->a == instr->b && is_const(instr->c)) {
+		step = const_value(peephole, instr->c);
+	} else if (instr->op == OP_ADD && instr->a == instr->c && is_const(instr->b)) {
+		step = const_value(peephole, instr->b);
+	} else if (instr->op == OP_SUB && instr->a == instr->b && is_const(instr->c)) {
+		step = (int) -((unsigned) const_value(peephole, instr->c));
+	} else {
+		return;
+	}
+
+	*instr = (Instr) { .op = OP_INCREMENT, .a = instr->a, .b = step };
+	peephole->program->fusions[peephole->program->n_code - 1] = FUSED_INCREMENT;
+}
+
+// Comparisons with a constant compare against an immediate instead of a register
+static void fuse_compare_branch(Peephole* peephole, Instr* instr) {
+	if (instr->op < OP_JUMP_EQ || instr->op > OP_JUMP_GE) {
+		return;
+	}
+
+	if (is_const(instr->c) && !is_const(instr->b)) {
+		instr->op = OP_JUMP_EQ_IMM + (instr->op - OP_JUMP_EQ);
+		instr->c = const_value(peephole, instr->c);
+	} else if (is_const(instr->b) && !is_const(instr->c)) {
+		int value = const_value(peephole, instr->b);
+		instr->op = OP_JUMP_EQ_IMM + (mirrored_jump(instr->op) - OP_JUMP_EQ);
+		instr->b = instr->c;
+		instr->c = value;
+	} else {
+		return;
+	}
+
+	peephole->program->fusions[peephole->program->n_code - 1] = FUSED_COMPARE_BRANCH;
+}
+
+static void add_instr(Peephole* peephole, Instr instr, int line, Fusion fusion) {
+	Program* program = peephole->program;
+
+	program->code[program->n_code] = instr;
+	program->lines[program->n_code] = line;
+	program->fusions[program->n_code] = fusion;
+
+	program->n_code++;
+}
+
+// OP_KERNEL and OP_PARALLEL jump past their loop whenever they run it
+static bool is_jump(OpCode op) {
+	return (op >= OP_JUMP && op <= OP_JUMP_GE) ||
+	       (op >= OP_JUMP_EQ_IMM && op <= OP_JUMP_GE_IMM) ||
+	       op == OP_KERNEL || op == OP_PARALLEL;
+}
+
+static bool writes_register_a(OpCode op) {
+	switch (op) {
+		case OP_MOVE: case OP_ADD: case OP_SUB: case OP_MUL: case OP_DIV: case OP_MOD:
+		case OP_GET_ELEM: case OP_SIZE: case OP_READ: case OP_RANDOM: case OP_ARG:
+		case OP_ARG_SIZE:
+			return true;
+
+		default:
+			return false;
+	}
+}
+
+static bool is_temp(Peephole* peephole, int reg) {
+	return reg >= peephole->program->n_slots;
+}
+
+static bool is_const(int reg) {
+	return reg < 0;
+}
+
+static int const_value(Peephole* peephole, int reg) {
+	return peephole->program->consts[-(reg+1)];
+}
+
+// Returns the jump that's equivalent to op when its operands are swapped
+static OpCode mirrored_jump(OpCode op) {
+	switch (op) {
+		case OP_JUMP_LT: return OP_JUMP_GT;
+		case OP_JUMP_LE: return OP_JUMP_GE;
+		case OP_JUMP_GT: return OP_JUMP_LT;
+		case OP_JUMP_GE: return OP_JUMP_LE;
+		default: return op; // == and != are symmetric
+	}
+}
@@ -0,0 +1,214 @@
+#include <stdio.h>
+#include <assert.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdbool.h>
+
+#include "vector.h"
+
+#include "stmt.h"
+#include "expr.h"
+#include "resolver.h"
+
+typedef struct resolver Resolver;
+
+// Helper functions used by the resolver (no reason to expose them)
+static void resolve_stmts(Resolver* resolver, Block stmts);
+static void resolve_stmt(Resolver* resolver, Stmt* stmt);
+static void resolve_lvalue(Resolver* resolver, Expr lvalue);
+static void resolve_expr(Resolver* resolver, Expr expr);
+static void resolve_name(Resolver* resolver, int slot, bool is_array);
+static void destroy_symbol(void* symbol);
+
+// This is used as a wrapper for the resolver's state
+struct resolver {
+	Tree* tree;
+	Vector symbols;
+};
+
+Vector resolve(Tree* tree, Block stmts, Vector names) {
+	Resolver resolver = { .tree = tree, .symbols = vector_create(destroy_symbol) };
+
+	int n_names = vector_size(names);
+	for (int i = 0; i < n_names; i++) {
+		Symbol* symbol = malloc(sizeof(Symbol));
+		assert(symbol != NULL);
+
+		symbol->name = strdup(vector_get(names, i));
+		assert(symbol->name != NULL);
+
+		symbol->is_var = false;
+		symbol->is_array = false;
+
+		vector_add(resolver.symbols, symbol);
+	}
+
+	resolve_stmts(&resolver, stmts);
+	return resolver.symbols;
+}
+
+bool is_mixed_symbol(Symbol* symbol) {
+	return symbol->is_var && symbol->is_array;
+}
+
+int add_var_symbol(Vector symbols, char* name) {
+	Symbol* symbol = malloc(sizeof(Symbol));
+	assert(symbol != NULL);
+
+	symbol->name = strdup(name);
+	assert(symbol->name != NULL);
+
+	symbol->is_var = true;
+	symbol->is_array = false;
+
+	vector_add(symbols, symbol);
+	return vector_size(symbols) - 1;
+}
+
+static void resolve_stmts(Resolver* resolver, Block stmts) {
+	for (int i = 0; i < stmts.n_stmts; i++) {
+		Stmt stmt = get_stmt(resolver->tree, stmts, i);
+		resolve_stmt(resolver, &stmt);
+	}
+}
+
+static void resolve_stmt(Resolver* resolver, Stmt* stmt) {
+	switch (stmt->type) {
+		case READ_STMT: {
+			ReadStmt* read_stmt = get_payload(resolver->tree, stmt);
+			resolve_lvalue(resolver, read_stmt->lvalue);
+			break;
+		}
+
+		case ASSIGNMENT_STMT: {
+			AssignmentStmt* assignment_stmt = get_payload(resolver->tree, stmt);
+			resolve_lvalue(resolver, assignment_stmt->lvalue);
+			resolve_expr(resolver, assignment_stmt->expr);
+			break;
+		}
+
+		case WRITE_STMT: {
+			WriteStmt* write_stmt = get_payload(resolver->tree, stmt);
+			if (write_stmt->expr != NO_EXPR) {
+				resolve_expr(resolver, write_stmt->expr);
+			}
+			break;
+		}
+
+		case WRITELN_STMT: {
+			WritelnStmt* writeln_stmt = get_payload(resolver->tree, stmt);
+			if (writeln_stmt->expr != NO_EXPR) {
+				resolve_expr(resolver, writeln_stmt->expr);
+			}
+			break;
+		}
+
+		case WHILE_STMT: {
+			WhileStmt* while_stmt = get_payload(resolver->tree, stmt);
+			resolve_expr(resolver, while_stmt->cond);
+			resolve_stmts(resolver, while_stmt->stmts);
+			break;
+		}
+
+		case IF_ELSE_STMT: {
+			IfElseStmt* if_else_stmt = get_payload(resolver->tree, stmt);
+			resolve_expr(resolver, if_else_stmt->cond);
+			resolve_stmts(resolver, if_else_stmt->then_stmts);
+			if (if_else_stmt->has_else) {
+				resolve_stmts(resolver, if_else_stmt->else_stmts);
+			}
+			break;
+		}
+
+		case RANDOM_STMT: {
+			RandomStmt* random_stmt = get_payload(resolver->tree, stmt);
+			resolve_lvalue(resolver, random_stmt->lvalue);
+			break;
+		}
+
+		case ARG_STMT: {
+			ArgStmt* arg_stmt = get_payload(resolver->tree, stmt);
+			resolve_expr(resolver, arg_stmt->expr);
+			resolve_lvalue(resolver, arg_stmt->lvalue);
+			break;
+		}
+
+		case ARG_SIZE_STMT: {
+			ArgSizeStmt* arg_size_stmt = get_payload(resolver->tree, stmt);
+			resolve_lvalue(resolver, arg_size_stmt->lvalue);
+			break;
+		}
+
+		case NEW_STMT: {
+			NewStmt* new_stmt = get_payload(resolver->tree, stmt);
+			resolve_name(resolver, new_stmt->slot, true);
+			resolve_expr(resolver, new_stmt->size);
+			break;
+		}
+
+		case FREE_STMT: {
+			FreeStmt* free_stmt = get_payload(resolver->tree, stmt);
+			resolve_name(resolver, free_stmt->slot, true);
+			break;
+		}
+
+		case SIZE_STMT: {
+			SizeStmt* size_stmt = get_payload(resolver->tree, stmt);
+			resolve_name(resolver, size_stmt->slot, true);
+			resolve_lvalue(resolver, size_stmt->lvalue);
+			break;
+		}
+
+		case BREAK_STMT:
+		case CONTINUE_STMT:
+			break;
+
+		default:
+			fprintf(stderr, "Invalid statement type (this shouldn't be printed)\n");
+			exit(EXIT_FAILURE);
+	}
+}
+
+static void resolve_lvalue(Resolver* resolver, Expr lvalue) {
+	if (EXPR_TYPE(lvalue) == ARRAY) {
+		Array* array = get_array(resolver->tree, lvalue);
+		resolve_name(resolver, array->slot, true);
+		resolve_expr(resolver, array->index);
+	} else {
+		resolve_name(resolver, get_var(resolver->tree, lvalue)->slot, false);
+	}
+}
+
+static void resolve_expr(Resolver* resolver, Expr expr) {
+	switch (EXPR_TYPE(expr)) {
+		case LITERAL: break;
+		case VAR:
+		case ARRAY: resolve_lvalue(resolver, expr); break;
+
+		case BINARY:
+			resolve_expr(resolver, get_binary(resolver->tree, expr)->left);
+			resolve_expr(resolver, get_binary(resolver->tree, expr)->right);
+			break;
+
+		default:
+			fprintf(stderr, "Invalid expression type (this shouldn't be printed)\n");
+			exit(EXIT_FAILURE);
+	}
+}
+
+static void resolve_name(Resolver* resolver, int slot, bool is_array) {
+	Symbol* symbol = vector_get(resolver->symbols, slot);
+	if (is_array) {
+		symbol->is_array = true;
+	} else {
+		symbol->is_var = true;
+	}
+}
+
+static void destroy_symbol(void* symbol) {
+	assert(symbol != NULL);
+
+	Symbol* symboll = (Symbol*) symbol;
+	free(symboll->name);
+	free(symboll);
+}
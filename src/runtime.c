@@ -0,0 +1,51 @@
+#include <stdio.h>
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stdlib.h>
+
+#include "runtime.h"
+
+static _Thread_local ErrorTrap* error_trap;
+
+void report_error(int status, const char* format, ...) {
+	va_list args;
+	va_start(args, format);
+
+	if (error_trap != NULL) {
+		vsnprintf(error_trap->msg, MAX_ERROR, format, args);
+		va_end(args);
+
+		error_trap->status = status;
+		longjmp(error_trap->env, 1);
+	}
+
+	vfprintf(stderr, format, args);
+	va_end(args);
+	exit(status);
+}
+
+void runtime_error(char* msg, int line, int status) {
+	report_error(status, "Runtime Error: %s at line %d\n", msg, line);
+}
+
+ErrorTrap* set_error_trap(ErrorTrap* trap) {
+	ErrorTrap* previous = error_trap;
+	error_trap = trap;
+	return previous;
+}
+
+void rethrow_error(ErrorTrap* trap) {
+	report_error(trap->status, "%s", trap->msg);
+}
+
+int read_input(RunIO* io) {
+	int input;
+	if (io->in == NULL || fscanf(io->in, "%d", &input) != 1) {
+		input = 0;
+	}
+	return input;
+}
+
+int draw_random(RunIO* io) {
+	return io->seed != NULL ? rand_r(io->seed) : rand();
+}
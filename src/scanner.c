@@ -1,261 +1,671 @@
 #include <stdio.h>
 #include <assert.h>
+#include <limits.h>
+#include <setjmp.h>
 #include <string.h>
 #include <stdlib.h>
+#include <unistd.h>
+#include <pthread.h>
 #include <stdbool.h>
 
-#include "map.h"
 #include "vector.h"
 
+#include "arena.h"
 #include "error.h"
 #include "token.h"
+#include "runtime.h"
 #include "scanner.h"
-
-#define MAX_LEXEME 100
+#include "charclass.h"
+
+#define MIN_KEYWORD 2 // The lengths of the shortest and longest keywords
+#define MAX_KEYWORD 8
+#define N_KEYWORD_SLOTS 32
+#define MIN_BUCKETS 64
+#define NO_NAME -1
+#define MIN_RING 1024 // A power of 2, so that a token's index is masked into its slot
+#define FILL_BATCH 256 // Tokens scanned at a time when the parser runs out of them
+#define PUBLISH_BATCH 512 // Tokens that the scanning thread hands over at a time
+#define PIPELINE_MIN_SIZE (1 << 20) // Smaller programs aren't worth a thread
+#define PIPELINE_RING 8192 // Lets the thread get a few batches ahead of the parser
+
+typedef struct keyword {
+	const char* lexeme;
+	int length;
+	TokenType type;
+} Keyword;
+
+// Every keyword has a slot of its own under keyword_slot, which was picked so
+// that looking one up takes a single comparison
+static const Keyword keywords[N_KEYWORD_SLOTS] = {
+	[0] = { "continue", 8, CONTINUE },
+	[1] = { "random", 6, RANDOM },
+	[2] = { "break", 5, BREAK },
+	[3] = { "new", 3, NEW },
+	[4] = { "free", 4, FREE },
+	[7] = { "argument", 8, ARGUMENT },
+	[9] = { "read", 4, READ },
+	[17] = { "else", 4, ELSE },
+	[22] = { "size", 4, SIZE },
+	[23] = { "write", 5, WRITE },
+	[25] = { "while", 5, WHILE },
+	[27] = { "writeln", 7, WRITELN },
+	[31] = { "if", 2, IF },
+};
+
+typedef struct scanner Scanner;
 
 // Helper functions used by the scanner (no reason to expose them)
-static void init_scanner(FILE* fp);
-static void scan_token(void);
-static void scan_identifier(void);
-static void scan_number(void);
-static void consume_symbol(int symbol);
-static bool match_symbol(int symbol);
-static void add_token(TokenType type, char* lexeme, int literal);
+static void init_scanner(Scanner* scanner, TokenStream* tokens, const char* source, size_t size);
+static void* scan_ahead(void* arg);
+static void fill_tokens(TokenStream* tokens, int i);
+static void wait_for_tokens(TokenStream* tokens, int i);
+static void drain_tokens(TokenStream* tokens);
+static void scan_next(Scanner* scanner);
+static void scan_token(Scanner* scanner);
+static void scan_identifier(Scanner* scanner);
+static void scan_number(Scanner* scanner);
+static int keyword_slot(const char* lexeme, int length);
+static int intern_name(Scanner* scanner, const char* lexeme, int length);
+static void grow_buckets(Scanner* scanner);
+static unsigned hash_name(const char* name, int length);
+static int next_symbol(Scanner* scanner);
+static void consume_symbol(Scanner* scanner, int symbol);
+static bool match_symbol(Scanner* scanner, int symbol);
+static void add_token(Scanner* scanner, TokenType type, int literal);
+static void make_room(TokenStream* tokens);
+static void grow_ring(TokenStream* tokens);
+static void publish_tokens(TokenStream* tokens);
+static void keep_error(TokenStream* tokens, ErrorTrap* trap);
+static int parse_number(const char* digits, int length);
 static bool is_alpha(int symbol);
 static bool is_digit(int symbol);
-static bool is_alnum(int symbol);
-static bool reached_eof(void);
+static bool reached_eof(Scanner* scanner);
 
 // This is used as a wrapper for the scanner's state
-static struct scanner {
-	Vector tokens;
-	FILE* stream;
-	Map keywords;
+struct scanner {
+	TokenStream* tokens;
+	const char* source;
+	const char* curr; // The next character to be scanned
+	const char* end;
+	const CharSkippers* skip;
+	int* buckets; // Open addressing table of the names' indices (or NO_NAME)
+	int n_buckets;
 	int line;
-	int lexeme_pos;
-	char lexeme[MAX_LEXEME+1];
+	const char* lexeme; // Where the token that's being scanned starts
 	int current_indentation;
 	bool computing_indentation;
 	bool currently_at_blank_line;
-} scanner;
+	bool done; // The ENDOFFILE token has been added
+};
+
+// The tokens live in a ring that the scanner fills and the parser empties, where
+// the i-th token goes to slot i & (ring_cap - 1). When the scanner runs on a thread
+// of its own, the fields under the lock are the only ones that both sides touch
+struct token_stream {
+	Scanner scanner;
+	Vector names;
+	Arena* arena; // Where the names are allocated from
+	Token* ring;
+	int ring_cap;
+
+	// The scanner's side
+	int n_scanned;
+	int n_published;
+	int room_start; // The first slot that may still be in use, as far as it knows
+
+	// The parser's side
+	int n_visible; // The tokens that it may read without asking for more
+	int n_released;
+
+	bool pipelined;
+	bool joined;
+	pthread_t thread;
+	pthread_mutex_t lock;
+	pthread_cond_t scanned; // Signalled when tokens are published or scanning is over
+	pthread_cond_t released; // Signalled when room is freed or the parser starts waiting
+	int n_tokens; // The tokens that have been published
+	int first; // The first token that hasn't been released
+	int waiting_for; // The token that the parser is waiting for (-1 if it isn't)
+	bool finished; // The scanner got to the end of the text or ran into an error
+	bool draining; // The tokens aren't needed anymore
+	int error_status; // A lexical error that the scanner ran into (0 if none)
+	char error_msg[MAX_ERROR];
+};
+
+static void init_scanner(Scanner* scanner, TokenStream* tokens, const char* source, size_t size) {
+	scanner->tokens = tokens;
+	scanner->source = source;
+	scanner->curr = source;
+	scanner->end = source + size;
+	scanner->skip = char_skippers();
+
+	scanner->line = 1;
+	scanner->lexeme = source;
+	scanner->current_indentation = 0;
+	scanner->computing_indentation = true;
+	scanner->currently_at_blank_line = true;
+	scanner->done = false;
+
+	scanner->n_buckets = MIN_BUCKETS;
+	scanner->buckets = malloc(scanner->n_buckets * sizeof(int));
+	assert(scanner->buckets != NULL);
+
+	for (int b = 0; b < scanner->n_buckets; b++) {
+		scanner->buckets[b] = NO_NAME;
+	}
+}
+
+TokenStream* scan_tokens(const char* source, size_t size) {
+	TokenStream* tokens = calloc(1, sizeof(TokenStream));
+	assert(tokens != NULL);
+
+	// The two only overlap if there's another CPU for the thread to run on
+	bool pipelined = size >= PIPELINE_MIN_SIZE && sysconf(_SC_NPROCESSORS_ONLN) > 1;
+
+	tokens->names = vector_create(NULL);
+	tokens->arena = arena_create();
+	tokens->ring_cap = pipelined ? PIPELINE_RING : MIN_RING;
+	tokens->ring = malloc(tokens->ring_cap * sizeof(Token));
+	tokens->waiting_for = -1;
+	assert(tokens->ring != NULL);
+
+	init_scanner(&tokens->scanner, tokens, source, size);
+
+	// Scanning is left to the thread if it can be started at all
+	if (pipelined) {
+		pthread_mutex_init(&tokens->lock, NULL);
+		pthread_cond_init(&tokens->scanned, NULL);
+		pthread_cond_init(&tokens->released, NULL);
+
+		tokens->pipelined = true;
+		if (pthread_create(&tokens->thread, NULL, scan_ahead, tokens) != 0) {
+			tokens->pipelined = false;
+			pthread_mutex_destroy(&tokens->lock);
+			pthread_cond_destroy(&tokens->scanned);
+			pthread_cond_destroy(&tokens->released);
+		}
+	}
 
-static int* create_int(int value) {
-	int* new_int = malloc(sizeof(int));
-	assert(new_int != NULL);
-	*new_int = value;
-	return new_int;
+	return tokens;
 }
 
-static void destroy_token(void* item) {
-	Token* token = (Token*) item;
-	free(token->lexeme);
-	free(token);
+Token get_token(TokenStream* tokens, int i) {
+	if (i >= tokens->n_visible) {
+		if (tokens->pipelined) {
+			wait_for_tokens(tokens, i);
+		} else {
+			fill_tokens(tokens, i);
+		}
+
+		// Scanning stopped short of the token, which only a lexical error does
+		if (i >= tokens->n_visible) {
+			assert(tokens->error_status != 0);
+			report_error(tokens->error_status, "%s", tokens->error_msg);
+		}
+	}
+
+	return tokens->ring[i & (tokens->ring_cap - 1)];
 }
 
-static void init_scanner(FILE* fp) {
-	scanner.stream = fp;
-	scanner.tokens = vector_create(destroy_token);
-
-	scanner.line = 1;
-	scanner.lexeme_pos = 0;
-	scanner.current_indentation = 0;
-	scanner.computing_indentation = true;
-	scanner.currently_at_blank_line = true;
-
-	scanner.keywords = map_create(NULL, NULL, free, NULL);
-
-	map_put(scanner.keywords, "read", create_int(READ));
-	map_put(scanner.keywords, "write", create_int(WRITE));
-	map_put(scanner.keywords, "writeln", create_int(WRITELN));
-	map_put(scanner.keywords, "if", create_int(IF));
-	map_put(scanner.keywords, "else", create_int(ELSE));
-	map_put(scanner.keywords, "while", create_int(WHILE));
-	map_put(scanner.keywords, "random", create_int(RANDOM));
-	map_put(scanner.keywords, "argument", create_int(ARGUMENT));
-	map_put(scanner.keywords, "size", create_int(SIZE));
-	map_put(scanner.keywords, "break", create_int(BREAK));
-	map_put(scanner.keywords, "continue", create_int(CONTINUE));
-	map_put(scanner.keywords, "new", create_int(NEW));
-	map_put(scanner.keywords, "free", create_int(FREE));
+void release_tokens(TokenStream* tokens, int i) {
+	assert(i >= tokens->n_released);
+	tokens->n_released = i;
+
+	if (!tokens->pipelined) {
+		tokens->first = i;
+	} else if (i - tokens->first >= tokens->ring_cap / 2) {
+		// The scanning thread is told in bulk, as it mostly has room to spare anyway
+		pthread_mutex_lock(&tokens->lock);
+		tokens->first = i;
+		pthread_cond_signal(&tokens->released);
+		pthread_mutex_unlock(&tokens->lock);
+	}
 }
 
-Vector scan_tokens(FILE* fp) {
-	init_scanner(fp);
+void finish_tokens(TokenStream* tokens) {
+	drain_tokens(tokens);
 
-	while (!reached_eof()) {
-		scanner.lexeme_pos = 0;
-		scan_token();
+	if (tokens->error_status != 0) {
+		report_error(tokens->error_status, "%s", tokens->error_msg);
 	}
+}
+
+Vector token_names(TokenStream* tokens) {
+	return tokens->names;
+}
 
-	add_token(ENDOFFILE, "<EOF>", 0);
+void destroy_tokens(TokenStream* tokens) {
+	drain_tokens(tokens);
 
-	map_destroy(scanner.keywords);
-	return scanner.tokens;
+	if (tokens->pipelined) {
+		pthread_mutex_destroy(&tokens->lock);
+		pthread_cond_destroy(&tokens->scanned);
+		pthread_cond_destroy(&tokens->released);
+	}
+
+	free(tokens->scanner.buckets);
+	vector_destroy(tokens->names);
+	arena_destroy(tokens->arena);
+	free(tokens->ring);
+	free(tokens);
+}
+
+// The scanning thread, which stops at the first lexical error and leaves it to the
+// parser to report once it gets that far
+static void* scan_ahead(void* arg) {
+	TokenStream* tokens = arg;
+	Scanner* scanner = &tokens->scanner;
+
+	ErrorTrap trap;
+	set_error_trap(&trap);
+
+	if (setjmp(trap.env) == 0) {
+		while (!scanner->done) {
+			scan_next(scanner);
+			if (tokens->n_scanned - tokens->n_published >= PUBLISH_BATCH) {
+				publish_tokens(tokens);
+			}
+		}
+	}
+
+	set_error_trap(NULL);
+
+	pthread_mutex_lock(&tokens->lock);
+	if (!scanner->done) {
+		keep_error(tokens, &trap);
+	}
+	tokens->n_tokens = tokens->n_scanned;
+	tokens->finished = true;
+	pthread_cond_signal(&tokens->scanned);
+	pthread_mutex_unlock(&tokens->lock);
+
+	return NULL;
 }
 
-static void scan_token(void) {
-	int symbol = fgetc(scanner.stream);
+// Scans a batch of tokens past the i-th one on the parser's own thread
+static void fill_tokens(TokenStream* tokens, int i) {
+	Scanner* scanner = &tokens->scanner;
+	if (tokens->finished) {
+		return; // There's nothing past the ENDOFFILE or a lexical error
+	}
+
+	ErrorTrap trap;
+	ErrorTrap* previous = set_error_trap(&trap);
+
+	if (setjmp(trap.env) == 0) {
+		while (!scanner->done && tokens->n_scanned <= i + FILL_BATCH) {
+			scan_next(scanner);
+		}
+	} else {
+		keep_error(tokens, &trap);
+	}
+
+	set_error_trap(previous);
+	tokens->n_tokens = tokens->n_visible = tokens->n_scanned;
+	tokens->finished = scanner->done || tokens->error_status != 0;
+}
+
+// Blocks until the scanning thread gets past the i-th token or stops
+static void wait_for_tokens(TokenStream* tokens, int i) {
+	pthread_mutex_lock(&tokens->lock);
+
+	// The thread is told where the parser's at, or it could be waiting for room
+	// that's already been released
+	tokens->first = tokens->n_released;
+
+	while (i >= tokens->n_tokens && !tokens->finished) {
+		tokens->waiting_for = i;
+		pthread_cond_signal(&tokens->released);
+		pthread_cond_wait(&tokens->scanned, &tokens->lock);
+	}
+
+	tokens->waiting_for = -1;
+	tokens->n_visible = tokens->n_tokens;
+	pthread_mutex_unlock(&tokens->lock);
+}
+
+// Gets the scanner to the end of the text, with the tokens thrown away as it goes
+static void drain_tokens(TokenStream* tokens) {
+	if (tokens->pipelined) {
+		if (!tokens->joined) {
+			pthread_mutex_lock(&tokens->lock);
+			tokens->draining = true;
+			pthread_cond_signal(&tokens->released);
+			pthread_mutex_unlock(&tokens->lock);
+
+			pthread_join(tokens->thread, NULL);
+			tokens->joined = true;
+		}
+		return;
+	}
+
+	tokens->draining = true;
+	while (!tokens->finished) {
+		fill_tokens(tokens, tokens->n_scanned);
+	}
+}
+
+// Adds the next token (or a few of them), unless the text is over, in which case
+// it adds the ENDOFFILE
+static void scan_next(Scanner* scanner) {
+	scanner->lexeme = scanner->curr;
+
+	if (!reached_eof(scanner)) {
+		scan_token(scanner);
+	} else {
+		add_token(scanner, ENDOFFILE, 0);
+		scanner->done = true;
+	}
+}
+
+static void scan_token(Scanner* scanner) {
+	int symbol = next_symbol(scanner);
 
 	switch (symbol) {
-		case '+': add_token(PLUS, "+", 0); break;
-		case '-': add_token(MINUS, "-", 0); break;
-		case '*': add_token(STAR, "*", 0); break;
-		case '/': add_token(SLASH, "/", 0); break;
-		case '%': add_token(MODULO, "%", 0); break;
-		case '[': add_token(LSBRACE, "[", 0); break;
-		case ']': add_token(RSBRACE, "]", 0); break;
+		case '+': add_token(scanner, PLUS, 0); break;
+		case '-': add_token(scanner, MINUS, 0); break;
+		case '*': add_token(scanner, STAR, 0); break;
+		case '/': add_token(scanner, SLASH, 0); break;
+		case '%': add_token(scanner, MODULO, 0); break;
+		case '[': add_token(scanner, LSBRACE, 0); break;
+		case ']': add_token(scanner, RSBRACE, 0); break;
 
 		case '!':
-			consume_symbol('=');
-			add_token(BANG_EQUAL, "!=", 0);
+			consume_symbol(scanner, '=');
+			add_token(scanner, BANG_EQUAL, 0);
 			break;
 
 		case '=':
-			if (match_symbol('=')) {
-				add_token(EQUAL_EQUAL, "==", 0);
+			if (match_symbol(scanner, '=')) {
+				add_token(scanner, EQUAL_EQUAL, 0);
 			} else {
-				add_token(EQUAL, "=", 0);
+				add_token(scanner, EQUAL, 0);
 			}
 			break;
 
 		case '<':
-			if (match_symbol('=')) {
-				add_token(LESS_EQUAL, "<=", 0);
+			if (match_symbol(scanner, '=')) {
+				add_token(scanner, LESS_EQUAL, 0);
 			} else {
-				add_token(LESS, "<", 0);
+				add_token(scanner, LESS, 0);
 			}
 			break;
 
 		case '>':
-			if (match_symbol('=')) {
-				add_token(GREATER_EQUAL, ">=", 0);
+			if (match_symbol(scanner, '=')) {
+				add_token(scanner, GREATER_EQUAL, 0);
 			} else {
-				add_token(GREATER, ">", 0);
+				add_token(scanner, GREATER, 0);
 			}
 			break;
 
 		case '\t':
-			if (scanner.computing_indentation) {
-				scanner.current_indentation++;
+			// Only the tabs before anything else on a line count towards its indentation
+			if (scanner->computing_indentation) {
+				const char* tabs_end = scanner->skip->tabs(scanner->curr, scanner->end);
+				scanner->current_indentation += 1 + (tabs_end - scanner->curr);
+				scanner->curr = tabs_end;
+			} else {
+				scanner->curr = scanner->skip->blanks(scanner->curr, scanner->end);
 			}
 			return;
 
-		case '#':
+		case '#': {
 			// Skip comments completely (falls through to case '\n' on purpose)
-			while (fgetc(scanner.stream) != '\n') {
-				if (reached_eof()) {
-					return;
-				}
+			const char* newline = memchr(scanner->curr, '\n', scanner->end - scanner->curr);
+			if (newline == NULL) {
+				scanner->curr = scanner->end;
+				return;
 			}
 
+			scanner->lexeme = newline;
+			scanner->curr = newline + 1;
+		}
+		// Fall through
+
 		case '\n':
-			if (!scanner.currently_at_blank_line) {
-				add_token(NEWLINE, "\\n", 0); // No need to add tokens for empty lines
+			if (!scanner->currently_at_blank_line) {
+				add_token(scanner, NEWLINE, 0); // No need to add tokens for empty lines
 			}
 
-			scanner.line++;
-			scanner.current_indentation = 0;
-			scanner.computing_indentation = true;
-			scanner.currently_at_blank_line = true;
+			scanner->line++;
+			scanner->current_indentation = 0;
+			scanner->computing_indentation = true;
+			scanner->currently_at_blank_line = true;
 			return;
 
 		case ' ':
-			break; // Ignore spaces completely
+			// Ignore spaces completely (a tab after one doesn't count towards indentation)
+			scanner->curr = scanner->skip->blanks(scanner->curr, scanner->end);
+			break;
 
 		default:
-			scanner.lexeme[scanner.lexeme_pos++] = symbol;
 			if (is_alpha(symbol)) {
 				// Non-blank lines always start with an identifier
-				scanner.currently_at_blank_line = false;
+				scanner->currently_at_blank_line = false;
 
-				if (scanner.computing_indentation) {
-					while (scanner.current_indentation--) {
-						add_token(TAB, "\\t", 0); // Add the tabs we counted earlier
+				if (scanner->computing_indentation) {
+					while (scanner->current_indentation--) {
+						add_token(scanner, TAB, 0); // Add the tabs we counted earlier
 					}
 				}
 
-				scan_identifier();
+				scan_identifier(scanner);
 			} else if (is_digit(symbol)) {
-				scan_number();
-			} else if (symbol != EOF) {
-				fprintf(stderr, "Lexical Error: unexpected character '%c' at line %d\n",
-					symbol, scanner.line);
-				exit(EBAD_SYMBOL);
+				scan_number(scanner);
+			} else {
+				report_error(EBAD_SYMBOL, "Lexical Error: unexpected character '%c' at line %d\n",
+					symbol, scanner->line);
 			}
 			break;
 	}
 
-	scanner.computing_indentation = false;
+	scanner->computing_indentation = false;
 }
 
-static void scan_identifier(void) {
-	int symbol;
+static void scan_identifier(Scanner* scanner) {
+	scanner->curr = scanner->skip->name(scanner->curr, scanner->end);
 
-	while (!reached_eof()) {
-		symbol = fgetc(scanner.stream);
-		if (!is_alnum(symbol)) {
-			ungetc(symbol, scanner.stream);
-			break;
+	int length = scanner->curr - scanner->lexeme;
+
+	if (length >= MIN_KEYWORD && length <= MAX_KEYWORD) {
+		const Keyword* keyword = &keywords[keyword_slot(scanner->lexeme, length)];
+		if (keyword->length == length && memcmp(keyword->lexeme, scanner->lexeme, length) == 0) {
+			add_token(scanner, keyword->type, 0);
+			return;
 		}
+	}
+
+	add_token(scanner, IDENTIFIER, intern_name(scanner, scanner->lexeme, length));
+}
 
-		scanner.lexeme[scanner.lexeme_pos++] = symbol;
+// A perfect hash of the keywords (the empty slots have a length of 0, which no
+// lexeme that gets here has)
+static int keyword_slot(const char* lexeme, int length) {
+	return (lexeme[0] + 3 * lexeme[1] + 2 * length) & (N_KEYWORD_SLOTS - 1);
+}
+
+// Returns the index of the name among the program's names, adding it if it's new
+static int intern_name(Scanner* scanner, const char* lexeme, int length) {
+	Vector names = scanner->tokens->names;
+	int mask = scanner->n_buckets - 1;
+
+	int b = hash_name(lexeme, length) & mask;
+	for (; scanner->buckets[b] != NO_NAME; b = (b + 1) & mask) {
+		char* name = vector_get(names, scanner->buckets[b]);
+		if (strncmp(name, lexeme, length) == 0 && name[length] == '\0') {
+			return scanner->buckets[b];
+		}
 	}
 
-	scanner.lexeme[scanner.lexeme_pos] = '\0';
+	char* name = arena_alloc(scanner->tokens->arena, length + 1);
+	memcpy(name, lexeme, length);
+	name[length] = '\0';
+
+	int index = vector_size(names);
+	vector_add(names, name);
+	scanner->buckets[b] = index;
 
-	int* keyword_type = map_get(scanner.keywords, scanner.lexeme);
-	add_token(keyword_type == NULL ? IDENTIFIER : *keyword_type, scanner.lexeme, 0);
+	// The table is kept at most half full, so that probing stays short
+	if (2 * vector_size(names) > scanner->n_buckets) {
+		grow_buckets(scanner);
+	}
+
+	return index;
 }
 
-static void scan_number(void) {
-	int symbol;
+static void grow_buckets(Scanner* scanner) {
+	free(scanner->buckets);
+	scanner->n_buckets *= 2;
+	scanner->buckets = malloc(scanner->n_buckets * sizeof(int));
+	assert(scanner->buckets != NULL);
 
-	while (!reached_eof()) {
-		symbol = fgetc(scanner.stream);
-		if (!is_digit(symbol)) {
-			ungetc(symbol, scanner.stream);
-			break;
+	for (int b = 0; b < scanner->n_buckets; b++) {
+		scanner->buckets[b] = NO_NAME;
+	}
+
+	Vector names = scanner->tokens->names;
+	int mask = scanner->n_buckets - 1;
+	int n_names = vector_size(names);
+
+	for (int i = 0; i < n_names; i++) {
+		char* name = vector_get(names, i);
+		int b = hash_name(name, strlen(name)) & mask;
+		while (scanner->buckets[b] != NO_NAME) {
+			b = (b + 1) & mask;
 		}
+		scanner->buckets[b] = i;
+	}
+}
 
-		scanner.lexeme[scanner.lexeme_pos++] = symbol;
+// FNV-1a
+static unsigned hash_name(const char* name, int length) {
+	unsigned hash = 2166136261u;
+	for (int i = 0; i < length; i++) {
+		hash = (hash ^ (unsigned char) name[i]) * 16777619u;
 	}
+	return hash;
+}
+
+static void scan_number(Scanner* scanner) {
+	scanner->curr = scanner->skip->digits(scanner->curr, scanner->end);
 
-	scanner.lexeme[scanner.lexeme_pos] = '\0';
-	add_token(NUMBER, scanner.lexeme, atoi(scanner.lexeme));
+	int literal = parse_number(scanner->lexeme, scanner->curr - scanner->lexeme);
+	add_token(scanner, NUMBER, literal);
 }
 
-static void consume_symbol(int symbol) {
-	int ch = fgetc(scanner.stream);
+static int next_symbol(Scanner* scanner) {
+	return reached_eof(scanner) ? EOF : (unsigned char) *scanner->curr++;
+}
+
+static void consume_symbol(Scanner* scanner, int symbol) {
+	int ch = next_symbol(scanner);
 
 	if (ch != symbol) {
-		fprintf(stderr, "Lexical Error: unexpected character '%c' at line %d\n",
-			ch, scanner.line);
-		exit(EBAD_SYMBOL);
+		report_error(EBAD_SYMBOL, "Lexical Error: unexpected character '%c' at line %d\n",
+			ch, scanner->line);
 	}
 }
 
-static bool match_symbol(int symbol) {
-	int ch = fgetc(scanner.stream);
+static bool match_symbol(Scanner* scanner, int symbol) {
+	if (reached_eof(scanner) || *scanner->curr != symbol)
+		return false;
 
-	if (ch == symbol)
-		return true;
-
-	ungetc(ch, scanner.stream);
-	return false;
+	scanner->curr++;
+	return true;
 }
 
-static void add_token(TokenType type, char* lexeme, int literal) {
-	Token* token = malloc(sizeof(Token));
-	assert(token != NULL);
+// The token's lexeme goes from where it started up to the next character to be scanned
+static void add_token(Scanner* scanner, TokenType type, int literal) {
+	TokenStream* tokens = scanner->tokens;
 
-	token->lexeme = (lexeme == NULL) ? NULL : strdup(lexeme);
-	assert(lexeme == NULL || token->lexeme != NULL);
+	if (tokens->n_scanned - tokens->room_start == tokens->ring_cap) {
+		make_room(tokens);
+	}
 
+	Token* token = &tokens->ring[tokens->n_scanned++ & (tokens->ring_cap - 1)];
 	token->type = type;
+	token->start = scanner->lexeme - scanner->source;
+	token->length = type == TAB ? 0 : scanner->curr - scanner->lexeme; // Tabs are counted, not kept
 	token->literal = literal;
-	token->line = scanner.line;
+	token->line = scanner->line;
+}
 
-	vector_add(scanner.tokens, token);
+// The ring only grows if the parser needs every token in it (e.g. for a statement
+// that's nested deep enough), otherwise the scanner waits for it to release some
+static void make_room(TokenStream* tokens) {
+	if (!tokens->pipelined) {
+		if (tokens->draining) {
+			tokens->room_start = tokens->first = tokens->n_scanned;
+		} else if (tokens->n_scanned - tokens->first == tokens->ring_cap) {
+			grow_ring(tokens);
+		}
+		tokens->room_start = tokens->first;
+		return;
+	}
+
+	pthread_mutex_lock(&tokens->lock);
+	tokens->n_tokens = tokens->n_published = tokens->n_scanned;
+	pthread_cond_signal(&tokens->scanned);
+
+	for (;;) {
+		if (tokens->draining) {
+			tokens->first = tokens->n_scanned;
+		}
+
+		tokens->room_start = tokens->first;
+		if (tokens->n_scanned - tokens->room_start < tokens->ring_cap) {
+			break;
+		}
+
+		// The parser is waiting for a token that there's no room for
+		if (tokens->waiting_for >= tokens->n_tokens) {
+			grow_ring(tokens);
+			break;
+		}
+
+		pthread_cond_wait(&tokens->released, &tokens->lock);
+	}
+
+	pthread_mutex_unlock(&tokens->lock);
+}
+
+static void grow_ring(TokenStream* tokens) {
+	int cap = 2 * tokens->ring_cap;
+	Token* ring = malloc(cap * sizeof(Token));
+	assert(ring != NULL);
+
+	for (int i = tokens->first; i < tokens->n_scanned; i++) {
+		ring[i & (cap - 1)] = tokens->ring[i & (tokens->ring_cap - 1)];
+	}
+
+	free(tokens->ring);
+	tokens->ring = ring;
+	tokens->ring_cap = cap;
+}
+
+static void publish_tokens(TokenStream* tokens) {
+	pthread_mutex_lock(&tokens->lock);
+	tokens->n_tokens = tokens->n_published = tokens->n_scanned;
+	pthread_cond_signal(&tokens->scanned);
+	pthread_mutex_unlock(&tokens->lock);
+}
+
+static void keep_error(TokenStream* tokens, ErrorTrap* trap) {
+	tokens->error_status = trap->status;
+	strcpy(tokens->error_msg, trap->msg);
+}
+
+// Same as atoi on the digits, which saturates at LONG_MAX before truncating to an int
+static int parse_number(const char* digits, int length) {
+	long value = 0;
+
+	for (int i = 0; i < length; i++) {
+		int digit = digits[i] - '0';
+		value = value > (LONG_MAX - digit) / 10 ? LONG_MAX : value * 10 + digit;
+	}
+
+	return (int) value;
 }
 
 static bool is_alpha(int symbol) {
@@ -266,10 +676,6 @@ static bool is_digit(int symbol) {
 	return symbol >= '0' && symbol <= '9';
 }
 
-static bool is_alnum(int symbol) {
-	return is_alpha(symbol) || is_digit(symbol) || symbol == '_';
-}
-
-static bool reached_eof(void) {
-	return feof(scanner.stream);
+static bool reached_eof(Scanner* scanner) {
+	return scanner->curr == scanner->end;
 }
@@ -0,0 +1,280 @@
+#include <time.h>
+#include <stdio.h>
+#include <assert.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <sys/un.h>
+#include <sys/socket.h>
+
+#include "map.h"
+
+#include "error.h"
+#include "runtime.h"
+#include "cache.h"
+#include "source.h"
+#include "wire.h"
+#include "ipl.h"
+
+// Once the cache holds this many programs, every load evicts one of them
+#define MAX_CACHED 256
+
+// A program's text, which is what the cache is keyed by
+typedef struct source {
+	unsigned long hash;
+	size_t size;
+	char* text;
+} Source;
+
+// A loaded program is freed once it's neither cached nor running
+typedef struct cached {
+	IplProgram* program;
+	int refs;
+	bool used; // Whether it was hit since the clock hand last went past it
+} Cached;
+
+// Helper functions used by the server (no reason to expose them)
+static void* serve_connection(void* arg);
+static int serve_request(int argc, char** argv, FILE* in, FILE* out, FILE* err);
+static Cached* acquire_program(const char* path, char* text, size_t size, IplError* error);
+static Cached* find_program(Source* source);
+static void release_program(Cached* cached);
+static int evict_program(void);
+static void drop_program(void* cached);
+static unsigned long hash_source(void* source);
+static int cmp_sources(void* a, void* b);
+static void destroy_source(void* source);
+
+// This is used as a wrapper for the server's state
+static struct server {
+	IplOptions options;
+	Map cache; // Source* -> Cached*
+	Source* keys[MAX_CACHED]; // The cache's keys, in the order that the clock hand visits them
+	int hand; // The key that eviction looks at next
+	pthread_mutex_t lock; // Guards the cache (and the above) and the programs' refs
+	atomic_uint n_requests; // Only used to seed the requests' random numbers
+} server = { .lock = PTHREAD_MUTEX_INITIALIZER };
+
+int ipl_serve(const char* socket_path, IplOptions options, IplError* error) {
+	struct sockaddr_un addr = { .sun_family = AF_UNIX };
+	if (strlen(socket_path) >= sizeof(addr.sun_path)) {
+		error->status = EOPEN_FILE;
+		strcpy(error->msg, "Error: unable to open socket\n");
+		return error->status;
+	}
+	strcpy(addr.sun_path, socket_path);
+
+	// A socket left behind by a server that's no longer running is replaced
+	int sock = socket(AF_UNIX, SOCK_STREAM, 0);
+	unlink(socket_path);
+
+	if (sock < 0 || bind(sock, (struct sockaddr*) &addr, sizeof(addr)) != 0 ||
+		listen(sock, SOMAXCONN) != 0) {
+		if (sock >= 0) {
+			close(sock);
+		}
+
+		error->status = EOPEN_FILE;
+		strcpy(error->msg, "Error: unable to open socket\n");
+		return error->status;
+	}
+
+	// Clients that go away mid-run shouldn't take the server down with them
+	signal(SIGPIPE, SIG_IGN);
+
+	server.options = options;
+	server.cache = map_create(cmp_sources, destroy_source, drop_program, hash_source);
+
+	for (;;) {
+		int conn = accept(sock, NULL, NULL);
+		if (conn < 0) {
+			continue;
+		}
+
+		pthread_t thread;
+		if (pthread_create(&thread, NULL, serve_connection, (void*) (intptr_t) conn) != 0) {
+			close(conn);
+			continue;
+		}
+		pthread_detach(thread);
+	}
+}
+
+static void* serve_connection(void* arg) {
+	int conn = (int) (intptr_t) arg;
+
+	int streams[N_STREAMS];
+	int n_strings;
+	char** strings;
+
+	if (receive_request(conn, streams, &n_strings, &strings)) {
+		FILE* in = fdopen(streams[0], "r");
+		FILE* out = fdopen(streams[1], "w");
+		FILE* err = fdopen(streams[2], "w");
+		assert(in != NULL && out != NULL && err != NULL);
+
+		int status = serve_request(n_strings, strings, in, out, err);
+
+		fclose(in);
+		fclose(out);
+		fclose(err);
+
+		send_status(conn, status);
+		free_strings(n_strings, strings);
+	}
+
+	close(conn);
+	return NULL;
+}
+
+// Runs the program at argv[0] with the rest of argv as its arguments, the same way
+// ipli would on those streams, and returns the status ipli would exit with
+static int serve_request(int argc, char** argv, FILE* in, FILE* out, FILE* err) {
+	size_t size;
+	char* text = read_source(argv[0], &size);
+	if (text == NULL) {
+		fprintf(err, "Error: unable to open input file\n");
+		return EOPEN_FILE;
+	}
+
+	IplError error;
+	Cached* cached = acquire_program(argv[0], text, size, &error);
+	if (cached == NULL) {
+		fprintf(err, "%s", error.msg);
+		return error.status;
+	}
+
+	unsigned n = atomic_fetch_add(&server.n_requests, 1);
+	unsigned seed = (unsigned) time(NULL) ^ (n * 2654435761u);
+	RunIO io = { .in = in, .out = out, .seed = &seed };
+
+	int status = ipl_run_io(cached->program, argc - 1, argv + 1, io, &error);
+	if (status != 0) {
+		fflush(out);
+		fprintf(err, "%s", error.msg);
+	}
+
+	release_program(cached);
+	return status;
+}
+
+// Returns the cached program for text (loading it if it's not there yet), which
+// the caller releases once it's done running it. Takes ownership of text
+static Cached* acquire_program(const char* path, char* text, size_t size, IplError* error) {
+	Source source = { .hash = hash_text(text, size), .size = size, .text = text };
+
+	pthread_mutex_lock(&server.lock);
+	Cached* cached = find_program(&source);
+	pthread_mutex_unlock(&server.lock);
+
+	if (cached != NULL) {
+		free(text);
+		return cached;
+	}
+
+	// Programs are loaded without the lock, so that a slow one doesn't hold up the
+	// requests for the others
+	IplProgram* program = ipl_program_load_source(path, text, size, server.options, error);
+	if (program == NULL) {
+		free(text);
+		return NULL;
+	}
+
+	// Another request may have loaded the same text in the meantime
+	pthread_mutex_lock(&server.lock);
+	cached = find_program(&source);
+	if (cached != NULL) {
+		pthread_mutex_unlock(&server.lock);
+
+		ipl_program_free(program);
+		free(text);
+		return cached;
+	}
+
+	int n_cached = map_size(server.cache);
+	int slot = n_cached < MAX_CACHED ? n_cached : evict_program();
+
+	Source* key = malloc(sizeof(Source));
+	cached = malloc(sizeof(Cached));
+	assert(key != NULL && cached != NULL);
+
+	*key = source;
+	cached->program = program;
+	cached->refs = 2; // The cache's and the caller's
+	cached->used = false;
+	map_put(server.cache, key, cached);
+	server.keys[slot] = key;
+
+	pthread_mutex_unlock(&server.lock);
+	return cached;
+}
+
+// Returns the cached program for source with a new reference to it (or NULL), with
+// the lock held
+static Cached* find_program(Source* source) {
+	Cached* cached = map_get(server.cache, source);
+	if (cached != NULL) {
+		cached->refs++;
+		cached->used = true;
+	}
+
+	return cached;
+}
+
+static void release_program(Cached* cached) {
+	pthread_mutex_lock(&server.lock);
+	drop_program(cached);
+	pthread_mutex_unlock(&server.lock);
+}
+
+// Removes the first program that the clock hand comes across that wasn't hit since
+// it last went past it (clearing the others' hits) from the full cache, with the
+// lock held, and returns the slot of its key. The programs that are still running
+// hold on to their own reference
+static int evict_program(void) {
+	for (;;) {
+		int slot = server.hand;
+		Cached* cached = map_get(server.cache, server.keys[slot]);
+		server.hand = (server.hand + 1) % MAX_CACHED;
+
+		if (!cached->used) {
+			map_remove(server.cache, server.keys[slot]);
+			return slot;
+		}
+		cached->used = false;
+	}
+}
+
+// Drops a reference to a program, with the lock held
+static void drop_program(void* cached) {
+	Cached* c = cached;
+	if (--c->refs == 0) {
+		ipl_program_free(c->program);
+		free(c);
+	}
+}
+
+static unsigned long hash_source(void* source) {
+	return ((Source*) source)->hash;
+}
+
+static int cmp_sources(void* a, void* b) {
+	Source* sa = a;
+	Source* sb = b;
+
+	if (sa->hash != sb->hash || sa->size != sb->size) {
+		return 1;
+	}
+
+	return memcmp(sa->text, sb->text, sa->size);
+}
+
+static void destroy_source(void* source) {
+	free(((Source*) source)->text);
+	free(source);
+}
@@ -0,0 +1,106 @@
+#include <stdio.h>
+#include <fcntl.h>
+#include <assert.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <stdbool.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "source.h"
+
+// Helper functions used by the source reader (no reason to expose them)
+static bool stat_source(int fd, struct stat* st);
+static char* read_stream(FILE* stream, size_t* size);
+
+bool open_source(const char* path, SourceFile* file) {
+	int fd = open(path, O_RDONLY);
+	if (fd < 0) {
+		return false;
+	}
+
+	struct stat st;
+	if (!stat_source(fd, &st)) {
+		close(fd);
+		return false;
+	}
+
+	// Empty files can't be mapped, and neither can pipes
+	if (S_ISREG(st.st_mode) && st.st_size > 0) {
+		void* text = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (text != MAP_FAILED) {
+			close(fd);
+
+			// The scanner goes through the text once, front to back
+			madvise(text, st.st_size, MADV_SEQUENTIAL);
+
+			file->text = text;
+			file->size = st.st_size;
+			file->mapped = true;
+			return true;
+		}
+	}
+
+	// Anything else is read through the same descriptor, since a pipe can't be opened twice
+	FILE* stream = fdopen(fd, "r");
+	assert(stream != NULL);
+
+	file->text = read_stream(stream, &file->size);
+	file->mapped = false;
+	fclose(stream);
+	return file->text != NULL;
+}
+
+void close_source(SourceFile* file) {
+	if (file->mapped) {
+		munmap(file->text, file->size);
+	} else {
+		free(file->text);
+	}
+}
+
+char* read_source(const char* path, size_t* size) {
+	FILE* stream = fopen(path, "r");
+	if (stream == NULL) {
+		return NULL;
+	}
+
+	struct stat st;
+	if (!stat_source(fileno(stream), &st)) {
+		fclose(stream);
+		return NULL;
+	}
+
+	char* text = read_stream(stream, size);
+	fclose(stream);
+	return text;
+}
+
+// Directories (and devices) open fine, but only files and pipes hold a program
+static bool stat_source(int fd, struct stat* st) {
+	return fstat(fd, st) == 0 && (S_ISREG(st->st_mode) || S_ISFIFO(st->st_mode));
+}
+
+// Returns NULL if the stream can't be read to the end
+static char* read_stream(FILE* stream, size_t* size) {
+	size_t cap = 4096;
+	char* text = malloc(cap);
+	assert(text != NULL);
+
+	*size = 0;
+	for (size_t n; (n = fread(text + *size, 1, cap - *size, stream)) > 0;) {
+		*size += n;
+		if (*size == cap) {
+			cap *= 2;
+			text = realloc(text, cap);
+			assert(text != NULL);
+		}
+	}
+
+	if (ferror(stream)) {
+		free(text);
+		return NULL;
+	}
+
+	return text;
+}
@@ -0,0 +1,712 @@
+#include <stdio.h>
+#include <assert.h>
+#include <limits.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <stdbool.h>
+
+#include "vector.h"
+
+#include "stmt.h"
+#include "expr.h"
+#include "error.h"
+#include "token.h"
+#include "resolver.h"
+#include "translator.h"
+
+#define MIN_CAP 64
+
+// The declarations that a name needs: its value, its array and its kind
+#define USES_VAR 1
+#define USES_ARRAY 2
+#define USES_KIND 4
+
+// Loops that are left by break <n> or continue <n> with n > 1 get labels
+typedef struct loop {
+	int id;
+	bool break_label;
+	bool continue_label;
+} Loop;
+
+typedef struct translator Translator;
+
+// Helper functions used by the translator (no reason to expose them)
+static void init_translator(Translator* translator, Tree* tree, Vector symbols, FILE* out);
+static void emit_support_code(Translator* translator, char* source);
+static void emit_declarations(Translator* translator);
+static void translate_stmts(Translator* translator, Block stmts);
+static void translate_stmt(Translator* translator, Stmt* stmt);
+static void translate_read_stmt(Translator* translator, int line, ReadStmt* stmt);
+static void translate_assignment_stmt(Translator* translator, int line, AssignmentStmt* stmt);
+static void translate_write_stmt(Translator* translator, int line, WriteStmt* stmt);
+static void translate_writeln_stmt(Translator* translator, int line, WritelnStmt* stmt);
+static void translate_while_stmt(Translator* translator, int line, WhileStmt* stmt);
+static void translate_if_else_stmt(Translator* translator, int line, IfElseStmt* stmt);
+static void translate_random_stmt(Translator* translator, int line, RandomStmt* stmt);
+static void translate_arg_stmt(Translator* translator, int line, ArgStmt* stmt);
+static void translate_arg_size_stmt(Translator* translator, int line, ArgSizeStmt* stmt);
+static void translate_break_stmt(Translator* translator, int line, BreakStmt* stmt);
+static void translate_continue_stmt(Translator* translator, int line, ContinueStmt* stmt);
+static void translate_new_stmt(Translator* translator, int line, NewStmt* stmt);
+static void translate_free_stmt(Translator* translator, int line, FreeStmt* stmt);
+static void translate_size_stmt(Translator* translator, int line, SizeStmt* stmt);
+static char* translate_expr(Translator* translator, int line, Expr expr);
+static char* translate_element(Translator* translator, int line, Array* array);
+static void translate_store(Translator* translator, int line, Expr lvalue, char* value,
+	bool can_fail);
+static char* hoist(Translator* translator, char* value);
+static bool needs_hoisting(Translator* translator, Expr expr);
+static bool can_fail(Translator* translator, Expr expr);
+static bool is_mixed_slot(Translator* translator, int slot);
+static char* symbol_name(Translator* translator, int slot);
+static char* use_name(Translator* translator, int slot, int uses);
+static char* operator(TokenType type);
+static char* format(const char* fmt, ...);
+static void emit(Translator* translator, const char* fmt, ...);
+
+// This is used as a wrapper for the translator's state
+struct translator {
+	Tree* tree;
+	FILE* out;
+	Vector symbols;
+	int indent;
+	int n_temps; // Temporaries get unique names, so they can be declared anywhere
+	int n_loops;
+	Loop* loops;
+	int loop_nesting;
+	int loops_cap;
+	unsigned char* uses; // Which declarations each slot needs (USES_* flags)
+};
+
+// The generated program only depends on the C standard library. Its helpers are
+// static inline, so the ones that aren't used don't cause any warnings
+static const char* const support_code =
+	"enum { UNBOUND, BOUND_VAR, BOUND_ARRAY };\n"
+	"\n"
+	"typedef struct array {\n"
+	"\tint size;\n"
+	"\tint* elems;\n"
+	"} Array;\n"
+	"\n"
+	"// Same as ipli's argc, i.e. the input file counts as an argument\n"
+	"static int n_args;\n"
+	"static char** args;\n"
+	"\n"
+	"static void runtime_error(const char* msg, int line, int status) {\n"
+	"\tfprintf(stderr, \"Runtime Error: %s at line %d\\n\", msg, line);\n"
+	"\texit(status);\n"
+	"}\n"
+	"\n"
+	"// Arithmetic wraps around on overflow\n"
+	"static inline int add(int left, int right) {\n"
+	"\treturn (int) ((unsigned) left + (unsigned) right);\n"
+	"}\n"
+	"\n"
+	"static inline int sub(int left, int right) {\n"
+	"\treturn (int) ((unsigned) left - (unsigned) right);\n"
+	"}\n"
+	"\n"
+	"static inline int mul(int left, int right) {\n"
+	"\treturn (int) ((unsigned) left * (unsigned) right);\n"
+	"}\n"
+	"\n"
+	"static inline int divide(int left, int right, int line) {\n"
+	"\tif (right == 0) {\n"
+	"\t\truntime_error(\"division with 0\", line, EDIV_ZERO);\n"
+	"\t}\n"
+	"\treturn left / right;\n"
+	"}\n"
+	"\n"
+	"static inline int modulo(int left, int right, int line) {\n"
+	"\tif (right == 0) {\n"
+	"\t\truntime_error(\"division with 0\", line, EDIV_ZERO);\n"
+	"\t}\n"
+	"\treturn left % right;\n"
+	"}\n"
+	"\n"
+	"// Names that aren't arrays have size 0, so one check covers both errors\n"
+	"static inline int* element(Array* array, int idx, int line) {\n"
+	"\tif ((unsigned) idx >= (unsigned) array->size) {\n"
+	"\t\tif (array->elems == NULL) {\n"
+	"\t\t\truntime_error(\"name does not correspond to an array\", line, EBAD_ARRAY);\n"
+	"\t\t}\n"
+	"\t\truntime_error(\"array index out of bounds\", line, EIDX_OOB);\n"
+	"\t}\n"
+	"\treturn &array->elems[idx];\n"
+	"}\n"
+	"\n"
+	"static inline void check_array(Array* array, int line) {\n"
+	"\tif (array->elems == NULL) {\n"
+	"\t\truntime_error(\"name does not correspond to an array\", line, EBAD_ARRAY);\n"
+	"\t}\n"
+	"}\n"
+	"\n"
+	"static inline void new_array(Array* array, int size, int line) {\n"
+	"\tif (size <= 0) {\n"
+	"\t\truntime_error(\"array size must be greater than 0\", line, EBAD_SIZE);\n"
+	"\t}\n"
+	"\n"
+	"\tint* elems = calloc(size, sizeof(int));\n"
+	"\tif (elems == NULL) {\n"
+	"\t\tfprintf(stderr, \"Error: out of memory\\n\");\n"
+	"\t\texit(EXIT_FAILURE);\n"
+	"\t}\n"
+	"\n"
+	"\tfree(array->elems);\n"
+	"\tarray->size = size;\n"
+	"\tarray->elems = elems;\n"
+	"}\n"
+	"\n"
+	"static inline void free_array(Array* array, int line) {\n"
+	"\tcheck_array(array, line);\n"
+	"\tfree(array->elems);\n"
+	"\tarray->size = 0;\n"
+	"\tarray->elems = NULL;\n"
+	"}\n"
+	"\n"
+	"static inline int size_of(Array* array, int line) {\n"
+	"\tcheck_array(array, line);\n"
+	"\treturn array->size;\n"
+	"}\n"
+	"\n"
+	"// Only needed for names that are used both as variables and as arrays\n"
+	"static inline void check_var(int* kind, int line) {\n"
+	"\tif (*kind == BOUND_ARRAY) {\n"
+	"\t\truntime_error(\"expected a variable name\", line, EBAD_VAR);\n"
+	"\t}\n"
+	"\t*kind = BOUND_VAR;\n"
+	"}\n"
+	"\n"
+	"static inline void check_new(int* kind, int line) {\n"
+	"\tif (*kind == BOUND_VAR) {\n"
+	"\t\truntime_error(\"array name overlaps with variable name\", line, EBAD_ID);\n"
+	"\t}\n"
+	"}\n"
+	"\n"
+	"static inline int read_int(void) {\n"
+	"\tint input;\n"
+	"\tif (scanf(\"%d\", &input) != 1) {\n"
+	"\t\tinput = 0;\n"
+	"\t}\n"
+	"\treturn input;\n"
+	"}\n"
+	"\n"
+	"static inline int argument(int pos, int line) {\n"
+	"\tif (pos < 1 || pos > n_args-2) {\n"
+	"\t\truntime_error(\"invalid argument index\", line, EBAD_IDX);\n"
+	"\t}\n"
+	"\treturn atoi(args[pos]);\n"
+	"}\n";
+
+static void init_translator(Translator* translator, Tree* tree, Vector symbols, FILE* out) {
+	translator->tree = tree;
+	translator->out = out;
+	translator->symbols = symbols;
+	translator->indent = 0;
+	translator->n_temps = 0;
+	translator->n_loops = 0;
+
+	translator->loops = malloc(MIN_CAP * sizeof(Loop));
+	assert(translator->loops != NULL);
+	translator->loop_nesting = 0;
+	translator->loops_cap = MIN_CAP;
+
+	translator->uses = calloc(vector_size(symbols) + 1, sizeof(unsigned char));
+	assert(translator->uses != NULL);
+}
+
+void translate_to_c(Tree* tree, Block stmts, Vector symbols, char* source, FILE* out) {
+	Translator translator;
+	init_translator(&translator, tree, symbols, out);
+
+	emit_support_code(&translator, source);
+
+	// The optimizer may have removed every use of a name, so main is translated
+	// first and only the names that it ends up using get declared
+	char* body;
+	size_t body_size;
+	translator.out = open_memstream(&body, &body_size);
+	assert(translator.out != NULL);
+
+	emit(&translator, "int main(int argc, char** argv) {");
+	translator.indent++;
+
+	// The binary takes the place of both ipli and the input file
+	emit(&translator, "n_args = argc + 1;");
+	emit(&translator, "args = argv;");
+	emit(&translator, "srand(time(NULL));");
+	emit(&translator, "");
+
+	translate_stmts(&translator, stmts);
+
+	emit(&translator, "");
+	emit(&translator, "return 0;");
+	translator.indent--;
+	emit(&translator, "}");
+
+	fclose(translator.out);
+	translator.out = out;
+
+	emit_declarations(&translator);
+	fputs(body, out);
+
+	free(body);
+	free(translator.uses);
+	free(translator.loops);
+}
+
+static void emit_support_code(Translator* translator, char* source) {
+	emit(translator, "// Translated from %s by ipli --emit-c", source);
+	emit(translator, "");
+	emit(translator, "#include <time.h>");
+	emit(translator, "#include <stdio.h>");
+	emit(translator, "#include <stdlib.h>");
+	emit(translator, "");
+
+	emit(translator, "enum {");
+	emit(translator,
+		"\tEDIV_ZERO = %d, EBAD_BREAK = %d, EBAD_CONT = %d, EBAD_ID = %d, EBAD_SIZE = %d,",
+		EDIV_ZERO, EBAD_BREAK, EBAD_CONT, EBAD_ID, EBAD_SIZE);
+	emit(translator, "\tEBAD_ARRAY = %d, EIDX_OOB = %d, EBAD_VAR = %d, EBAD_IDX = %d",
+		EBAD_ARRAY, EIDX_OOB, EBAD_VAR, EBAD_IDX);
+	emit(translator, "};");
+	emit(translator, "");
+
+	fputs(support_code, translator->out);
+	emit(translator, "");
+}
+
+// Every name gets a prefix, so that it can't clash with C's keywords or the
+// helpers above: v_ for variables, a_ for arrays and k_ for the kind of a name
+// that's used both ways
+static void emit_declarations(Translator* translator) {
+	int n_declared = 0;
+	int n_symbols = vector_size(translator->symbols);
+	for (int slot = 0; slot < n_symbols; slot++) {
+		Symbol* symbol = vector_get(translator->symbols, slot);
+
+		if (translator->uses[slot] & USES_VAR) {
+			emit(translator, "static int v_%s;", symbol->name);
+		}
+		if (translator->uses[slot] & USES_ARRAY) {
+			emit(translator, "static Array a_%s;", symbol->name);
+		}
+		if (translator->uses[slot] & USES_KIND) {
+			emit(translator, "static int k_%s;", symbol->name);
+		}
+
+		n_declared += translator->uses[slot] != 0;
+	}
+
+	if (n_declared > 0) {
+		emit(translator, "");
+	}
+}
+
+static void translate_stmts(Translator* translator, Block stmts) {
+	for (int i = 0; i < stmts.n_stmts; i++) {
+		Stmt stmt = get_stmt(translator->tree, stmts, i);
+		translate_stmt(translator, &stmt);
+	}
+}
+
+static void translate_stmt(Translator* translator, Stmt* stmt) {
+	void* payload = get_payload(translator->tree, stmt);
+
+	switch (stmt->type) {
+		case READ_STMT: translate_read_stmt(translator, stmt->line, payload); break;
+		case ASSIGNMENT_STMT: translate_assignment_stmt(translator, stmt->line, payload); break;
+		case WRITE_STMT: translate_write_stmt(translator, stmt->line, payload); break;
+		case WRITELN_STMT: translate_writeln_stmt(translator, stmt->line, payload); break;
+		case WHILE_STMT: translate_while_stmt(translator, stmt->line, payload); break;
+		case IF_ELSE_STMT: translate_if_else_stmt(translator, stmt->line, payload); break;
+		case RANDOM_STMT: translate_random_stmt(translator, stmt->line, payload); break;
+		case ARG_STMT: translate_arg_stmt(translator, stmt->line, payload); break;
+		case ARG_SIZE_STMT: translate_arg_size_stmt(translator, stmt->line, payload); break;
+		case BREAK_STMT: translate_break_stmt(translator, stmt->line, payload); break;
+		case CONTINUE_STMT: translate_continue_stmt(translator, stmt->line, payload); break;
+		case NEW_STMT: translate_new_stmt(translator, stmt->line, payload); break;
+		case FREE_STMT: translate_free_stmt(translator, stmt->line, payload); break;
+		case SIZE_STMT: translate_size_stmt(translator, stmt->line, payload); break;
+		default:
+			fprintf(stderr, "Invalid statement type (this shouldn't be printed)\n");
+			exit(EXIT_FAILURE);
+	}
+}
+
+// Reading input and drawing random numbers can't fail, so the order in which they
+// happen relative to a failing lvalue doesn't matter
+static void translate_read_stmt(Translator* translator, int line, ReadStmt* stmt) {
+	translate_store(translator, line, stmt->lvalue, format("read_int()"), false);
+}
+
+static void translate_assignment_stmt(Translator* translator, int line, AssignmentStmt* stmt) {
+	char* value = translate_expr(translator, line, stmt->expr);
+	translate_store(translator, line, stmt->lvalue, value, can_fail(translator, stmt->expr));
+}
+
+static void translate_write_stmt(Translator* translator, int line, WriteStmt* stmt) {
+	if (stmt->expr != NO_EXPR) {
+		char* value = translate_expr(translator, line, stmt->expr);
+		emit(translator, "printf(\"%%d \", %s);", value);
+		free(value);
+	} else {
+		emit(translator, "printf(\" \");");
+	}
+}
+
+static void translate_writeln_stmt(Translator* translator, int line, WritelnStmt* stmt) {
+	if (stmt->expr != NO_EXPR) {
+		char* value = translate_expr(translator, line, stmt->expr);
+		emit(translator, "printf(\"%%d\\n\", %s);", value);
+		free(value);
+	} else {
+		emit(translator, "printf(\"\\n\");");
+	}
+}
+
+static void translate_while_stmt(Translator* translator, int line, WhileStmt* stmt) {
+	// A condition that needs statements of its own is evaluated inside the loop
+	if (needs_hoisting(translator, stmt->cond)) {
+		emit(translator, "for (;;) {");
+		translator->indent++;
+
+		char* cond = translate_expr(translator, line, stmt->cond);
+		emit(translator, "if (!(%s)) break;", cond);
+		free(cond);
+	} else {
+		char* cond = translate_expr(translator, line, stmt->cond);
+		emit(translator, "while (%s) {", cond);
+		free(cond);
+		translator->indent++;
+	}
+
+	if (translator->loop_nesting == translator->loops_cap) {
+		translator->loops_cap *= 2;
+		translator->loops = realloc(translator->loops, translator->loops_cap * sizeof(Loop));
+		assert(translator->loops != NULL);
+	}
+
+	Loop* loop = &translator->loops[translator->loop_nesting++];
+	*loop = (Loop) { .id = translator->n_loops++, .break_label = false, .continue_label = false };
+
+	translate_stmts(translator, stmt->stmts);
+
+	loop = &translator->loops[--translator->loop_nesting];
+	if (loop->continue_label) {
+		emit(translator, "continue_%d:;", loop->id);
+	}
+
+	translator->indent--;
+	emit(translator, "}");
+
+	if (loop->break_label) {
+		emit(translator, "break_%d:;", loop->id);
+	}
+}
+
+static void translate_if_else_stmt(Translator* translator, int line, IfElseStmt* stmt) {
+	char* cond = translate_expr(translator, line, stmt->cond);
+	emit(translator, "if (%s) {", cond);
+	free(cond);
+
+	translator->indent++;
+	translate_stmts(translator, stmt->then_stmts);
+	translator->indent--;
+
+	if (stmt->has_else) {
+		emit(translator, "} else {");
+		translator->indent++;
+		translate_stmts(translator, stmt->else_stmts);
+		translator->indent--;
+	}
+
+	emit(translator, "}");
+}
+
+static void translate_random_stmt(Translator* translator, int line, RandomStmt* stmt) {
+	translate_store(translator, line, stmt->lvalue, format("rand()"), false);
+}
+
+static void translate_arg_stmt(Translator* translator, int line, ArgStmt* stmt) {
+	char* pos = translate_expr(translator, line, stmt->expr);
+	translate_store(translator, line, stmt->lvalue, format("argument(%s, %d)", pos, line), true);
+	free(pos);
+}
+
+static void translate_arg_size_stmt(Translator* translator, int line, ArgSizeStmt* stmt) {
+	translate_store(translator, line, stmt->lvalue, format("n_args"), false);
+}
+
+// Only an error if it's ever reached, just like in the tree-walker
+static void translate_break_stmt(Translator* translator, int line, BreakStmt* stmt) {
+	if (stmt->n_loops > translator->loop_nesting) {
+		emit(translator, "runtime_error(\"invalid break statement\", %d, EBAD_BREAK);", line);
+	} else if (stmt->n_loops == 1) {
+		emit(translator, "break;");
+	} else {
+		Loop* loop = &translator->loops[translator->loop_nesting - stmt->n_loops];
+		loop->break_label = true;
+		emit(translator, "goto break_%d;", loop->id);
+	}
+}
+
+static void translate_continue_stmt(Translator* translator, int line, ContinueStmt* stmt) {
+	if (stmt->n_loops > translator->loop_nesting) {
+		emit(translator, "runtime_error(\"invalid continue statement\", %d, EBAD_CONT);", line);
+	} else if (stmt->n_loops == 1) {
+		emit(translator, "continue;");
+	} else {
+		Loop* loop = &translator->loops[translator->loop_nesting - stmt->n_loops];
+		loop->continue_label = true;
+		emit(translator, "goto continue_%d;", loop->id);
+	}
+}
+
+static void translate_new_stmt(Translator* translator, int line, NewStmt* stmt) {
+	char* name = use_name(translator, stmt->slot,
+		USES_ARRAY | (is_mixed_slot(translator, stmt->slot) ? USES_KIND : 0));
+
+	if (is_mixed_slot(translator, stmt->slot)) {
+		emit(translator, "check_new(&k_%s, %d);", name, line); // Must precede the size's evaluation
+	}
+
+	char* size = translate_expr(translator, line, stmt->size);
+	emit(translator, "new_array(&a_%s, %s, %d);", name, size, line);
+	free(size);
+
+	if (is_mixed_slot(translator, stmt->slot)) {
+		emit(translator, "k_%s = BOUND_ARRAY;", name);
+	}
+}
+
+static void translate_free_stmt(Translator* translator, int line, FreeStmt* stmt) {
+	char* name = use_name(translator, stmt->slot,
+		USES_ARRAY | (is_mixed_slot(translator, stmt->slot) ? USES_KIND : 0));
+	emit(translator, "free_array(&a_%s, %d);", name, line);
+
+	if (is_mixed_slot(translator, stmt->slot)) {
+		emit(translator, "k_%s = UNBOUND;", name);
+	}
+}
+
+static void translate_size_stmt(Translator* translator, int line, SizeStmt* stmt) {
+	char* value = format("size_of(&a_%s, %d)", use_name(translator, stmt->slot, USES_ARRAY), line);
+	translate_store(translator, line, stmt->lvalue, value, true);
+}
+
+// The tree-walker evaluates operands from left to right, but C leaves the order
+// unspecified. That only matters if both operands can fail, in which case the
+// left one is evaluated into a temporary first. The same goes for an array's
+// name check, which has to happen before a failing index is evaluated
+static char* translate_expr(Translator* translator, int line, Expr expr) {
+	switch (EXPR_TYPE(expr)) {
+		// Folded constants can be negative, and -2147483648 would have type long in C
+		case LITERAL: {
+			int value = get_literal(translator->tree, expr)->value;
+			return value == INT_MIN ? format("(%d - 1)", INT_MIN + 1) : format("%d", value);
+		}
+
+		case VAR: {
+			Var* var = get_var(translator->tree, expr);
+			if (is_mixed_slot(translator, var->slot)) {
+				use_name(translator, var->slot, USES_VAR | USES_KIND);
+				char* name = symbol_name(translator, var->slot);
+				return format("(check_var(&k_%s, %d), v_%s)", name, line, name);
+			}
+			return format("v_%s", use_name(translator, var->slot, USES_VAR));
+		}
+
+		case ARRAY:
+			return translate_element(translator, line, get_array(translator->tree, expr));
+
+		case BINARY: {
+			Binary* binary = get_binary(translator->tree, expr);
+
+			char* left = translate_expr(translator, line, binary->left);
+			if (can_fail(translator, binary->left) && can_fail(translator, binary->right)) {
+				left = hoist(translator, left);
+			}
+			char* right = translate_expr(translator, line, binary->right);
+
+			char* value;
+			switch (binary->type) {
+				case PLUS: value = format("add(%s, %s)", left, right); break;
+				case MINUS: value = format("sub(%s, %s)", left, right); break;
+				case STAR: value = format("mul(%s, %s)", left, right); break;
+				case SLASH: value = format("divide(%s, %s, %d)", left, right, line); break;
+				case MODULO: value = format("modulo(%s, %s, %d)", left, right, line); break;
+				default: value = format("%s %s %s", left, operator(binary->type), right); break;
+			}
+
+			free(left);
+			free(right);
+			return value;
+		}
+
+		default:
+			fprintf(stderr, "Invalid expression type (this shouldn't be printed)\n");
+			exit(EXIT_FAILURE);
+	}
+}
+
+// Returns an lvalue for the element. Accesses that the bounds analysis proved to
+// be in range index the array directly
+static char* translate_element(Translator* translator, int line, Array* array) {
+	use_name(translator, array->slot, USES_ARRAY);
+
+	if (!array->in_bounds && can_fail(translator, array->index)) {
+		emit(translator, "check_array(&a_%s, %d);", symbol_name(translator, array->slot), line);
+	}
+
+	char* idx = translate_expr(translator, line, array->index);
+	char* element;
+	if (array->in_bounds) {
+		element = format("a_%s.elems[%s]", symbol_name(translator, array->slot), idx);
+	} else {
+		element = format("*element(&a_%s, %s, %d)", symbol_name(translator, array->slot), idx,
+			line);
+	}
+	free(idx);
+
+	return element;
+}
+
+// The value is always computed before the lvalue is checked. Takes ownership of value
+static void translate_store(Translator* translator, int line, Expr lvalue, char* value,
+	bool can_fail) {
+	if (EXPR_TYPE(lvalue) == ARRAY) {
+		if (can_fail) {
+			value = hoist(translator, value);
+		}
+
+		char* element = translate_element(translator, line, get_array(translator->tree, lvalue));
+		emit(translator, "%s = %s;", element, value);
+		free(element);
+	} else {
+		// Checking a mixed name after the store is fine, as a failed check is fatal
+		Var* var = get_var(translator->tree, lvalue);
+		use_name(translator, var->slot,
+			USES_VAR | (is_mixed_slot(translator, var->slot) ? USES_KIND : 0));
+		emit(translator, "v_%s = %s;", symbol_name(translator, var->slot), value);
+
+		if (is_mixed_slot(translator, var->slot)) {
+			emit(translator, "check_var(&k_%s, %d);", symbol_name(translator, var->slot), line);
+		}
+	}
+
+	free(value);
+}
+
+// Evaluates value into a new temporary and returns its name. Takes ownership of value
+static char* hoist(Translator* translator, char* value) {
+	int temp = translator->n_temps++;
+	emit(translator, "int t%d = %s;", temp, value);
+	free(value);
+
+	return format("t%d", temp);
+}
+
+// Whether translating expr emits statements before the expression itself
+static bool needs_hoisting(Translator* translator, Expr expr) {
+	switch (EXPR_TYPE(expr)) {
+		case LITERAL: return false;
+		case VAR: return false;
+		case ARRAY: {
+			Array* array = get_array(translator->tree, expr);
+			return (!array->in_bounds && can_fail(translator, array->index)) ||
+			       needs_hoisting(translator, array->index);
+		}
+
+		case BINARY: {
+			Binary* binary = get_binary(translator->tree, expr);
+			return (can_fail(translator, binary->left) && can_fail(translator, binary->right)) ||
+			       needs_hoisting(translator, binary->left) ||
+				needs_hoisting(translator, binary->right);
+		}
+
+		default:
+			fprintf(stderr, "Invalid expression type (this shouldn't be printed)\n");
+			exit(EXIT_FAILURE);
+	}
+}
+
+static bool can_fail(Translator* translator, Expr expr) {
+	switch (EXPR_TYPE(expr)) {
+		case LITERAL: return false;
+		case VAR: return is_mixed_slot(translator, get_var(translator->tree, expr)->slot);
+		case ARRAY: return !get_array(translator->tree, expr)->in_bounds ||
+			can_fail(translator, get_array(translator->tree, expr)->index);
+
+		case BINARY: {
+			Binary* binary = get_binary(translator->tree, expr);
+			return binary->type == SLASH || binary->type == MODULO ||
+			       can_fail(translator, binary->left) || can_fail(translator, binary->right);
+		}
+
+		default:
+			fprintf(stderr, "Invalid expression type (this shouldn't be printed)\n");
+			exit(EXIT_FAILURE);
+	}
+}
+
+static bool is_mixed_slot(Translator* translator, int slot) {
+	return is_mixed_symbol(vector_get(translator->symbols, slot));
+}
+
+static char* symbol_name(Translator* translator, int slot) {
+	return ((Symbol*) vector_get(translator->symbols, slot))->name;
+}
+
+// Same as symbol_name, but also records which of the name's declarations are needed
+static char* use_name(Translator* translator, int slot, int uses) {
+	translator->uses[slot] |= uses;
+	return symbol_name(translator, slot);
+}
+
+static char* operator(TokenType type) {
+	switch (type) {
+		case EQUAL_EQUAL: return "==";
+		case BANG_EQUAL: return "!=";
+		case LESS: return "<";
+		case LESS_EQUAL: return "<=";
+		case GREATER: return ">";
+		case GREATER_EQUAL: return ">=";
+		default:
+			fprintf(stderr, "Invalid operator type (this shouldn't be printed)\n");
+			exit(EXIT_FAILURE);
+	}
+}
+
+static char* format(const char* fmt, ...) {
+	va_list args;
+
+	va_start(args, fmt);
+	int length = vsnprintf(NULL, 0, fmt, args);
+	va_end(args);
+
+	char* str = malloc(length + 1);
+	assert(str != NULL);
+
+	va_start(args, fmt);
+	vsnprintf(str, length + 1, fmt, args);
+	va_end(args);
+
+	return str;
+}
+
+// Writes a line of C at the current indentation
+static void emit(Translator* translator, const char* fmt, ...) {
+	if (fmt[0] != '\0') {
+		for (int i = 0; i < translator->indent; i++) {
+			fputc('\t', translator->out);
+		}
+	}
+
+	va_list args;
+	va_start(args, fmt);
+	vfprintf(translator->out, fmt, args);
+	va_end(args);
+
+	fputc('\n', translator->out);
+}
@@ -0,0 +1,92 @@
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "arena.h"
+#include "expr.h"
+#include "stmt.h"
+#include "tree.h"
+
+#define MIN_CAP 64
+
+// Helper functions used by the tree (no reason to expose them)
+static void init_nodes(NodeArray* nodes, int item_size);
+
+static const int payload_sizes[N_STMT_TYPES] = {
+	[READ_STMT] = sizeof(ReadStmt), [ASSIGNMENT_STMT] = sizeof(AssignmentStmt),
+	[WRITE_STMT] = sizeof(WriteStmt), [WRITELN_STMT] = sizeof(WritelnStmt),
+	[WHILE_STMT] = sizeof(WhileStmt), [IF_ELSE_STMT] = sizeof(IfElseStmt),
+	[RANDOM_STMT] = sizeof(RandomStmt), [ARG_STMT] = sizeof(ArgStmt),
+	[ARG_SIZE_STMT] = sizeof(ArgSizeStmt), [BREAK_STMT] = sizeof(BreakStmt),
+	[CONTINUE_STMT] = sizeof(ContinueStmt), [NEW_STMT] = sizeof(NewStmt),
+	[FREE_STMT] = sizeof(FreeStmt), [SIZE_STMT] = sizeof(SizeStmt)
+};
+
+Tree* tree_create(void) {
+	Tree* tree = malloc(sizeof(Tree));
+	assert(tree != NULL);
+
+	init_nodes(&tree->exprs[LITERAL], sizeof(Literal));
+	init_nodes(&tree->exprs[VAR], sizeof(Var));
+	init_nodes(&tree->exprs[ARRAY], sizeof(Array));
+	init_nodes(&tree->exprs[BINARY], sizeof(Binary));
+
+	for (int type = 0; type < N_STMT_TYPES; type++) {
+		init_nodes(&tree->payloads[type], payload_sizes[type]);
+	}
+
+	init_nodes(&tree->stmts, sizeof(Stmt));
+	tree->arena = arena_create();
+
+	return tree;
+}
+
+// Nothing is allocated until the first node of the kind is added
+static void init_nodes(NodeArray* nodes, int item_size) {
+	nodes->items = NULL;
+	nodes->n_items = 0;
+	nodes->cap = 0;
+	nodes->item_size = item_size;
+}
+
+void tree_destroy(Tree* tree) {
+	assert(tree != NULL);
+
+	for (int type = 0; type < N_EXPR_TYPES; type++) {
+		free(tree->exprs[type].items);
+	}
+	for (int type = 0; type < N_STMT_TYPES; type++) {
+		free(tree->payloads[type].items);
+	}
+
+	free(tree->stmts.items);
+	arena_destroy(tree->arena);
+	free(tree);
+}
+
+int add_nodes(NodeArray* nodes, const void* items, int n) {
+	if (n == 0) {
+		return nodes->n_items; // e.g. an empty program
+	}
+
+	if (nodes->n_items + n > nodes->cap) {
+		int cap = nodes->cap > 0 ? nodes->cap : MIN_CAP;
+		while (cap < nodes->n_items + n) {
+			cap *= 2;
+		}
+
+		nodes->items = realloc(nodes->items, (size_t) cap * nodes->item_size);
+		assert(nodes->items != NULL);
+		nodes->cap = cap;
+	}
+
+	int first = nodes->n_items;
+	memcpy(nodes->items + (size_t) first * nodes->item_size, items, (size_t) n * nodes->item_size);
+	nodes->n_items += n;
+
+	return first;
+}
+
+void* alloc_node(Tree* tree, size_t size) {
+	return arena_alloc(tree->arena, size);
+}
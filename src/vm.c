@@ -0,0 +1,554 @@
+#include <stdio.h>
+#include <assert.h>
+#include <setjmp.h>
+#include <stdlib.h>
+#include <stdbool.h>
+
+#include "error.h"
+#include "runtime.h"
+#include "kernels.h"
+#include "parallel.h"
+#include "bytecode.h"
+#include "jit.h"
+#include "vm.h"
+
+// GCC and Clang can thread the dispatch through labels-as-values, so that every
+// handler ends with its own indirect jump instead of sharing the switch's one.
+// Building with SWITCH_DISPATCH defined (make DISPATCH=switch) uses the switch
+#if defined(__GNUC__) && !defined(SWITCH_DISPATCH)
+#define THREADED_DISPATCH
+#endif
+
+#ifdef THREADED_DISPATCH
+#define CASE(op) L_##op
+#define DISPATCH() do { instr = &code[pc]; goto *vm->handlers[pc++]; } while (0)
+#else
+#define CASE(op) case op
+#define DISPATCH() break
+#endif
+
+// Iterations after which a loop gets compiled to native code
+#define JIT_THRESHOLD 1000
+
+typedef struct loop_state {
+	int iterations;
+	NativeCode* native; // NULL until the loop is compiled
+} LoopState;
+
+typedef struct vm VM;
+
+// Helper functions used by the virtual machine (no reason to expose them)
+static void init_vm(VM* vm, Program* program, int argc, char** argv, VMOptions options,
+	RunIO io);
+static void destroy_vm(VM* vm);
+static VM* create_worker(VM* vm, Program* body);
+static void destroy_machine(VM* vm);
+static int* create_frame(Program* program);
+static void run(VM* vm, int pc);
+static bool run_parallel_loop(VM* vm, int index);
+static int* worker_regs(void* state, int worker);
+static void run_worker(void* state, int worker, int start, int end);
+static void element_error(int line, ArrayDesc* array);
+static void print_stats(VM* vm);
+
+// This is used as a wrapper for the virtual machine's state. The workers of a
+// parallel loop run its body on machines of their own, which share the arrays
+// (and name kinds) of the machine that runs the program
+struct vm {
+	Program* program;
+	int n_args;
+	char** args;
+	int* frame; // Constants followed by the registers
+	int* regs;
+	SlotKind* kinds; // Only kept up to date for names used as arrays
+	ArrayDesc* arrays;
+	void** handlers; // Handler of every instruction when the dispatch is threaded
+	long long* counts; // Execution count of every instruction, only kept for --stats
+	LoopState* loops;
+	bool jit;
+	int n_native; // Loops compiled to native code
+	RunIO io;
+	struct vm** workers; // One machine per thread for every parallel loop (or NULL)
+	int parallel; // The parallel loop that the workers are running
+};
+
+static void init_vm(VM* vm, Program* program, int argc, char** argv, VMOptions options,
+	RunIO io) {
+	vm->program = program;
+	vm->n_args = argc;
+	vm->args = argv;
+	vm->io = io;
+
+	vm->frame = create_frame(program);
+	vm->regs = vm->frame + program->n_consts;
+
+	vm->kinds = calloc(program->n_slots + 1, sizeof(SlotKind));
+	vm->arrays = calloc(program->n_slots + 1, sizeof(ArrayDesc));
+	assert(vm->kinds != NULL && vm->arrays != NULL);
+
+	vm->handlers = NULL; // Filled in by run(), the only place where labels are visible
+
+	vm->counts = NULL;
+	if (options.stats) {
+		vm->counts = calloc(program->n_code, sizeof(long long));
+		assert(vm->counts != NULL);
+	}
+
+	vm->loops = calloc(program->n_loops + 1, sizeof(LoopState));
+	assert(vm->loops != NULL);
+	vm->jit = options.jit;
+	vm->n_native = 0;
+
+	// The workers' machines are only created once their loop runs in parallel
+	vm->workers = calloc(program->n_parallel * get_threads() + 1, sizeof(VM*));
+	assert(vm->workers != NULL);
+	vm->parallel = 0;
+}
+
+static void destroy_vm(VM* vm) {
+	for (int i = 0; i < vm->program->n_slots; i++) {
+		free(vm->arrays[i].elems);
+	}
+
+	free(vm->kinds);
+	free(vm->arrays);
+	free(vm->counts);
+
+	for (int i = 0; i < vm->program->n_parallel * get_threads(); i++) {
+		if (vm->workers[i] != NULL) {
+			destroy_machine(vm->workers[i]);
+			free(vm->workers[i]);
+		}
+	}
+	free(vm->workers);
+
+	destroy_machine(vm);
+}
+
+static VM* create_worker(VM* vm, Program* body) {
+	VM* worker = malloc(sizeof(VM));
+	assert(worker != NULL);
+
+	worker->program = body;
+	worker->n_args = vm->n_args;
+	worker->args = vm->args;
+	worker->io = vm->io;
+
+	worker->frame = create_frame(body);
+	worker->regs = worker->frame + body->n_consts;
+
+	worker->kinds = vm->kinds;
+	worker->arrays = vm->arrays;
+	worker->handlers = NULL;
+	worker->counts = NULL;
+
+	worker->loops = calloc(body->n_loops + 1, sizeof(LoopState));
+	assert(worker->loops != NULL);
+	worker->jit = vm->jit;
+	worker->n_native = 0;
+
+	worker->workers = NULL;
+	worker->parallel = 0;
+
+	return worker;
+}
+
+// Frees the state that every machine has of its own, which is all that a worker has
+static void destroy_machine(VM* vm) {
+	free(vm->frame);
+	free(vm->handlers);
+
+	for (int i = 0; i < vm->program->n_loops; i++) {
+		if (vm->loops[i].native != NULL) {
+			jit_destroy(vm->loops[i].native);
+		}
+	}
+	free(vm->loops);
+}
+
+static int* create_frame(Program* program) {
+	int n_regs = program->n_slots + program->n_temps;
+	int* frame = calloc(program->n_consts + n_regs + 1, sizeof(int));
+	assert(frame != NULL);
+
+	int* regs = frame + program->n_consts;
+	for (int k = 0; k < program->n_consts; k++) {
+		regs[-(k+1)] = program->consts[k];
+	}
+
+	return frame;
+}
+
+void run_program(Program* program, int argc, char **argv, VMOptions options, RunIO io) {
+	VM vm;
+	init_vm(&vm, program, argc, argv, options, io);
+
+	// The machine is torn down before a runtime error is reported any further
+	ErrorTrap trap;
+	ErrorTrap* previous = set_error_trap(&trap);
+
+	if (setjmp(trap.env) != 0) {
+		set_error_trap(previous);
+		destroy_vm(&vm);
+		rethrow_error(&trap);
+	}
+
+	run(&vm, 0);
+	set_error_trap(previous);
+
+	if (options.stats) {
+		print_stats(&vm);
+	}
+
+	destroy_vm(&vm);
+}
+
+static void run(VM* vm, int pc) {
+	Instr* code = vm->program->code;
+	int* regs = vm->regs;
+	Instr* instr;
+
+#ifdef THREADED_DISPATCH
+	static void* const labels[] = {
+		[OP_MOVE] = &&L_OP_MOVE, [OP_ADD] = &&L_OP_ADD, [OP_SUB] = &&L_OP_SUB,
+		[OP_MUL] = &&L_OP_MUL, [OP_DIV] = &&L_OP_DIV, [OP_MOD] = &&L_OP_MOD,
+		[OP_JUMP] = &&L_OP_JUMP, [OP_JUMP_ZERO] = &&L_OP_JUMP_ZERO,
+		[OP_JUMP_NOT_ZERO] = &&L_OP_JUMP_NOT_ZERO, [OP_JUMP_EQ] = &&L_OP_JUMP_EQ,
+		[OP_JUMP_NE] = &&L_OP_JUMP_NE, [OP_JUMP_LT] = &&L_OP_JUMP_LT,
+		[OP_JUMP_LE] = &&L_OP_JUMP_LE, [OP_JUMP_GT] = &&L_OP_JUMP_GT,
+		[OP_JUMP_GE] = &&L_OP_JUMP_GE, [OP_GET_ELEM] = &&L_OP_GET_ELEM,
+		[OP_SET_ELEM] = &&L_OP_SET_ELEM, [OP_CHECK_VAR] = &&L_OP_CHECK_VAR,
+		[OP_CHECK_ARRAY] = &&L_OP_CHECK_ARRAY, [OP_CHECK_NEW] = &&L_OP_CHECK_NEW,
+		[OP_NEW] = &&L_OP_NEW, [OP_FREE] = &&L_OP_FREE, [OP_SIZE] = &&L_OP_SIZE,
+		[OP_READ] = &&L_OP_READ, [OP_RANDOM] = &&L_OP_RANDOM, [OP_ARG] = &&L_OP_ARG,
+		[OP_ARG_SIZE] = &&L_OP_ARG_SIZE, [OP_WRITE] = &&L_OP_WRITE,
+		[OP_WRITELN] = &&L_OP_WRITELN, [OP_WRITE_SPACE] = &&L_OP_WRITE_SPACE,
+		[OP_WRITE_NEWLINE] = &&L_OP_WRITE_NEWLINE, [OP_ERROR] = &&L_OP_ERROR,
+		[OP_HALT] = &&L_OP_HALT, [OP_LOOP_HEAD] = &&L_OP_LOOP_HEAD,
+		[OP_KERNEL] = &&L_OP_KERNEL, [OP_PARALLEL] = &&L_OP_PARALLEL,
+		[OP_INCREMENT] = &&L_OP_INCREMENT,
+		[OP_JUMP_EQ_IMM] = &&L_OP_JUMP_EQ_IMM, [OP_JUMP_NE_IMM] = &&L_OP_JUMP_NE_IMM,
+		[OP_JUMP_LT_IMM] = &&L_OP_JUMP_LT_IMM, [OP_JUMP_LE_IMM] = &&L_OP_JUMP_LE_IMM,
+		[OP_JUMP_GT_IMM] = &&L_OP_JUMP_GT_IMM, [OP_JUMP_GE_IMM] = &&L_OP_JUMP_GE_IMM,
+		[OP_ADD_ELEM] = &&L_OP_ADD_ELEM, [OP_SUB_ELEM] = &&L_OP_SUB_ELEM
+	};
+
+	// Direct threading: resolve every instruction's handler once, up front. When
+	// profiling, every instruction goes through the counting handler first
+	if (vm->handlers == NULL) {
+		vm->handlers = malloc(vm->program->n_code * sizeof(void*));
+		assert(vm->handlers != NULL);
+
+		for (int i = 0; i < vm->program->n_code; i++) {
+			vm->handlers[i] = vm->counts != NULL ? &&L_PROFILE : labels[code[i].op];
+		}
+	}
+
+	DISPATCH();
+
+L_PROFILE:
+	vm->counts[pc-1]++;
+	goto *labels[instr->op];
+#else
+	for (;;) {
+		instr = &code[pc++];
+
+		if (vm->counts != NULL) {
+			vm->counts[pc-1]++;
+		}
+
+		switch (instr->op) {
+#endif
+			CASE(OP_MOVE):
+				regs[instr->a] = regs[instr->b];
+				DISPATCH();
+
+			// Wrap around on overflow instead of relying on undefined behavior
+			CASE(OP_ADD):
+				regs[instr->a] = (int) ((unsigned) regs[instr->b] + (unsigned) regs[instr->c]);
+				DISPATCH();
+
+			CASE(OP_SUB):
+				regs[instr->a] = (int) ((unsigned) regs[instr->b] - (unsigned) regs[instr->c]);
+				DISPATCH();
+
+			CASE(OP_MUL):
+				regs[instr->a] = (int) ((unsigned) regs[instr->b] * (unsigned) regs[instr->c]);
+				DISPATCH();
+
+			CASE(OP_DIV):
+				if (regs[instr->c] == 0) {
+					runtime_error("division with 0", vm->program->lines[pc-1], EDIV_ZERO);
+				}
+				regs[instr->a] = regs[instr->b] / regs[instr->c];
+				DISPATCH();
+
+			CASE(OP_MOD):
+				if (regs[instr->c] == 0) {
+					runtime_error("division with 0", vm->program->lines[pc-1], EDIV_ZERO);
+				}
+				regs[instr->a] = regs[instr->b] % regs[instr->c];
+				DISPATCH();
+
+			CASE(OP_JUMP): pc = instr->a; DISPATCH();
+			CASE(OP_JUMP_ZERO): if (regs[instr->b] == 0) pc = instr->a; DISPATCH();
+			CASE(OP_JUMP_NOT_ZERO): if (regs[instr->b] != 0) pc = instr->a; DISPATCH();
+			CASE(OP_JUMP_EQ): if (regs[instr->b] == regs[instr->c]) pc = instr->a; DISPATCH();
+			CASE(OP_JUMP_NE): if (regs[instr->b] != regs[instr->c]) pc = instr->a; DISPATCH();
+			CASE(OP_JUMP_LT): if (regs[instr->b] < regs[instr->c]) pc = instr->a; DISPATCH();
+			CASE(OP_JUMP_LE): if (regs[instr->b] <= regs[instr->c]) pc = instr->a; DISPATCH();
+			CASE(OP_JUMP_GT): if (regs[instr->b] > regs[instr->c]) pc = instr->a; DISPATCH();
+			CASE(OP_JUMP_GE): if (regs[instr->b] >= regs[instr->c]) pc = instr->a; DISPATCH();
+
+			CASE(OP_GET_ELEM): {
+				// Names that aren't arrays have size 0, so one check covers both errors
+				ArrayDesc* array = &vm->arrays[instr->b];
+				int idx = regs[instr->c];
+				if ((unsigned) idx >= (unsigned) array->size) {
+					element_error(vm->program->lines[pc-1], array);
+				}
+				regs[instr->a] = array->elems[idx];
+				DISPATCH();
+			}
+
+			CASE(OP_SET_ELEM): {
+				ArrayDesc* array = &vm->arrays[instr->a];
+				int idx = regs[instr->b];
+				if ((unsigned) idx >= (unsigned) array->size) {
+					element_error(vm->program->lines[pc-1], array);
+				}
+				array->elems[idx] = regs[instr->c];
+				DISPATCH();
+			}
+
+			CASE(OP_CHECK_VAR):
+				// An unbound variable's register is still 0, so binding it is enough
+				if (vm->kinds[instr->a] == BOUND_ARRAY) {
+					runtime_error("expected a variable name", vm->program->lines[pc-1], EBAD_VAR);
+				}
+				vm->kinds[instr->a] = BOUND_VAR;
+				DISPATCH();
+
+			CASE(OP_CHECK_ARRAY):
+				if (vm->kinds[instr->a] != BOUND_ARRAY) {
+					runtime_error("name does not correspond to an array",
+						vm->program->lines[pc-1], EBAD_ARRAY);
+				}
+				DISPATCH();
+
+			CASE(OP_CHECK_NEW):
+				if (vm->kinds[instr->a] == BOUND_VAR) {
+					runtime_error("array name overlaps with variable name",
+						vm->program->lines[pc-1], EBAD_ID);
+				}
+				DISPATCH();
+
+			CASE(OP_NEW): {
+				int size = regs[instr->b];
+				if (size <= 0) {
+					runtime_error("array size must be greater than 0",
+						vm->program->lines[pc-1], EBAD_SIZE);
+				}
+
+				int* elems = calloc(size, sizeof(int)); // Implicit 0-initialization
+				assert(elems != NULL);
+
+				ArrayDesc* array = &vm->arrays[instr->a];
+				free(array->elems); // Old array (if any) gets deallocated
+
+				array->size = size;
+				array->elems = elems;
+				vm->kinds[instr->a] = BOUND_ARRAY;
+				DISPATCH();
+			}
+
+			CASE(OP_FREE): {
+				if (vm->kinds[instr->a] != BOUND_ARRAY) {
+					runtime_error("name does not correspond to an array",
+						vm->program->lines[pc-1], EBAD_ARRAY);
+				}
+
+				ArrayDesc* array = &vm->arrays[instr->a];
+				free(array->elems);
+
+				array->size = 0;
+				array->elems = NULL;
+				vm->kinds[instr->a] = UNBOUND;
+				DISPATCH();
+			}
+
+			CASE(OP_SIZE):
+				if (vm->kinds[instr->b] != BOUND_ARRAY) {
+					runtime_error("name does not correspond to an array",
+						vm->program->lines[pc-1], EBAD_ARRAY);
+				}
+				regs[instr->a] = vm->arrays[instr->b].size;
+				DISPATCH();
+
+			CASE(OP_READ):
+				regs[instr->a] = read_input(&vm->io);
+				DISPATCH();
+
+			CASE(OP_RANDOM):
+				regs[instr->a] = draw_random(&vm->io);
+				DISPATCH();
+
+			CASE(OP_ARG): {
+				int pos = regs[instr->b];
+				if (pos < 1 || pos > vm->n_args-2) {
+					runtime_error("invalid argument index", vm->program->lines[pc-1], EBAD_IDX);
+				}
+				regs[instr->a] = atoi(vm->args[pos+1]);
+				DISPATCH();
+			}
+
+			CASE(OP_ARG_SIZE):
+				regs[instr->a] = vm->n_args;
+				DISPATCH();
+
+			CASE(OP_WRITE): fprintf(vm->io.out, "%d ", regs[instr->a]); DISPATCH();
+			CASE(OP_WRITELN): fprintf(vm->io.out, "%d\n", regs[instr->a]); DISPATCH();
+			CASE(OP_WRITE_SPACE): fputc(' ', vm->io.out); DISPATCH();
+			CASE(OP_WRITE_NEWLINE): fputc('\n', vm->io.out); DISPATCH();
+
+			CASE(OP_ERROR):
+				if (instr->a == EBAD_BREAK) {
+					runtime_error("invalid break statement", vm->program->lines[pc-1], EBAD_BREAK);
+				}
+				runtime_error("invalid continue statement", vm->program->lines[pc-1], EBAD_CONT);
+				DISPATCH();
+
+			CASE(OP_HALT):
+				return;
+
+			CASE(OP_LOOP_HEAD): {
+				LoopState* loop = &vm->loops[instr->a];
+
+				if (loop->native == NULL && vm->jit && ++loop->iterations == JIT_THRESHOLD) {
+					loop->native = jit_compile(vm->program, pc-1);
+					vm->n_native += loop->native != NULL;
+				}
+
+				if (loop->native != NULL) {
+					pc = loop->native->entry(regs, vm->arrays);
+				}
+				DISPATCH();
+			}
+
+			CASE(OP_KERNEL):
+				if (run_idiom(&vm->program->idioms[instr->b], regs, vm->arrays)) {
+					pc = instr->a;
+				}
+				DISPATCH();
+
+			CASE(OP_PARALLEL):
+				if (run_parallel_loop(vm, instr->b)) {
+					pc = instr->a;
+				}
+				DISPATCH();
+
+			CASE(OP_INCREMENT):
+				regs[instr->a] = (int) ((unsigned) regs[instr->a] + (unsigned) instr->b);
+				DISPATCH();
+
+			CASE(OP_JUMP_EQ_IMM): if (regs[instr->b] == instr->c) pc = instr->a; DISPATCH();
+			CASE(OP_JUMP_NE_IMM): if (regs[instr->b] != instr->c) pc = instr->a; DISPATCH();
+			CASE(OP_JUMP_LT_IMM): if (regs[instr->b] < instr->c) pc = instr->a; DISPATCH();
+			CASE(OP_JUMP_LE_IMM): if (regs[instr->b] <= instr->c) pc = instr->a; DISPATCH();
+			CASE(OP_JUMP_GT_IMM): if (regs[instr->b] > instr->c) pc = instr->a; DISPATCH();
+			CASE(OP_JUMP_GE_IMM): if (regs[instr->b] >= instr->c) pc = instr->a; DISPATCH();
+
+			CASE(OP_ADD_ELEM): {
+				ArrayDesc* array = &vm->arrays[instr->a];
+				int idx = regs[instr->b];
+				if ((unsigned) idx >= (unsigned) array->size) {
+					element_error(vm->program->lines[pc-1], array);
+				}
+				array->elems[idx] = (int) ((unsigned) array->elems[idx] + (unsigned) regs[instr->c]);
+				DISPATCH();
+			}
+
+			CASE(OP_SUB_ELEM): {
+				ArrayDesc* array = &vm->arrays[instr->a];
+				int idx = regs[instr->b];
+				if ((unsigned) idx >= (unsigned) array->size) {
+					element_error(vm->program->lines[pc-1], array);
+				}
+				array->elems[idx] = (int) ((unsigned) array->elems[idx] - (unsigned) regs[instr->c]);
+				DISPATCH();
+			}
+
+#ifndef THREADED_DISPATCH
+			default:
+				fprintf(stderr, "Invalid instruction (this shouldn't be printed)\n");
+				exit(EXIT_FAILURE);
+		}
+	}
+#endif
+}
+
+static bool run_parallel_loop(VM* vm, int index) {
+	LoopBody body = { .vars = worker_regs, .run = run_worker, .state = vm };
+	vm->parallel = index;
+
+	return run_parallel(vm->program->parallel[index].loop, vm->regs, vm->program->n_slots, &body);
+}
+
+// A worker's variables are the registers of its machine, so its iterations run the
+// body's code just like the program's own code runs (see compile_parallel_body)
+static int* worker_regs(void* state, int worker) {
+	VM* vm = state;
+
+	VM** machine = &vm->workers[vm->parallel * get_threads() + worker];
+	if (*machine == NULL) {
+		*machine = create_worker(vm, vm->program->parallel[vm->parallel].body);
+	}
+
+	return (*machine)->regs;
+}
+
+static void run_worker(void* state, int worker, int start, int end) {
+	VM* vm = state;
+	VM* machine = vm->workers[vm->parallel * get_threads() + worker];
+	ParallelCode* parallel = &vm->program->parallel[vm->parallel];
+
+	machine->regs[parallel->loop->counter] = start;
+	machine->regs[parallel->end] = end;
+	run(machine, 0);
+}
+
+static void element_error(int line, ArrayDesc* array) {
+	if (array->elems == NULL) {
+		runtime_error("name does not correspond to an array", line, EBAD_ARRAY);
+	}
+
+	runtime_error("array index out of bounds", line, EIDX_OOB);
+}
+
+// Reports how often each peephole pattern was applied and how many instructions
+// that it produced were executed
+static void print_stats(VM* vm) {
+	static const char* const names[N_FUSIONS] = {
+		[NO_FUSION] = "unfused",
+		[FUSED_INCREMENT] = "increment by constant",
+		[FUSED_COMPARE_BRANCH] = "compare with constant",
+		[FUSED_ELEM_UPDATE] = "element update",
+		[FUSED_OP_INTO_VAR] = "op into variable"
+	};
+
+	int sites[N_FUSIONS] = {0};
+	long long executed[N_FUSIONS] = {0};
+
+	for (int pc = 0; pc < vm->program->n_code; pc++) {
+		sites[vm->program->fusions[pc]]++;
+		executed[vm->program->fusions[pc]] += vm->counts[pc];
+	}
+
+	fprintf(stderr, "%-24s %8s %16s\n", "instructions", "sites", "executed");
+	for (int i = 0; i < N_FUSIONS; i++) {
+		fprintf(stderr, "%-24s %8d %16lld\n", names[i], sites[i], executed[i]);
+	}
+
+	// Instructions that ran as native code aren't counted above
+	fprintf(stderr, "%-24s %8d\n", "native loops", vm->n_native);
+}
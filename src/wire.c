@@ -0,0 +1,152 @@
+#include <assert.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <stdbool.h>
+#include <sys/socket.h>
+
+#include "wire.h"
+
+// Strings longer than this are taken to be garbage rather than a path or argument
+#define MAX_STRING (1 << 20)
+#define MAX_STRINGS (1 << 16)
+
+// Helper functions used by the protocol (no reason to expose them)
+static bool write_all(int sock, const void* buf, size_t size);
+static bool read_all(int sock, void* buf, size_t size);
+
+bool send_request(int sock, int streams[N_STREAMS], int n_strings, char** strings) {
+	// The streams ride along with the number of strings, so that they arrive first
+	uint32_t count = n_strings;
+	struct iovec iov = { .iov_base = &count, .iov_len = sizeof(count) };
+
+	char control[CMSG_SPACE(N_STREAMS * sizeof(int))];
+	memset(control, 0, sizeof(control));
+
+	struct msghdr msg = {
+		.msg_iov = &iov, .msg_iovlen = 1,
+		.msg_control = control, .msg_controllen = sizeof(control)
+	};
+
+	struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+	cmsg->cmsg_level = SOL_SOCKET;
+	cmsg->cmsg_type = SCM_RIGHTS;
+	cmsg->cmsg_len = CMSG_LEN(N_STREAMS * sizeof(int));
+	memcpy(CMSG_DATA(cmsg), streams, N_STREAMS * sizeof(int));
+
+	if (sendmsg(sock, &msg, 0) != sizeof(count)) {
+		return false;
+	}
+
+	for (int i = 0; i < n_strings; i++) {
+		uint32_t len = strlen(strings[i]);
+		if (!write_all(sock, &len, sizeof(len)) || !write_all(sock, strings[i], len)) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+bool receive_request(int sock, int streams[N_STREAMS], int* n_strings, char*** strings) {
+	uint32_t count;
+	struct iovec iov = { .iov_base = &count, .iov_len = sizeof(count) };
+
+	char control[CMSG_SPACE(N_STREAMS * sizeof(int))];
+	struct msghdr msg = {
+		.msg_iov = &iov, .msg_iovlen = 1,
+		.msg_control = control, .msg_controllen = sizeof(control)
+	};
+
+	if (recvmsg(sock, &msg, MSG_CMSG_CLOEXEC) != sizeof(count)) {
+		return false;
+	}
+
+	struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+	if (cmsg == NULL || cmsg->cmsg_type != SCM_RIGHTS ||
+		cmsg->cmsg_len != CMSG_LEN(N_STREAMS * sizeof(int))) {
+		return false;
+	}
+
+	memcpy(streams, CMSG_DATA(cmsg), N_STREAMS * sizeof(int));
+
+	// A request always names a program
+	if (count < 1 || count > MAX_STRINGS) {
+		for (int i = 0; i < N_STREAMS; i++) {
+			close(streams[i]);
+		}
+		return false;
+	}
+
+	*strings = calloc(count, sizeof(char*));
+	assert(*strings != NULL);
+	*n_strings = count;
+
+	bool complete = true;
+	for (int i = 0; complete && i < (int) count; i++) {
+		uint32_t len;
+		complete = read_all(sock, &len, sizeof(len)) && len <= MAX_STRING;
+
+		if (complete) {
+			(*strings)[i] = malloc(len + 1);
+			assert((*strings)[i] != NULL);
+
+			complete = read_all(sock, (*strings)[i], len);
+			(*strings)[i][len] = '\0';
+		}
+	}
+
+	if (!complete) {
+		free_strings(count, *strings);
+		for (int i = 0; i < N_STREAMS; i++) {
+			close(streams[i]);
+		}
+	}
+
+	return complete;
+}
+
+void free_strings(int n_strings, char** strings) {
+	for (int i = 0; i < n_strings; i++) {
+		free(strings[i]);
+	}
+	free(strings);
+}
+
+bool send_status(int sock, int status) {
+	int32_t value = status;
+	return write_all(sock, &value, sizeof(value));
+}
+
+bool receive_status(int sock, int* status) {
+	int32_t value;
+	if (!read_all(sock, &value, sizeof(value))) {
+		return false;
+	}
+
+	*status = value;
+	return true;
+}
+
+static bool write_all(int sock, const void* buf, size_t size) {
+	for (size_t done = 0; done < size;) {
+		ssize_t n = write(sock, (const char*) buf + done, size - done);
+		if (n <= 0) {
+			return false;
+		}
+		done += n;
+	}
+	return true;
+}
+
+static bool read_all(int sock, void* buf, size_t size) {
+	for (size_t done = 0; done < size;) {
+		ssize_t n = read(sock, (char*) buf + done, size - done);
+		if (n <= 0) {
+			return false;
+		}
+		done += n;
+	}
+	return true;
+}